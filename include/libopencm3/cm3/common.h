@@ -46,6 +46,17 @@
 #	define LIBOPENCM3_DEPRECATED(x)
 #endif
 
+/* Hot paths the speed flavors of the library run from RAM, clear of the flash
+ * wait states. The linker scripts copy .ramtext to RAM along with .data, out
+ * of branch range of flash, hence the long calls.
+ */
+#if defined(LIBOPENCM3_RAMFUNCS) && !defined(LIBOPENCM3_HOST)
+#	define LIBOPENCM3_RAMFUNC \
+		__attribute__((long_call, noinline, section(".ramtext")))
+#else
+#	define LIBOPENCM3_RAMFUNC
+#endif
+
 
 #if defined (__ASSEMBLER__)
 #define MMIO8(addr)	(addr)
@@ -58,6 +69,32 @@
 
 #define BBIO_PERIPH(addr, bit) \
 	(((addr) & 0x0FFFFF) * 32 + 0x42000000 + (bit) * 4)
+#elif defined(LIBOPENCM3_HOST)
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Host build: registers live in the simulated register file, see
+ * libopencm3/host/mmio_sim.h
+ */
+BEGIN_DECLS
+volatile void *mmio_sim_reg(uint32_t addr, uint8_t size);
+END_DECLS
+
+#define MMIO8(addr)		(*(volatile uint8_t *) \
+				 mmio_sim_reg((uint32_t)(addr), 1))
+#define MMIO16(addr)		(*(volatile uint16_t *) \
+				 mmio_sim_reg((uint32_t)(addr), 2))
+#define MMIO32(addr)		(*(volatile uint32_t *) \
+				 mmio_sim_reg((uint32_t)(addr), 4))
+#define MMIO64(addr)		(*(volatile uint64_t *) \
+				 mmio_sim_reg((uint32_t)(addr), 8))
+
+#define BBIO_SRAM(addr, bit) \
+	MMIO32((((uint32_t)addr) & 0x0FFFFF) * 32 + 0x22000000 + (bit) * 4)
+
+#define BBIO_PERIPH(addr, bit) \
+	MMIO32((((uint32_t)addr) & 0x0FFFFF) * 32 + 0x42000000 + (bit) * 4)
 #else
 
 #include <stdint.h>
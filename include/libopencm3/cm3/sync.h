@@ -39,8 +39,14 @@ void __dmb(void);
 uint32_t __ldrex(volatile uint32_t *addr);
 uint32_t __strex(uint32_t val, volatile uint32_t *addr);
 
+#endif
+
 /* --- Convenience functions ----------------------------------------------- */
 
+/* On the host the mutexes are built on the compiler atomics instead */
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || \
+	defined(LIBOPENCM3_HOST)
+
 /* Here we implement some simple synchronisation primitives. */
 
 typedef uint32_t mutex_t;
@@ -0,0 +1,158 @@
+/** @defgroup pl230_defines PL230 uDMA Defines
+ *
+ * @brief <b>Defined Constants and Types for the ARM PL230 uDMA cycle engine</b>
+ *
+ * The PL230 micro DMA controller is used by the EFM32 DMA and the LM4F
+ * uDMA. This is the part shared by both: the channel control structures
+ * and the cycle engine. The family drivers own the control table and the
+ * interrupt flags, which the vendors added outside of the PL230, and wrap
+ * these functions in their own API.
+ *
+ * LGPL License Terms @ref lgpl_license
+ */
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_PL230_H
+#define LIBOPENCM3_PL230_H
+
+#include <libopencm3/cm3/common.h>
+
+/**@{*/
+
+/* --- PL230 registers, relative to the controller base -------------------- */
+
+#define PL230_CFG(base)			MMIO32((base) + 0x004)
+#define PL230_CTRLBASE(base)		MMIO32((base) + 0x008)
+#define PL230_SWREQ(base)		MMIO32((base) + 0x014)
+#define PL230_USEBURSTCLR(base)		MMIO32((base) + 0x01C)
+#define PL230_REQMASKCLR(base)		MMIO32((base) + 0x024)
+#define PL230_ENASET(base)		MMIO32((base) + 0x028)
+#define PL230_ENACLR(base)		MMIO32((base) + 0x02C)
+#define PL230_ALTSET(base)		MMIO32((base) + 0x030)
+#define PL230_ALTCLR(base)		MMIO32((base) + 0x034)
+
+#define PL230_CFG_MASTEN		(1 << 0)
+
+/* --- Channel control word ------------------------------------------------ */
+
+#define PL230_CTRL_DST_INC_SHIFT	30
+#define PL230_CTRL_DST_INC_MASK		(0x3U << PL230_CTRL_DST_INC_SHIFT)
+#define PL230_CTRL_DST_SIZE_SHIFT	28
+#define PL230_CTRL_SRC_INC_SHIFT	26
+#define PL230_CTRL_SRC_INC_MASK		(0x3 << PL230_CTRL_SRC_INC_SHIFT)
+#define PL230_CTRL_SRC_SIZE_SHIFT	24
+#define PL230_CTRL_R_POWER_SHIFT	14
+#define PL230_CTRL_N_MINUS_1_SHIFT	4
+#define PL230_CTRL_N_MINUS_1_MASK	(0x3ff << PL230_CTRL_N_MINUS_1_SHIFT)
+#define PL230_CTRL_CYCLE_CTRL_SHIFT	0
+#define PL230_CTRL_CYCLE_CTRL_MASK	(0x7 << PL230_CTRL_CYCLE_CTRL_SHIFT)
+
+/** Increment encoding for no increment, the others are log2 of the step */
+#define PL230_INC_NONE			3
+/** Size and increment encoding of a word */
+#define PL230_WORD			2
+
+/** Largest transfer count of one control structure */
+#define PL230_MAX_COUNT			1024
+
+/** Cycle types of the cycle_ctrl field */
+enum pl230_mode {
+	PL230_MODE_STOP = 0,
+	PL230_MODE_BASIC,
+	PL230_MODE_AUTO,
+	PL230_MODE_PING_PONG,
+	PL230_MODE_MEM_SG,
+	PL230_MODE_MEM_SG_ALT,
+	PL230_MODE_PERIPH_SG,
+	PL230_MODE_PERIPH_SG_ALT,
+};
+
+/** Channel control structure, also a scatter-gather task */
+struct pl230_desc {
+	uint32_t src_end;
+	uint32_t dst_end;
+	uint32_t control;
+	uint32_t user;
+} __attribute__((packed));
+
+/* --- Cycle engine -------------------------------------------------------- */
+
+/** Events passed to the channel callback */
+#define PL230_EVENT_DONE		(1 << 0)
+/** The alternate half of a ping-pong channel completed */
+#define PL230_EVENT_ALTERNATE		(1 << 1)
+#define PL230_EVENT_ERROR		(1 << 2)
+
+typedef void (*pl230_callback)(uint8_t ch, uint32_t events, void *user_data);
+
+/** Per channel state of the cycle engine */
+struct pl230_chan {
+	pl230_callback callback;
+	void *user_data;
+	/** Control words of the two halves of a ping-pong channel */
+	uint32_t ping_pong_control[2];
+};
+
+/** One controller, set up by the family driver */
+struct pl230 {
+	uint32_t base;
+	/** Primary and alternate control structures of channel 0 */
+	struct pl230_desc *primary;
+	struct pl230_desc *alternate;
+	/** State of each channel, @ref channels entries */
+	struct pl230_chan *chan;
+	uint8_t channels;
+	/** Clear the done flag of a channel about to start, and enable its
+	 * interrupt if @p irq where the vendor allows to
+	 */
+	void (*arm)(uint8_t ch, bool irq);
+	/** Channels running a ping-pong stream */
+	uint32_t ping_pong;
+	/** Channels started and not yet done */
+	uint32_t active;
+};
+
+BEGIN_DECLS
+
+void pl230_init(struct pl230 *dma);
+void pl230_desc_build(struct pl230_desc *desc, enum pl230_mode mode,
+		      uint32_t src, uint32_t dst, uint16_t count,
+		      uint32_t control);
+void pl230_set_callback(struct pl230 *dma, uint8_t ch,
+			pl230_callback callback, void *user_data);
+void pl230_cycle_basic(struct pl230 *dma, uint8_t ch, uint32_t src,
+		       uint32_t dst, uint16_t count, uint32_t control);
+void pl230_cycle_auto(struct pl230 *dma, uint8_t ch, uint32_t src,
+		      uint32_t dst, uint16_t count, uint32_t control);
+void pl230_cycle_ping_pong(struct pl230 *dma, uint8_t ch, uint32_t src0,
+			   uint32_t dst0, uint32_t src1, uint32_t dst1,
+			   uint16_t count, uint32_t control);
+int pl230_cycle_scatter_gather(struct pl230 *dma, uint8_t ch,
+			       struct pl230_desc *tasks, uint16_t task_count,
+			       bool periph);
+void pl230_cycle_stop(struct pl230 *dma, uint8_t ch);
+bool pl230_cycle_busy(struct pl230 *dma, uint8_t ch);
+uint16_t pl230_cycle_remaining(struct pl230 *dma, uint8_t ch);
+void pl230_irq_done(struct pl230 *dma, uint32_t channels);
+void pl230_irq_error(struct pl230 *dma, uint32_t channels);
+
+END_DECLS
+
+/**@}*/
+
+#endif
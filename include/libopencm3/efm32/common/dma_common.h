@@ -23,6 +23,7 @@
 
 #include <libopencm3/efm32/memorymap.h>
 #include <libopencm3/cm3/common.h>
+#include <libopencm3/dma/pl230.h>
 
 /**@{*/
 
@@ -754,6 +755,19 @@ enum dma_r_power {
 	DMA_R_POWER_1024
 };
 
+/* Channels of the control structure table managed by dma_table_init() */
+#define DMA_CHANNELS		12
+/* Most transfers of a single cycle, the width of N_MINUS_1 */
+#define DMA_MAX_COUNT		PL230_MAX_COUNT
+
+/* Events passed to the callback */
+#define DMA_EVENT_DONE		PL230_EVENT_DONE
+/* In ping-pong mode: the half that completed is the alternate one */
+#define DMA_EVENT_ALTERNATE	PL230_EVENT_ALTERNATE
+#define DMA_EVENT_ERROR		PL230_EVENT_ERROR
+
+typedef pl230_callback dma_callback;
+
 BEGIN_DECLS
 
 void dma_enable(void);
@@ -909,6 +923,28 @@ void dma_desc_set_mode(uint32_t desc_base, enum dma_ch ch, enum dma_mode mode);
 #define dma_set_alt_mode(ch, mode)	\
 	dma_desc_set_mode(DMA_ALTCTRLBASE, ch, mode)
 
+/* Control structure table (prefix "dma_table_"), cycle engine (prefix
+ * "dma_cycle_") and its callbacks, dma_desc_build() fills the structures
+ */
+void dma_table_init(void);
+struct pl230_desc *dma_table_primary(enum dma_ch ch);
+struct pl230_desc *dma_table_alternate(enum dma_ch ch);
+void dma_desc_build(struct pl230_desc *desc, enum dma_mode mode,
+		    uint32_t src, uint32_t dest, uint16_t count, uint32_t cfg);
+void dma_set_callback(enum dma_ch ch, dma_callback callback,
+		      void *user_data);
+void dma_cycle_basic(enum dma_ch ch, uint32_t src, uint32_t dest,
+		     uint16_t count, uint32_t cfg);
+void dma_cycle_auto(enum dma_ch ch, uint32_t src, uint32_t dest,
+		    uint16_t count, uint32_t cfg);
+void dma_cycle_ping_pong(enum dma_ch ch, uint32_t src0, uint32_t dest0,
+			 uint32_t src1, uint32_t dest1, uint16_t count,
+			 uint32_t cfg);
+int dma_cycle_scatter_gather(enum dma_ch ch, struct pl230_desc *tasks,
+			     uint16_t task_count, bool periph);
+void dma_cycle_stop(enum dma_ch ch);
+void dma_irq_handler(void);
+
 END_DECLS
 
 /**@}*/
\ No newline at end of file
@@ -0,0 +1,65 @@
+/** @defgroup mmio_sim_defines Simulated MMIO
+ *
+ * @brief <b>Simulated register file for host builds</b>
+ *
+ * @ingroup host_defines
+ *
+ * LGPL License Terms @ref lgpl_license
+ */
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_HOST_MMIO_SIM_H
+#define LIBOPENCM3_HOST_MMIO_SIM_H
+
+#include <libopencm3/cm3/common.h>
+
+/**@{*/
+
+/** Size of the regions created on the first access to an unknown address */
+#define MMIO_SIM_PAGE_SIZE	4096
+
+/** Peripheral model of an address range, see @ref mmio_sim_attach */
+struct mmio_sim_ops {
+	/** Called before each access, the model may update the register
+	 * first, e.g. set a status flag. NULL if not needed.
+	 */
+	void (*access)(uint32_t addr, uint8_t size, void *user_data);
+	/** Called after each store to a register, with the value before and
+	 * after. Where stores are trapped this runs in their signal handler,
+	 * state shared with code storing to registers directly must be
+	 * volatile. NULL if not needed.
+	 */
+	void (*write)(uint32_t addr, uint8_t size, uint64_t old, uint64_t val,
+		      void *user_data);
+};
+
+BEGIN_DECLS
+
+int mmio_sim_attach(uint32_t base, uint32_t size,
+		    const struct mmio_sim_ops *ops, void *user_data);
+void *mmio_sim_mem(uint32_t addr, uint32_t size);
+void mmio_sim_flush(void);
+void mmio_sim_reset(void);
+uint32_t mmio_sim_peek32(uint32_t addr);
+void mmio_sim_poke32(uint32_t addr, uint32_t val);
+
+END_DECLS
+
+/**@}*/
+
+#endif
@@ -80,6 +80,8 @@
 
 #define USB_BASE			(0x40050000U)
 
+#define UDMA_BASE			(0x400FF000U)
+
 #define SYSCTL_BASE			(0x400FE000U)
 
 #endif
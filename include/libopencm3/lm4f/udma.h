@@ -0,0 +1,244 @@
+/** @defgroup udma_defines uDMA Control
+ *
+ * @brief <b>Defined Constants and Types for the LM4F Micro Direct Memory
+ * Access controller</b>
+ *
+ * @ingroup LM4Fxx_defines
+ *
+ * LGPL License Terms @ref lgpl_license
+ */
+
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_LM4F_UDMA_H
+#define LIBOPENCM3_LM4F_UDMA_H
+
+/**@{*/
+
+#include <libopencm3/lm4f/memorymap.h>
+#include <libopencm3/cm3/common.h>
+#include <libopencm3/dma/pl230.h>
+
+/* =============================================================================
+ * uDMA registers
+ * ---------------------------------------------------------------------------*/
+
+/* DMA Status */
+#define UDMA_STAT			MMIO32(UDMA_BASE + 0x000)
+
+/* DMA Configuration */
+#define UDMA_CFG			MMIO32(UDMA_BASE + 0x004)
+
+/* DMA Channel Control Base Pointer */
+#define UDMA_CTLBASE			MMIO32(UDMA_BASE + 0x008)
+
+/* DMA Alternate Channel Control Base Pointer */
+#define UDMA_ALTBASE			MMIO32(UDMA_BASE + 0x00C)
+
+/* DMA Channel Wait-on-Request Status */
+#define UDMA_WAITSTAT			MMIO32(UDMA_BASE + 0x010)
+
+/* DMA Channel Software Request */
+#define UDMA_SWREQ			MMIO32(UDMA_BASE + 0x014)
+
+/* DMA Channel Useburst Set */
+#define UDMA_USEBURSTSET		MMIO32(UDMA_BASE + 0x018)
+
+/* DMA Channel Useburst Clear */
+#define UDMA_USEBURSTCLR		MMIO32(UDMA_BASE + 0x01C)
+
+/* DMA Channel Request Mask Set */
+#define UDMA_REQMASKSET			MMIO32(UDMA_BASE + 0x020)
+
+/* DMA Channel Request Mask Clear */
+#define UDMA_REQMASKCLR			MMIO32(UDMA_BASE + 0x024)
+
+/* DMA Channel Enable Set */
+#define UDMA_ENASET			MMIO32(UDMA_BASE + 0x028)
+
+/* DMA Channel Enable Clear */
+#define UDMA_ENACLR			MMIO32(UDMA_BASE + 0x02C)
+
+/* DMA Channel Primary Alternate Set */
+#define UDMA_ALTSET			MMIO32(UDMA_BASE + 0x030)
+
+/* DMA Channel Primary Alternate Clear */
+#define UDMA_ALTCLR			MMIO32(UDMA_BASE + 0x034)
+
+/* DMA Channel Priority Set */
+#define UDMA_PRIOSET			MMIO32(UDMA_BASE + 0x038)
+
+/* DMA Channel Priority Clear */
+#define UDMA_PRIOCLR			MMIO32(UDMA_BASE + 0x03C)
+
+/* DMA Bus Error Clear */
+#define UDMA_ERRCLR			MMIO32(UDMA_BASE + 0x04C)
+
+/* DMA Channel Assignment */
+#define UDMA_CHASGN			MMIO32(UDMA_BASE + 0x500)
+
+/* DMA Channel Interrupt Status */
+#define UDMA_CHIS			MMIO32(UDMA_BASE + 0x504)
+
+/* DMA Channel Map Select [0-3] */
+#define UDMA_CHMAP(n)			MMIO32(UDMA_BASE + 0x510 + (n)*0x04)
+
+/* =============================================================================
+ * UDMA_CFG values
+ * ---------------------------------------------------------------------------*/
+/** Controller Master Enable */
+#define UDMA_CFG_MASTEN			(1 << 0)
+
+/* =============================================================================
+ * UDMA_ERRCLR values
+ * ---------------------------------------------------------------------------*/
+/** uDMA Bus Error Status, write 1 to clear */
+#define UDMA_ERRCLR_ERRCLR		(1 << 0)
+
+/* =============================================================================
+ * UDMA_CHMAP values
+ * ---------------------------------------------------------------------------*/
+#define UDMA_CHMAP_SHIFT(ch)		(((ch) % 8) * 4)
+#define UDMA_CHMAP_MASK(ch)		(0xfU << UDMA_CHMAP_SHIFT(ch))
+
+/* =============================================================================
+ * Channel control word, in the control table
+ * ---------------------------------------------------------------------------*/
+/** @defgroup udma_chctl Channel control word
+ * @{*/
+#define UDMA_CHCTL_DSTINC_SHIFT		30
+#define UDMA_CHCTL_DSTINC_MASK		(0x3U << UDMA_CHCTL_DSTINC_SHIFT)
+#define UDMA_CHCTL_DSTINC_8		(0x0U << UDMA_CHCTL_DSTINC_SHIFT)
+#define UDMA_CHCTL_DSTINC_16		(0x1U << UDMA_CHCTL_DSTINC_SHIFT)
+#define UDMA_CHCTL_DSTINC_32		(0x2U << UDMA_CHCTL_DSTINC_SHIFT)
+#define UDMA_CHCTL_DSTINC_NONE		(0x3U << UDMA_CHCTL_DSTINC_SHIFT)
+
+#define UDMA_CHCTL_DSTSIZE_SHIFT	28
+#define UDMA_CHCTL_DSTSIZE_MASK		(0x3 << UDMA_CHCTL_DSTSIZE_SHIFT)
+#define UDMA_CHCTL_DSTSIZE_8		(0x0 << UDMA_CHCTL_DSTSIZE_SHIFT)
+#define UDMA_CHCTL_DSTSIZE_16		(0x1 << UDMA_CHCTL_DSTSIZE_SHIFT)
+#define UDMA_CHCTL_DSTSIZE_32		(0x2 << UDMA_CHCTL_DSTSIZE_SHIFT)
+
+#define UDMA_CHCTL_SRCINC_SHIFT		26
+#define UDMA_CHCTL_SRCINC_MASK		(0x3 << UDMA_CHCTL_SRCINC_SHIFT)
+#define UDMA_CHCTL_SRCINC_8		(0x0 << UDMA_CHCTL_SRCINC_SHIFT)
+#define UDMA_CHCTL_SRCINC_16		(0x1 << UDMA_CHCTL_SRCINC_SHIFT)
+#define UDMA_CHCTL_SRCINC_32		(0x2 << UDMA_CHCTL_SRCINC_SHIFT)
+#define UDMA_CHCTL_SRCINC_NONE		(0x3 << UDMA_CHCTL_SRCINC_SHIFT)
+
+#define UDMA_CHCTL_SRCSIZE_SHIFT	24
+#define UDMA_CHCTL_SRCSIZE_MASK		(0x3 << UDMA_CHCTL_SRCSIZE_SHIFT)
+#define UDMA_CHCTL_SRCSIZE_8		(0x0 << UDMA_CHCTL_SRCSIZE_SHIFT)
+#define UDMA_CHCTL_SRCSIZE_16		(0x1 << UDMA_CHCTL_SRCSIZE_SHIFT)
+#define UDMA_CHCTL_SRCSIZE_32		(0x2 << UDMA_CHCTL_SRCSIZE_SHIFT)
+
+/** Arbitration size, 2^n transfers between re-arbitrations */
+#define UDMA_CHCTL_ARBSIZE_SHIFT	14
+#define UDMA_CHCTL_ARBSIZE_MASK		(0xf << UDMA_CHCTL_ARBSIZE_SHIFT)
+#define UDMA_CHCTL_ARBSIZE(n)		((n) << UDMA_CHCTL_ARBSIZE_SHIFT)
+
+/** Transfer size minus one */
+#define UDMA_CHCTL_XFERSIZE_SHIFT	4
+#define UDMA_CHCTL_XFERSIZE_MASK	(0x3ff << UDMA_CHCTL_XFERSIZE_SHIFT)
+#define UDMA_CHCTL_XFERSIZE(n)		((n) << UDMA_CHCTL_XFERSIZE_SHIFT)
+
+#define UDMA_CHCTL_NXTUSEBURST		(1 << 3)
+
+#define UDMA_CHCTL_XFERMODE_SHIFT	0
+#define UDMA_CHCTL_XFERMODE_MASK	(0x7 << UDMA_CHCTL_XFERMODE_SHIFT)
+#define UDMA_CHCTL_XFERMODE(mode)	((mode) << UDMA_CHCTL_XFERMODE_SHIFT)
+/** @} */
+
+/* =============================================================================
+ * Convenience enums
+ * ---------------------------------------------------------------------------*/
+/** Number of channels of the controller */
+#define UDMA_CHANNELS			32
+
+/** Largest transfer count of one control structure */
+#define UDMA_MAX_COUNT			PL230_MAX_COUNT
+
+/** Transfer modes of the XFERMODE field */
+enum udma_mode {
+	UDMA_MODE_STOP = 0,
+	UDMA_MODE_BASIC = 1,
+	UDMA_MODE_AUTO = 2,
+	UDMA_MODE_PING_PONG = 3,
+	UDMA_MODE_MEM_SG = 4,
+	UDMA_MODE_MEM_SG_ALT = 5,
+	UDMA_MODE_PERIPH_SG = 6,
+	UDMA_MODE_PERIPH_SG_ALT = 7,
+};
+
+/** Arbitration sizes, for UDMA_CHCTL_ARBSIZE() */
+enum udma_arb {
+	UDMA_ARB_1 = 0,
+	UDMA_ARB_2,
+	UDMA_ARB_4,
+	UDMA_ARB_8,
+	UDMA_ARB_16,
+	UDMA_ARB_32,
+	UDMA_ARB_64,
+	UDMA_ARB_128,
+	UDMA_ARB_256,
+	UDMA_ARB_512,
+	UDMA_ARB_1024,
+};
+
+/** Events passed to the channel callback */
+#define UDMA_EVENT_DONE			PL230_EVENT_DONE
+/** The alternate half of a ping-pong channel completed */
+#define UDMA_EVENT_ALTERNATE		PL230_EVENT_ALTERNATE
+#define UDMA_EVENT_ERROR		PL230_EVENT_ERROR
+
+typedef pl230_callback udma_callback;
+
+/* =============================================================================
+ * Function prototypes
+ * ---------------------------------------------------------------------------*/
+BEGIN_DECLS
+
+void udma_init(void);
+void udma_channel_assign(uint8_t ch, uint8_t encoding);
+void udma_channel_set_priority(uint8_t ch, bool high);
+struct pl230_desc *udma_table_primary(uint8_t ch);
+struct pl230_desc *udma_table_alternate(uint8_t ch);
+void udma_desc_build(struct pl230_desc *desc, enum udma_mode mode,
+		     uint32_t src, uint32_t dst, uint16_t count,
+		     uint32_t control);
+void udma_set_callback(uint8_t ch, udma_callback callback, void *user_data);
+void udma_cycle_basic(uint8_t ch, uint32_t src, uint32_t dst, uint16_t count,
+		      uint32_t control);
+void udma_cycle_auto(uint8_t ch, uint32_t src, uint32_t dst, uint16_t count,
+		     uint32_t control);
+void udma_cycle_ping_pong(uint8_t ch, uint32_t src0, uint32_t dst0,
+			  uint32_t src1, uint32_t dst1, uint16_t count,
+			  uint32_t control);
+int udma_cycle_scatter_gather(uint8_t ch, struct pl230_desc *tasks,
+			      uint16_t task_count, bool periph);
+void udma_cycle_stop(uint8_t ch);
+bool udma_cycle_busy(uint8_t ch);
+uint16_t udma_cycle_remaining(uint8_t ch);
+void udma_irq_handler(uint32_t channels);
+void udma_error_irq_handler(void);
+
+END_DECLS
+
+/**@}*/
+
+#endif /* LIBOPENCM3_LM4F_UDMA_H */
@@ -403,6 +403,16 @@ enum usb_ep_interrupt {
 	USB_EP6_INT			= USB_EP6,
 	USB_EP7_INT			= USB_EP7,
 };
+
+/**
+ * \brief Completion of an endpoint DMA transfer
+ *
+ * @param[in] addr Endpoint address
+ * @param[in] len Number of bytes moved
+ * @param[in] user_data As passed when the transfer was started
+ */
+typedef void (*usb_dma_callback)(uint8_t addr, uint16_t len, void *user_data);
+
 /* =============================================================================
  * Function prototypes
  * ---------------------------------------------------------------------------*/
@@ -415,6 +425,12 @@ void usb_disable_interrupts(enum usb_interrupt ints,
 			    enum usb_ep_interrupt rx_ints,
 			    enum usb_ep_interrupt tx_ints);
 
+int usb_ep_dma_write(uint8_t addr, const void *buf, uint16_t len,
+		     usb_dma_callback callback, void *user_data);
+int usb_ep_dma_read(uint8_t addr, void *buf, uint16_t len,
+		    usb_dma_callback callback, void *user_data);
+void usb_ep_dma_abort(uint8_t addr);
+
 END_DECLS
 
 /**@}*/
@@ -547,6 +547,94 @@
 #define GPDMA_CxCONFIG_H_MASK		(0x1 << GPDMA_CxCONFIG_H_SHIFT)
 #define GPDMA_CxCONFIG_H(x)		((x) << GPDMA_CxCONFIG_H_SHIFT)
 
+/* --- Driver ------------------------------------------------------------- */
+
+#define GPDMA_CHANNELS			8
+
+/* Peripheral requests: one of the 16 request lines with the DMAMUX setting
+ * that routes the peripheral to it, from the UM10503 DMA connections table.
+ */
+#define GPDMA_REQ(line, mux)		((line) | ((mux) << 4))
+#define GPDMA_REQ_LINE(req)		((req) & 0xf)
+#define GPDMA_REQ_MUX(req)		(((req) >> 4) & 0x3)
+/* Memory side of a transfer, no request line */
+#define GPDMA_REQ_MEMORY		0xff
+
+#define GPDMA_REQ_USART0_TX		GPDMA_REQ(1, 1)
+#define GPDMA_REQ_USART0_RX		GPDMA_REQ(2, 1)
+#define GPDMA_REQ_UART1_TX		GPDMA_REQ(3, 1)
+#define GPDMA_REQ_UART1_RX		GPDMA_REQ(4, 1)
+#define GPDMA_REQ_USART2_TX		GPDMA_REQ(5, 1)
+#define GPDMA_REQ_USART2_RX		GPDMA_REQ(6, 1)
+#define GPDMA_REQ_USART3_TX		GPDMA_REQ(7, 1)
+#define GPDMA_REQ_USART3_RX		GPDMA_REQ(8, 1)
+#define GPDMA_REQ_SSP0_RX		GPDMA_REQ(9, 0)
+#define GPDMA_REQ_SSP0_TX		GPDMA_REQ(10, 0)
+#define GPDMA_REQ_SSP1_RX		GPDMA_REQ(11, 0)
+#define GPDMA_REQ_SSP1_TX		GPDMA_REQ(12, 0)
+#define GPDMA_REQ_ADC0			GPDMA_REQ(13, 0)
+#define GPDMA_REQ_ADC1			GPDMA_REQ(14, 0)
+#define GPDMA_REQ_DAC			GPDMA_REQ(15, 0)
+
+/* SWIDTH and DWIDTH values */
+#define GPDMA_WIDTH_8BIT		0
+#define GPDMA_WIDTH_16BIT		1
+#define GPDMA_WIDTH_32BIT		2
+
+/* SBSIZE and DBSIZE values */
+#define GPDMA_BURST_1			0
+#define GPDMA_BURST_4			1
+#define GPDMA_BURST_8			2
+#define GPDMA_BURST_16			3
+#define GPDMA_BURST_32			4
+#define GPDMA_BURST_64			5
+#define GPDMA_BURST_128			6
+#define GPDMA_BURST_256			7
+
+/* FLOWCNTRL values, the DMA controller being the flow controller */
+#define GPDMA_FLOW_M2M			0
+#define GPDMA_FLOW_M2P			1
+#define GPDMA_FLOW_P2M			2
+#define GPDMA_FLOW_P2P			3
+
+/* Events passed to the callback */
+#define GPDMA_EVENT_COMPLETE		(1 << 0)
+#define GPDMA_EVENT_ERROR		(1 << 1)
+
+/* Largest TRANSFERSIZE of a single item */
+#define GPDMA_MAX_TRANSFER_SIZE		0xfff
+
+/* Loaded into SRCADDR, DESTADDR, LLI and CONTROL when the previous item
+ * completes, must be word aligned.
+ */
+struct gpdma_lli {
+	uint32_t src;
+	uint32_t dest;
+	uint32_t lli;
+	uint32_t control;
+};
+
+typedef void (*gpdma_callback)(uint8_t channel, uint32_t events,
+			       void *user_data);
+
+BEGIN_DECLS
+
+void gpdma_init(void);
+int gpdma_alloc(uint8_t channel_mask);
+void gpdma_free(uint8_t channel);
+uint32_t gpdma_lli_chain(struct gpdma_lli *lli, uint32_t lli_count,
+			 uint32_t src, uint32_t dest, uint32_t count,
+			 uint32_t control);
+void gpdma_lli_link(struct gpdma_lli *lli, const struct gpdma_lli *next);
+void gpdma_start(uint8_t channel, const struct gpdma_lli *lli,
+		 uint8_t src_req, uint8_t dest_req,
+		 gpdma_callback callback, void *user_data);
+void gpdma_stop(uint8_t channel);
+bool gpdma_busy(uint8_t channel);
+void gpdma_irq_handler(void);
+
+END_DECLS
+
 /**@}*/
 
 #endif
@@ -23,8 +23,73 @@
 #include <libopencm3/cm3/common.h>
 #include <libopencm3/lpc43xx/memorymap.h>
 
+/* --- Inter-core messaging ----------------------------------------------- */
+
+/* Slots per message ring, a power of two */
+#define IPC_RING_SLOTS			32
+/* Upper bound on the buffers of the shared pool, a power of two */
+#define IPC_POOL_MAX_BUFFERS		64
+
+#define IPC_MAGIC			0x49504331
+
+/* Core index, also the index of the ring a core receives on */
+#define IPC_CORE_M4			0
+#define IPC_CORE_M0			1
+
+struct ipc_msg {
+	uint16_t cmd;
+	uint16_t len;
+	/* Value, or address of a pool buffer handed over to the receiver */
+	uint32_t arg;
+};
+
+/* Single producer, single consumer ring. head is only written by the
+ * producer, tail only by the consumer.
+ */
+struct ipc_ring {
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	struct ipc_msg msg[IPC_RING_SLOTS];
+};
+
+/* Pool buffers released by the other core, on their way home */
+struct ipc_buf_ring {
+	volatile uint32_t head;
+	volatile uint32_t tail;
+	uint8_t idx[IPC_POOL_MAX_BUFFERS];
+};
+
+/* Control block in SRAM accessible to both cores, e.g. AHB SRAM */
+struct ipc_shared {
+	volatile uint32_t magic;
+	uint32_t pool_base;
+	uint32_t buf_size;
+	uint32_t buf_count;
+	struct ipc_ring ring[2];
+	struct ipc_buf_ring ret[2];
+};
+
+typedef void (*ipc_callback_t)(const struct ipc_msg *msg, void *user_data);
+
+BEGIN_DECLS
+
 void ipc_halt_m0(void);
 
 void ipc_start_m0(uint32_t cm0_baseaddr);
 
+void ipc_init(struct ipc_shared *shared, void *pool, uint32_t buf_size,
+	      uint32_t buf_count);
+void ipc_attach(struct ipc_shared *shared);
+int ipc_post(const struct ipc_msg *msg);
+void ipc_flush(void);
+int ipc_send(const struct ipc_msg *msg);
+int ipc_recv(struct ipc_msg *msg);
+void ipc_set_callback(ipc_callback_t callback, void *user_data);
+void ipc_irq_handler(void);
+void *ipc_buf_alloc(void);
+void ipc_buf_free(void *buf);
+int ipc_send_buf(uint16_t cmd, void *buf, uint16_t len);
+
+END_DECLS
+
 #endif
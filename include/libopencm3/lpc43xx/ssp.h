@@ -39,6 +39,7 @@ LGPL License Terms @ref lgpl_license
 
 #include <libopencm3/cm3/common.h>
 #include <libopencm3/lpc43xx/memorymap.h>
+#include <libopencm3/lpc43xx/gpdma.h>
 
 /* --- Convenience macros -------------------------------------------------- */
 
@@ -180,6 +181,26 @@ typedef enum {
 	SSP_SLAVE_OUT_DISABLE = BIT3
 } ssp_slave_option_t; /* This option is relevant only in slave mode */
 
+/* Depth of the transmit and receive FIFOs */
+#define SSP_FIFO_DEPTH			8
+
+/* Linked list items needed per direction for a DMA transfer */
+#define SSP_DMA_LLI_COUNT(frames) \
+	(((frames) + GPDMA_MAX_TRANSFER_SIZE - 1) / GPDMA_MAX_TRANSFER_SIZE)
+
+/*
+ * GPDMA full duplex transfer state. Channels with a lower number have a
+ * higher priority, the receive channel should be the lower one.
+ */
+struct ssp_dma {
+	ssp_num_t ssp_num;
+	uint8_t tx_channel;
+	uint8_t rx_channel;
+	/* Word aligned, 2 * SSP_DMA_LLI_COUNT(frames) items */
+	struct gpdma_lli *lli;
+	uint32_t lli_count;
+};
+
 BEGIN_DECLS
 
 void ssp_disable(ssp_num_t ssp_num);
@@ -202,6 +223,14 @@ void ssp_init(ssp_num_t ssp_num,
 
 uint16_t ssp_transfer(ssp_num_t ssp_num, uint16_t data);
 
+void ssp_transfer_block(ssp_num_t ssp_num, const void *tx, void *rx,
+			uint32_t frames);
+
+int ssp_dma_transfer(const struct ssp_dma *dma, const void *tx, void *rx,
+		     uint32_t frames);
+bool ssp_dma_done(const struct ssp_dma *dma);
+void ssp_dma_wait(const struct ssp_dma *dma);
+
 END_DECLS
 
 /**@}*/
@@ -265,6 +265,69 @@
 #define CAN_BITS_23_21  (0x00E00000U)
 /**@}*/
 
+/**
+ * @defgroup can_buffered_defs CAN Buffered Driver Definitions
+ * @{*/
+/** A CAN frame as stored in the rings of the buffered driver */
+struct can_msg {
+	uint32_t id;
+	bool ext;
+	bool rtr;
+	uint8_t length;
+	uint8_t data[8];
+};
+
+/** Error state of the controller, from its error counters */
+enum can_bus_state {
+	CAN_BUS_ACTIVE,
+	CAN_BUS_WARNING,
+	CAN_BUS_PASSIVE,
+	CAN_BUS_OFF,
+};
+
+/** Frames were added to the receive ring */
+#define CAN_EVENT_RX            BIT0
+/** The transmit ring ran empty and the last frame was sent */
+#define CAN_EVENT_TX_DONE       BIT1
+/** Frames were lost, the hardware FIFO or the receive ring was full */
+#define CAN_EVENT_RX_OVERRUN    BIT2
+/** The bus state changed, see can_buffered::state */
+#define CAN_EVENT_STATE         BIT3
+
+typedef void (*can_buffered_callback)(uint32_t canport, uint32_t events,
+			void *user_data);
+
+/** Interrupt driven CAN. The fields up to user_data are set by the
+ * application before can_buffered_init().
+ */
+struct can_buffered {
+	uint32_t canport;
+	/** Receive ring, a power of two frames */
+	struct can_msg *rx_buf;
+	uint32_t rx_size;
+	/** Transmit ring, a power of two frames */
+	struct can_msg *tx_buf;
+	uint32_t tx_size;
+	/** Leave bus-off by itself, else see can_buffered_recover() */
+	bool auto_recover;
+	can_buffered_callback callback;
+	void *user_data;
+
+	/** Free running frame counters, the ring sizes divide their range */
+	uint32_t rx_head;
+	uint32_t rx_tail;
+	uint32_t tx_head;
+	uint32_t tx_tail;
+	/** A frame of the transmit ring is in the transmit buffer */
+	bool tx_busy;
+	enum can_bus_state state;
+	/** Frames lost on reception */
+	uint32_t rx_dropped;
+	/** Frames lost when the controller went bus-off */
+	uint32_t tx_dropped;
+};
+/**@}*/
+
 /**@}*/
 
 BEGIN_DECLS
@@ -300,6 +363,17 @@ void can_abort_transmit(uint32_t canport);
 
 void can_receive(uint32_t canport, uint32_t *id, bool *ext, bool *rtr, uint8_t *length,
 			uint8_t *data);
+
+void can_buffered_init(struct can_buffered *cb);
+void can_buffered_stop(struct can_buffered *cb);
+uint32_t can_buffered_rx_available(struct can_buffered *cb);
+uint32_t can_buffered_read(struct can_buffered *cb, struct can_msg *msgs,
+			uint32_t count);
+uint32_t can_buffered_tx_free(struct can_buffered *cb);
+uint32_t can_buffered_write(struct can_buffered *cb, const struct can_msg *msgs,
+			uint32_t count);
+void can_buffered_recover(struct can_buffered *cb);
+void can_buffered_irq_handler(struct can_buffered *cb);
 /**@}*/
 
 END_DECLS
@@ -0,0 +1,55 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SAM_PDC_H
+#define SAM_PDC_H
+
+#include <libopencm3/cm3/common.h>
+
+/* --- Peripheral DMA Controller (PDC) registers --------------------------
+ * The PDC channel of a SAM3 peripheral lives at offset 0x100 of the
+ * peripheral, x is the peripheral base address.
+ */
+#define PDC_RPR(x)			MMIO32((x) + 0x0100)
+#define PDC_RCR(x)			MMIO32((x) + 0x0104)
+#define PDC_TPR(x)			MMIO32((x) + 0x0108)
+#define PDC_TCR(x)			MMIO32((x) + 0x010C)
+#define PDC_RNPR(x)			MMIO32((x) + 0x0110)
+#define PDC_RNCR(x)			MMIO32((x) + 0x0114)
+#define PDC_TNPR(x)			MMIO32((x) + 0x0118)
+#define PDC_TNCR(x)			MMIO32((x) + 0x011C)
+#define PDC_PTCR(x)			MMIO32((x) + 0x0120)
+#define PDC_PTSR(x)			MMIO32((x) + 0x0124)
+
+/* Transfer Control Register (PDC_PTCR) */
+/* Bits [31:10] - Reserved */
+#define PDC_PTCR_TXTDIS			(0x01 << 9)
+#define PDC_PTCR_TXTEN			(0x01 << 8)
+/* Bits [7:2] - Reserved */
+#define PDC_PTCR_RXTDIS			(0x01 << 1)
+#define PDC_PTCR_RXTEN			(0x01 << 0)
+
+/* Transfer Status Register (PDC_PTSR) */
+/* Bits [31:9] - Reserved */
+#define PDC_PTSR_TXTEN			(0x01 << 8)
+/* Bits [7:1] - Reserved */
+#define PDC_PTSR_RXTEN			(0x01 << 0)
+
+/* Largest RCR/TCR value */
+#define PDC_MAX_COUNT			0xFFFF
+
+#endif
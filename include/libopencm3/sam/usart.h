@@ -160,7 +160,7 @@
 #define USART_CSR_TXBUFE		(0x01 << 11)
 /* Bit [10] - Reserved */
 #define USART_CSR_TXEMPTY		(0x01 << 9)
-/* Bit [8] - Reserved */
+#define USART_CSR_TIMEOUT		(0x01 << 8)
 #define USART_CSR_PARE			(0x01 << 7)
 #define USART_CSR_FRAME			(0x01 << 6)
 #define USART_CSR_OVRE			(0x01 << 5)
@@ -170,6 +170,9 @@
 #define USART_CSR_TXRDY			(0x01 << 1)
 #define USART_CSR_RXRDY			(0x01 << 0)
 
+/* Receiver Time-out Register (USART_RTOR) */
+#define USART_RTOR_TO_MASK		(0xFFFF << 0)
+
 #define USART_WPMR_KEY			(0x555341 << 8)
 #define USART_WPMR_WPEN			(0x01 << 0)
 
@@ -0,0 +1,76 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SAM_USART_PDC_H
+#define SAM_USART_PDC_H
+
+#include <libopencm3/cm3/common.h>
+#include <libopencm3/sam/usart.h>
+#include <libopencm3/sam/pdc.h>
+
+/* Events passed to the callback */
+/* Half of the receive buffer was filled */
+#define USART_PDC_EVENT_RX		(1 << 0)
+/* The line was idle for rx_timeout bit periods after a character */
+#define USART_PDC_EVENT_RX_IDLE		(1 << 1)
+/* Everything written was handed to the transmitter */
+#define USART_PDC_EVENT_TX_DONE		(1 << 2)
+/* Overrun, framing or parity error */
+#define USART_PDC_EVENT_ERROR		(1 << 3)
+
+typedef void (*usart_pdc_callback)(uint32_t usart, uint32_t events,
+				   void *user_data);
+
+/* Buffered USART, the fields up to user_data are set by the application
+ * before usart_pdc_init().
+ */
+struct usart_pdc {
+	uint32_t usart;
+	/* Receive ring, a power of two bytes up to 65536 */
+	uint8_t *rx_buf;
+	uint32_t rx_size;
+	/* Transmit ring, a power of two bytes */
+	uint8_t *tx_buf;
+	uint32_t tx_size;
+	/* Idle time in bit periods reported as USART_PDC_EVENT_RX_IDLE, 0 to
+	 * disable
+	 */
+	uint16_t rx_timeout;
+	usart_pdc_callback callback;
+	void *user_data;
+
+	/* Free running byte counters, the ring sizes divide their range */
+	uint32_t rx_read;
+	uint32_t rx_armed;
+	uint32_t tx_head;
+	uint32_t tx_queued;
+};
+
+BEGIN_DECLS
+
+void usart_pdc_init(struct usart_pdc *pdc);
+void usart_pdc_stop(struct usart_pdc *pdc);
+uint32_t usart_pdc_rx_available(struct usart_pdc *pdc);
+uint32_t usart_pdc_read(struct usart_pdc *pdc, void *buf, uint32_t len);
+uint32_t usart_pdc_tx_free(struct usart_pdc *pdc);
+uint32_t usart_pdc_write(struct usart_pdc *pdc, const void *buf,
+			 uint32_t len);
+void usart_pdc_irq_handler(struct usart_pdc *pdc);
+
+END_DECLS
+
+#endif
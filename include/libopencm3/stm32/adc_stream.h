@@ -0,0 +1,85 @@
+/** @defgroup adc_stream_defines ADC streaming Defines
+
+@ingroup STM32F_defines
+
+@brief <b>libopencm3 Defined Constants and Types for continuous, timer
+triggered ADC acquisition</b>
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_ADC_STREAM_H
+#define LIBOPENCM3_ADC_STREAM_H
+
+#include <libopencm3/cm3/common.h>
+#include <libopencm3/stm32/adc.h>
+
+/**@{*/
+
+struct adc_stream;
+
+/** Callback delivering one block of samples.
+ *
+ * Called from the DMA interrupt with a pointer into the acquisition buffer.
+ * The block is overwritten once the other half has been filled, so it
+ * must be consumed (or handed off) within one block period. Samples are
+ * uint16_t, or uint32_t with the master in the low half-word in dual mode.
+ */
+typedef void (*adc_stream_callback)(struct adc_stream *stream,
+				    const void *block, uint16_t samples);
+
+/** State of one continuous acquisition. */
+struct adc_stream {
+	/** ADC, the master in dual mode */
+	uint32_t adc;
+	uint32_t dma;
+	uint8_t dma_channel;
+	/** Timer providing the sample clock, 0 if triggered otherwise */
+	uint32_t timer;
+	/** Dual ADC mode from @ref adc_multi_mode, 0 for a single ADC */
+	uint32_t dual_mode;
+	void *buf;
+	/** Samples per block, the buffer holds two blocks */
+	uint16_t block_len;
+	adc_stream_callback callback;
+	void *user_data;
+	/** Blocks dropped because the interrupt was serviced too late */
+	uint32_t overruns;
+	/** ADC data overruns, the DMA could not keep up */
+	uint32_t adc_overruns;
+};
+
+BEGIN_DECLS
+
+void adc_stream_init(struct adc_stream *stream, uint32_t adc, uint32_t dma,
+		     uint8_t dma_channel, uint8_t dma_request,
+		     uint32_t dual_mode, void *buf, uint16_t block_len,
+		     adc_stream_callback callback);
+uint32_t adc_stream_set_rate(struct adc_stream *stream, uint32_t timer,
+			     uint32_t timer_clk, uint32_t rate);
+void adc_stream_start(struct adc_stream *stream, uint32_t trigger,
+		      uint32_t polarity);
+void adc_stream_stop(struct adc_stream *stream);
+void adc_stream_irq_handler(struct adc_stream *stream);
+
+END_DECLS
+
+/**@}*/
+
+#endif
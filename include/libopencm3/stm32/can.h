@@ -36,6 +36,7 @@ LGPL License Terms @ref lgpl_license
 
 #include <libopencm3/stm32/memorymap.h>
 #include <libopencm3/cm3/common.h>
+#include <libopencm3/stm32/common/can_filter.h>
 
 /**@{*/
 
@@ -640,6 +641,64 @@ LGPL License Terms @ref lgpl_license
 
 /* FB[31:0]: Filter bits */
 
+/* --- Buffered driver ----------------------------------------------------- */
+
+/** @defgroup can_frame_flags CAN frame flags
+@ingroup can_defines
+@{*/
+#define CAN_FRAME_EXT			(1 << 0)
+#define CAN_FRAME_RTR			(1 << 1)
+/**@}*/
+
+/** Largest number of exact IDs and ID/mask pairs @ref can_filter_plan
+ * works with at once, ranges needing more are merged while planning.
+ */
+#define CAN_FILTER_PLAN_MAX		64
+
+/** One CAN frame as stored in the software queues. */
+struct can_frame {
+	/** Standard (11 bit) or extended (29 bit) identifier */
+	uint32_t id;
+	/** Payload, word aligned so that it is copied a word at a time */
+	uint8_t data[8];
+	/** Data length code */
+	uint8_t len;
+	/** @ref can_frame_flags */
+	uint8_t flags;
+	/** Index of the filter that accepted the frame, received frames only */
+	uint8_t fmi;
+	/** Time stamp, received frames only, valid with TTCM */
+	uint16_t timestamp;
+	/** Queueing order, set by @ref can_queue_transmit */
+	uint32_t seq;
+};
+
+/** Software receive ring and transmit priority queue of one CAN port. */
+struct can_queue {
+	uint32_t canport;
+	struct can_frame *rx_buf;
+	uint16_t rx_size;
+	volatile uint16_t rx_head;
+	volatile uint16_t rx_tail;
+	/** Binary heap, the highest priority frame is at index 0 */
+	struct can_frame *tx_buf;
+	uint16_t tx_size;
+	uint16_t tx_count;
+	/** Sequence number of the next queued frame */
+	uint32_t tx_seq;
+	/** Frames currently held in the hardware mailboxes */
+	struct can_frame tx_mbox[3];
+	uint8_t tx_mbox_busy;
+	/** Mailboxes aborted to make room for a higher priority frame */
+	uint8_t tx_mbox_abort;
+	/** Frames dropped after a failed attempt, with NART set */
+	uint32_t tx_errors;
+	/** Frames dropped because the receive ring was full */
+	uint32_t rx_overruns;
+	/** Frames lost by the hardware FIFOs before they were drained */
+	uint32_t fifo_overruns;
+};
+
 /* --- CAN functions -------------------------------------------------------- */
 
 BEGIN_DECLS
@@ -662,6 +721,8 @@ void can_filter_id_list_16bit_init(uint32_t nr, uint16_t id1,
 				   uint32_t fifo, bool enable);
 void can_filter_id_list_32bit_init(uint32_t nr, uint32_t id1,
 				   uint32_t id2, uint32_t fifo, bool enable);
+int can_filter_plan(const struct can_filter_range *ranges, unsigned count,
+		    uint32_t first_bank, uint32_t nr_banks, uint32_t fifo);
 
 void can_enable_irq(uint32_t canport, uint32_t irq);
 void can_disable_irq(uint32_t canport, uint32_t irq);
@@ -674,6 +735,15 @@ void can_receive(uint32_t canport, uint8_t fifo, bool release, uint32_t *id,
 
 void can_fifo_release(uint32_t canport, uint8_t fifo);
 bool can_available_mailbox(uint32_t canport);
+
+void can_queue_init(struct can_queue *q, uint32_t canport,
+		    struct can_frame *rx_buf, uint16_t rx_size,
+		    struct can_frame *tx_buf, uint16_t tx_size);
+int can_queue_transmit(struct can_queue *q, const struct can_frame *frame);
+bool can_queue_receive(struct can_queue *q, struct can_frame *frame);
+uint16_t can_queue_rx_pending(struct can_queue *q);
+uint16_t can_queue_tx_pending(struct can_queue *q);
+void can_queue_irq_handler(struct can_queue *q);
 END_DECLS
 
 /**@}*/
@@ -0,0 +1,43 @@
+/** @addtogroup can_defines
+ */
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* THIS FILE SHOULD NOT BE INCLUDED DIRECTLY, BUT ONLY VIA CAN.H OR FDCAN.H */
+
+#ifndef LIBOPENCM3_CAN_FILTER_H
+#define LIBOPENCM3_CAN_FILTER_H
+
+#include <libopencm3/cm3/common.h>
+
+/**@{*/
+
+/** Identifiers to accept, for @ref can_filter_plan and
+ * @ref fdcan_filter_plan.
+ */
+struct can_filter_range {
+	/** First identifier of the range */
+	uint32_t first;
+	/** Last identifier of the range, equal to first for a single one */
+	uint32_t last;
+	/** Extended (29 bit) instead of standard (11 bit) identifiers */
+	bool ext;
+};
+
+/**@}*/
+
+#endif
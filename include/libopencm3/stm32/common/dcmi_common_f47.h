@@ -226,4 +226,64 @@
  */
 #define DCMI_DR				MMIO32(DCMI_BASE + 0x28U)
 
+/**
+ * @defgroup dcmi_capture DCMI frame capture
+ * @{
+ */
+
+/** Highest number of DMA transfers a frame can be split into */
+#define DCMI_CAPTURE_MAX_CHUNKS		64
+
+struct dcmi_capture;
+
+/** Capture event callback.
+ *
+ * Called with DCMI_MIS_FRAME once a whole frame is in memory (from the DMA
+ * interrupt), and with the other DCMI_MIS_xxx flags enabled in @ref
+ * dcmi_capture_start from @ref dcmi_capture_irq_handler.
+ */
+typedef void (*dcmi_callback)(struct dcmi_capture *cap, uint32_t events);
+
+/** State of a frame capture. */
+struct dcmi_capture {
+	uint32_t dma;
+	uint8_t dma_stream;
+	uint8_t dma_channel;
+	/** Frame buffer */
+	uint32_t buf;
+	/** Words per DMA transfer, the frame is chunks of these */
+	uint16_t chunk_words;
+	uint8_t chunks;
+	/** Chunks of the current frame already in memory */
+	uint8_t done;
+	bool snapshot;
+	dcmi_callback callback;
+	/** For the application, NULL after @ref dcmi_capture_init */
+	void *user_data;
+	/** Complete frames */
+	uint32_t frames;
+	/** Frames lost to DCMI overruns or synchronisation errors */
+	uint32_t errors;
+};
+
+/**@}*/
+
+BEGIN_DECLS
+
+void dcmi_setup(uint32_t flags);
+void dcmi_set_embedded_codes(uint8_t fsc, uint8_t lsc, uint8_t lec,
+			     uint8_t fec, uint32_t unmask);
+void dcmi_set_crop(uint16_t x, uint16_t y, uint16_t width, uint16_t height,
+		   uint8_t clocks_per_pixel);
+void dcmi_disable_crop(void);
+int dcmi_capture_init(struct dcmi_capture *cap, uint32_t dma, uint8_t stream,
+		      uint8_t channel, void *buf, uint32_t frame_bytes,
+		      dcmi_callback callback);
+void dcmi_capture_start(struct dcmi_capture *cap, bool snapshot,
+			uint32_t interrupts);
+void dcmi_capture_stop(struct dcmi_capture *cap);
+void dcmi_capture_irq_handler(struct dcmi_capture *cap);
+
+END_DECLS
+
 /**@}*/
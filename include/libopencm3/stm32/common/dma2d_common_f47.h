@@ -33,6 +33,7 @@
  */
 
 #include <libopencm3/stm32/memorymap.h>
+#include <libopencm3/cm3/common.h>
 #include <stdint.h>
 
 #ifndef DMA2D_H
@@ -184,5 +185,49 @@
 /** DMA2D Background Color Lookup table */
 #define DMA2D_BG_CLUT			(uint32_t *)(DMA2D_BASE + 0x800U)
 
+/* --- Graphics engine ----------------------------------------------------- */
+
+/** Number of operations that can be queued at once */
+#define DMA2D_QUEUE_LEN			16
+
+/** A rectangular block of pixels in memory, e.g. a framebuffer. */
+struct dma2d_surface {
+	/** Address of the top left pixel */
+	uint32_t addr;
+	/** Distance between the start of two lines in pixels */
+	uint16_t pitch;
+	/** Pixel format, one of DMA2D_xPFCCR_CM_xxx. Only ARGB8888 up to
+	 * ARGB4444 can be written to.
+	 */
+	uint8_t format;
+};
+
+/** Called from @ref dma2d_irq_handler after every completed operation with
+ * its sequence number, or with error set if the DMA2D reported an error.
+ */
+typedef void (*dma2d_callback)(uint32_t seq, bool error, void *user_data);
+
+BEGIN_DECLS
+
+void dma2d_init(dma2d_callback callback, void *user_data);
+int dma2d_fill(const struct dma2d_surface *dst, uint16_t x, uint16_t y,
+	       uint16_t width, uint16_t height, uint32_t color);
+int dma2d_copy(const struct dma2d_surface *dst, uint16_t dx, uint16_t dy,
+	       const struct dma2d_surface *src, uint16_t sx, uint16_t sy,
+	       uint16_t width, uint16_t height);
+int dma2d_blend(const struct dma2d_surface *dst, uint16_t dx, uint16_t dy,
+		const struct dma2d_surface *fg, uint16_t fx, uint16_t fy,
+		const struct dma2d_surface *bg, uint16_t bx, uint16_t by,
+		uint16_t width, uint16_t height, uint8_t alpha);
+int dma2d_load_clut(bool background, const uint32_t *clut, uint16_t entries,
+		    bool rgb888);
+uint32_t dma2d_submitted(void);
+uint32_t dma2d_completed(void);
+bool dma2d_busy(void);
+void dma2d_wait(void);
+void dma2d_irq_handler(void);
+
+END_DECLS
+
 /**@}*/
 #endif
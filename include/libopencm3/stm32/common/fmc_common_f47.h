@@ -254,6 +254,48 @@ enum fmc_sdram_command { SDRAM_CLK_CONF, SDRAM_NORMAL, SDRAM_PALL,
 			 SDRAM_AUTO_REFRESH, SDRAM_LOAD_MODE,
 			 SDRAM_SELF_REFRESH, SDRAM_POWER_DOWN };
 
+/* SDRAM description, all timings from the datasheet of the device */
+struct sdram_config {
+	uint8_t columns;	/* Column address bits, 8 .. 11 */
+	uint8_t rows;		/* Row address bits, 11 .. 13 */
+	uint8_t width;		/* Data bus width in bits, 8, 16 or 32 */
+	uint8_t banks;		/* Internal banks, 2 or 4 */
+	uint8_t cas_latency;	/* CAS latency in SDCLK cycles, 1 .. 3 */
+	uint8_t sdclk_div;	/* SDCLK = HCLK / 2 or HCLK / 3 */
+	uint8_t read_pipe;	/* Extra read delay in HCLK cycles, 0 .. 2 */
+	bool read_burst;	/* Prefetch whole bursts on reads */
+	uint16_t trcd_ns;	/* Active to read/write */
+	uint16_t trp_ns;	/* Precharge to active */
+	uint16_t twr_ns;	/* Write recovery, as time after last data */
+	uint16_t trc_ns;	/* Active to active, same bank */
+	uint16_t tras_ns;	/* Active to precharge */
+	uint16_t txsr_ns;	/* Exit self refresh to active */
+	uint8_t tmrd_clk;	/* Load mode register to active, in cycles */
+	uint8_t twr_clk;	/* Minimum write recovery in cycles */
+	uint16_t refresh_ms;	/* Refresh period, usually 64 */
+	uint16_t refresh_rows;	/* Refresh commands per period, e.g. 8192 */
+};
+
+/* Asynchronous or synchronous burst SRAM/PSRAM/NOR on banks 1 .. 4 */
+enum fmc_memory_type { FMC_MEMORY_SRAM, FMC_MEMORY_PSRAM, FMC_MEMORY_NOR };
+
+struct fmc_sram_config {
+	enum fmc_memory_type type;
+	uint8_t width;		/* Data bus width in bits, 8, 16 or 32 */
+	bool mux;		/* Address/data multiplexed */
+	bool wait;		/* Honour the NWAIT signal */
+	uint16_t addset_ns;	/* Address setup */
+	uint16_t addhld_ns;	/* Address hold, multiplexed memories only */
+	uint16_t datast_ns;	/* Data phase (NOE/NWE low) */
+	uint16_t busturn_ns;	/* Bus turnaround after the access */
+	uint16_t wr_addset_ns;	/* Write timings if they differ from */
+	uint16_t wr_datast_ns;	/* the read timings, 0 to use the same */
+	bool burst_read;	/* Synchronous burst reads */
+	bool burst_write;	/* Synchronous burst writes */
+	uint32_t clk_hz;	/* Maximum CLK frequency in burst mode */
+	uint8_t data_latency;	/* Latency before the first data, in CLK */
+};
+
 /* Send an array of timing parameters (indices above) to create SDTR register
  * value
  */
@@ -262,6 +304,13 @@ BEGIN_DECLS
 uint32_t sdram_timing(struct sdram_timing *t);
 void sdram_command(enum fmc_sdram_bank bank, enum fmc_sdram_command cmd,
 			int autorefresh, int modereg);
+int sdram_calc_timing(const struct sdram_config *cfg, uint32_t hclk,
+		      struct sdram_timing *t);
+uint32_t sdram_refresh_count(const struct sdram_config *cfg, uint32_t hclk);
+int sdram_init(enum fmc_sdram_bank bank, const struct sdram_config *cfg,
+	       uint32_t hclk);
+int fmc_sram_init(uint8_t bank, const struct fmc_sram_config *cfg,
+		  uint32_t hclk);
 
 END_DECLS
 
@@ -1607,10 +1607,10 @@ specific memorymap.h header before including this header file.*/
 #define HRTIM_TIMx_CR_DELCMP2_SHIFT   12
 #define HRTIM_TIMx_CR_DELCMP2_MASK    (0x3 << HRTIM_TIMx_CR_DELCMP2_SHIFT)
 
-#define HRTIM_TIMx_CR_DELCMP2_ALWAYS        (0x << HRTIM_TIMx_CR_DELCMP2_SHIFT)
-#define HRTIM_TIMx_CR_DELCMP2_CAP1          (0x << HRTIM_TIMx_CR_DELCMP2_SHIFT)
-#define HRTIM_TIMx_CR_DELCMP2_CAP1_COMP1    (0x << HRTIM_TIMx_CR_DELCMP2_SHIFT)
-#define HRTIM_TIMx_CR_DELCMP2_CAP1_COMP3    (0x << HRTIM_TIMx_CR_DELCMP2_SHIFT)
+#define HRTIM_TIMx_CR_DELCMP2_ALWAYS        (0 << HRTIM_TIMx_CR_DELCMP2_SHIFT)
+#define HRTIM_TIMx_CR_DELCMP2_CAP1          (1 << HRTIM_TIMx_CR_DELCMP2_SHIFT)
+#define HRTIM_TIMx_CR_DELCMP2_CAP1_COMP1    (2 << HRTIM_TIMx_CR_DELCMP2_SHIFT)
+#define HRTIM_TIMx_CR_DELCMP2_CAP1_COMP3    (3 << HRTIM_TIMx_CR_DELCMP2_SHIFT)
 
 /** SYNCSTRTx: Synchronization Starts Timer x */
 #define HRTIM_TIMx_CR_SYNCSTRTx       (1 << 11)
@@ -2988,10 +2988,80 @@ specific memorymap.h header before including this header file.*/
 #define HRTIM_TIMx_FLT_FLT1EN          (1 << 0)
 /**@}*/
 
+/** @defgroup hrtim_api_values HRTIM driver definitions
+ * @ingroup hrtim_defines
+ * @{
+ */
+
+/** Timer index of the master timer, used alongside HRTIM_TIMA..HRTIM_TIME */
+#define HRTIM_MASTER                   5
+
+/** Fault input polarity: active high (default active low) */
+#define HRTIM_FAULT_POL_HIGH           (1 << 1)
+/** Fault input source: internal comparator (default FLTx pin) */
+#define HRTIM_FAULT_SRC_INTERNAL       (1 << 2)
+/** Fault input digital filter, 0 (none) to 15 */
+#define HRTIM_FAULT_FILTER(n)          (((n) & 0xf) << 3)
+
+/** Output state while a fault is active, see @ref hrtim_timer_set_faults */
+enum hrtim_fault_state {
+	HRTIM_FAULT_STATE_NOOP,
+	HRTIM_FAULT_STATE_ACTIVE,
+	HRTIM_FAULT_STATE_INACTIVE,
+	HRTIM_FAULT_STATE_HIGHZ,
+};
+
+/** Timer setup for @ref hrtim_timer_setup */
+struct hrtim_timer_config {
+	/** PWM frequency, the finest prescaler that reaches it is used */
+	uint32_t freq_hz;
+	/** Repetition counter, a repetition event occurs every rep + 1
+	 * periods
+	 */
+	uint8_t repetition;
+	/** Additional TIMCR (MCR) bits, e.g. HRTIM_TIMx_CR_PREEN,
+	 * HRTIM_TIMx_CR_TxREPU or HRTIM_TIMx_CR_HALF. Continuous mode is
+	 * always set.
+	 */
+	uint32_t flags;
+};
+
+/**@}*/
+
 /* --- Function prototypes ------------------------------------------------- */
 
 BEGIN_DECLS
 
+void hrtim_init(uint32_t hrtim_clk_hz);
+int hrtim_dll_calibrate(uint32_t timeout);
+int hrtim_timer_setup(uint8_t timer, const struct hrtim_timer_config *cfg);
+uint32_t hrtim_ps_to_ticks(uint8_t timer, uint32_t ps);
+uint32_t hrtim_get_period(uint8_t timer);
+void hrtim_set_compare(uint8_t timer, uint8_t cmp, uint32_t value);
+void hrtim_set_duty(uint8_t timer, uint8_t cmp, uint16_t duty);
+void hrtim_set_output(uint8_t timer, uint8_t output, uint32_t set,
+		      uint32_t reset);
+int hrtim_set_deadtime(uint8_t timer, uint32_t rising_ps,
+		       uint32_t falling_ps);
+void hrtim_counter_enable(uint32_t timers);
+void hrtim_counter_disable(uint32_t timers);
+void hrtim_force_update(uint32_t timers);
+void hrtim_output_enable(uint32_t outputs);
+void hrtim_output_disable(uint32_t outputs);
+void hrtim_fault_setup(uint8_t fault, uint8_t flags);
+void hrtim_timer_set_faults(uint8_t timer, uint8_t faults,
+			    enum hrtim_fault_state state);
+uint32_t hrtim_get_and_clear_faults(void);
+void hrtim_set_adc_trigger(uint8_t trigger, uint32_t sources);
+int hrtim_burst_dma_setup(uint8_t timer, uint32_t registers, uint32_t dma,
+			  uint8_t channel, const uint32_t *table,
+			  uint16_t periods);
+void hrtim_burst_dma_stop(uint8_t timer, uint32_t dma, uint8_t channel);
+void hrtim_burst_mode_setup(uint32_t clock, uint32_t prescaler,
+			    uint32_t timers, uint16_t period, uint16_t idle);
+void hrtim_burst_mode_start(uint32_t triggers);
+void hrtim_burst_mode_stop(void);
+
 END_DECLS
 
 #endif
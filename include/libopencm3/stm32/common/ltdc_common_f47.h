@@ -505,6 +505,73 @@ void ltdc_setup_windowing(
 
 
 
+/* --- Display pipeline --------------------------------------------------- */
+
+/** Layer configuration for @ref ltdc_layer_setup. */
+struct ltdc_layer_config {
+	/** Framebuffer address */
+	uint32_t fb_addr;
+	/** Pixel format, LTDC_LxPFCR_xxx */
+	uint32_t format;
+	/** Window position within the active area */
+	uint16_t x, y;
+	/** Window size in pixels */
+	uint16_t width, height;
+	/** Distance between the start of two lines in bytes, 0 if packed */
+	uint16_t pitch;
+	/** Constant alpha */
+	uint8_t alpha;
+	/** Blending factors, LTDC_LxBFCR_BF1_xxx and LTDC_LxBFCR_BF2_xxx */
+	uint8_t bf1, bf2;
+	/** ARGB8888 color outside the window */
+	uint32_t default_color;
+};
+
+/** Maximum number of framebuffers of a swap chain */
+#define LTDC_SWAPCHAIN_MAX		3
+
+/** Framebuffers of a layer, flipped on vertical blanking.
+ *
+ * One buffer is scanned out (front), at most one is latched to become the
+ * front at the next vertical blanking (pending), the others can be drawn
+ * into.
+ */
+struct ltdc_swapchain {
+	uint32_t layer;
+	uint8_t count;
+	uint32_t buffers[LTDC_SWAPCHAIN_MAX];
+	uint8_t front;
+	/** Buffer waiting for the reload, count if none */
+	uint8_t pending;
+	/** Buffer handed out by @ref ltdc_swapchain_acquire, count if none */
+	uint8_t back;
+};
+
+/** Called from @ref ltdc_irq_handler with the LTDC_ISR_xxx flags that
+ * were raised.
+ */
+typedef void (*ltdc_callback)(uint32_t events, void *user_data);
+
+BEGIN_DECLS
+
+uint8_t ltdc_pixel_size(uint32_t format);
+void ltdc_layer_setup(uint32_t layer, const struct ltdc_layer_config *cfg);
+void ltdc_layer_load_clut(uint32_t layer, const uint32_t *clut,
+			  uint16_t entries);
+void ltdc_set_line_interrupt(uint16_t line);
+void ltdc_set_callback(ltdc_callback callback, void *user_data,
+		       uint32_t interrupts);
+void ltdc_irq_handler(void);
+
+void ltdc_swapchain_init(struct ltdc_swapchain *sc, uint32_t layer,
+			 const uint32_t *buffers, uint8_t count);
+uint32_t ltdc_swapchain_acquire(struct ltdc_swapchain *sc);
+int ltdc_swapchain_present(struct ltdc_swapchain *sc);
+bool ltdc_swapchain_pending(struct ltdc_swapchain *sc);
+uint32_t ltdc_swapchain_front(struct ltdc_swapchain *sc);
+
+END_DECLS
+
 /**
  * Helper function to wait for SRCR reload to complete or so
  */
@@ -48,7 +48,7 @@
 #define QUADSPI_PIR     MMIO32(QUADSPI_BASE + 0x2CU)
 
 /** QUADSPI low power timeout */
-#define QUADSPI_LPTR      MMIO32(QUADSPI_BASE + 0x30U
+#define QUADSPI_LPTR      MMIO32(QUADSPI_BASE + 0x30U)
 /**@}*/
 
 #define QUADSPI_CR_PRESCALE_MASK  0xff
@@ -144,6 +144,46 @@
 #define QUADSPI_CCR_FMODE_APOLL   2
 #define QUADSPI_CCR_FMODE_MEMMAP  3
 
+/** Start of the flash memory in memory-mapped mode */
+#define QUADSPI_MEM_BASE	0x90000000U
+
+/** @defgroup quadspi_cmd_flags QuadSPI command flags
+ * @{
+ */
+/** Double data rate for address, alternate bytes and data */
+#define QUADSPI_CMD_DDR		(1 << 0)
+/** Send the instruction only for the first command (memory-mapped mode) */
+#define QUADSPI_CMD_SIOO	(1 << 1)
+/**@}*/
+
+/** Description of one flash command.
+ *
+ * Each phase is skipped when its mode is QUADSPI_CCR_MODE_NONE, otherwise
+ * it is sent over the number of lines given by QUADSPI_CCR_MODE_xLINE.
+ */
+struct quadspi_command {
+	uint8_t instruction;
+	uint8_t instruction_mode;
+	uint8_t address_mode;
+	/** Address size in bytes, 1 to 4 */
+	uint8_t address_size;
+	uint8_t alternate_mode;
+	/** Alternate bytes size in bytes, 1 to 4 */
+	uint8_t alternate_size;
+	/** Number of dummy cycles between address/alternate and data phase */
+	uint8_t dummy_cycles;
+	uint8_t data_mode;
+	/** @ref quadspi_cmd_flags */
+	uint8_t flags;
+	uint32_t address;
+	uint32_t alternate;
+};
+
+/** Completion callback for DMA transfers, see @ref quadspi_read_dma and
+ * @ref quadspi_write_dma.
+ */
+typedef void (*quadspi_callback)(bool error, void *user_data);
+
 /**@}*/
 
 
@@ -170,6 +210,144 @@ void quadspi_enable(void);
  */
 void quadspi_disable(void);
 
+/**
+ * Set up the interface to the flash device.
+ *
+ * The peripheral is left disabled, enable it with @ref quadspi_enable.
+ *
+ * @param prescaler Clock prescaler, the bus runs at the kernel clock
+ * divided by prescaler + 1.
+ * @param flash_size_log2 Flash size as the base 2 log of its size in bytes,
+ * e.g. 24 for 16 MiB.
+ * @param cs_high_cycles Minimum number of clock cycles nCS stays high
+ * between commands, 1 to 8.
+ * @param clock_mode3 CLK stays high while nCS is high (SPI mode 3) instead
+ * of low (mode 0).
+ * @param sample_shift Sample read data half a cycle later, for high clock
+ * rates.
+ */
+void quadspi_setup(uint8_t prescaler, uint8_t flash_size_log2,
+		   uint8_t cs_high_cycles, bool clock_mode3, bool sample_shift);
+
+/**
+ * Abort the ongoing command, e.g. to leave memory-mapped mode.
+ */
+void quadspi_abort(void);
+
+/**
+ * Run a command without data phase, waiting for its completion.
+ * @param cmd Command description, data_mode is ignored.
+ * @returns 0 on success, -1 on a transfer error.
+ */
+int quadspi_command(const struct quadspi_command *cmd);
+
+/**
+ * Run a command and read its data phase in indirect mode, by polling.
+ * @param cmd Command description.
+ * @param data Buffer receiving the data.
+ * @param len Number of bytes to read.
+ * @returns 0 on success, -1 on a transfer error.
+ */
+int quadspi_read(const struct quadspi_command *cmd, void *data, uint32_t len);
+
+/**
+ * Run a command and write its data phase in indirect mode, by polling.
+ * @param cmd Command description.
+ * @param data Data to write.
+ * @param len Number of bytes to write.
+ * @returns 0 on success, -1 on a transfer error.
+ */
+int quadspi_write(const struct quadspi_command *cmd, const void *data,
+		  uint32_t len);
+
+/**
+ * Repeat a status read command until the status matches.
+ *
+ * Auto-polling mode reads the status register every @p interval cycles
+ * without involving the CPU and stops at the first match, e.g. when the
+ * write in progress bit of a NOR flash clears.
+ *
+ * @param cmd Status read command, with a data phase.
+ * @param size Number of status bytes, 1 to 4.
+ * @param match Expected value of the masked status.
+ * @param mask Status bits to compare.
+ * @param interval Clock cycles between two reads.
+ * @param timeout Number of busy loop iterations to wait, 0 to wait forever.
+ * @returns 0 on a match, -1 on timeout or transfer error.
+ */
+int quadspi_auto_poll(const struct quadspi_command *cmd, uint8_t size,
+		      uint32_t match, uint32_t mask, uint16_t interval,
+		      uint32_t timeout);
+
+/**
+ * Map the flash into the address space at @ref QUADSPI_MEM_BASE.
+ *
+ * Reads from the mapped region, including instruction fetches, are turned
+ * into @p cmd with the address filled in. The peripheral prefetches
+ * following data while nCS is held low, so sequential reads run at full
+ * bus speed. Use @ref quadspi_abort to leave memory-mapped mode.
+ *
+ * @param cmd Read command description, address is ignored.
+ * @param timeout If not 0, release nCS after this many clock cycles
+ * without access, which stops the prefetch and saves power.
+ */
+void quadspi_memory_mapped(const struct quadspi_command *cmd,
+			   uint16_t timeout);
+
+#if defined(QUADSPI_CR_DMAEN)
+
+/**
+ * Select the DMA channel used by @ref quadspi_read_dma and
+ * @ref quadspi_write_dma. Not available on H7.
+ * @param dma DMA controller base address: DMA1 or DMA2
+ * @param channel DMA channel (stream) serving the QUADSPI.
+ * @param request Request routed to the channel, see struct dma_xfer_config.
+ */
+void quadspi_dma_init(uint32_t dma, uint8_t channel, uint8_t request);
+
+/**
+ * Start a command reading its data phase with DMA.
+ *
+ * Returns immediately, @p callback is called once the DMA has stored the
+ * last byte, from @ref dma_xfer_irq_handler, which has to serve the
+ * interrupt of the DMA channel, or from @ref quadspi_irq_handler on a
+ * transfer error. Words are transferred if @p data is word aligned and
+ * @p len a multiple of four, bytes otherwise.
+ *
+ * @param cmd Command description.
+ * @param data Buffer receiving the data.
+ * @param len Number of bytes to read, at most 65535 transfers.
+ * @param callback Optional completion callback.
+ * @param user_data Passed to @p callback.
+ * @returns 0 if the transfer was started, -1 if it is too long.
+ */
+int quadspi_read_dma(const struct quadspi_command *cmd, void *data,
+		     uint32_t len, quadspi_callback callback, void *user_data);
+
+/**
+ * Start a command writing its data phase with DMA.
+ *
+ * Same as @ref quadspi_read_dma in the other direction, except that
+ * @p callback is called from @ref quadspi_irq_handler once the memory has
+ * received the last byte.
+ * @returns 0 if the transfer was started, -1 if it is too long.
+ */
+int quadspi_write_dma(const struct quadspi_command *cmd, const void *data,
+		      uint32_t len, quadspi_callback callback,
+		      void *user_data);
+
+#endif
+
+/**
+ * Check whether a command is still running.
+ */
+bool quadspi_busy(void);
+
+/**
+ * Service the QUADSPI interrupt, finishing DMA transfers.
+ */
+void quadspi_irq_handler(void);
+
 END_DECLS
 
 /**@}*/
@@ -1173,6 +1173,8 @@ void timer_reset_output_idle_state(uint32_t timer_peripheral, uint32_t outputs);
 void timer_set_ti1_ch123_xor(uint32_t timer_peripheral);
 void timer_set_ti1_ch1(uint32_t timer_peripheral);
 void timer_set_master_mode(uint32_t timer_peripheral, uint32_t mode);
+uint32_t timer_set_trgo_rate(uint32_t timer_peripheral, uint32_t timer_clk,
+			     uint32_t rate);
 void timer_set_dma_on_compare_event(uint32_t timer_peripheral);
 void timer_set_dma_on_update_event(uint32_t timer_peripheral);
 void timer_enable_compare_control_update_on_trigger(uint32_t timer_peripheral);
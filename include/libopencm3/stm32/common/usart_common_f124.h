@@ -116,7 +116,7 @@ specific memorymap.h header before including this header file.*/
  */
 #define USART_FLAG_PE	USART_SR_PE
 #define USART_FLAG_FE	USART_SR_FE
-#define USART_FLAG_NF	USART_SR_NF
+#define USART_FLAG_NF	USART_SR_NE
 #define USART_FLAG_ORE	USART_SR_ORE
 #define USART_FLAG_IDLE	USART_SR_IDLE
 #define USART_FLAG_RXNE	USART_SR_RXNE
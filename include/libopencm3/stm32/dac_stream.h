@@ -0,0 +1,87 @@
+/** @defgroup dac_stream_defines DAC streaming Defines
+
+@ingroup STM32F_defines
+
+@brief <b>libopencm3 Defined Constants and Types for continuous, timer
+triggered DAC output</b>
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_DAC_STREAM_H
+#define LIBOPENCM3_DAC_STREAM_H
+
+#include <libopencm3/cm3/common.h>
+#include <libopencm3/stm32/dac.h>
+
+/**@{*/
+
+struct dac_stream;
+
+/** Callback asking for one block of samples.
+ *
+ * Called from the DMA interrupt with a pointer to the half of the output
+ * buffer that has just been played and is now idle. It must be refilled
+ * before the other half has been played, i.e. within one block period.
+ * Samples are uint16_t for a single channel (uint8_t with DAC_ALIGN_RIGHT8)
+ * and uint32_t for both channels (uint16_t with DAC_ALIGN_RIGHT8), channel
+ * 1 in the low half.
+ */
+typedef void (*dac_stream_callback)(struct dac_stream *stream, void *block,
+				    uint16_t samples);
+
+/** State of one continuous output. */
+struct dac_stream {
+	uint32_t dac;
+	/** @ref dac_channel_id, DAC_CHANNEL_BOTH for synchronised output */
+	int channel;
+	enum dac_align align;
+	uint32_t dma;
+	uint8_t dma_channel;
+	uint8_t dma_request;
+	/** Timer providing the sample clock, 0 if triggered otherwise */
+	uint32_t timer;
+	void *buf;
+	/** Samples per block, the buffer holds two blocks */
+	uint16_t block_len;
+	dac_stream_callback callback;
+	void *user_data;
+	/** Blocks replayed because the interrupt was serviced too late */
+	uint32_t underruns;
+	/** DAC DMA underruns, the DMA could not keep up, not detected on F1 */
+	uint32_t dac_underruns;
+};
+
+BEGIN_DECLS
+
+void dac_stream_init(struct dac_stream *stream, uint32_t dac, int channel,
+		     enum dac_align align, uint32_t dma, uint8_t dma_channel,
+		     uint8_t dma_request, void *buf, uint16_t block_len,
+		     dac_stream_callback callback);
+uint32_t dac_stream_set_rate(struct dac_stream *stream, uint32_t timer,
+			     uint32_t timer_clk, uint32_t rate);
+void dac_stream_start(struct dac_stream *stream, uint32_t trigger);
+void dac_stream_stop(struct dac_stream *stream);
+void dac_stream_irq_handler(struct dac_stream *stream);
+
+END_DECLS
+
+/**@}*/
+
+#endif
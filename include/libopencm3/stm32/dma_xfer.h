@@ -0,0 +1,135 @@
+/** @defgroup dma_xfer_defines DMA transfer Defines
+
+@ingroup STM32F_defines
+
+@brief <b>libopencm3 Defined Constants and Types for the STM32 DMA transfer
+layer</b>
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_DMA_XFER_H
+#define LIBOPENCM3_DMA_XFER_H
+
+#include <libopencm3/cm3/common.h>
+#include <libopencm3/stm32/dma.h>
+
+/**@{*/
+
+/** @defgroup dma_xfer_flags DMA transfer configuration flags
+ * These are the same on every DMA controller variant and are translated to
+ * the controller specific register layout by @ref dma_xfer_setup.
+ * @{
+ */
+#define DMA_XFER_PERIPH_TO_MEM		(0 << 0)
+#define DMA_XFER_MEM_TO_PERIPH		(1 << 0)
+/** periph_addr is the source, mem_addr the destination */
+#define DMA_XFER_MEM_TO_MEM		(2 << 0)
+#define DMA_XFER_DIR_MASK		(3 << 0)
+
+#define DMA_XFER_MINC			(1 << 2)
+#define DMA_XFER_PINC			(1 << 3)
+#define DMA_XFER_CIRCULAR		(1 << 4)
+/** Ping-pong between mem_addr and mem1_addr, see @ref dma_xfer_setup */
+#define DMA_XFER_DOUBLE_BUFFER		(1 << 5)
+/** Report @ref DMA_XFER_EVENT_HALF */
+#define DMA_XFER_HALF_IRQ		(1 << 6)
+/** Use the stream FIFO instead of direct mode (F2/F4/F7 only) */
+#define DMA_XFER_FIFO			(1 << 7)
+
+#define DMA_XFER_MSIZE_8BIT		(0 << 8)
+#define DMA_XFER_MSIZE_16BIT		(1 << 8)
+#define DMA_XFER_MSIZE_32BIT		(2 << 8)
+#define DMA_XFER_MSIZE_SHIFT		8
+#define DMA_XFER_MSIZE_MASK		(3 << 8)
+
+#define DMA_XFER_PSIZE_8BIT		(0 << 10)
+#define DMA_XFER_PSIZE_16BIT		(1 << 10)
+#define DMA_XFER_PSIZE_32BIT		(2 << 10)
+#define DMA_XFER_PSIZE_SHIFT		10
+#define DMA_XFER_PSIZE_MASK		(3 << 10)
+
+#define DMA_XFER_PL_LOW			(0 << 12)
+#define DMA_XFER_PL_MEDIUM		(1 << 12)
+#define DMA_XFER_PL_HIGH		(2 << 12)
+#define DMA_XFER_PL_VERY_HIGH		(3 << 12)
+#define DMA_XFER_PL_SHIFT		12
+#define DMA_XFER_PL_MASK		(3 << 12)
+/**@}*/
+
+/** @defgroup dma_xfer_event DMA transfer events passed to the callback
+ * @{
+ */
+#define DMA_XFER_EVENT_HALF		(1 << 0)
+#define DMA_XFER_EVENT_COMPLETE		(1 << 1)
+#define DMA_XFER_EVENT_ERROR		(1 << 2)
+/** With DMA_XFER_DOUBLE_BUFFER: the buffer just completed is mem1_addr */
+#define DMA_XFER_EVENT_BUFFER1		(1 << 3)
+/** With DMA_XFER_DOUBLE_BUFFER: the interrupt was serviced too late and
+ * buffers were lost. On channel based controllers it replaces
+ * DMA_XFER_EVENT_COMPLETE for a buffer the DMA is already transferring
+ * again. On F2/F4/F7 it comes with DMA_XFER_EVENT_COMPLETE for the latest
+ * buffer, which is intact, when earlier completions were missed.
+ */
+#define DMA_XFER_EVENT_OVERRUN		(1 << 4)
+/**@}*/
+
+/** Highest channel (stream) number plus one handled by this layer */
+#define DMA_XFER_CHANNELS		9
+
+typedef void (*dma_xfer_callback)(uint32_t dma, uint8_t channel,
+				  uint32_t events, void *user_data);
+
+/** Description of one DMA transfer. */
+struct dma_xfer_config {
+	/** @ref dma_xfer_flags */
+	uint32_t flags;
+	uint32_t periph_addr;
+	uint32_t mem_addr;
+	/** Second buffer for DMA_XFER_DOUBLE_BUFFER, unused otherwise */
+	uint32_t mem1_addr;
+	/** Number of data items, per buffer in double buffer mode */
+	uint16_t count;
+	/** Request routed to the channel: CHSEL on F2/F4/F7, the CSELR value
+	 * on parts with channel selection, the DMAMUX request id on parts
+	 * with a DMAMUX. Ignored on parts with fixed request mapping.
+	 */
+	uint8_t request;
+	/** Optional, called from @ref dma_xfer_irq_handler */
+	dma_xfer_callback callback;
+	void *user_data;
+};
+
+BEGIN_DECLS
+
+int dma_xfer_alloc(uint32_t dma, uint32_t channel_mask);
+void dma_xfer_free(uint32_t dma, uint8_t channel);
+void dma_xfer_setup(uint32_t dma, uint8_t channel,
+		    const struct dma_xfer_config *cfg);
+void dma_xfer_start(uint32_t dma, uint8_t channel);
+void dma_xfer_stop(uint32_t dma, uint8_t channel);
+void dma_xfer_reload(uint32_t dma, uint8_t channel, uint32_t mem_addr,
+		     uint16_t count);
+void dma_xfer_irq_handler(uint32_t dma, uint32_t channel_mask);
+
+END_DECLS
+
+/**@}*/
+
+#endif
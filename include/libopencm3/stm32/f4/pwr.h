@@ -43,7 +43,13 @@ LGPL License Terms @ref lgpl_license
 
 /* --- PWR_CR values ------------------------------------------------------- */
 
-/* Bits [31:16]: Reserved */
+/* Bits [31:18]: Reserved */
+
+/* ODSWEN: Over-drive switching enable (F42x/F43x/F446/F469/F479) */
+#define PWR_CR_ODSWEN			(1 << 17)
+
+/* ODEN: Over-drive enable (F42x/F43x/F446/F469/F479) */
+#define PWR_CR_ODEN			(1 << 16)
 
 /* VOS: Regulator voltage scaling output selection */
 #define PWR_CR_VOS_SHIFT			14
@@ -56,7 +62,15 @@ LGPL License Terms @ref lgpl_license
 
 /* --- PWR_CSR values ------------------------------------------------------ */
 
-/* Bits [31:15]: Reserved */
+/* Bits [31:18]: Reserved */
+
+/* ODSWRDY: Over-drive mode switching ready */
+#define PWR_CSR_ODSWRDY			(1 << 17)
+
+/* ODRDY: Over-drive mode ready */
+#define PWR_CSR_ODRDY			(1 << 16)
+
+/* Bit 15: Reserved */
 
 /* VOSRDY: Regulator voltage scaling output selection ready bit */
 #define PWR_CSR_VOSRDY			(1 << 14)
@@ -82,6 +96,8 @@ enum pwr_vos_scale {
 BEGIN_DECLS
 
 void pwr_set_vos_scale(enum pwr_vos_scale scale);
+void pwr_enable_overdrive(void);
+void pwr_disable_overdrive(void);
 
 END_DECLS
 
@@ -8,8 +8,12 @@
 #pragma once
 
 #include <libopencm3/stm32/memorymap.h>
-#include <libopencm3/stm32/common/quadspi_common_v1.h>
 
+/* Defined ahead of the common header, which only declares the DMA API
+ * when it exists.
+ */
 #define QUADSPI_CR_DMAEN    (1 << 2)
 
+#include <libopencm3/stm32/common/quadspi_common_v1.h>
+
 /**@}*/
\ No newline at end of file
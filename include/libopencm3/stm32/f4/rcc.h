@@ -713,6 +713,9 @@
 /* RCC_PLLI2SCFGR[14:6]: PLLI2SN */
 #define RCC_PLLI2SCFGR_PLLI2SN_SHIFT		6
 #define RCC_PLLI2SCFGR_PLLI2SN_MASK		0x1ff
+/* RCC_PLLI2SCFGR[5:0]: PLLI2SM, F446, F412 and F413 only */
+#define RCC_PLLI2SCFGR_PLLI2SM_SHIFT		0
+#define RCC_PLLI2SCFGR_PLLI2SM_MASK		0x3f
 
 /* --- RCC_PLLSAICFGR values ----------------------------------------------- */
 
@@ -816,6 +819,38 @@ struct rcc_clock_scale {
 	uint32_t ahb_frequency;
 	uint32_t apb1_frequency;
 	uint32_t apb2_frequency;
+	/** Enable the regulator over-drive, needed above 168 MHz */
+	bool overdrive;
+	/** PLLI2S multiplier, 0 to leave the PLLI2S alone */
+	uint16_t plli2sn;
+	/** PLLI2S divider for the I2S clock */
+	uint8_t plli2sr;
+	/** PLLI2S input divider on parts with their own (F446, F412, F413),
+	 * 0 where the PLLI2S shares PLLM
+	 */
+	uint8_t plli2sm;
+};
+
+/** Clock tree requirements for @ref rcc_clock_solve */
+struct rcc_clock_target {
+	/** HSE crystal or clock frequency, 0 to run from the HSI */
+	uint32_t hse_frequency;
+	/** Upper bound for SYSCLK, 0 for the maximum of the device */
+	uint32_t sysclk_max;
+	/** Wanted PLLI2S output, 0 if unused. The closest reachable
+	 * frequency is used.
+	 */
+	uint32_t i2s_frequency;
+	/** Lowest supply voltage in mV, sets the flash wait states. 0 is
+	 * taken as 2.7 V or more. Below 2.1 V there is no over-drive.
+	 */
+	uint16_t vdd_mv;
+	/** DBGMCU_IDCODE device ID to plan for, 0 to read it. Some F40x
+	 * revisions only read it with a debugger attached.
+	 */
+	uint16_t dev_id;
+	/** The PLL48CK output must be exactly 48 MHz for USB, SDIO and RNG */
+	bool usb;
 };
 
 extern const struct rcc_clock_scale rcc_hsi_configs[RCC_CLOCK_3V3_END];
@@ -1129,6 +1164,8 @@ void rcc_set_main_pll_hse(uint32_t pllm, uint32_t plln, uint32_t pllp,
 			  uint32_t pllq, uint32_t pllr);
 uint32_t rcc_system_clock_source(void);
 void rcc_clock_setup_pll(const struct rcc_clock_scale *clock);
+int rcc_clock_solve(const struct rcc_clock_target *target,
+		    struct rcc_clock_scale *clock);
 void __attribute__((deprecated("Use rcc_clock_setup_pll as direct replacement"))) rcc_clock_setup_hse_3v3(const struct rcc_clock_scale *clock);
 uint32_t rcc_get_usart_clk_freq(uint32_t usart);
 uint32_t rcc_get_timer_clk_freq(uint32_t timer);
@@ -34,6 +34,7 @@ LGPL License Terms @ref lgpl_license
 
 #include <libopencm3/stm32/memorymap.h>
 #include <libopencm3/cm3/common.h>
+#include <libopencm3/stm32/common/can_filter.h>
 
 /** @{ */
 
@@ -370,6 +371,11 @@ LGPL License Terms @ref lgpl_license
 #define FDCAN_RXGFC_ANFS_SHIFT			4
 #define FDCAN_RXGFC_ANFS_MASK			0x3
 
+/* Values of ANFE and ANFS */
+#define FDCAN_RXGFC_ANF_FIFO0			0x0
+#define FDCAN_RXGFC_ANF_FIFO1			0x1
+#define FDCAN_RXGFC_ANF_REJECT			0x2
+
 #define FDCAN_RXGFC_F1OM				(1 << 8)
 #define FDCAN_RXGFC_F0OM				(1 << 9)
 /* LSS[4:0]: List size of standard ID filters */
@@ -632,6 +638,10 @@ struct fdcan_standard_filter {
  **/
 #define FDCAN_SFT_MAX_NR				28
 
+/** Largest number of identifier ranges @ref fdcan_filter_plan takes at once
+ **/
+#define FDCAN_FILTER_PLAN_MAX				64
+
 /* SFEC = 0x7 is unused */
 
 #define FDCAN_SFID1_SHIFT				16
@@ -766,7 +776,7 @@ struct fdcan_tx_buffer_element {
  * @{
  */
 #define FDCAN_FIFO_ESI					(1 << 31)
-#define FDCAN_FIFO_XTD					(1 << 20)
+#define FDCAN_FIFO_XTD					(1 << 30)
 #define FDCAN_FIFO_RTR					(1 << 29)
 #define FDCAN_FIFO_EFC					(1 << 23)
 #define FDCAN_FIFO_FDF					(1 << 21)
@@ -814,6 +824,26 @@ struct fdcan_message_ram {
 	struct fdcan_tx_buffer_element tx_buffer[3];
 };
 
+/** @defgroup fdcan_frame_flags FDCAN frame flags
+ * @{
+ */
+#define FDCAN_FRAME_EXT					(1 << 0)
+#define FDCAN_FRAME_RTR					(1 << 1)
+#define FDCAN_FRAME_FDF					(1 << 2)
+#define FDCAN_FRAME_BRS					(1 << 3)
+/**@}*/
+
+/** Frame to be sent by @ref fdcan_transmit_batch. */
+struct fdcan_frame {
+	/** Standard (11 bit) or extended (29 bit) identifier */
+	uint32_t id;
+	/** @ref fdcan_frame_flags */
+	uint8_t flags;
+	/** Payload length, must be a valid CAN or FDCAN frame length */
+	uint8_t length;
+	/** Payload, copied into message RAM a word at a time */
+	uint32_t data[64 / sizeof(uint32_t)];
+};
 
 /* --- FD-CAN error returns ------------------------------------------------- */
 
@@ -871,6 +901,9 @@ void fdcan_set_ext_filter(uint32_t canport, uint32_t nr,
 		uint8_t id_list_mode, uint32_t id1, uint32_t id2,
 		uint8_t action);
 
+int fdcan_filter_plan(uint32_t canport, const struct can_filter_range *ranges,
+		unsigned count, uint8_t fifo);
+
 void fdcan_enable_irq(uint32_t canport, uint32_t irq);
 void fdcan_disable_irq(uint32_t canport, uint32_t irq);
 
@@ -881,6 +914,15 @@ int fdcan_receive(uint32_t canport, uint8_t fifo, bool release, uint32_t *id,
 		bool *ext, bool *rtr, uint8_t *fmi, uint8_t *length,
 		uint8_t *data, uint16_t *timestamp);
 
+unsigned fdcan_receive_batch(uint32_t canport, uint8_t fifo_id,
+		const struct fdcan_rx_fifo_element **elements, unsigned max);
+void fdcan_release_batch(uint32_t canport, uint8_t fifo_id, unsigned count);
+uint32_t fdcan_rx_element_id(const struct fdcan_rx_fifo_element *element,
+		bool *ext);
+uint8_t fdcan_rx_element_length(const struct fdcan_rx_fifo_element *element);
+unsigned fdcan_transmit_batch(uint32_t canport, const struct fdcan_frame *frames,
+		unsigned count);
+
 void fdcan_release_fifo(uint32_t canport, uint8_t fifo);
 
 bool fdcan_available_tx(uint32_t canport);
@@ -0,0 +1,63 @@
+/** @defgroup lptimer_timebase_defines LPTIM time base Defines
+
+@ingroup STM32F_defines
+
+@brief <b>libopencm3 Defined Constants and Types for the low power time
+base</b>
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_LPTIMER_TIMEBASE_H
+#define LIBOPENCM3_LPTIMER_TIMEBASE_H
+
+#include <libopencm3/cm3/common.h>
+#include <libopencm3/stm32/lptimer.h>
+
+/**@{*/
+
+/** Alarms closer than this many ticks cannot be programmed reliably */
+#define LPTIMER_TIMEBASE_MIN_DELTA	4
+
+/** Called from @ref lptimer_timebase_irq_handler when the alarm expires. */
+typedef void (*lptimer_timebase_callback)(uint64_t now, void *user_data);
+
+BEGIN_DECLS
+
+void lptimer_timebase_init(uint32_t lptim, uint32_t clk_hz,
+			   uint32_t prescaler);
+uint32_t lptimer_timebase_hz(void);
+uint64_t lptimer_timebase_now(void);
+uint64_t lptimer_timebase_now_us(void);
+uint64_t lptimer_timebase_us_to_ticks(uint64_t us);
+int lptimer_timebase_set_alarm(uint64_t tick,
+			       lptimer_timebase_callback callback,
+			       void *user_data);
+void lptimer_timebase_cancel_alarm(void);
+void lptimer_timebase_irq_handler(void);
+#if defined(STM32F4) || defined(STM32L0) || defined(STM32L4)
+void lptimer_timebase_sync_rtc(void);
+uint64_t lptimer_timebase_rtc_now(void);
+#endif
+
+END_DECLS
+
+/**@}*/
+
+#endif
@@ -0,0 +1,83 @@
+/** @defgroup pm_defines Power mode manager Defines
+
+@ingroup STM32F_defines
+
+@brief <b>libopencm3 Defined Constants and Types for the low power mode
+manager</b>
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_PM_H
+#define LIBOPENCM3_PM_H
+
+#include <libopencm3/cm3/common.h>
+
+/**@{*/
+
+/** Low power modes, from the shallowest to the deepest. */
+enum pm_mode {
+	/** Stay awake, the idle hook returns at once */
+	PM_MODE_RUN,
+	/** CPU clock stopped, peripherals keep running */
+	PM_MODE_SLEEP,
+	/** All clocks in the core domain stopped, SRAM and registers kept */
+	PM_MODE_STOP,
+	/** Core domain powered down, wakeup goes through reset */
+	PM_MODE_STANDBY,
+	PM_MODE_COUNT
+};
+
+/** Application hooks of the power mode manager, all optional. */
+struct pm_config {
+	/** Called before entering @p mode, e.g. to arm a wakeup timer that
+	 * is still running in this mode, or to save state before Standby.
+	 */
+	void (*suspend)(enum pm_mode mode, uint32_t idle_us);
+	/** Called after waking up from @p mode, once the clocks have been
+	 * restored and before interrupts are re-enabled.
+	 */
+	void (*resume)(enum pm_mode mode);
+	/** Microsecond time stamp used to measure the time spent restoring
+	 * the clocks. It must keep counting across clock changes (RTC,
+	 * LPTIM, ...).
+	 */
+	uint32_t (*now_us)(void);
+	/** Put the regulator in low power mode during Stop. Saves power at
+	 * the cost of a longer wakeup.
+	 */
+	bool stop_lp_regulator;
+};
+
+BEGIN_DECLS
+
+void pm_init(const struct pm_config *config);
+void pm_set_wakeup_latency(enum pm_mode mode, uint32_t us);
+uint32_t pm_get_wakeup_latency(enum pm_mode mode);
+void pm_block(enum pm_mode mode);
+void pm_unblock(enum pm_mode mode);
+enum pm_mode pm_select(uint32_t idle_us);
+enum pm_mode pm_idle(uint32_t idle_us);
+uint32_t pm_get_entries(enum pm_mode mode);
+
+END_DECLS
+
+/**@}*/
+
+#endif
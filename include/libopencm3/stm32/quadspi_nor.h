@@ -0,0 +1,100 @@
+/** @defgroup quadspi_nor_defines QuadSPI NOR flash Defines
+
+@ingroup STM32F_defines
+
+@brief <b>libopencm3 Defined Constants and Types for JEDEC serial NOR flash
+on the QuadSPI</b>
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_QUADSPI_NOR_H
+#define LIBOPENCM3_QUADSPI_NOR_H
+
+#include <libopencm3/cm3/common.h>
+#include <libopencm3/stm32/quadspi.h>
+
+/**@{*/
+
+/** @defgroup quadspi_nor_cmd JEDEC serial NOR flash opcodes
+ * @{
+ */
+#define QUADSPI_NOR_CMD_WRSR		0x01
+#define QUADSPI_NOR_CMD_PP		0x02
+#define QUADSPI_NOR_CMD_READ		0x03
+#define QUADSPI_NOR_CMD_RDSR		0x05
+#define QUADSPI_NOR_CMD_WREN		0x06
+#define QUADSPI_NOR_CMD_FAST_READ	0x0B
+#define QUADSPI_NOR_CMD_PP4B		0x12
+#define QUADSPI_NOR_CMD_SE		0x20
+#define QUADSPI_NOR_CMD_SE4B		0x21
+#define QUADSPI_NOR_CMD_QPP		0x32
+#define QUADSPI_NOR_CMD_QPP4B		0x34
+#define QUADSPI_NOR_CMD_RDSR2		0x35
+#define QUADSPI_NOR_CMD_RSTEN		0x66
+#define QUADSPI_NOR_CMD_RST		0x99
+#define QUADSPI_NOR_CMD_RDID		0x9F
+#define QUADSPI_NOR_CMD_EN4B		0xB7
+#define QUADSPI_NOR_CMD_CE		0xC7
+#define QUADSPI_NOR_CMD_BE		0xD8
+#define QUADSPI_NOR_CMD_BE4B		0xDC
+#define QUADSPI_NOR_CMD_4READ		0xEB
+#define QUADSPI_NOR_CMD_4READ4B		0xEC
+/**@}*/
+
+/** Status register bits */
+#define QUADSPI_NOR_SR_WIP		(1 << 0)
+#define QUADSPI_NOR_SR_WEL		(1 << 1)
+
+#define QUADSPI_NOR_PAGE_SIZE		256
+#define QUADSPI_NOR_SECTOR_SIZE		4096
+#define QUADSPI_NOR_BLOCK_SIZE		65536
+
+/** Description of the attached flash. */
+struct quadspi_nor {
+	/** Address size in bytes, 3 or 4. With 4, the 4-byte opcodes are
+	 * used, so the device does not need to be switched to 4-byte mode.
+	 */
+	uint8_t address_size;
+	/** Dummy cycles of the quad I/O read (0xEB) after the mode byte */
+	uint8_t read_dummy_cycles;
+	/** Polling budget of @ref quadspi_nor_wait_ready, 0 to wait forever */
+	uint32_t timeout;
+};
+
+BEGIN_DECLS
+
+int quadspi_nor_read_id(uint8_t *id, uint32_t len);
+int quadspi_nor_read_status(uint8_t *status);
+int quadspi_nor_write_enable(const struct quadspi_nor *nor);
+int quadspi_nor_wait_ready(const struct quadspi_nor *nor);
+int quadspi_nor_erase_sector(const struct quadspi_nor *nor, uint32_t addr);
+int quadspi_nor_erase_block(const struct quadspi_nor *nor, uint32_t addr);
+int quadspi_nor_erase_chip(const struct quadspi_nor *nor);
+int quadspi_nor_program(const struct quadspi_nor *nor, uint32_t addr,
+			const void *data, uint32_t len);
+int quadspi_nor_read(const struct quadspi_nor *nor, uint32_t addr,
+		     void *data, uint32_t len);
+void quadspi_nor_memory_mapped(const struct quadspi_nor *nor);
+
+END_DECLS
+
+/**@}*/
+
+#endif
@@ -0,0 +1,101 @@
+/** @defgroup usart_dma_defines USART DMA ring buffer Defines
+
+@ingroup STM32F_defines
+
+@brief <b>libopencm3 Defined Constants and Types for the DMA backed USART
+ring buffer driver</b>
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_USART_DMA_H
+#define LIBOPENCM3_USART_DMA_H
+
+#include <libopencm3/cm3/common.h>
+#include <libopencm3/stm32/usart.h>
+#include <libopencm3/stm32/dma.h>
+
+/**@{*/
+
+struct usart_dma_ring;
+
+/** Callback publishing a chunk of received data.
+ *
+ * Called from interrupt context with a pointer directly into the RX ring.
+ * The data must be consumed before the DMA wraps around to it again. A
+ * chunk that straddles the end of the ring is reported as two calls.
+ */
+typedef void (*usart_dma_rx_callback)(struct usart_dma_ring *ring,
+				      const uint8_t *data, uint16_t len);
+
+/** State of one DMA backed USART.
+ *
+ * All fields are set up by @ref usart_dma_init and owned by the driver
+ * afterwards, except for @ref user_data.
+ */
+struct usart_dma_ring {
+	uint32_t usart;
+	uint32_t dma;
+	/** DMA channel (stream on F2/F4/F7) serving USART RX requests */
+	uint8_t rx_channel;
+	/** DMA channel (stream on F2/F4/F7) serving USART TX requests */
+	uint8_t tx_channel;
+
+	uint8_t *rx_buf;
+	uint16_t rx_size;
+	/** Ring offset of the first byte not yet published */
+	uint16_t rx_tail;
+	usart_dma_rx_callback rx_callback;
+	/** Number of USART overrun errors seen */
+	uint32_t rx_overruns;
+
+	uint8_t *tx_buf;
+	uint16_t tx_size;
+	/** Ring offset the next written byte is stored at */
+	volatile uint16_t tx_head;
+	/** Ring offset of the first byte not yet sent */
+	volatile uint16_t tx_tail;
+	/** Number of bytes handed to the DMA, zero when idle */
+	volatile uint16_t tx_inflight;
+
+	void *user_data;
+};
+
+BEGIN_DECLS
+
+void usart_dma_init(struct usart_dma_ring *ring, uint32_t usart, uint32_t dma,
+		    uint8_t rx_channel, uint8_t rx_request,
+		    uint8_t *rx_buf, uint16_t rx_size,
+		    uint8_t tx_channel, uint8_t tx_request,
+		    uint8_t *tx_buf, uint16_t tx_size,
+		    usart_dma_rx_callback rx_callback);
+void usart_dma_start(struct usart_dma_ring *ring);
+void usart_dma_stop(struct usart_dma_ring *ring);
+uint16_t usart_dma_write(struct usart_dma_ring *ring, const uint8_t *data,
+			 uint16_t len);
+uint16_t usart_dma_tx_free(struct usart_dma_ring *ring);
+bool usart_dma_tx_busy(struct usart_dma_ring *ring);
+void usart_dma_rx_poll(struct usart_dma_ring *ring);
+void usart_dma_irq_handler(struct usart_dma_ring *ring);
+
+END_DECLS
+
+/**@}*/
+
+#endif
@@ -22,9 +22,36 @@
 /* DMB is supported on CM0 */
 void __dmb()
 {
+#if defined(LIBOPENCM3_HOST)
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+#else
 	__asm__ volatile ("dmb");
+#endif
+}
+
+#if defined(LIBOPENCM3_HOST)
+
+void mutex_lock(mutex_t *m)
+{
+	while (!mutex_trylock(m));
 }
 
+/* returns 1 if the lock was acquired */
+uint32_t mutex_trylock(mutex_t *m)
+{
+	uint32_t unlocked = MUTEX_UNLOCKED;
+
+	return __atomic_compare_exchange_n(m, &unlocked, MUTEX_LOCKED, false,
+					   __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+void mutex_unlock(mutex_t *m)
+{
+	__atomic_store_n(m, MUTEX_UNLOCKED, __ATOMIC_RELEASE);
+}
+
+#endif
+
 /* Those are defined only on CM3 or CM4 */
 #if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
 
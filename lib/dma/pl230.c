@@ -0,0 +1,394 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @defgroup pl230_file PL230 uDMA cycle engine
+ *
+ * @ingroup peripheral_apis
+ *
+ * \brief <b>Cycle engine of the ARM PL230 micro DMA controller</b>
+ *
+ * Fills the channel control structures for one of the cycle types and starts
+ * the channel. In ping-pong mode @ref pl230_irq_done re-arms the half that
+ * just completed with its original count, so a stream runs until
+ * @ref pl230_cycle_stop as long as the interrupt is served within one half.
+ *
+ * Applications use this through the family drivers, the EFM32 dma_cycle_*()
+ * and the LM4F udma_cycle_*() functions, which own the control table and
+ * the done flags.
+ *
+ * @{
+ */
+
+#include <stddef.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/dma/pl230.h>
+
+/**
+ * \brief Install the control table and enable the controller
+ *
+ * @param[in] dma Controller, with the table and channel state set
+ */
+void pl230_init(struct pl230 *dma)
+{
+	dma->ping_pong = 0;
+	dma->active = 0;
+
+	PL230_CTRLBASE(dma->base) = (uint32_t)dma->primary;
+	PL230_CFG(dma->base) = PL230_CFG_MASTEN;
+}
+
+/* End pointer of a transfer, the address of its last item */
+static uint32_t pl230_end_pointer(uint32_t start, uint32_t inc,
+				  uint16_t count)
+{
+	if (inc == PL230_INC_NONE) {
+		return start;
+	}
+
+	return start + ((uint32_t)(count - 1) << inc);
+}
+
+/**
+ * \brief Fill a control structure
+ *
+ * @param[out] desc Structure, in the table or a scatter-gather task list
+ * @param[in] mode Cycle type
+ * @param[in] src Source data start address
+ * @param[in] dst Destination data start address
+ * @param[in] count Number of transfers, 1 to PL230_MAX_COUNT
+ * @param[in] control Size, increment and R_POWER fields, the cycle type and
+ *		      count are ignored
+ */
+void pl230_desc_build(struct pl230_desc *desc, enum pl230_mode mode,
+		      uint32_t src, uint32_t dst, uint16_t count,
+		      uint32_t control)
+{
+	uint32_t src_inc = (control & PL230_CTRL_SRC_INC_MASK) >>
+			   PL230_CTRL_SRC_INC_SHIFT;
+	uint32_t dst_inc = (control & PL230_CTRL_DST_INC_MASK) >>
+			   PL230_CTRL_DST_INC_SHIFT;
+
+	control &= ~(PL230_CTRL_CYCLE_CTRL_MASK | PL230_CTRL_N_MINUS_1_MASK);
+
+	desc->src_end = pl230_end_pointer(src, src_inc, count);
+	desc->dst_end = pl230_end_pointer(dst, dst_inc, count);
+	desc->control = control | (mode << PL230_CTRL_CYCLE_CTRL_SHIFT) |
+			((uint32_t)(count - 1) << PL230_CTRL_N_MINUS_1_SHIFT);
+	desc->user = 0;
+}
+
+/**
+ * \brief Set the function called by @ref pl230_irq_done for a channel
+ *
+ * @param[in] dma Controller
+ * @param[in] ch Channel
+ * @param[in] callback Called on completion and bus errors, NULL for none
+ * @param[in] user_data Passed to the callback
+ */
+void pl230_set_callback(struct pl230 *dma, uint8_t ch,
+			pl230_callback callback, void *user_data)
+{
+	dma->chan[ch].callback = callback;
+	dma->chan[ch].user_data = user_data;
+}
+
+/* Start a channel whose structures are filled in */
+static void pl230_cycle_start(struct pl230 *dma, uint8_t ch, bool ping_pong)
+{
+	CM_ATOMIC_BLOCK() {
+		if (ping_pong) {
+			dma->ping_pong |= 1U << ch;
+		} else {
+			dma->ping_pong &= ~(1U << ch);
+		}
+		dma->active |= 1U << ch;
+	}
+
+	PL230_ALTCLR(dma->base) = 1U << ch;
+	PL230_USEBURSTCLR(dma->base) = 1U << ch;
+	PL230_REQMASKCLR(dma->base) = 1U << ch;
+	dma->arm(ch, dma->chan[ch].callback != NULL);
+	PL230_ENASET(dma->base) = 1U << ch;
+}
+
+/**
+ * \brief Start a basic cycle, driven by the peripheral requests
+ *
+ * @param[in] dma Controller
+ * @param[in] ch Channel
+ * @param[in] src Source data start address
+ * @param[in] dst Destination data start address
+ * @param[in] count Number of transfers, 1 to PL230_MAX_COUNT
+ * @param[in] control Sizes, increments and arbitration, see
+ *		      @ref pl230_desc_build
+ */
+void pl230_cycle_basic(struct pl230 *dma, uint8_t ch, uint32_t src,
+		       uint32_t dst, uint16_t count, uint32_t control)
+{
+	pl230_desc_build(&dma->primary[ch], PL230_MODE_BASIC, src, dst, count,
+			 control);
+	pl230_cycle_start(dma, ch, false);
+}
+
+/**
+ * \brief Start an auto-request cycle, a copy triggered by software
+ *
+ * @param[in] dma Controller
+ * @param[in] ch Channel
+ * @param[in] src Source data start address
+ * @param[in] dst Destination data start address
+ * @param[in] count Number of transfers, 1 to PL230_MAX_COUNT
+ * @param[in] control Sizes, increments and arbitration, see
+ *		      @ref pl230_desc_build
+ */
+void pl230_cycle_auto(struct pl230 *dma, uint8_t ch, uint32_t src,
+		      uint32_t dst, uint16_t count, uint32_t control)
+{
+	pl230_desc_build(&dma->primary[ch], PL230_MODE_AUTO, src, dst, count,
+			 control);
+	pl230_cycle_start(dma, ch, false);
+	PL230_SWREQ(dma->base) = 1U << ch;
+}
+
+/**
+ * \brief Start a continuous ping-pong cycle
+ *
+ * The primary structure moves @a count transfers from @a src0 to @a dst0,
+ * then the alternate one from @a src1 to @a dst1, and so on. Each completed
+ * half is reported to the callback, with PL230_EVENT_ALTERNATE for the
+ * second one, and re-armed.
+ *
+ * @param[in] dma Controller
+ * @param[in] ch Channel
+ * @param[in] src0 Source of the primary half
+ * @param[in] dst0 Destination of the primary half
+ * @param[in] src1 Source of the alternate half
+ * @param[in] dst1 Destination of the alternate half
+ * @param[in] count Number of transfers per half, 1 to PL230_MAX_COUNT
+ * @param[in] control Sizes, increments and arbitration, see
+ *		      @ref pl230_desc_build
+ */
+void pl230_cycle_ping_pong(struct pl230 *dma, uint8_t ch, uint32_t src0,
+			   uint32_t dst0, uint32_t src1, uint32_t dst1,
+			   uint16_t count, uint32_t control)
+{
+	struct pl230_desc *primary = &dma->primary[ch];
+	struct pl230_desc *alternate = &dma->alternate[ch];
+
+	pl230_desc_build(primary, PL230_MODE_PING_PONG, src0, dst0, count,
+			 control);
+	pl230_desc_build(alternate, PL230_MODE_PING_PONG, src1, dst1, count,
+			 control);
+	dma->chan[ch].ping_pong_control[0] = primary->control;
+	dma->chan[ch].ping_pong_control[1] = alternate->control;
+
+	pl230_cycle_start(dma, ch, true);
+}
+
+/**
+ * \brief Start a scatter-gather cycle
+ *
+ * The primary structure copies each task in turn into the alternate
+ * structure, which then executes it. Build the tasks with
+ * @ref pl230_desc_build, the cycle types are set here.
+ *
+ * @param[in] dma Controller
+ * @param[in] ch Channel
+ * @param[in] tasks Task list, word aligned, must stay valid until done
+ * @param[in] task_count Number of tasks, 1 to PL230_MAX_COUNT / 4
+ * @param[in] periph true for peripheral scatter-gather, each task waiting
+ *		     for the peripheral request, false for memory
+ *		     scatter-gather started by software
+ * @return 0 on success, -1 if @a task_count is out of range
+ */
+int pl230_cycle_scatter_gather(struct pl230 *dma, uint8_t ch,
+			       struct pl230_desc *tasks, uint16_t task_count,
+			       bool periph)
+{
+	enum pl230_mode alt_mode = periph ? PL230_MODE_PERIPH_SG_ALT :
+					    PL230_MODE_MEM_SG_ALT;
+	/* The last task ends the cycle */
+	enum pl230_mode last_mode = periph ? PL230_MODE_BASIC :
+					     PL230_MODE_AUTO;
+	uint16_t i;
+
+	if (task_count == 0 || task_count > PL230_MAX_COUNT / 4) {
+		return -1;
+	}
+
+	for (i = 0; i < task_count; i++) {
+		enum pl230_mode mode = i == task_count - 1 ? last_mode :
+							     alt_mode;
+
+		tasks[i].control = (tasks[i].control &
+				    ~PL230_CTRL_CYCLE_CTRL_MASK) |
+				   (mode << PL230_CTRL_CYCLE_CTRL_SHIFT);
+	}
+
+	/*
+	 * Four words per task, copied as one arbitration burst. The source
+	 * walks the whole list, the destination stays the alternate structure.
+	 */
+	pl230_desc_build(&dma->primary[ch],
+			 periph ? PL230_MODE_PERIPH_SG : PL230_MODE_MEM_SG,
+			 (uint32_t)tasks, 0, task_count * 4,
+			 (PL230_WORD << PL230_CTRL_DST_INC_SHIFT) |
+			 (PL230_WORD << PL230_CTRL_DST_SIZE_SHIFT) |
+			 (PL230_WORD << PL230_CTRL_SRC_INC_SHIFT) |
+			 (PL230_WORD << PL230_CTRL_SRC_SIZE_SHIFT) |
+			 (2 << PL230_CTRL_R_POWER_SHIFT));
+	dma->primary[ch].dst_end = (uint32_t)&dma->alternate[ch].user;
+
+	pl230_cycle_start(dma, ch, false);
+	if (!periph) {
+		PL230_SWREQ(dma->base) = 1U << ch;
+	}
+	return 0;
+}
+
+/**
+ * \brief Stop a channel, a ping-pong stream included
+ *
+ * The structure keeps the count of the transfers not done, see
+ * @ref pl230_cycle_remaining.
+ *
+ * @param[in] dma Controller
+ * @param[in] ch Channel
+ */
+void pl230_cycle_stop(struct pl230 *dma, uint8_t ch)
+{
+	PL230_ENACLR(dma->base) = 1U << ch;
+	dma->arm(ch, false);
+
+	CM_ATOMIC_BLOCK() {
+		dma->ping_pong &= ~(1U << ch);
+		dma->active &= ~(1U << ch);
+	}
+}
+
+/**
+ * \brief Check whether a channel is still enabled
+ *
+ * @param[in] dma Controller
+ * @param[in] ch Channel
+ * @return false once the cycle completed or the channel was stopped
+ */
+bool pl230_cycle_busy(struct pl230 *dma, uint8_t ch)
+{
+	return PL230_ENASET(dma->base) & (1U << ch);
+}
+
+/**
+ * \brief Number of transfers left in the structure in use
+ *
+ * @param[in] dma Controller
+ * @param[in] ch Channel
+ * @return transfers left, 0 once the structure completed
+ */
+uint16_t pl230_cycle_remaining(struct pl230 *dma, uint8_t ch)
+{
+	struct pl230_desc *desc = (PL230_ALTSET(dma->base) & (1U << ch)) ?
+				  &dma->alternate[ch] : &dma->primary[ch];
+	uint32_t control = desc->control;
+
+	/* The cycle type is set to stop once the last transfer is done */
+	if ((control & PL230_CTRL_CYCLE_CTRL_MASK) == PL230_MODE_STOP) {
+		return 0;
+	}
+
+	return ((control & PL230_CTRL_N_MINUS_1_MASK) >>
+		PL230_CTRL_N_MINUS_1_SHIFT) + 1;
+}
+
+/**
+ * \brief Dispatch the completions of some channels to their callbacks
+ *
+ * Re-arms the completed halves of ping-pong channels.
+ *
+ * @param[in] dma Controller
+ * @param[in] channels Channels whose done flag was set and cleared by the
+ *		       family driver, bit n for channel n
+ */
+void pl230_irq_done(struct pl230 *dma, uint32_t channels)
+{
+	uint8_t ch;
+
+	for (ch = 0; ch < dma->channels; ch++) {
+		uint32_t events = PL230_EVENT_DONE;
+
+		if (!(channels & (1U << ch))) {
+			continue;
+		}
+
+		if (dma->ping_pong & (1U << ch)) {
+			/* ALTSET shows the half running now */
+			if (PL230_ALTSET(dma->base) & (1U << ch)) {
+				dma->primary[ch].control =
+					dma->chan[ch].ping_pong_control[0];
+			} else {
+				dma->alternate[ch].control =
+					dma->chan[ch].ping_pong_control[1];
+				events |= PL230_EVENT_ALTERNATE;
+			}
+			/* Both halves ran out before the re-arm */
+			if (!(PL230_ENASET(dma->base) & (1U << ch))) {
+				PL230_ENASET(dma->base) = 1U << ch;
+			}
+		} else {
+			CM_ATOMIC_BLOCK() {
+				dma->active &= ~(1U << ch);
+			}
+		}
+
+		if (dma->chan[ch].callback) {
+			dma->chan[ch].callback(ch, events,
+					       dma->chan[ch].user_data);
+		}
+	}
+}
+
+/**
+ * \brief Report a bus error to the callbacks of the failed channels
+ *
+ * The controller disables the failing channel but does not tell which one
+ * it was. It is taken as every active channel that is disabled without a
+ * completion pending.
+ *
+ * @param[in] dma Controller
+ * @param[in] done Channels whose done flag is set and not served yet
+ */
+void pl230_irq_error(struct pl230 *dma, uint32_t done)
+{
+	uint32_t failed = 0;
+	uint8_t ch;
+
+	CM_ATOMIC_BLOCK() {
+		failed = dma->active & ~PL230_ENASET(dma->base) & ~done;
+		dma->active &= ~failed;
+		dma->ping_pong &= ~failed;
+	}
+
+	for (ch = 0; ch < dma->channels; ch++) {
+		if ((failed & (1U << ch)) && dma->chan[ch].callback) {
+			dma->chan[ch].callback(ch, PL230_EVENT_ERROR,
+					       dma->chan[ch].user_data);
+		}
+	}
+}
+
+/** @} */
@@ -0,0 +1,229 @@
+/** @addtogroup dma_file DMA peripheral API
+ * @ingroup peripheral_apis
+ */
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Cycle engine on top of the PL230 register API, the shared PL230 one with
+ * the EFM32 done flags and interrupt enables.
+ *
+ * The control structure table lives here: the primary structures of all
+ * channels, followed 256 bytes later by the alternate ones, as the PL230
+ * expects for up to 16 channels. The dma_cycle_* functions fill the
+ * structures for one of the cycle types and start the channel. The request
+ * source of a peripheral transfer is set beforehand with dma_set_source()
+ * and dma_set_signal().
+ *
+ * In ping-pong mode dma_irq_handler() re-arms the half that just completed
+ * with its original count, so a stream runs until dma_cycle_stop() as long
+ * as the interrupt is served within one half.
+ */
+
+#include <stddef.h>
+#include <libopencm3/efm32/dma.h>
+
+/**@{*/
+
+#define DMA_IF_DONE_MASK	((1 << DMA_CHANNELS) - 1)
+
+static struct pl230_desc dma_table[2][16] __attribute__((aligned(256)));
+
+static struct pl230_chan dma_chan[DMA_CHANNELS];
+
+/* Clear the done flag, the done interrupt is only enabled for a callback */
+static void dma_arm(uint8_t ch, bool irq)
+{
+	DMA_IFC = DMA_IFC_CHxDONE(ch);
+	if (irq) {
+		DMA_IEN |= DMA_IEN_CHxDONE(ch);
+	} else {
+		DMA_IEN &= ~DMA_IEN_CHxDONE(ch);
+	}
+}
+
+static struct pl230 dma_ctrl = {
+	.base = DMA_BASE,
+	.primary = dma_table[0],
+	.alternate = dma_table[1],
+	.chan = dma_chan,
+	.channels = DMA_CHANNELS,
+	.arm = dma_arm,
+};
+
+/**
+ * Install the control structure table and enable the controller
+ * @note Must be called before any dma_cycle_*() function.
+ */
+void dma_table_init(void)
+{
+	pl230_init(&dma_ctrl);
+	DMA_IFC = DMA_IF_ERR;
+	DMA_IEN |= DMA_IEN_ERR;
+}
+
+/**
+ * Primary control structure of a channel
+ * @param[in] ch Channel (use DMA_CHx)
+ * @return structure in the table installed by dma_table_init()
+ */
+struct pl230_desc *dma_table_primary(enum dma_ch ch)
+{
+	return &dma_table[0][ch];
+}
+
+/**
+ * Alternate control structure of a channel
+ * @param[in] ch Channel (use DMA_CHx)
+ * @return structure in the table installed by dma_table_init()
+ */
+struct pl230_desc *dma_table_alternate(enum dma_ch ch)
+{
+	return &dma_table[1][ch];
+}
+
+/**
+ * Fill a control structure
+ * @param[out] desc Structure, in the table or a scatter-gather task list
+ * @param[in] mode Cycle type (use DMA_MODE_*)
+ * @param[in] src Source data start address
+ * @param[in] dest Destination data start address
+ * @param[in] count Number of transfers, 1 to DMA_MAX_COUNT
+ * @param[in] cfg DMA_DESC_CH_CFG_{SRC,DEST}_{SIZE,INC}_* and
+ *            DMA_DESC_CH_CFG_R_POWER() bits, the cycle type and count are
+ *            ignored
+ */
+void dma_desc_build(struct pl230_desc *desc, enum dma_mode mode,
+		    uint32_t src, uint32_t dest, uint16_t count, uint32_t cfg)
+{
+	pl230_desc_build(desc, (enum pl230_mode)mode, src, dest, count, cfg);
+}
+
+/**
+ * Set the function called by dma_irq_handler() for a channel
+ * @param[in] ch Channel (use DMA_CHx)
+ * @param[in] callback Called on the done and bus error interrupts, NULL to
+ *            leave the done interrupt disabled
+ * @param[in] user_data Passed to the callback
+ * @note Takes effect with the next dma_cycle_*() call.
+ */
+void dma_set_callback(enum dma_ch ch, dma_callback callback, void *user_data)
+{
+	pl230_set_callback(&dma_ctrl, ch, callback, user_data);
+}
+
+/**
+ * Start a basic cycle, one transfer per peripheral request
+ * @param[in] ch Channel (use DMA_CHx)
+ * @param[in] src Source data start address
+ * @param[in] dest Destination data start address
+ * @param[in] count Number of transfers, 1 to DMA_MAX_COUNT
+ * @param[in] cfg Sizes, increments and arbitration, see dma_desc_build()
+ */
+void dma_cycle_basic(enum dma_ch ch, uint32_t src, uint32_t dest,
+		     uint16_t count, uint32_t cfg)
+{
+	pl230_cycle_basic(&dma_ctrl, ch, src, dest, count, cfg);
+}
+
+/**
+ * Start an auto-request cycle, a memory to memory copy triggered by
+ * software
+ * @param[in] ch Channel (use DMA_CHx)
+ * @param[in] src Source data start address
+ * @param[in] dest Destination data start address
+ * @param[in] count Number of transfers, 1 to DMA_MAX_COUNT
+ * @param[in] cfg Sizes, increments and arbitration, see dma_desc_build()
+ */
+void dma_cycle_auto(enum dma_ch ch, uint32_t src, uint32_t dest,
+		    uint16_t count, uint32_t cfg)
+{
+	pl230_cycle_auto(&dma_ctrl, ch, src, dest, count, cfg);
+}
+
+/**
+ * Start a continuous ping-pong cycle
+ *
+ * The primary structure moves @a count transfers from @a src0 to
+ * @a dest0, then the alternate one from @a src1 to @a dest1, and so on.
+ * Each completed half is reported to the callback, with
+ * DMA_EVENT_ALTERNATE for the second one, and re-armed.
+ *
+ * @param[in] ch Channel (use DMA_CHx)
+ * @param[in] src0 Source of the primary half
+ * @param[in] dest0 Destination of the primary half
+ * @param[in] src1 Source of the alternate half
+ * @param[in] dest1 Destination of the alternate half
+ * @param[in] count Number of transfers per half, 1 to DMA_MAX_COUNT
+ * @param[in] cfg Sizes, increments and arbitration, see dma_desc_build()
+ */
+void dma_cycle_ping_pong(enum dma_ch ch, uint32_t src0, uint32_t dest0,
+			 uint32_t src1, uint32_t dest1, uint16_t count,
+			 uint32_t cfg)
+{
+	pl230_cycle_ping_pong(&dma_ctrl, ch, src0, dest0, src1, dest1, count,
+			      cfg);
+}
+
+/**
+ * Start a scatter-gather cycle
+ *
+ * The primary structure copies each task in turn into the alternate
+ * structure, which then executes it. Build the tasks with
+ * dma_desc_build(), the cycle types are set here.
+ *
+ * @param[in] ch Channel (use DMA_CHx)
+ * @param[in] tasks Task list, word aligned, must stay valid until done
+ * @param[in] task_count Number of tasks, 1 to DMA_MAX_COUNT / 4
+ * @param[in] periph true for peripheral scatter-gather, each task waiting
+ *            for the peripheral request, false for memory scatter-gather
+ *            started by software
+ * @return 0 on success, -1 if @a task_count is out of range
+ */
+int dma_cycle_scatter_gather(enum dma_ch ch, struct pl230_desc *tasks,
+			     uint16_t task_count, bool periph)
+{
+	return pl230_cycle_scatter_gather(&dma_ctrl, ch, tasks, task_count,
+					  periph);
+}
+
+/**
+ * Stop a channel, a ping-pong stream included
+ * @param[in] ch Channel (use DMA_CHx)
+ */
+void dma_cycle_stop(enum dma_ch ch)
+{
+	pl230_cycle_stop(&dma_ctrl, ch);
+}
+
+/**
+ * Dispatch the done and bus error interrupts, re-arming ping-pong halves
+ * @note Call from dma_isr().
+ */
+void dma_irq_handler(void)
+{
+	uint32_t flags = DMA_IF & DMA_IEN;
+
+	DMA_IFC = flags;
+	pl230_irq_done(&dma_ctrl, flags & DMA_IF_DONE_MASK);
+
+	if (flags & DMA_IF_ERR) {
+		pl230_irq_error(&dma_ctrl, DMA_IF & DMA_IF_DONE_MASK);
+	}
+}
+
+/**@}*/
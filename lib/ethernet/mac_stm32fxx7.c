@@ -123,6 +123,7 @@ void eth_desc_init(uint8_t *buf, uint32_t nTx, uint32_t nRx, uint32_t cTx,
  * @param[in] n uint32_t Size of the packet
  * @returns bool true, if success
  */
+LIBOPENCM3_RAMFUNC
 bool eth_tx(uint8_t *ppkt, uint32_t n)
 {
 	if (ETH_DES0(TxBD) & ETH_TDES0_OWN) {
@@ -151,6 +152,7 @@ bool eth_tx(uint8_t *ppkt, uint32_t n)
  * @param[in] maxlen uint32_t Maximum length of the packet
  * @returns bool true, if the buffer contains readed packet data
  */
+LIBOPENCM3_RAMFUNC
 bool eth_rx(uint8_t *ppkt, uint32_t *len, uint32_t maxlen)
 {
 	bool fs = false;
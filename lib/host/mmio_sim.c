@@ -0,0 +1,604 @@
+/** @defgroup mmio_sim_file Simulated MMIO
+ *
+ * @ingroup host
+ *
+ * @brief <b>libopencm3 simulated register file for host builds</b>
+ *
+ * With LIBOPENCM3_HOST defined, the MMIO accessors of
+ * libopencm3/cm3/common.h resolve each register address through
+ * mmio_sim_reg(), which returns its location in a register file allocated
+ * on the host. Addresses nobody claimed get zeroed pages on first use, so
+ * the library runs unchanged against registers that simply hold what was
+ * written.
+ *
+ * Peripheral behaviour is modelled by attaching callbacks to an address
+ * range with @ref mmio_sim_attach. The accessors are plain lvalues, so the
+ * memory of a model with a write callback is mapped read-only: every store
+ * faults, is single-stepped with the page writable and then reported with
+ * the register value before and after, a store of an unchanged value
+ * included, as for write-one-to-clear registers. This needs Linux on x86.
+ * Other hosts fall back to comparing the register touched last with its
+ * previous value on the next access, or on @ref mmio_sim_flush, and miss
+ * stores of an unchanged value.
+ *
+ * Callbacks must use @ref mmio_sim_peek32 and @ref mmio_sim_poke32, MMIO
+ * accesses from a callback bypass the models. A debugger sees a SIGSEGV
+ * and a SIGTRAP for each store to a model.
+ *
+ * Example, a status register whose ready flag is always set:
+ * @code{.c}
+ *	static void uart_access(uint32_t addr, uint8_t size, void *data)
+ *	{
+ *		(void)size;
+ *		(void)data;
+ *		if (addr == USART1_BASE + 0x1c) {
+ *			mmio_sim_poke32(addr, USART_ISR_TXE);
+ *		}
+ *	}
+ *
+ *	static const struct mmio_sim_ops uart_ops = {
+ *		.access = uart_access,
+ *	};
+ *
+ *	mmio_sim_attach(USART1_BASE, 0x400, &uart_ops, NULL);
+ * @endcode
+ *
+ * The simulation is not thread safe.
+ *
+ * LGPL License Terms @ref lgpl_license
+ */
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+/* ucontext register names */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <libopencm3/host/mmio_sim.h>
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__i386__))
+#define MMIO_SIM_TRAP_STORES	1
+#else
+#define MMIO_SIM_TRAP_STORES	0
+#endif
+
+#if MMIO_SIM_TRAP_STORES
+#include <signal.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/* EFLAGS trap flag, single steps the next instruction */
+#define MMIO_SIM_EFLAGS_TF	0x100
+#endif
+
+struct mmio_sim_region {
+	uint32_t base;
+	uint32_t size;
+	uint8_t *mem;
+	const struct mmio_sim_ops *ops;
+	void *user_data;
+	/* mem is a read-only mapping, stores fault */
+	bool trap;
+};
+
+/* The register being accessed through a model with a write callback */
+struct mmio_sim_pending {
+	struct mmio_sim_region *region;
+	uint32_t addr;
+	uint8_t size;
+	uint64_t old;
+};
+
+/* Allocated one by one, the pointers stay valid while the table grows */
+static struct mmio_sim_region **mmio_sim_regions;
+static uint32_t mmio_sim_region_count;
+static uint32_t mmio_sim_region_max;
+/* Accesses come in runs on the same peripheral */
+static struct mmio_sim_region *mmio_sim_last;
+static struct mmio_sim_pending mmio_sim_pending;
+static bool mmio_sim_in_callback;
+
+static struct mmio_sim_region *mmio_sim_find(uint32_t addr, uint32_t size)
+{
+	struct mmio_sim_region *r = mmio_sim_last;
+	uint32_t i;
+
+	if (r && addr - r->base < r->size &&
+	    size <= r->size - (addr - r->base)) {
+		return r;
+	}
+
+	for (i = 0; i < mmio_sim_region_count; i++) {
+		r = mmio_sim_regions[i];
+		if (addr - r->base < r->size &&
+		    size <= r->size - (addr - r->base)) {
+			mmio_sim_last = r;
+			return r;
+		}
+	}
+	return NULL;
+}
+
+static bool mmio_sim_overlaps(uint32_t base, uint32_t size)
+{
+	uint32_t i;
+
+	for (i = 0; i < mmio_sim_region_count; i++) {
+		const struct mmio_sim_region *r = mmio_sim_regions[i];
+
+		if (base < r->base + r->size && r->base < base + size) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static uint64_t mmio_sim_load(const uint8_t *p, uint8_t size)
+{
+	uint64_t val = 0;
+
+	/* The host is little endian like the targets */
+	memcpy(&val, p, size);
+	return val;
+}
+
+static void mmio_sim_call_write(struct mmio_sim_region *r, uint32_t addr,
+				uint8_t size, uint64_t old, uint64_t val);
+
+#if MMIO_SIM_TRAP_STORES
+
+static struct sigaction mmio_sim_old_segv;
+static struct sigaction mmio_sim_old_trap;
+static bool mmio_sim_handlers;
+/* Pages made writable for MMIO stores from a callback */
+static bool mmio_sim_unprotected;
+/* The store being single-stepped */
+static struct mmio_sim_pending mmio_sim_step;
+
+static size_t mmio_sim_map_size(uint32_t size)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+
+	return (size + page - 1) & ~(page - 1);
+}
+
+static void mmio_sim_protect(const struct mmio_sim_region *r, int prot)
+{
+	if (mprotect(r->mem, mmio_sim_map_size(r->size), prot)) {
+		abort();
+	}
+}
+
+static void mmio_sim_protect_all(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < mmio_sim_region_count; i++) {
+		if (mmio_sim_regions[i]->trap) {
+			mmio_sim_protect(mmio_sim_regions[i], PROT_READ);
+		}
+	}
+	mmio_sim_unprotected = false;
+}
+
+static struct mmio_sim_region *mmio_sim_trapped(const uint8_t *p)
+{
+	uint32_t i;
+
+	for (i = 0; i < mmio_sim_region_count; i++) {
+		struct mmio_sim_region *r = mmio_sim_regions[i];
+
+		if (r->trap && p >= r->mem && p < r->mem + r->size) {
+			return r;
+		}
+	}
+	return NULL;
+}
+
+/* A store to a model: let it through one instruction, see mmio_sim_trap */
+static void mmio_sim_segv(int sig, siginfo_t *si, void *ctx)
+{
+	ucontext_t *uc = ctx;
+	uint8_t *p = si->si_addr;
+	struct mmio_sim_region *r = mmio_sim_trapped(p);
+	uint32_t addr;
+	uint8_t size;
+
+	(void)sig;
+
+	if (!r || mmio_sim_step.region) {
+		/* Not ours, fault again with the previous handler */
+		sigaction(SIGSEGV, &mmio_sim_old_segv, NULL);
+		return;
+	}
+	mmio_sim_protect(r, PROT_READ | PROT_WRITE);
+	if (mmio_sim_in_callback) {
+		mmio_sim_unprotected = true;
+		return;
+	}
+
+	/* The size is known for the register the accessor just resolved */
+	addr = r->base + (p - r->mem);
+	size = addr == mmio_sim_pending.addr ? mmio_sim_pending.size : 4;
+	if (size > r->size - (addr - r->base)) {
+		size = r->size - (addr - r->base);
+	}
+	mmio_sim_step.region = r;
+	mmio_sim_step.addr = addr;
+	mmio_sim_step.size = size;
+	mmio_sim_step.old = mmio_sim_load(p, size);
+	uc->uc_mcontext.gregs[REG_EFL] |= MMIO_SIM_EFLAGS_TF;
+}
+
+/* The store is done: protect the region again and report it */
+static void mmio_sim_trap(int sig, siginfo_t *si, void *ctx)
+{
+	ucontext_t *uc = ctx;
+	struct mmio_sim_pending st = mmio_sim_step;
+	uint64_t val;
+
+	(void)si;
+
+	if (!st.region) {
+		sigaction(SIGTRAP, &mmio_sim_old_trap, NULL);
+		raise(sig);
+		return;
+	}
+	uc->uc_mcontext.gregs[REG_EFL] &= ~MMIO_SIM_EFLAGS_TF;
+	mmio_sim_step.region = NULL;
+	mmio_sim_protect(st.region, PROT_READ);
+
+	val = mmio_sim_load(st.region->mem + (st.addr - st.region->base),
+			    st.size);
+	mmio_sim_call_write(st.region, st.addr, st.size, st.old, val);
+}
+
+static void mmio_sim_install(void)
+{
+	struct sigaction sa;
+
+	if (mmio_sim_handlers) {
+		return;
+	}
+	memset(&sa, 0, sizeof(sa));
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_SIGINFO;
+	sa.sa_sigaction = mmio_sim_segv;
+	sigaction(SIGSEGV, &sa, &mmio_sim_old_segv);
+	sa.sa_sigaction = mmio_sim_trap;
+	sigaction(SIGTRAP, &sa, &mmio_sim_old_trap);
+	mmio_sim_handlers = true;
+}
+
+static void mmio_sim_uninstall(void)
+{
+	if (!mmio_sim_handlers) {
+		return;
+	}
+	sigaction(SIGSEGV, &mmio_sim_old_segv, NULL);
+	sigaction(SIGTRAP, &mmio_sim_old_trap, NULL);
+	mmio_sim_handlers = false;
+}
+
+static uint8_t *mmio_sim_alloc(struct mmio_sim_region *r)
+{
+	void *mem;
+
+	if (!r->ops || !r->ops->write) {
+		return calloc(1, r->size);
+	}
+	mem = mmap(NULL, mmio_sim_map_size(r->size), PROT_READ,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED) {
+		return NULL;
+	}
+	mmio_sim_install();
+	r->trap = true;
+	return mem;
+}
+
+static void mmio_sim_free(struct mmio_sim_region *r)
+{
+	if (r->trap) {
+		munmap(r->mem, mmio_sim_map_size(r->size));
+	} else {
+		free(r->mem);
+	}
+}
+
+/* Store done by the simulation itself, not reported */
+static void mmio_sim_store(struct mmio_sim_region *r, uint32_t addr,
+			   const void *val, uint8_t size)
+{
+	if (r->trap) {
+		mmio_sim_protect(r, PROT_READ | PROT_WRITE);
+	}
+	memcpy(r->mem + (addr - r->base), val, size);
+	if (r->trap) {
+		mmio_sim_protect(r, PROT_READ);
+	}
+}
+
+#else
+
+static uint8_t *mmio_sim_alloc(struct mmio_sim_region *r)
+{
+	return calloc(1, r->size);
+}
+
+static void mmio_sim_free(struct mmio_sim_region *r)
+{
+	free(r->mem);
+}
+
+static void mmio_sim_store(struct mmio_sim_region *r, uint32_t addr,
+			   const void *val, uint8_t size)
+{
+	memcpy(r->mem + (addr - r->base), val, size);
+}
+
+#endif
+
+static void mmio_sim_call_write(struct mmio_sim_region *r, uint32_t addr,
+				uint8_t size, uint64_t old, uint64_t val)
+{
+	mmio_sim_in_callback = true;
+	r->ops->write(addr, size, old, val, r->user_data);
+	mmio_sim_in_callback = false;
+#if MMIO_SIM_TRAP_STORES
+	if (mmio_sim_unprotected) {
+		mmio_sim_protect_all();
+	}
+#endif
+}
+
+static struct mmio_sim_region *mmio_sim_add(uint32_t base, uint32_t size,
+					    const struct mmio_sim_ops *ops,
+					    void *user_data)
+{
+	struct mmio_sim_region *r;
+
+	if (mmio_sim_overlaps(base, size)) {
+		return NULL;
+	}
+
+	if (mmio_sim_region_count == mmio_sim_region_max) {
+		uint32_t max = mmio_sim_region_max ? 2 * mmio_sim_region_max :
+						     64;
+		struct mmio_sim_region **regions;
+
+		regions = realloc(mmio_sim_regions, max * sizeof(*regions));
+		if (!regions) {
+			return NULL;
+		}
+		mmio_sim_regions = regions;
+		mmio_sim_region_max = max;
+	}
+
+	r = calloc(1, sizeof(*r));
+	if (!r) {
+		return NULL;
+	}
+	r->base = base;
+	r->size = size;
+	r->ops = ops;
+	r->user_data = user_data;
+	r->mem = mmio_sim_alloc(r);
+	if (!r->mem) {
+		free(r);
+		return NULL;
+	}
+	mmio_sim_regions[mmio_sim_region_count] = r;
+	mmio_sim_region_count++;
+	return r;
+}
+
+/* Region of an address, a page of plain memory is created for a new one */
+static struct mmio_sim_region *mmio_sim_locate(uint32_t addr, uint8_t size)
+{
+	struct mmio_sim_region *r = mmio_sim_find(addr, size);
+	uint32_t lo = addr & ~(MMIO_SIM_PAGE_SIZE - 1);
+	uint32_t hi = lo + MMIO_SIM_PAGE_SIZE;
+	uint32_t i;
+
+	if (r) {
+		return r;
+	}
+
+	/* Clip the page to the gap between attached regions */
+	for (i = 0; i < mmio_sim_region_count; i++) {
+		const struct mmio_sim_region *o = mmio_sim_regions[i];
+
+		if (o->base <= addr && o->base + o->size > lo) {
+			lo = o->base + o->size;
+		} else if (o->base > addr && o->base < hi) {
+			hi = o->base;
+		}
+	}
+
+	r = mmio_sim_add(lo, hi - lo, NULL, NULL);
+	if (!r || addr + size > hi) {
+		abort();
+	}
+	mmio_sim_last = r;
+	return r;
+}
+
+/**
+ * \brief Model the peripheral behind an address range
+ *
+ * Must be called before the first access to the range.
+ *
+ * @param[in] base First address
+ * @param[in] size Size of the range in bytes
+ * @param[in] ops Callbacks, must stay valid, NULL for plain memory
+ * @param[in] user_data Passed to the callbacks
+ * @return 0 on success, -1 if the range overlaps one in use or no memory
+ *	   is left
+ */
+int mmio_sim_attach(uint32_t base, uint32_t size,
+		    const struct mmio_sim_ops *ops, void *user_data)
+{
+	return mmio_sim_add(base, size, ops, user_data) ? 0 : -1;
+}
+
+/**
+ * \brief Contiguous host memory for a target memory range
+ *
+ * For structures laid over peripheral memory, like CAN message RAM, which
+ * may cross the pages created on demand. The range is created as plain
+ * memory if no region holds it yet.
+ *
+ * @param[in] addr First address
+ * @param[in] size Size in bytes
+ * @return host address of @a addr, aborts if the range straddles a region
+ *	   in use or the host is out of memory
+ */
+void *mmio_sim_mem(uint32_t addr, uint32_t size)
+{
+	struct mmio_sim_region *r = mmio_sim_find(addr, size);
+
+	if (!r) {
+		r = mmio_sim_add(addr, size, NULL, NULL);
+	}
+	if (!r) {
+		abort();
+	}
+	return r->mem + (addr - r->base);
+}
+
+/**
+ * \brief Report the last write to its model
+ *
+ * Call before looking at the state of a model from outside the library.
+ * Nothing to do where stores are trapped, they are reported at once.
+ */
+void mmio_sim_flush(void)
+{
+#if !MMIO_SIM_TRAP_STORES
+	struct mmio_sim_pending p = mmio_sim_pending;
+	uint64_t val;
+
+	if (!p.region) {
+		return;
+	}
+	mmio_sim_pending.region = NULL;
+
+	val = mmio_sim_load(p.region->mem + (p.addr - p.region->base), p.size);
+	if (val != p.old) {
+		mmio_sim_call_write(p.region, p.addr, p.size, p.old, val);
+	}
+#endif
+}
+
+/**
+ * \brief Drop all regions and their contents
+ */
+void mmio_sim_reset(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < mmio_sim_region_count; i++) {
+		mmio_sim_free(mmio_sim_regions[i]);
+		free(mmio_sim_regions[i]);
+	}
+#if MMIO_SIM_TRAP_STORES
+	mmio_sim_uninstall();
+	mmio_sim_unprotected = false;
+#endif
+	free(mmio_sim_regions);
+	mmio_sim_regions = NULL;
+	mmio_sim_region_count = 0;
+	mmio_sim_region_max = 0;
+	mmio_sim_last = NULL;
+	mmio_sim_pending.region = NULL;
+	mmio_sim_in_callback = false;
+}
+
+/**
+ * \brief Read a register without calling the models
+ *
+ * @param[in] addr Register address
+ * @return register value
+ */
+uint32_t mmio_sim_peek32(uint32_t addr)
+{
+	struct mmio_sim_region *r = mmio_sim_locate(addr, 4);
+
+	return mmio_sim_load(r->mem + (addr - r->base), 4);
+}
+
+/**
+ * \brief Write a register without calling the models
+ *
+ * @param[in] addr Register address
+ * @param[in] val Value
+ */
+void mmio_sim_poke32(uint32_t addr, uint32_t val)
+{
+	struct mmio_sim_region *r = mmio_sim_locate(addr, 4);
+
+	mmio_sim_store(r, addr, &val, 4);
+}
+
+/*
+ * Backend of the MMIO accessors: the host location of a register. The
+ * models see the access here. Where stores are not trapped, the previous
+ * access is checked for a write.
+ */
+volatile void *mmio_sim_reg(uint32_t addr, uint8_t size)
+{
+	struct mmio_sim_region *r;
+	uint8_t *reg;
+
+	if (mmio_sim_in_callback) {
+		r = mmio_sim_locate(addr, size);
+		return r->mem + (addr - r->base);
+	}
+
+	mmio_sim_flush();
+
+	r = mmio_sim_locate(addr, size);
+	reg = r->mem + (addr - r->base);
+
+	if (r->ops) {
+		if (r->ops->access) {
+			mmio_sim_in_callback = true;
+			r->ops->access(addr, size, r->user_data);
+			mmio_sim_in_callback = false;
+#if MMIO_SIM_TRAP_STORES
+			if (mmio_sim_unprotected) {
+				mmio_sim_protect_all();
+			}
+#endif
+		}
+		if (r->ops->write) {
+			mmio_sim_pending.region = r;
+			mmio_sim_pending.addr = addr;
+			mmio_sim_pending.size = size;
+			mmio_sim_pending.old = mmio_sim_load(reg, size);
+		}
+	}
+
+	return reg;
+}
+
+/**@}*/
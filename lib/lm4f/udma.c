@@ -0,0 +1,331 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @defgroup udma_file uDMA
+ *
+ * @ingroup LM4Fxx
+ *
+ * \brief <b>libopencm3 LM4F Micro Direct Memory Access controller</b>
+ *
+ * The control table lives here: the primary structures of the 32 channels,
+ * followed 512 bytes later by the alternate ones. The udma_cycle_*()
+ * functions fill the structures for one of the transfer modes and start the
+ * channel, through the PL230 cycle engine shared with the EFM32. The
+ * peripheral of a channel is selected beforehand with
+ * @ref udma_channel_assign.
+ *
+ * Completion is signalled differently for the two kinds of channels.
+ * Channels started by software interrupt through udma_isr(), channels of a
+ * peripheral through the interrupt of that peripheral. Both set the channel
+ * bit in UDMA_CHIS, so @ref udma_irq_handler is called with the channels
+ * belonging to the interrupt being served:
+ * @code{.c}
+ *	void udma_isr(void)
+ *	{
+ *		udma_irq_handler(1 << 30);
+ *	}
+ *
+ *	void uart0_isr(void)
+ *	{
+ *		udma_irq_handler((1 << 8) | (1 << 9));
+ *		...
+ *	}
+ * @endcode
+ * In ping-pong mode the half that just completed is re-armed with its
+ * original count, so a stream runs until @ref udma_cycle_stop as long as the
+ * interrupt is served within one half.
+ *
+ * @{
+ */
+
+#include <stddef.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/lm4f/systemcontrol.h>
+#include <libopencm3/lm4f/udma.h>
+
+static struct pl230_desc udma_table[2][UDMA_CHANNELS]
+	__attribute__((aligned(1024)));
+
+static struct pl230_chan udma_chan[UDMA_CHANNELS];
+
+/* The done flags have no enable, the interrupt of the channel decides */
+static void udma_arm(uint8_t ch, bool irq)
+{
+	(void)irq;
+	UDMA_CHIS = 1U << ch;
+}
+
+static struct pl230 udma_ctrl = {
+	.base = UDMA_BASE,
+	.primary = udma_table[0],
+	.alternate = udma_table[1],
+	.chan = udma_chan,
+	.channels = UDMA_CHANNELS,
+	.arm = udma_arm,
+};
+
+/**
+ * \brief Enable the controller and install the control table
+ *
+ * Must be called before any other udma_*() function.
+ */
+void udma_init(void)
+{
+	periph_clock_enable(RCC_DMA);
+	/* We need a brief delay before we can access the uDMA registers */
+	__asm__("nop"); __asm__("nop"); __asm__("nop");
+
+	pl230_init(&udma_ctrl);
+	UDMA_ERRCLR = UDMA_ERRCLR_ERRCLR;
+	UDMA_CHIS = 0xffffffff;
+}
+
+/**
+ * \brief Select the peripheral of a channel
+ *
+ * @param[in] ch Channel, 0 to 31
+ * @param[in] encoding Channel encoding, see the "uDMA Channel Assignments"
+ *		       table of the datasheet. Encoding 0 is the reset value.
+ */
+void udma_channel_assign(uint8_t ch, uint8_t encoding)
+{
+	CM_ATOMIC_BLOCK() {
+		UDMA_CHMAP(ch / 8) = (UDMA_CHMAP(ch / 8) &
+				      ~UDMA_CHMAP_MASK(ch)) |
+				     (encoding << UDMA_CHMAP_SHIFT(ch));
+	}
+}
+
+/**
+ * \brief Set the priority of a channel
+ *
+ * High priority channels are served before the default priority ones, and
+ * lower channel numbers before higher ones at the same priority.
+ *
+ * @param[in] ch Channel, 0 to 31
+ * @param[in] high true for high priority
+ */
+void udma_channel_set_priority(uint8_t ch, bool high)
+{
+	if (high) {
+		UDMA_PRIOSET = 1U << ch;
+	} else {
+		UDMA_PRIOCLR = 1U << ch;
+	}
+}
+
+/**
+ * \brief Primary control structure of a channel
+ *
+ * @param[in] ch Channel, 0 to 31
+ * @return structure in the table installed by @ref udma_init
+ */
+struct pl230_desc *udma_table_primary(uint8_t ch)
+{
+	return &udma_table[0][ch];
+}
+
+/**
+ * \brief Alternate control structure of a channel
+ *
+ * @param[in] ch Channel, 0 to 31
+ * @return structure in the table installed by @ref udma_init
+ */
+struct pl230_desc *udma_table_alternate(uint8_t ch)
+{
+	return &udma_table[1][ch];
+}
+
+/**
+ * \brief Fill a control structure
+ *
+ * @param[out] desc Structure, in the table or a scatter-gather task list
+ * @param[in] mode Transfer mode
+ * @param[in] src Source data start address
+ * @param[in] dst Destination data start address
+ * @param[in] count Number of transfers, 1 to UDMA_MAX_COUNT
+ * @param[in] control UDMA_CHCTL_{SRC,DST}{SIZE,INC}_* and
+ *		      UDMA_CHCTL_ARBSIZE() bits, the mode and size are ignored
+ */
+void udma_desc_build(struct pl230_desc *desc, enum udma_mode mode,
+		     uint32_t src, uint32_t dst, uint16_t count,
+		     uint32_t control)
+{
+	pl230_desc_build(desc, (enum pl230_mode)mode, src, dst, count,
+			 control);
+}
+
+/**
+ * \brief Set the function called by @ref udma_irq_handler for a channel
+ *
+ * @param[in] ch Channel, 0 to 31
+ * @param[in] callback Called on completion and bus errors, NULL for none
+ * @param[in] user_data Passed to the callback
+ */
+void udma_set_callback(uint8_t ch, udma_callback callback, void *user_data)
+{
+	pl230_set_callback(&udma_ctrl, ch, callback, user_data);
+}
+
+/**
+ * \brief Start a basic transfer, driven by the peripheral requests
+ *
+ * @param[in] ch Channel, 0 to 31
+ * @param[in] src Source data start address
+ * @param[in] dst Destination data start address
+ * @param[in] count Number of transfers, 1 to UDMA_MAX_COUNT
+ * @param[in] control Sizes, increments and arbitration, see
+ *		      @ref udma_desc_build
+ */
+void udma_cycle_basic(uint8_t ch, uint32_t src, uint32_t dst, uint16_t count,
+		      uint32_t control)
+{
+	pl230_cycle_basic(&udma_ctrl, ch, src, dst, count, control);
+}
+
+/**
+ * \brief Start an auto-request transfer, a copy triggered by software
+ *
+ * @param[in] ch Channel, 0 to 31
+ * @param[in] src Source data start address
+ * @param[in] dst Destination data start address
+ * @param[in] count Number of transfers, 1 to UDMA_MAX_COUNT
+ * @param[in] control Sizes, increments and arbitration, see
+ *		      @ref udma_desc_build
+ */
+void udma_cycle_auto(uint8_t ch, uint32_t src, uint32_t dst, uint16_t count,
+		     uint32_t control)
+{
+	pl230_cycle_auto(&udma_ctrl, ch, src, dst, count, control);
+}
+
+/**
+ * \brief Start a continuous ping-pong transfer
+ *
+ * The primary structure moves @a count transfers from @a src0 to @a dst0,
+ * then the alternate one from @a src1 to @a dst1, and so on. Each completed
+ * half is reported to the callback, with UDMA_EVENT_ALTERNATE for the second
+ * one, and re-armed.
+ *
+ * @param[in] ch Channel, 0 to 31
+ * @param[in] src0 Source of the primary half
+ * @param[in] dst0 Destination of the primary half
+ * @param[in] src1 Source of the alternate half
+ * @param[in] dst1 Destination of the alternate half
+ * @param[in] count Number of transfers per half, 1 to UDMA_MAX_COUNT
+ * @param[in] control Sizes, increments and arbitration, see
+ *		      @ref udma_desc_build
+ */
+void udma_cycle_ping_pong(uint8_t ch, uint32_t src0, uint32_t dst0,
+			  uint32_t src1, uint32_t dst1, uint16_t count,
+			  uint32_t control)
+{
+	pl230_cycle_ping_pong(&udma_ctrl, ch, src0, dst0, src1, dst1, count,
+			      control);
+}
+
+/**
+ * \brief Start a scatter-gather transfer
+ *
+ * The primary structure copies each task in turn into the alternate
+ * structure, which then executes it. Build the tasks with
+ * @ref udma_desc_build, the modes are set here.
+ *
+ * @param[in] ch Channel, 0 to 31
+ * @param[in] tasks Task list, word aligned, must stay valid until done
+ * @param[in] task_count Number of tasks, 1 to UDMA_MAX_COUNT / 4
+ * @param[in] periph true for peripheral scatter-gather, each task waiting
+ *		     for the peripheral request, false for memory
+ *		     scatter-gather started by software
+ * @return 0 on success, -1 if @a task_count is out of range
+ */
+int udma_cycle_scatter_gather(uint8_t ch, struct pl230_desc *tasks,
+			      uint16_t task_count, bool periph)
+{
+	return pl230_cycle_scatter_gather(&udma_ctrl, ch, tasks, task_count,
+					  periph);
+}
+
+/**
+ * \brief Stop a channel, a ping-pong stream included
+ *
+ * The structure keeps the count of the transfers not done, see
+ * @ref udma_cycle_remaining.
+ *
+ * @param[in] ch Channel, 0 to 31
+ */
+void udma_cycle_stop(uint8_t ch)
+{
+	pl230_cycle_stop(&udma_ctrl, ch);
+}
+
+/**
+ * \brief Check whether a channel is still enabled
+ *
+ * @param[in] ch Channel, 0 to 31
+ * @return false once the transfer completed or the channel was stopped
+ */
+bool udma_cycle_busy(uint8_t ch)
+{
+	return pl230_cycle_busy(&udma_ctrl, ch);
+}
+
+/**
+ * \brief Number of transfers left in the structure in use
+ *
+ * @param[in] ch Channel, 0 to 31
+ * @return transfers left, 0 once the structure completed
+ */
+uint16_t udma_cycle_remaining(uint8_t ch)
+{
+	return pl230_cycle_remaining(&udma_ctrl, ch);
+}
+
+/**
+ * \brief Dispatch the completions of some channels to their callbacks
+ *
+ * Re-arms the completed halves of ping-pong channels.
+ *
+ * @param[in] channels Channels served by the calling interrupt, bit n for
+ *		       channel n
+ */
+void udma_irq_handler(uint32_t channels)
+{
+	uint32_t flags = UDMA_CHIS & channels;
+
+	UDMA_CHIS = flags;
+	pl230_irq_done(&udma_ctrl, flags);
+}
+
+/**
+ * \brief Report a bus error to the callbacks of the failed channels
+ *
+ * The controller disables the failing channel but does not tell which one
+ * it was. Call from udmaerr_isr().
+ */
+void udma_error_irq_handler(void)
+{
+	if (!(UDMA_ERRCLR & UDMA_ERRCLR_ERRCLR)) {
+		return;
+	}
+	UDMA_ERRCLR = UDMA_ERRCLR_ERRCLR;
+
+	pl230_irq_error(&udma_ctrl, UDMA_CHIS);
+}
+
+/** @} */
@@ -0,0 +1,339 @@
+/** @defgroup gpdma_file GPDMA
+
+@ingroup LPC43xx
+
+@brief <b>libopencm3 LPC43xx General Purpose DMA</b>
+
+Channel allocation, peripheral request routing and linked list transfers on
+the eight channel GPDMA controller. Channel 0 has the highest priority.
+
+A transfer is a chain of @ref gpdma_lli items. @ref gpdma_lli_chain splits a
+block into items of at most 4095 transfers, chains can be joined with
+@ref gpdma_lli_link for scatter-gather, and linking the last item back to
+the first gives a circular transfer that runs until @ref gpdma_stop. The
+last item of each chain raises a terminal count, which is reported to the
+callback of the channel, so a circular transfer made of two chains
+reports each half.
+
+Example, receiving USART0 into a double buffer:
+@code
+	struct gpdma_lli lli[2];
+	uint32_t control = GPDMA_CCONTROL_DI(1) | GPDMA_CCONTROL_S(1);
+	int ch;
+
+	gpdma_init();
+	ch = gpdma_alloc(0xff);
+	gpdma_lli_chain(&lli[0], 1, (uint32_t)&UART_RBR(UART0),
+			(uint32_t)buf[0], 64, control);
+	gpdma_lli_chain(&lli[1], 1, (uint32_t)&UART_RBR(UART0),
+			(uint32_t)buf[1], 64, control);
+	gpdma_lli_link(&lli[0], &lli[1]);
+	gpdma_lli_link(&lli[1], &lli[0]);
+	gpdma_start(ch, lli, GPDMA_REQ_USART0_RX, GPDMA_REQ_MEMORY,
+		    rx_half_done, NULL);
+	nvic_enable_irq(NVIC_DMA_IRQ);
+@endcode
+with dma_isr() calling @ref gpdma_irq_handler.
+
+The controller is shared by both cores, the driver must only be used from
+one of them.
+
+LGPL License Terms @ref lgpl_license
+*/
+
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <stddef.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/lpc43xx/creg.h>
+#include <libopencm3/lpc43xx/gpdma.h>
+
+static uint8_t gpdma_allocated;
+static gpdma_callback gpdma_callbacks[GPDMA_CHANNELS];
+static void *gpdma_user_data[GPDMA_CHANNELS];
+
+/*---------------------------------------------------------------------------*/
+/** @brief Enable the controller.
+
+Both AHB masters are little endian. Pending interrupts are cleared.
+*/
+
+void gpdma_init(void)
+{
+	GPDMA_CONFIG = GPDMA_CONFIG_E(1);
+	while (!(GPDMA_CONFIG & GPDMA_CONFIG_E_MASK));
+
+	GPDMA_INTTCCLEAR = 0xff;
+	GPDMA_INTERRCLR = 0xff;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Allocate a free channel.
+
+@param[in] channel_mask Channels that may be used, bit n for channel n. The
+lowest free one, which has the highest priority, is taken.
+@returns Channel number, -1 if none is free.
+*/
+
+int gpdma_alloc(uint8_t channel_mask)
+{
+	int channel = -1;
+	int i;
+
+	CM_ATOMIC_BLOCK() {
+		for (i = 0; i < GPDMA_CHANNELS; i++) {
+			if ((channel_mask & ~gpdma_allocated) & (1 << i)) {
+				gpdma_allocated |= 1 << i;
+				channel = i;
+				break;
+			}
+		}
+	}
+
+	return channel;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Stop a channel and return it to the free ones.
+
+@param[in] channel Channel from @ref gpdma_alloc.
+*/
+
+void gpdma_free(uint8_t channel)
+{
+	gpdma_stop(channel);
+
+	CM_ATOMIC_BLOCK() {
+		gpdma_allocated &= ~(1 << channel);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Describe a block transfer with linked list items.
+
+The block is split into items of at most @ref GPDMA_MAX_TRANSFER_SIZE
+transfers. Addresses advance between items on the sides that increment.
+The last item raises a terminal count and ends the chain, see
+@ref gpdma_lli_link to continue it.
+
+@param[out] lli Items to fill.
+@param[in] lli_count Number of items available.
+@param[in] src Source address.
+@param[in] dest Destination address.
+@param[in] count Number of transfers of the source width.
+@param[in] control CONTROL value without TRANSFERSIZE and I: widths, burst
+sizes, increments and AHB masters.
+@returns Number of items used, 0 if @p lli_count is too small.
+*/
+
+uint32_t gpdma_lli_chain(struct gpdma_lli *lli, uint32_t lli_count,
+			 uint32_t src, uint32_t dest, uint32_t count,
+			 uint32_t control)
+{
+	uint32_t swidth = (control & GPDMA_CCONTROL_SWIDTH_MASK) >>
+			  GPDMA_CCONTROL_SWIDTH_SHIFT;
+	uint32_t items = (count + GPDMA_MAX_TRANSFER_SIZE - 1) /
+			 GPDMA_MAX_TRANSFER_SIZE;
+	uint32_t i;
+
+	if (!count || items > lli_count) {
+		return 0;
+	}
+
+	for (i = 0; i < items; i++) {
+		uint32_t n = count;
+		uint32_t bytes;
+
+		if (n > GPDMA_MAX_TRANSFER_SIZE) {
+			n = GPDMA_MAX_TRANSFER_SIZE;
+		}
+		count -= n;
+		/* TRANSFERSIZE counts source transfers */
+		bytes = n << swidth;
+
+		lli[i].src = src;
+		lli[i].dest = dest;
+		lli[i].control = control | GPDMA_CCONTROL_TRANSFERSIZE(n);
+		if (count) {
+			lli[i].lli = (uint32_t)&lli[i + 1];
+		} else {
+			lli[i].lli = 0;
+			lli[i].control |= GPDMA_CCONTROL_I(1);
+		}
+
+		if (control & GPDMA_CCONTROL_SI_MASK) {
+			src += bytes;
+		}
+		if (control & GPDMA_CCONTROL_DI_MASK) {
+			dest += bytes;
+		}
+	}
+
+	return items;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Continue a chain with another one.
+
+@param[in] lli Last item of a chain from @ref gpdma_lli_chain.
+@param[in] next Item to continue with, the first item of the same chain for
+a circular transfer, NULL to end the chain here.
+*/
+
+void gpdma_lli_link(struct gpdma_lli *lli, const struct gpdma_lli *next)
+{
+	/* LM stays 0, the items are loaded through AHB master 0 */
+	lli->lli = (uint32_t)next;
+}
+
+/* Route a request line to the peripheral, return the line number */
+static uint32_t gpdma_route(uint8_t req)
+{
+	uint32_t line;
+
+	if (req == GPDMA_REQ_MEMORY) {
+		return 0;
+	}
+
+	line = GPDMA_REQ_LINE(req);
+	CM_ATOMIC_BLOCK() {
+		CREG_DMAMUX = (CREG_DMAMUX & ~(0x3 << (line * 2))) |
+			      (GPDMA_REQ_MUX(req) << (line * 2));
+	}
+	return line;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Start a transfer.
+
+The flow control is derived from the request arguments. The callback is
+called from @ref gpdma_irq_handler with GPDMA_EVENT_COMPLETE at the end of
+each chain and GPDMA_EVENT_ERROR on a bus error, which also stops the
+channel.
+
+@param[in] channel Channel from @ref gpdma_alloc.
+@param[in] lli First item of the transfer. For a single item it is copied
+to the channel and need not stay valid, linked items must.
+@param[in] src_req Source request, GPDMA_REQ_MEMORY for memory.
+@param[in] dest_req Destination request, GPDMA_REQ_MEMORY for memory.
+@param[in] callback Optional, NULL leaves the channel interrupts masked.
+@param[in] user_data Passed to the callback.
+*/
+
+void gpdma_start(uint8_t channel, const struct gpdma_lli *lli,
+		 uint8_t src_req, uint8_t dest_req,
+		 gpdma_callback callback, void *user_data)
+{
+	uint32_t config;
+	uint32_t flow;
+
+	if (src_req == GPDMA_REQ_MEMORY) {
+		flow = dest_req == GPDMA_REQ_MEMORY ? GPDMA_FLOW_M2M :
+						       GPDMA_FLOW_M2P;
+	} else {
+		flow = dest_req == GPDMA_REQ_MEMORY ? GPDMA_FLOW_P2M :
+						       GPDMA_FLOW_P2P;
+	}
+
+	config = GPDMA_CCONFIG_SRCPERIPHERAL(gpdma_route(src_req)) |
+		 GPDMA_CCONFIG_DESTPERIPHERAL(gpdma_route(dest_req)) |
+		 GPDMA_CCONFIG_FLOWCNTRL(flow);
+	if (callback) {
+		config |= GPDMA_CCONFIG_IE(1) | GPDMA_CCONFIG_ITC(1);
+	}
+
+	gpdma_callbacks[channel] = callback;
+	gpdma_user_data[channel] = user_data;
+
+	GPDMA_INTTCCLEAR = 1 << channel;
+	GPDMA_INTERRCLR = 1 << channel;
+
+	GPDMA_CSRCADDR(channel) = lli->src;
+	GPDMA_CDESTADDR(channel) = lli->dest;
+	GPDMA_CLLI(channel) = lli->lli;
+	GPDMA_CCONTROL(channel) = lli->control;
+	GPDMA_CCONFIG(channel) = config | GPDMA_CCONFIG_E(1);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Stop a channel.
+
+Further requests are ignored and the data already in the channel FIFO is
+written out before the channel is disabled.
+
+@param[in] channel Channel from @ref gpdma_alloc.
+*/
+
+void gpdma_stop(uint8_t channel)
+{
+	if (!gpdma_busy(channel)) {
+		return;
+	}
+
+	GPDMA_CCONFIG(channel) |= GPDMA_CCONFIG_H(1);
+	while (GPDMA_CCONFIG(channel) & GPDMA_CCONFIG_A_MASK);
+	GPDMA_CCONFIG(channel) &= ~(GPDMA_CCONFIG_E_MASK |
+				    GPDMA_CCONFIG_H_MASK);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Check whether a channel is still enabled.
+
+@param[in] channel Channel from @ref gpdma_alloc.
+@returns false once the last item of a non circular transfer completed, or
+the channel was stopped.
+*/
+
+bool gpdma_busy(uint8_t channel)
+{
+	return GPDMA_ENBLDCHNS & (1 << channel);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Dispatch the channel interrupts to the callbacks.
+
+Call from dma_isr().
+*/
+
+void gpdma_irq_handler(void)
+{
+	uint32_t tc = GPDMA_INTTCSTAT;
+	uint32_t err = GPDMA_INTERRSTAT;
+	int i;
+
+	GPDMA_INTTCCLEAR = tc;
+	GPDMA_INTERRCLR = err;
+
+	for (i = 0; i < GPDMA_CHANNELS; i++) {
+		uint32_t events = 0;
+
+		if (tc & (1 << i)) {
+			events |= GPDMA_EVENT_COMPLETE;
+		}
+		if (err & (1 << i)) {
+			events |= GPDMA_EVENT_ERROR;
+		}
+		if (events && gpdma_callbacks[i]) {
+			gpdma_callbacks[i](i, events, gpdma_user_data[i]);
+		}
+	}
+}
+
+/**@}*/
@@ -0,0 +1,396 @@
+/** @defgroup ipc_mbox_file IPC messaging
+
+@ingroup LPC43xx
+
+@brief <b>libopencm3 LPC43xx inter-core messaging</b>
+
+Message rings and a buffer pool shared by the M4 and the M0 core.
+
+Each direction has a single producer, single consumer ring in SRAM that
+both cores can reach, so no lock is needed, which the M0 could not provide
+anyway. A core rings the doorbell of the other one with SEV: its TXEV
+output is the M0CORE interrupt of the M4, respectively the M4CORE interrupt
+of the M0. The doorbell is only rung when the ring was empty, while the
+receiver drains the ring completely in its interrupt, so a burst of
+messages costs one interrupt. ipc_post() and ipc_flush() batch explicitly.
+
+Large data is not copied through the rings: a buffer from the shared pool
+is handed over with ipc_send_buf(), and released by the receiver with
+ipc_buf_free() once done. Each core owns half of the pool, buffers released
+by the other core travel home through a return ring.
+
+Usage on the M4, with the control block and pool placed in AHB SRAM:
+@code
+	ipc_init(&shared, pool, 512, 16);
+	ipc_start_m0(m0_image);
+	nvic_enable_irq(NVIC_M0CORE_IRQ);
+@endcode
+and on the M0, with the same control block address:
+@code
+	ipc_attach(shared);
+	nvic_enable_irq(NVIC_M4CORE_IRQ);
+@endcode
+Both cores call ipc_irq_handler() from their cross-core interrupt.
+
+LPC43xx has no data cache, barriers are enough for coherency.
+
+LGPL License Terms @ref lgpl_license
+*/
+
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <stddef.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/lpc43xx/creg.h>
+#include <libopencm3/lpc43xx/ipc.h>
+
+#if defined(LPC43XX_M4)
+#define IPC_SELF		IPC_CORE_M4
+#define IPC_PEER		IPC_CORE_M0
+/* Doorbell from the M0, raised by its TXEV */
+#define IPC_PEER_TXEVENT	CREG_M0TXEVENT
+#else
+#define IPC_SELF		IPC_CORE_M0
+#define IPC_PEER		IPC_CORE_M4
+#define IPC_PEER_TXEVENT	CREG_M4TXEVENT
+#endif
+
+#define IPC_RING_MASK		(IPC_RING_SLOTS - 1)
+#define IPC_POOL_MASK		(IPC_POOL_MAX_BUFFERS - 1)
+
+static struct ipc_shared *ipc_shared;
+static ipc_callback_t ipc_callback;
+static void *ipc_user_data;
+
+/* Free buffers of the local half of the pool */
+static uint8_t ipc_free[IPC_POOL_MAX_BUFFERS];
+static uint32_t ipc_free_count;
+
+/* Orders the accesses to the shared memory, DMB exists on both cores. */
+static inline void ipc_barrier(void)
+{
+	__asm__ volatile ("dmb" : : : "memory");
+}
+
+static inline void ipc_doorbell(void)
+{
+	__asm__ volatile ("dsb\n\tsev" : : : "memory");
+}
+
+/* The M4 owns the lower half of the pool, the M0 the upper half. */
+static bool ipc_buf_is_local(uint32_t idx)
+{
+	uint32_t half = ipc_shared->buf_count / 2;
+
+	return (IPC_SELF == IPC_CORE_M4) == (idx < half);
+}
+
+static void ipc_pool_reset(void)
+{
+	uint32_t i;
+
+	ipc_free_count = 0;
+	for (i = 0; i < ipc_shared->buf_count; i++) {
+		if (ipc_buf_is_local(i)) {
+			ipc_free[ipc_free_count++] = i;
+		}
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Set up the shared control block, on the M4.
+
+Must be called before the M0 is started.
+
+@param[in] shared Control block in SRAM accessible to both cores.
+@param[in] pool Buffer pool in shared SRAM, NULL if unused.
+@param[in] buf_size Size of a pool buffer in bytes, a multiple of 4.
+@param[in] buf_count Number of pool buffers, up to IPC_POOL_MAX_BUFFERS.
+*/
+
+void ipc_init(struct ipc_shared *shared, void *pool, uint32_t buf_size,
+	      uint32_t buf_count)
+{
+	if (!pool) {
+		buf_count = 0;
+	}
+	if (buf_count > IPC_POOL_MAX_BUFFERS) {
+		buf_count = IPC_POOL_MAX_BUFFERS;
+	}
+
+	*shared = (struct ipc_shared) {
+		.pool_base = (uint32_t)pool,
+		.buf_size = buf_size,
+		.buf_count = buf_count,
+	};
+
+	ipc_shared = shared;
+	ipc_pool_reset();
+
+	ipc_barrier();
+	shared->magic = IPC_MAGIC;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Attach to the control block set up by the M4, on the M0.
+
+Waits until the M4 has completed @ref ipc_init.
+
+@param[in] shared Control block passed to @ref ipc_init.
+*/
+
+void ipc_attach(struct ipc_shared *shared)
+{
+	while (shared->magic != IPC_MAGIC);
+	ipc_barrier();
+
+	ipc_shared = shared;
+	ipc_pool_reset();
+}
+
+/* Copy a message into the peer ring, storing the head it was written at. */
+static int ipc_push(const struct ipc_msg *msg, uint32_t *slot)
+{
+	struct ipc_ring *ring = &ipc_shared->ring[IPC_PEER];
+	int ret = -1;
+
+	/* Interrupt and thread code of this core may both send */
+	CM_ATOMIC_BLOCK() {
+		uint32_t head = ring->head;
+
+		if (head - ring->tail < IPC_RING_SLOTS) {
+			ring->msg[head & IPC_RING_MASK] = *msg;
+			ipc_barrier();
+			ring->head = head + 1;
+			*slot = head;
+			ret = 0;
+		}
+	}
+
+	return ret;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Queue a message for the other core without ringing its doorbell.
+
+Use @ref ipc_flush once a batch is complete.
+
+@param[in] msg Message, copied into the ring.
+@returns 0 on success, -1 if the ring is full.
+*/
+
+int ipc_post(const struct ipc_msg *msg)
+{
+	uint32_t slot;
+
+	return ipc_push(msg, &slot);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Ring the doorbell of the other core if messages are pending. */
+
+void ipc_flush(void)
+{
+	struct ipc_ring *ring = &ipc_shared->ring[IPC_PEER];
+
+	ipc_barrier();
+	if (ring->head != ring->tail) {
+		ipc_doorbell();
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Send a message to the other core.
+
+The doorbell is only rung if the other core had emptied the ring, otherwise
+it is still draining and picks the message up without a new interrupt.
+
+@param[in] msg Message, copied into the ring.
+@returns 0 on success, -1 if the ring is full.
+*/
+
+int ipc_send(const struct ipc_msg *msg)
+{
+	struct ipc_ring *ring = &ipc_shared->ring[IPC_PEER];
+	uint32_t slot;
+
+	if (ipc_push(msg, &slot) < 0) {
+		return -1;
+	}
+
+	/* The other core had emptied the ring up to this message. The slot
+	 * comes from the atomic push, an interrupt sending in between cannot
+	 * make it stale.
+	 */
+	ipc_barrier();
+	if (ring->tail == slot) {
+		ipc_doorbell();
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Take the next message sent by the other core.
+
+@param[out] msg Message.
+@returns 0 on success, -1 if no message is pending.
+*/
+
+int ipc_recv(struct ipc_msg *msg)
+{
+	struct ipc_ring *ring = &ipc_shared->ring[IPC_SELF];
+	uint32_t tail = ring->tail;
+
+	if (tail == ring->head) {
+		return -1;
+	}
+
+	ipc_barrier();
+	*msg = ring->msg[tail & IPC_RING_MASK];
+	ipc_barrier();
+	/* Publish the tail before the next look at head, see ipc_send() */
+	ring->tail = tail + 1;
+	ipc_barrier();
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Set the function receiving the messages in @ref ipc_irq_handler.
+
+@param[in] callback Called once per message, NULL to leave the messages in
+the ring for @ref ipc_recv.
+@param[in] user_data Passed to the callback.
+*/
+
+void ipc_set_callback(ipc_callback_t callback, void *user_data)
+{
+	ipc_user_data = user_data;
+	ipc_callback = callback;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Handle the doorbell of the other core.
+
+Call from m0core_isr() on the M4 and m4core_isr() on the M0. Drains the
+whole ring into the callback.
+*/
+
+void ipc_irq_handler(void)
+{
+	struct ipc_msg msg;
+
+	/* Clear first, a doorbell rung while draining interrupts again */
+	IPC_PEER_TXEVENT = 0;
+
+	if (!ipc_callback) {
+		return;
+	}
+	while (ipc_recv(&msg) == 0) {
+		ipc_callback(&msg, ipc_user_data);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Allocate a buffer from the shared pool.
+
+@returns Buffer of the size given to @ref ipc_init, NULL if none is free.
+*/
+
+void *ipc_buf_alloc(void)
+{
+	struct ipc_buf_ring *ret = &ipc_shared->ret[IPC_SELF];
+	void *buf = NULL;
+
+	CM_ATOMIC_BLOCK() {
+		uint32_t tail = ret->tail;
+		uint32_t head = ret->head;
+
+		/* Take back the buffers the other core has released */
+		ipc_barrier();
+		while (tail != head) {
+			ipc_free[ipc_free_count++] = ret->idx[tail & IPC_POOL_MASK];
+			tail++;
+		}
+		ipc_barrier();
+		ret->tail = tail;
+
+		if (ipc_free_count) {
+			uint32_t idx = ipc_free[--ipc_free_count];
+
+			buf = (void *)(ipc_shared->pool_base +
+				       idx * ipc_shared->buf_size);
+		}
+	}
+
+	return buf;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Release a pool buffer, on either core.
+
+@param[in] buf Buffer from @ref ipc_buf_alloc or received from the other
+core.
+*/
+
+void ipc_buf_free(void *buf)
+{
+	uint32_t idx = ((uint32_t)buf - ipc_shared->pool_base) /
+		       ipc_shared->buf_size;
+
+	CM_ATOMIC_BLOCK() {
+		if (ipc_buf_is_local(idx)) {
+			ipc_free[ipc_free_count++] = idx;
+		} else {
+			struct ipc_buf_ring *ret = &ipc_shared->ret[IPC_PEER];
+			uint32_t head = ret->head;
+
+			/* Cannot overflow, it holds the whole pool */
+			ret->idx[head & IPC_POOL_MASK] = idx;
+			ipc_barrier();
+			ret->head = head + 1;
+		}
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Hand a pool buffer over to the other core.
+
+Ownership passes to the receiver, which finds the buffer address in the arg
+field of the message and releases it with @ref ipc_buf_free.
+
+@param[in] cmd Message command.
+@param[in] buf Buffer from @ref ipc_buf_alloc.
+@param[in] len Number of valid bytes in the buffer.
+@returns 0 on success, -1 if the ring is full, the buffer is still owned by
+the caller then.
+*/
+
+int ipc_send_buf(uint16_t cmd, void *buf, uint16_t len)
+{
+	const struct ipc_msg msg = {
+		.cmd = cmd,
+		.len = len,
+		.arg = (uint32_t)buf,
+	};
+
+	return ipc_send(&msg);
+}
+
+/**@}*/
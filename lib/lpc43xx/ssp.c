@@ -32,8 +32,10 @@ LGPL License Terms @ref lgpl_license
 
 /**@{*/
 
+#include <stddef.h>
 #include <libopencm3/lpc43xx/ssp.h>
 #include <libopencm3/lpc43xx/cgu.h>
+#include <libopencm3/lpc43xx/gpdma.h>
 
 /* Disable SSP */
 void ssp_disable(ssp_num_t ssp_num)
@@ -135,6 +137,136 @@ uint16_t ssp_transfer(ssp_num_t ssp_num, uint16_t data)
 	return SSP_DR(ssp_port);
 }
 
+static uint32_t ssp_get_port(ssp_num_t ssp_num)
+{
+	return ssp_num == SSP0_NUM ? SSP0 : SSP1;
+}
+
+/* Bytes per frame in memory, 1 for frames up to 8 bits, 2 above */
+static uint32_t ssp_frame_bytes(uint32_t ssp_port)
+{
+	return (SSP_CR0(ssp_port) & 0xf) >= SSP_DATA_9BITS ? 2 : 1;
+}
+
+/*
+ * Transfer a block of frames, keeping the FIFOs busy.
+ * tx may be NULL to send all ones, rx may be NULL to discard the received
+ * frames. Buffers hold uint8_t frames up to 8 bits, uint16_t above.
+ * Up to SSP_FIFO_DEPTH frames are in flight, which is as many as the
+ * receive FIFO can hold, so it cannot overflow even if the CPU is
+ * interrupted. Returns once the last frame has been received.
+ */
+void ssp_transfer_block(ssp_num_t ssp_num, const void *tx, void *rx,
+			uint32_t frames)
+{
+	uint32_t ssp_port = ssp_get_port(ssp_num);
+	bool wide = ssp_frame_bytes(ssp_port) == 2;
+	uint32_t sent = 0;
+	uint32_t received = 0;
+
+	/* Drop stale frames */
+	while (SSP_SR(ssp_port) & SSP_SR_RNE) {
+		(void)SSP_DR(ssp_port);
+	}
+
+	while (received < frames) {
+		while (sent < frames && sent - received < SSP_FIFO_DEPTH &&
+		       (SSP_SR(ssp_port) & SSP_SR_TNF)) {
+			uint16_t data = 0xffff;
+
+			if (tx) {
+				data = wide ? ((const uint16_t *)tx)[sent] :
+					      ((const uint8_t *)tx)[sent];
+			}
+			SSP_DR(ssp_port) = data;
+			sent++;
+		}
+
+		while (SSP_SR(ssp_port) & SSP_SR_RNE) {
+			uint16_t data = SSP_DR(ssp_port);
+
+			if (rx && wide) {
+				((uint16_t *)rx)[received] = data;
+			} else if (rx) {
+				((uint8_t *)rx)[received] = data;
+			}
+			received++;
+		}
+	}
+}
+
+static const uint8_t ssp_dma_rx_req[] = {
+	GPDMA_REQ_SSP0_RX, GPDMA_REQ_SSP1_RX
+};
+static const uint8_t ssp_dma_tx_req[] = {
+	GPDMA_REQ_SSP0_TX, GPDMA_REQ_SSP1_TX
+};
+
+/* Source for receive only and sink for transmit only transfers */
+static const uint16_t ssp_dma_fill = 0xffff;
+static uint16_t ssp_dma_sink;
+
+/*
+ * Start a full duplex transfer driven by the GPDMA.
+ * Buffers are as for ssp_transfer_block() and must stay valid until
+ * ssp_dma_done() returns true. Transfers longer than 4095 frames are
+ * split into linked list items taken from dma->lli. The channels come from
+ * gpdma_alloc(), after gpdma_init().
+ * Returns 0 once started, -1 if the item storage is too small or the
+ * channels are still busy.
+ */
+int ssp_dma_transfer(const struct ssp_dma *dma, const void *tx, void *rx,
+		     uint32_t frames)
+{
+	uint32_t ssp_port = ssp_get_port(dma->ssp_num);
+	uint32_t width = ssp_frame_bytes(ssp_port) >> 1;
+	uint32_t items = SSP_DMA_LLI_COUNT(frames);
+	/* Bursts of 4 frames, the half FIFO level at which the SSP requests */
+	uint32_t control = GPDMA_CCONTROL_SBSIZE(GPDMA_BURST_4) |
+			   GPDMA_CCONTROL_DBSIZE(GPDMA_BURST_4) |
+			   GPDMA_CCONTROL_SWIDTH(width) |
+			   GPDMA_CCONTROL_DWIDTH(width);
+
+	if (!frames || 2 * items > dma->lli_count || !ssp_dma_done(dma)) {
+		return -1;
+	}
+
+	/* Peripheral side on AHB master 1, memory side on master 0 */
+	gpdma_lli_chain(dma->lli, items, (uint32_t)&SSP_DR(ssp_port),
+			rx ? (uint32_t)rx : (uint32_t)&ssp_dma_sink, frames,
+			control | GPDMA_CCONTROL_S(1) |
+			GPDMA_CCONTROL_DI(rx != NULL));
+	gpdma_lli_chain(dma->lli + items, items,
+			tx ? (uint32_t)tx : (uint32_t)&ssp_dma_fill,
+			(uint32_t)&SSP_DR(ssp_port), frames,
+			control | GPDMA_CCONTROL_D(1) |
+			GPDMA_CCONTROL_SI(tx != NULL));
+
+	/* Drop stale frames */
+	while (SSP_SR(ssp_port) & SSP_SR_RNE) {
+		(void)SSP_DR(ssp_port);
+	}
+	SSP_DMACR(ssp_port) = SSP_DMACR_RXDMAE | SSP_DMACR_TXDMAE;
+
+	gpdma_start(dma->rx_channel, dma->lli, ssp_dma_rx_req[dma->ssp_num],
+		    GPDMA_REQ_MEMORY, NULL, NULL);
+	gpdma_start(dma->tx_channel, dma->lli + items, GPDMA_REQ_MEMORY,
+		    ssp_dma_tx_req[dma->ssp_num], NULL, NULL);
+	return 0;
+}
+
+/* True once both channels of the transfer have completed */
+bool ssp_dma_done(const struct ssp_dma *dma)
+{
+	return !gpdma_busy(dma->rx_channel) && !gpdma_busy(dma->tx_channel);
+}
+
+/* Wait for the end of a DMA transfer and return the SSP to CPU mode */
+void ssp_dma_wait(const struct ssp_dma *dma)
+{
+	while (!ssp_dma_done(dma));
+	SSP_DMACR(ssp_get_port(dma->ssp_num)) = 0;
+}
 
 /**@}*/
 
@@ -30,6 +30,7 @@
  * You should have received a copy of the GNU Lesser General Public License
  * along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <libopencm3/cm3/cortex.h>
 #include <libopencm3/pac55xx/can.h>
 #include <libopencm3/cm3/common.h>
 
@@ -370,24 +371,9 @@ void can_abort_transmit(uint32_t canport) {
 	CAN_ISR_SR_CMR_MR_SET(canport, CAN_CMR_AT);
 }
 
-/*---------------------------------------------------------------------------*/
-/** @brief CAN Receive Message
-If no data is in the RX buffer, id and length are set to 0.
-
-@param[in] canport Unsigned int32. CAN block register base address.
-@param[out] id Unsigned int32 pointer. Message ID.
-@param[out] ext bool pointer. The message ID is extended.
-@param[out] rtr bool pointer. Remote Request bit value.
-@param[out] length Unsigned int8 pointer. Length of message payload.
-@param[out] data Unsigned int8[]. Message payload data, min length 8.
-*/
-void can_receive(uint32_t canport, uint32_t *id, bool *ext, bool *rtr, uint8_t *length,
-			uint8_t *data) {
-	if ((CAN_ISR_SR_CMR_MR(canport) & CAN_ISR_RI) == 0 || CAN_RMC(canport) == 0) {
-		*id = 0;
-		*length = 0;
-		return; /* empty RX FIFO */
-	}
+/* Read the frame at the head of the RX FIFO and acknowledge RI */
+static void can_fifo_read(uint32_t canport, uint32_t *id, bool *ext, bool *rtr,
+			uint8_t *length, uint8_t *data) {
 	uint32_t can_buffer = CAN_RXBUF(canport); /* read 32-bit word */
 	uint8_t rx_length = can_buffer & CAN_BITS_3_0;
 	bool is_extended = can_buffer & BIT7;
@@ -456,5 +442,298 @@ void can_receive(uint32_t canport, uint32_t *id, bool *ext, bool *rtr, uint8_t *
 	 * Note: CAN_ISR_RI is already high, but we still write '1' to it to clear it.
 	 */
 	CAN_ISR_ACKNOWLEDGE(canport, CAN_ISR_RI);
-	return;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Receive Message
+If no data is in the RX buffer, id and length are set to 0.
+
+@param[in] canport Unsigned int32. CAN block register base address.
+@param[out] id Unsigned int32 pointer. Message ID.
+@param[out] ext bool pointer. The message ID is extended.
+@param[out] rtr bool pointer. Remote Request bit value.
+@param[out] length Unsigned int8 pointer. Length of message payload.
+@param[out] data Unsigned int8[]. Message payload data, min length 8.
+*/
+void can_receive(uint32_t canport, uint32_t *id, bool *ext, bool *rtr, uint8_t *length,
+			uint8_t *data) {
+	if ((CAN_ISR_SR_CMR_MR(canport) & CAN_ISR_RI) == 0 || CAN_RMC(canport) == 0) {
+		*id = 0;
+		*length = 0;
+		return; /* empty RX FIFO */
+	}
+	can_fifo_read(canport, id, ext, rtr, length, data);
+}
+
+
+/*
+ * Buffered driver. The interrupt drains every frame of the hardware RX FIFO
+ * into the receive ring and reports them with a single callback, and chains
+ * the frames of the transmit ring through the single TX buffer, loading the
+ * next one from the TX complete interrupt. Ring positions are free running
+ * counters, each moved by one side only.
+ */
+
+/* Interrupts of the buffered driver. Bus errors are only reported through
+ * the error counters, BEI would fire on every error frame.
+ */
+#define CAN_BUFFERED_IMR	(CAN_IMR_DOIM | CAN_IMR_TIM | CAN_IMR_RIM | \
+				 CAN_IMR_EPIM | CAN_IMR_EWIM)
+
+static enum can_bus_state can_bus_state_get(uint32_t canport) {
+	uint32_t reg = CAN_ISR_SR_CMR_MR(canport);
+
+	if (reg & CAN_SR_BS) {
+		return CAN_BUS_OFF;
+	}
+	if (CAN_TXERR(canport) >= 128 || CAN_RXERR(canport) >= 128) {
+		return CAN_BUS_PASSIVE;
+	}
+	if (reg & CAN_SR_ES) {
+		return CAN_BUS_WARNING;
+	}
+	return CAN_BUS_ACTIVE;
+}
+
+/* Load the next frame of the transmit ring, interrupts masked */
+static void can_buffered_tx_kick(struct can_buffered *cb) {
+	const struct can_msg *msg;
+	bool sent;
+
+	if (cb->tx_busy || cb->tx_head == cb->tx_tail ||
+	    cb->state == CAN_BUS_OFF) {
+		return;
+	}
+
+	msg = &cb->tx_buf[cb->tx_tail % cb->tx_size];
+	if (msg->ext) {
+		sent = can_transmit_ext(cb->canport, msg->id, msg->rtr,
+					msg->length, msg->data);
+	} else {
+		sent = can_transmit_std(cb->canport, msg->id, msg->rtr,
+					msg->length, msg->data);
+	}
+
+	/* Otherwise the buffer is in use outside the driver, retried on TI */
+	if (sent) {
+		cb->tx_tail++;
+		cb->tx_busy = true;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Buffered Init
+Reset the rings and enable the interrupts of the buffered driver. The CAN
+block must be set up with can_init() and enabled, and its NVIC interrupt
+enabled by the application, whose can_isr() calls can_buffered_irq_handler().
+
+@param[in] cb Driver state, with the fields up to user_data filled in.
+*/
+void can_buffered_init(struct can_buffered *cb) {
+	cb->rx_head = 0;
+	cb->rx_tail = 0;
+	cb->tx_head = 0;
+	cb->tx_tail = 0;
+	cb->tx_busy = false;
+	cb->rx_dropped = 0;
+	cb->tx_dropped = 0;
+	cb->state = can_bus_state_get(cb->canport);
+
+	CAN_ISR_ACKNOWLEDGE(cb->canport, CAN_ISR_DOI | CAN_ISR_TI |
+			    CAN_ISR_EPI | CAN_ISR_EWI);
+	can_enable_irq(cb->canport, CAN_BUFFERED_IMR);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Buffered Stop
+Disable the interrupts of the buffered driver. A frame already in the TX
+buffer is still sent.
+
+@param[in] cb Driver state.
+*/
+void can_buffered_stop(struct can_buffered *cb) {
+	can_disable_irq(cb->canport, CAN_BUFFERED_IMR);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Buffered Receive Count
+@param[in] cb Driver state.
+@returns Number of frames waiting in the receive ring.
+*/
+uint32_t can_buffered_rx_available(struct can_buffered *cb) {
+	uint32_t avail;
+
+	CM_ATOMIC_BLOCK() {
+		avail = cb->rx_head - cb->rx_tail;
+	}
+	return avail;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Buffered Read
+Take up to count frames from the receive ring, without waiting.
+
+@param[in] cb Driver state.
+@param[out] msgs Frames.
+@param[in] count Number of frames msgs can hold.
+@returns Number of frames copied.
+*/
+uint32_t can_buffered_read(struct can_buffered *cb, struct can_msg *msgs,
+			uint32_t count) {
+	uint32_t avail = can_buffered_rx_available(cb);
+	uint32_t i;
+
+	if (count > avail) {
+		count = avail;
+	}
+
+	/* The interrupt does not write into the unread part */
+	for (i = 0; i < count; i++) {
+		msgs[i] = cb->rx_buf[(cb->rx_tail + i) % cb->rx_size];
+	}
+
+	CM_ATOMIC_BLOCK() {
+		cb->rx_tail += count;
+	}
+	return count;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Buffered Transmit Space
+@param[in] cb Driver state.
+@returns Number of frames that can be written without waiting.
+*/
+uint32_t can_buffered_tx_free(struct can_buffered *cb) {
+	uint32_t used;
+
+	CM_ATOMIC_BLOCK() {
+		used = cb->tx_head - cb->tx_tail;
+	}
+	return cb->tx_size - used;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Buffered Write
+Queue up to count frames and start sending, without waiting. The frames
+are sent in order.
+
+@param[in] cb Driver state.
+@param[in] msgs Frames.
+@param[in] count Number of frames.
+@returns Number of frames queued.
+*/
+uint32_t can_buffered_write(struct can_buffered *cb, const struct can_msg *msgs,
+			uint32_t count) {
+	uint32_t space = can_buffered_tx_free(cb);
+	uint32_t i;
+
+	if (count > space) {
+		count = space;
+	}
+
+	/* Only this function moves tx_head */
+	for (i = 0; i < count; i++) {
+		cb->tx_buf[(cb->tx_head + i) % cb->tx_size] = msgs[i];
+	}
+
+	CM_ATOMIC_BLOCK() {
+		cb->tx_head += count;
+		can_buffered_tx_kick(cb);
+	}
+	return count;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Buffered Bus-Off Recovery
+Start the bus-off recovery when auto_recover is not set. The controller
+rejoins the bus after 128 sequences of 11 recessive bits, which is reported
+as a CAN_EVENT_STATE, and transmission resumes with the next queued frame.
+
+@param[in] cb Driver state.
+*/
+void can_buffered_recover(struct can_buffered *cb) {
+	if (cb->state == CAN_BUS_OFF) {
+		can_enable(cb->canport);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Buffered Interrupt Handler
+Call from can_isr().
+
+@param[in] cb Driver state.
+*/
+void can_buffered_irq_handler(struct can_buffered *cb) {
+	uint32_t canport = cb->canport;
+	uint32_t isr = CAN_ISR_SR_CMR_MR(canport) &
+		((CAN_BTR1_BTR0_RMC_IMR(canport) & CAN_BUFFERED_IMR) << 24);
+	uint32_t events = 0;
+	uint32_t frames = 0;
+
+	/* RI is acknowledged with each frame read */
+	CAN_ISR_ACKNOWLEDGE(canport, isr & ~CAN_ISR_RI);
+
+	if (isr & CAN_ISR_DOI) {
+		events |= CAN_EVENT_RX_OVERRUN;
+	}
+
+	/* Drain the hardware FIFO, one callback for the whole batch */
+	while (CAN_RMC(canport)) {
+		struct can_msg *msg;
+		struct can_msg lost;
+
+		if (cb->rx_head - cb->rx_tail < cb->rx_size) {
+			msg = &cb->rx_buf[cb->rx_head % cb->rx_size];
+			cb->rx_head++;
+			events |= CAN_EVENT_RX;
+		} else {
+			msg = &lost;
+			cb->rx_dropped++;
+			events |= CAN_EVENT_RX_OVERRUN;
+		}
+		can_fifo_read(canport, &msg->id, &msg->ext, &msg->rtr,
+			      &msg->length, msg->data);
+		frames++;
+	}
+	if ((isr & CAN_ISR_RI) && !frames) {
+		CAN_ISR_ACKNOWLEDGE(canport, CAN_ISR_RI);
+	}
+
+	/* EWI follows the error and bus status bits, EPI error passive */
+	if (isr & (CAN_ISR_EWI | CAN_ISR_EPI)) {
+		enum can_bus_state state = can_bus_state_get(canport);
+
+		if (state != cb->state) {
+			if (state == CAN_BUS_OFF) {
+				/* The frame in the TX buffer is lost */
+				if (cb->tx_busy) {
+					cb->tx_busy = false;
+					cb->tx_dropped++;
+				}
+				if (cb->auto_recover) {
+					can_enable(canport);
+				}
+			}
+			cb->state = state;
+			events |= CAN_EVENT_STATE;
+		}
+	}
+
+	/* TX complete, chain the next frame */
+	if (isr & CAN_ISR_TI) {
+		bool was_busy = cb->tx_busy;
+
+		cb->tx_busy = false;
+		can_buffered_tx_kick(cb);
+		if (was_busy && !cb->tx_busy) {
+			events |= CAN_EVENT_TX_DONE;
+		}
+	} else {
+		/* Back from bus-off */
+		can_buffered_tx_kick(cb);
+	}
+
+	if (events && cb->callback) {
+		cb->callback(canport, events, cb->user_data);
+	}
 }
@@ -0,0 +1,298 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Buffered USART on the SAM3 Peripheral DMA Controller.
+ *
+ * The receive ring is split in two halves which the PDC fills alternately
+ * through its current and next pointers. A half is handed back to the PDC
+ * once the application has read it, so the PDC never overwrites unread
+ * data; if the application falls behind by a whole ring, the receiver
+ * overruns and USART_PDC_EVENT_ERROR is reported. The transmit ring is
+ * drained in up to two contiguous pieces queued in the current and next
+ * pointers, so the line stays busy while the interrupt refills.
+ *
+ * Positions are kept as free running byte counters, the PDC position being
+ * the bytes handed to it minus its remaining counts, so a full ring is
+ * never mistaken for an empty one.
+ *
+ * Interrupts come once per half ring, at the end of a burst with the
+ * receiver timeout, and when the transmitter runs dry. The application
+ * calls usart_pdc_irq_handler() from the USART interrupt.
+ */
+
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/sam/usart_pdc.h>
+
+/* Bytes of the transfers handed to the PDC that have not completed yet.
+ * The next counter moves into the current one when the current transfer
+ * completes, read until no such move happened in between.
+ */
+static uint32_t usart_pdc_rx_pending(uint32_t usart)
+{
+	uint32_t next;
+	uint32_t cur;
+
+	do {
+		next = PDC_RNCR(usart);
+		cur = PDC_RCR(usart);
+	} while (PDC_RNCR(usart) != next);
+
+	return cur + next;
+}
+
+static uint32_t usart_pdc_tx_pending(uint32_t usart)
+{
+	uint32_t next;
+	uint32_t cur;
+
+	do {
+		next = PDC_TNCR(usart);
+		cur = PDC_TCR(usart);
+	} while (PDC_TNCR(usart) != next);
+
+	return cur + next;
+}
+
+/* Hand free halves of the receive ring to the PDC, interrupts masked */
+static void usart_pdc_rx_arm(struct usart_pdc *pdc)
+{
+	uint32_t half = pdc->rx_size / 2;
+
+	while (PDC_RNCR(pdc->usart) == 0 &&
+	       pdc->rx_armed + half - pdc->rx_read <= pdc->rx_size) {
+		uint32_t addr = (uint32_t)pdc->rx_buf +
+				pdc->rx_armed % pdc->rx_size;
+
+		/* Stopped at the end of the ring or not started yet */
+		if (PDC_RCR(pdc->usart) == 0) {
+			PDC_RPR(pdc->usart) = addr;
+			PDC_RCR(pdc->usart) = half;
+		} else {
+			PDC_RNPR(pdc->usart) = addr;
+			PDC_RNCR(pdc->usart) = half;
+		}
+		pdc->rx_armed += half;
+	}
+
+	/* ENDRX stays set until a half is armed */
+	if (PDC_RNCR(pdc->usart)) {
+		USART_IER(pdc->usart) = USART_CSR_ENDRX;
+	} else {
+		USART_IDR(pdc->usart) = USART_CSR_ENDRX;
+	}
+}
+
+/* Queue pending transmit data to the PDC, interrupts masked */
+static void usart_pdc_tx_queue(struct usart_pdc *pdc)
+{
+	while (PDC_TNCR(pdc->usart) == 0 && pdc->tx_head != pdc->tx_queued) {
+		uint32_t offset = pdc->tx_queued % pdc->tx_size;
+		uint32_t len = pdc->tx_head - pdc->tx_queued;
+
+		if (len > pdc->tx_size - offset) {
+			len = pdc->tx_size - offset;
+		}
+		if (len > PDC_MAX_COUNT) {
+			len = PDC_MAX_COUNT;
+		}
+
+		if (PDC_TCR(pdc->usart) == 0) {
+			PDC_TPR(pdc->usart) = (uint32_t)pdc->tx_buf + offset;
+			PDC_TCR(pdc->usart) = len;
+		} else {
+			PDC_TNPR(pdc->usart) = (uint32_t)pdc->tx_buf + offset;
+			PDC_TNCR(pdc->usart) = len;
+		}
+		pdc->tx_queued += len;
+	}
+
+	/*
+	 * With a next transfer queued, refill as soon as the current one
+	 * ends. Otherwise wait for the PDC to run dry, ENDTX would stay set.
+	 */
+	if (PDC_TNCR(pdc->usart)) {
+		USART_IDR(pdc->usart) = USART_CSR_TXBUFE;
+		USART_IER(pdc->usart) = USART_CSR_ENDTX;
+	} else if (PDC_TCR(pdc->usart)) {
+		USART_IDR(pdc->usart) = USART_CSR_ENDTX;
+		USART_IER(pdc->usart) = USART_CSR_TXBUFE;
+	} else {
+		USART_IDR(pdc->usart) = USART_CSR_ENDTX | USART_CSR_TXBUFE;
+	}
+}
+
+/*
+ * Start continuous reception into the receive ring and enable the PDC.
+ * The USART must be configured and enabled, its NVIC interrupt enabled by
+ * the application.
+ */
+void usart_pdc_init(struct usart_pdc *pdc)
+{
+	uint32_t usart = pdc->usart;
+
+	pdc->rx_read = 0;
+	pdc->rx_armed = 0;
+	pdc->tx_head = 0;
+	pdc->tx_queued = 0;
+
+	PDC_PTCR(usart) = PDC_PTCR_RXTDIS | PDC_PTCR_TXTDIS;
+	PDC_RCR(usart) = 0;
+	PDC_RNCR(usart) = 0;
+	PDC_TCR(usart) = 0;
+	PDC_TNCR(usart) = 0;
+
+	USART_CR(usart) = USART_CR_RSTSTA;
+	USART_RTOR(usart) = pdc->rx_timeout;
+	if (pdc->rx_timeout) {
+		/* Counting starts with the next character */
+		USART_CR(usart) = USART_CR_STTTO;
+		USART_IER(usart) = USART_CSR_TIMEOUT;
+	}
+	USART_IER(usart) = USART_CSR_OVRE | USART_CSR_FRAME | USART_CSR_PARE;
+
+	CM_ATOMIC_BLOCK() {
+		usart_pdc_rx_arm(pdc);
+	}
+
+	PDC_PTCR(usart) = PDC_PTCR_RXTEN | PDC_PTCR_TXTEN;
+}
+
+/* Stop both PDC channels and the driver interrupts. */
+void usart_pdc_stop(struct usart_pdc *pdc)
+{
+	PDC_PTCR(pdc->usart) = PDC_PTCR_RXTDIS | PDC_PTCR_TXTDIS;
+	USART_IDR(pdc->usart) = USART_CSR_ENDRX | USART_CSR_ENDTX |
+				USART_CSR_TXBUFE | USART_CSR_TIMEOUT |
+				USART_CSR_OVRE | USART_CSR_FRAME |
+				USART_CSR_PARE;
+}
+
+/* Number of received bytes waiting to be read. */
+uint32_t usart_pdc_rx_available(struct usart_pdc *pdc)
+{
+	uint32_t avail;
+
+	CM_ATOMIC_BLOCK() {
+		avail = pdc->rx_armed - usart_pdc_rx_pending(pdc->usart) -
+			pdc->rx_read;
+	}
+
+	return avail;
+}
+
+/*
+ * Copy up to len received bytes to buf, without waiting.
+ * Returns the number of bytes copied.
+ */
+uint32_t usart_pdc_read(struct usart_pdc *pdc, void *buf, uint32_t len)
+{
+	uint8_t *dst = buf;
+	uint32_t avail = usart_pdc_rx_available(pdc);
+	uint32_t i;
+
+	if (len > avail) {
+		len = avail;
+	}
+
+	/* The PDC does not write into the unread part */
+	for (i = 0; i < len; i++) {
+		dst[i] = pdc->rx_buf[(pdc->rx_read + i) % pdc->rx_size];
+	}
+
+	CM_ATOMIC_BLOCK() {
+		pdc->rx_read += len;
+		usart_pdc_rx_arm(pdc);
+	}
+
+	return len;
+}
+
+/* Number of bytes that can be written without waiting. */
+uint32_t usart_pdc_tx_free(struct usart_pdc *pdc)
+{
+	uint32_t used;
+
+	CM_ATOMIC_BLOCK() {
+		used = pdc->tx_head - pdc->tx_queued +
+		       usart_pdc_tx_pending(pdc->usart);
+	}
+
+	return pdc->tx_size - used;
+}
+
+/*
+ * Copy up to len bytes into the transmit ring and start sending, without
+ * waiting. Returns the number of bytes accepted.
+ */
+uint32_t usart_pdc_write(struct usart_pdc *pdc, const void *buf,
+			 uint32_t len)
+{
+	const uint8_t *src = buf;
+	uint32_t space = usart_pdc_tx_free(pdc);
+	uint32_t i;
+
+	if (len > space) {
+		len = space;
+	}
+
+	/* Only this function moves tx_head */
+	for (i = 0; i < len; i++) {
+		pdc->tx_buf[(pdc->tx_head + i) % pdc->tx_size] = src[i];
+	}
+
+	CM_ATOMIC_BLOCK() {
+		pdc->tx_head += len;
+		usart_pdc_tx_queue(pdc);
+	}
+
+	return len;
+}
+
+/* Call from the interrupt handler of the USART. */
+void usart_pdc_irq_handler(struct usart_pdc *pdc)
+{
+	uint32_t usart = pdc->usart;
+	uint32_t csr = USART_CSR(usart) & USART_IMR(usart);
+	uint32_t events = 0;
+
+	if (csr & USART_CSR_ENDRX) {
+		usart_pdc_rx_arm(pdc);
+		events |= USART_PDC_EVENT_RX;
+	}
+
+	if (csr & USART_CSR_TIMEOUT) {
+		USART_CR(usart) = USART_CR_STTTO;
+		events |= USART_PDC_EVENT_RX_IDLE;
+	}
+
+	if (csr & (USART_CSR_OVRE | USART_CSR_FRAME | USART_CSR_PARE)) {
+		USART_CR(usart) = USART_CR_RSTSTA;
+		events |= USART_PDC_EVENT_ERROR;
+	}
+
+	if (csr & (USART_CSR_ENDTX | USART_CSR_TXBUFE)) {
+		usart_pdc_tx_queue(pdc);
+		if (!PDC_TCR(usart)) {
+			events |= USART_PDC_EVENT_TX_DONE;
+		}
+	}
+
+	if (events && pdc->callback) {
+		pdc->callback(usart, events, pdc->user_data);
+	}
+}
@@ -35,6 +35,8 @@ LGPL License Terms @ref lgpl_license
  * along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+#include <libopencm3/cm3/cortex.h>
 #include <libopencm3/stm32/can.h>
 #include <libopencm3/stm32/rcc.h>
 
@@ -317,6 +319,286 @@ void can_filter_id_list_32bit_init(uint32_t nr,
 	can_filter_init(nr, true, true, id1, id2, fifo, enable);
 }
 
+/*---------------------------------------------------------------------------*/
+/* Filter planner
+ *
+ * Every range is split into aligned power of two blocks, each of which is an
+ * exact identifier or an ID/mask pair. Blocks are packed into the densest
+ * bank layout: four standard IDs per 16 bit list bank, two standard ID/mask
+ * pairs per 16 bit mask bank, two extended IDs per 32 bit list bank and one
+ * extended ID/mask pair per 32 bit mask bank. When there are more blocks
+ * than fit, the two blocks whose common ID/mask pair lets through the
+ * fewest identifiers that were not asked for are merged, until they fit.
+ */
+
+#define CAN_FILTER_EXT		(1U << 31)
+#define CAN_FILTER_STD_BITS	0x7FF
+#define CAN_FILTER_EXT_BITS	0x1FFFFFFF
+
+struct can_filter_block {
+	/* Identifier, CAN_FILTER_EXT set for extended ones */
+	uint32_t id;
+	/* Bits that must match, within the identifier width */
+	uint32_t mask;
+};
+
+static uint32_t can_filter_bits(uint32_t id)
+{
+	return (id & CAN_FILTER_EXT) ? CAN_FILTER_EXT_BITS : CAN_FILTER_STD_BITS;
+}
+
+static bool can_filter_exact(const struct can_filter_block *b)
+{
+	return b->mask == can_filter_bits(b->id);
+}
+
+/* Number of identifiers a block accepts. */
+static uint32_t can_filter_span(const struct can_filter_block *b)
+{
+	uint32_t free_bits = can_filter_bits(b->id) & ~b->mask;
+	uint32_t span = 1;
+
+	while (free_bits) {
+		if (free_bits & 1) {
+			span <<= 1;
+		}
+		free_bits >>= 1;
+	}
+	return span;
+}
+
+static void can_filter_merged(const struct can_filter_block *a,
+			      const struct can_filter_block *b,
+			      struct can_filter_block *out)
+{
+	out->mask = a->mask & b->mask & ~(a->id ^ b->id);
+	out->id = (a->id & out->mask) | (a->id & CAN_FILTER_EXT);
+}
+
+/* Merge the cheapest pair of blocks, false if no two can be merged. */
+static bool can_filter_merge(struct can_filter_block *blocks, unsigned *n)
+{
+	struct can_filter_block m;
+	int32_t cost, best_cost = INT32_MAX;
+	unsigned i, j, best_i = 0, best_j = 0;
+
+	for (i = 0; i < *n; i++) {
+		for (j = i + 1; j < *n; j++) {
+			if ((blocks[i].id ^ blocks[j].id) & CAN_FILTER_EXT) {
+				continue;
+			}
+			can_filter_merged(&blocks[i], &blocks[j], &m);
+			cost = (int32_t)can_filter_span(&m) -
+			       (int32_t)can_filter_span(&blocks[i]) -
+			       (int32_t)can_filter_span(&blocks[j]);
+			if (cost < best_cost) {
+				best_cost = cost;
+				best_i = i;
+				best_j = j;
+			}
+		}
+	}
+
+	if (best_cost == INT32_MAX) {
+		return false;
+	}
+	can_filter_merged(&blocks[best_i], &blocks[best_j], &blocks[best_i]);
+	blocks[best_j] = blocks[--*n];
+	return true;
+}
+
+/* Standard IDs moved from list banks into free 16 bit mask slots. */
+static unsigned can_filter_std_moved(unsigned exact, unsigned masks)
+{
+	unsigned rest = exact % 4;
+	unsigned plain = (masks + 1) / 2 + (exact + 3) / 4;
+	unsigned moved = (masks + rest + 1) / 2 + exact / 4;
+
+	return (rest <= 2 && moved < plain) ? rest : 0;
+}
+
+static uint32_t can_filter_banks(const struct can_filter_block *blocks,
+				 unsigned n)
+{
+	unsigned i, std_exact = 0, std_masks = 0, ext_exact = 0, ext_masks = 0;
+	unsigned moved;
+
+	for (i = 0; i < n; i++) {
+		bool exact = can_filter_exact(&blocks[i]);
+
+		if (blocks[i].id & CAN_FILTER_EXT) {
+			exact ? ext_exact++ : ext_masks++;
+		} else {
+			exact ? std_exact++ : std_masks++;
+		}
+	}
+
+	moved = can_filter_std_moved(std_exact, std_masks);
+	return (std_masks + moved + 1) / 2 + (std_exact - moved + 3) / 4 +
+	       (ext_exact + 1) / 2 + ext_masks;
+}
+
+static bool can_filter_add(struct can_filter_block *blocks, unsigned *n,
+			   uint32_t id, uint32_t mask)
+{
+	if (*n == CAN_FILTER_PLAN_MAX && !can_filter_merge(blocks, n)) {
+		return false;
+	}
+	blocks[*n].id = id;
+	blocks[*n].mask = mask;
+	(*n)++;
+	return true;
+}
+
+/* Bank layout class: standard IDs, standard masks, extended IDs, masks. */
+static unsigned can_filter_kind(const struct can_filter_block *b)
+{
+	return ((b->id & CAN_FILTER_EXT) ? 2 : 0) +
+	       (can_filter_exact(b) ? 0 : 1);
+}
+
+static void can_filter_sort(struct can_filter_block *blocks, unsigned n)
+{
+	unsigned i, j;
+
+	for (i = 1; i < n; i++) {
+		struct can_filter_block b = blocks[i];
+
+		for (j = i; j > 0 &&
+		     can_filter_kind(&blocks[j - 1]) > can_filter_kind(&b); j--) {
+			blocks[j] = blocks[j - 1];
+		}
+		blocks[j] = b;
+	}
+}
+
+/* Standard ID in 16 bit filter layout: STID[10:0] RTR IDE EXID[17:15]. */
+#define CAN_FILTER_IDE16	(1 << 3)
+
+static uint16_t can_filter_std16(uint32_t id)
+{
+	return (id & CAN_FILTER_STD_BITS) << 5;
+}
+
+/* Extended ID in 32 bit filter layout, the same as CAN_TIxR. */
+static uint32_t can_filter_ext32(uint32_t id)
+{
+	return ((id & CAN_FILTER_EXT_BITS) << CAN_TIxR_EXID_SHIFT) |
+	       CAN_TIxR_IDE;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Plan and Program Acceptance Filters
+
+Programs a consecutive set of filter banks so that, as far as they allow,
+exactly the given identifiers are accepted into @p fifo. Ranges are split
+into ID/mask pairs and packed into the list and mask banks needing the
+fewest banks. If they do not fit, pairs are merged so that the fewest
+unwanted identifiers are let through. Remote frames only pass ID/mask pairs,
+not ID list entries.
+
+@param[in] ranges Identifier ranges to accept.
+@param[in] count Number of entries in @p ranges.
+@param[in] first_bank Unsigned int32. ID number of the first filter to use.
+@param[in] nr_banks Unsigned int32. Number of filters that may be used.
+@param[in] fifo Unsigned int32. FIFO id.
+@returns int Number of filters programmed, -1 if the ranges cannot be
+fitted: @p nr_banks is 0 while there are ranges, or standard and extended
+identifiers were requested but there is only one filter.
+ */
+int can_filter_plan(const struct can_filter_range *ranges, unsigned count,
+		    uint32_t first_bank, uint32_t nr_banks, uint32_t fifo)
+{
+	struct can_filter_block blocks[CAN_FILTER_PLAN_MAX];
+	unsigned kinds[4] = {0, 0, 0, 0};
+	unsigned i, n = 0, moved, end;
+	uint32_t bank = first_bank;
+
+	for (i = 0; i < count; i++) {
+		uint32_t bits = ranges[i].ext ? CAN_FILTER_EXT_BITS :
+						CAN_FILTER_STD_BITS;
+		uint32_t flag = ranges[i].ext ? CAN_FILTER_EXT : 0;
+		uint32_t first = ranges[i].first & bits;
+		uint32_t last = ranges[i].last & bits;
+
+		while (first <= last) {
+			uint32_t size = 1;
+
+			/* Largest aligned block starting at first. */
+			while (!(first & size) && (size << 1) - 1 <= bits &&
+			       first + (size << 1) - 1 <= last) {
+				size <<= 1;
+			}
+			if (!can_filter_add(blocks, &n, first | flag,
+					    bits & ~(size - 1))) {
+				return -1;
+			}
+			if (first + size - 1 == bits) {
+				break;
+			}
+			first += size;
+		}
+	}
+
+	while (can_filter_banks(blocks, n) > nr_banks) {
+		if (!can_filter_merge(blocks, &n)) {
+			return -1;
+		}
+	}
+
+	can_filter_sort(blocks, n);
+	for (i = 0; i < n; i++) {
+		kinds[can_filter_kind(&blocks[i])]++;
+	}
+	moved = can_filter_std_moved(kinds[0], kinds[1]);
+
+	/* Standard IDs, four per 16 bit list bank. */
+	end = kinds[0] - moved;
+	for (i = 0; i < end; i += 4) {
+		const struct can_filter_block *b = &blocks[i];
+
+		can_filter_id_list_16bit_init(bank++, can_filter_std16(b[0].id),
+			can_filter_std16(b[i + 1 < end ? 1 : 0].id),
+			can_filter_std16(b[i + 2 < end ? 2 : 0].id),
+			can_filter_std16(b[i + 3 < end ? 3 : 0].id),
+			fifo, true);
+	}
+
+	/* Standard ID/mask pairs and left over IDs, two per 16 bit bank. The
+	 * IDE bit is part of the mask so that extended frames never match.
+	 */
+	end = kinds[0] + kinds[1];
+	for (i = kinds[0] - moved; i < end; i += 2) {
+		const struct can_filter_block *b = &blocks[i];
+		unsigned j = i + 1 < end ? 1 : 0;
+
+		can_filter_id_mask_16bit_init(bank++, can_filter_std16(b[0].id),
+			can_filter_std16(b[0].mask) | CAN_FILTER_IDE16,
+			can_filter_std16(b[j].id),
+			can_filter_std16(b[j].mask) | CAN_FILTER_IDE16,
+			fifo, true);
+	}
+
+	/* Extended IDs, two per 32 bit list bank. */
+	end += kinds[2];
+	for (i = kinds[0] + kinds[1]; i < end; i += 2) {
+		const struct can_filter_block *b = &blocks[i];
+
+		can_filter_id_list_32bit_init(bank++, can_filter_ext32(b[0].id),
+			can_filter_ext32(b[i + 1 < end ? 1 : 0].id), fifo, true);
+	}
+
+	/* Extended ID/mask pairs, one per 32 bit mask bank. */
+	for (i = end; i < n; i++) {
+		can_filter_id_mask_32bit_init(bank++,
+			can_filter_ext32(blocks[i].id),
+			((blocks[i].mask & CAN_FILTER_EXT_BITS) << 3) |
+			CAN_TIxR_IDE, fifo, true);
+	}
+
+	return bank - first_bank;
+}
+
 /*---------------------------------------------------------------------------*/
 /** @brief CAN Enable IRQ
 
@@ -548,3 +830,381 @@ bool can_available_mailbox(uint32_t canport)
 {
 	return CAN_TSR(canport) & (CAN_TSR_TME0 | CAN_TSR_TME1 | CAN_TSR_TME2);
 }
+
+/*---------------------------------------------------------------------------*/
+/* Buffered driver
+ *
+ * Received frames are drained from both hardware FIFOs into a software ring
+ * on every interrupt, so the three entry FIFOs never have to hold more than
+ * what arrives during the interrupt latency. Frames to send are kept in a
+ * binary heap ordered like the bus arbitration, the lowest identifier first,
+ * and the three mailboxes are always loaded with the highest priority
+ * frames. A mailbox holding a lower priority frame than the best queued one
+ * is aborted and its frame put back in the queue, so a burst of low
+ * priority frames can not hold back an urgent one.
+ *
+ * Frames with the same identifier leave in the order they were queued: the
+ * heap breaks ties with a sequence number, and only one frame of a given
+ * identifier is held in the mailboxes at a time, since the hardware picks
+ * any of several mailboxes with equal identifiers.
+ */
+
+static const uint32_t can_mbox_array[3] = {CAN_MBOX0, CAN_MBOX1, CAN_MBOX2};
+
+/* Arbitration order of a frame, lower values win. */
+static uint32_t can_frame_key(const struct can_frame *frame)
+{
+	uint32_t key;
+
+	if (frame->flags & CAN_FRAME_EXT) {
+		key = (frame->id << CAN_TIxR_EXID_SHIFT) | CAN_TIxR_IDE;
+	} else {
+		key = frame->id << CAN_TIxR_STID_SHIFT;
+	}
+	if (frame->flags & CAN_FRAME_RTR) {
+		key |= CAN_TIxR_RTR;
+	}
+	return key;
+}
+
+/* Frames owned by the transmit side, queued or held in a mailbox. */
+static uint16_t can_queue_tx_used(const struct can_queue *q)
+{
+	return q->tx_count + ((q->tx_mbox_busy >> 0) & 1) +
+	       ((q->tx_mbox_busy >> 1) & 1) + ((q->tx_mbox_busy >> 2) & 1);
+}
+
+/* Heap order: arbitration first, then the order of queueing. */
+static bool can_frame_before(const struct can_frame *a,
+			     const struct can_frame *b)
+{
+	uint32_t ka = can_frame_key(a);
+	uint32_t kb = can_frame_key(b);
+
+	if (ka != kb) {
+		return ka < kb;
+	}
+	return (int32_t)(a->seq - b->seq) < 0;
+}
+
+static bool can_heap_push(struct can_queue *q, const struct can_frame *frame)
+{
+	uint16_t i, parent;
+
+	if (q->tx_count >= q->tx_size) {
+		return false;
+	}
+
+	for (i = q->tx_count++; i > 0; i = parent) {
+		parent = (i - 1) / 2;
+		if (!can_frame_before(frame, &q->tx_buf[parent])) {
+			break;
+		}
+		q->tx_buf[i] = q->tx_buf[parent];
+	}
+	q->tx_buf[i] = *frame;
+	return true;
+}
+
+static void can_heap_pop(struct can_queue *q, struct can_frame *frame)
+{
+	struct can_frame *last;
+	uint16_t i, child;
+
+	*frame = q->tx_buf[0];
+	last = &q->tx_buf[--q->tx_count];
+
+	for (i = 0; (child = 2 * i + 1) < q->tx_count; i = child) {
+		if (child + 1 < q->tx_count &&
+		    can_frame_before(&q->tx_buf[child + 1],
+				     &q->tx_buf[child])) {
+			child++;
+		}
+		if (!can_frame_before(&q->tx_buf[child], last)) {
+			break;
+		}
+		q->tx_buf[i] = q->tx_buf[child];
+	}
+	q->tx_buf[i] = *last;
+}
+
+/* Whether a mailbox already holds a frame with this identifier. */
+static bool can_queue_tx_held(const struct can_queue *q, uint32_t key)
+{
+	uint8_t n;
+
+	for (n = 0; n < 3; n++) {
+		if ((q->tx_mbox_busy & (1 << n)) &&
+		    can_frame_key(&q->tx_mbox[n]) == key) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void can_mbox_load(uint32_t canport, uint8_t n,
+			  const struct can_frame *frame)
+{
+	uint32_t mbox = can_mbox_array[n];
+	uint32_t word;
+
+	memcpy(&word, &frame->data[0], 4);
+	CAN_TDLxR(canport, mbox) = word;
+	memcpy(&word, &frame->data[4], 4);
+	CAN_TDHxR(canport, mbox) = word;
+	CAN_TDTxR(canport, mbox) = frame->len & CAN_TDTxR_DLC_MASK;
+	CAN_TIxR(canport, mbox) = can_frame_key(frame) | CAN_TIxR_TXRQ;
+}
+
+/* Load free mailboxes from the queue, preempt lower priority ones. */
+static void can_queue_tx_fill(struct can_queue *q)
+{
+	uint32_t tsr = CAN_TSR(q->canport);
+	uint32_t worst_key = 0;
+	int worst = -1;
+	uint8_t n;
+
+	for (n = 0; n < 3; n++) {
+		if (q->tx_mbox_busy & (1 << n)) {
+			uint32_t key = can_frame_key(&q->tx_mbox[n]);
+
+			if (key >= worst_key) {
+				worst_key = key;
+				worst = n;
+			}
+			continue;
+		}
+		if (!q->tx_count || !(tsr & (CAN_TSR_TME0 << n)) ||
+		    can_queue_tx_held(q, can_frame_key(&q->tx_buf[0]))) {
+			continue;
+		}
+		can_heap_pop(q, &q->tx_mbox[n]);
+		can_mbox_load(q->canport, n, &q->tx_mbox[n]);
+		q->tx_mbox_busy |= 1 << n;
+	}
+
+	/* A frame waiting for its predecessor is not worth an abort. */
+	if (q->tx_count && worst >= 0 &&
+	    !(q->tx_mbox_abort & (1 << worst)) &&
+	    can_frame_key(&q->tx_buf[0]) < worst_key &&
+	    !can_queue_tx_held(q, can_frame_key(&q->tx_buf[0]))) {
+		CAN_TSR(q->canport) = CAN_TSR_ABRQ0 << (8 * worst);
+		q->tx_mbox_abort |= 1 << worst;
+	}
+}
+
+static void can_queue_tx_irq(struct can_queue *q)
+{
+	uint32_t tsr = CAN_TSR(q->canport);
+	uint8_t n;
+
+	for (n = 0; n < 3; n++) {
+		bool aborted;
+
+		if (!(tsr & (CAN_TSR_RQCP0 << (8 * n)))) {
+			continue;
+		}
+		CAN_TSR(q->canport) = CAN_TSR_RQCP0 << (8 * n);
+		if (!(q->tx_mbox_busy & (1 << n))) {
+			continue;
+		}
+		aborted = q->tx_mbox_abort & (1 << n);
+		q->tx_mbox_busy &= ~(1 << n);
+		q->tx_mbox_abort &= ~(1 << n);
+		if (tsr & (CAN_TSR_TXOK0 << (8 * n))) {
+			continue;
+		}
+		/* Preempted frames go back, failed ones with NART are dropped */
+		if (aborted) {
+			can_heap_push(q, &q->tx_mbox[n]);
+		} else {
+			q->tx_errors++;
+		}
+	}
+
+	can_queue_tx_fill(q);
+}
+
+static void can_queue_rx_irq(struct can_queue *q, uint8_t fifo)
+{
+	volatile uint32_t *rfr = fifo ? &CAN_RF1R(q->canport) :
+					&CAN_RF0R(q->canport);
+	uint32_t fifo_id = fifo ? CAN_FIFO1 : CAN_FIFO0;
+
+	if (*rfr & CAN_RF0R_FOVR0) {
+		*rfr = CAN_RF0R_FOVR0;
+		q->fifo_overruns++;
+	}
+
+	while (*rfr & CAN_RF0R_FMP0_MASK) {
+		uint16_t next = q->rx_head + 1;
+
+		if (next == q->rx_size) {
+			next = 0;
+		}
+		if (next == q->rx_tail) {
+			q->rx_overruns++;
+		} else {
+			struct can_frame *frame = &q->rx_buf[q->rx_head];
+			uint32_t rir = CAN_RIxR(q->canport, fifo_id);
+			uint32_t rdtr = CAN_RDTxR(q->canport, fifo_id);
+			uint32_t word;
+
+			if (rir & CAN_RIxR_IDE) {
+				frame->id = (rir >> CAN_RIxR_EXID_SHIFT) &
+					    CAN_RIxR_EXID_MASK;
+				frame->flags = CAN_FRAME_EXT;
+			} else {
+				frame->id = (rir >> CAN_RIxR_STID_SHIFT) &
+					    CAN_RIxR_STID_MASK;
+				frame->flags = 0;
+			}
+			if (rir & CAN_RIxR_RTR) {
+				frame->flags |= CAN_FRAME_RTR;
+			}
+			frame->len = rdtr & CAN_RDTxR_DLC_MASK;
+			frame->fmi = (rdtr & CAN_RDTxR_FMI_MASK) >>
+				     CAN_RDTxR_FMI_SHIFT;
+			frame->timestamp = (rdtr & CAN_RDTxR_TIME_MASK) >>
+					   CAN_RDTxR_TIME_SHIFT;
+			word = CAN_RDLxR(q->canport, fifo_id);
+			memcpy(&frame->data[0], &word, 4);
+			word = CAN_RDHxR(q->canport, fifo_id);
+			memcpy(&frame->data[4], &word, 4);
+			q->rx_head = next;
+		}
+		/* FMP only counts down once the mailbox has been released. */
+		*rfr = CAN_RF0R_RFOM0;
+		while (*rfr & CAN_RF0R_RFOM0);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Buffered Driver Initialise
+
+Sets up the software queues and enables the transmit mailbox empty, FIFO
+message pending and FIFO overrun interrupts. The port must already be
+initialised with @ref can_init, with txfp false so that the mailboxes are
+sent in identifier order. With nart set, a frame failing its single attempt
+is dropped and counted in tx_errors. @ref can_queue_irq_handler must be
+called from every interrupt vector of the port, all at the same priority.
+
+@param[out] q Queue state to initialise.
+@param[in] canport Unsigned int32. CAN block register base @ref can_reg_base.
+@param[in] rx_buf Receive ring storage, holds rx_size - 1 frames.
+@param[in] rx_size Number of entries in rx_buf.
+@param[in] tx_buf Transmit queue storage.
+@param[in] tx_size Number of entries in tx_buf, including the frames held in
+the three mailboxes.
+ */
+void can_queue_init(struct can_queue *q, uint32_t canport,
+		    struct can_frame *rx_buf, uint16_t rx_size,
+		    struct can_frame *tx_buf, uint16_t tx_size)
+{
+	q->canport = canport;
+	q->rx_buf = rx_buf;
+	q->rx_size = rx_size;
+	q->rx_head = 0;
+	q->rx_tail = 0;
+	q->tx_buf = tx_buf;
+	q->tx_size = tx_size;
+	q->tx_count = 0;
+	q->tx_seq = 0;
+	q->tx_mbox_busy = 0;
+	q->tx_mbox_abort = 0;
+	q->tx_errors = 0;
+	q->rx_overruns = 0;
+	q->fifo_overruns = 0;
+
+	can_enable_irq(canport, CAN_IER_TMEIE | CAN_IER_FMPIE0 |
+		       CAN_IER_FOVIE0 | CAN_IER_FMPIE1 | CAN_IER_FOVIE1);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Buffered Driver Transmit
+
+@param[in] q Queue state set up by @ref can_queue_init.
+@param[in] frame Frame to send, copied into the queue.
+@returns int 0 on success, -1 if the transmit queue is full.
+ */
+int can_queue_transmit(struct can_queue *q, const struct can_frame *frame)
+{
+	struct can_frame queued = *frame;
+	int ret = 0;
+
+	CM_ATOMIC_BLOCK() {
+		queued.seq = q->tx_seq;
+		/* Keep room to put back frames taken out of a mailbox. */
+		if (can_queue_tx_used(q) < q->tx_size &&
+		    can_heap_push(q, &queued)) {
+			q->tx_seq++;
+			can_queue_tx_fill(q);
+		} else {
+			ret = -1;
+		}
+	}
+	return ret;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Buffered Driver Receive
+
+@param[in] q Queue state set up by @ref can_queue_init.
+@param[out] frame Oldest received frame.
+@returns bool true if a frame was returned, false if the ring is empty.
+ */
+bool can_queue_receive(struct can_queue *q, struct can_frame *frame)
+{
+	uint16_t tail = q->rx_tail;
+
+	if (tail == q->rx_head) {
+		return false;
+	}
+	*frame = q->rx_buf[tail];
+	q->rx_tail = (tail + 1 == q->rx_size) ? 0 : tail + 1;
+	return true;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Buffered Driver Received Frame Count
+
+@param[in] q Queue state set up by @ref can_queue_init.
+@returns Number of frames waiting in the receive ring.
+ */
+uint16_t can_queue_rx_pending(struct can_queue *q)
+{
+	uint16_t head = q->rx_head;
+	uint16_t tail = q->rx_tail;
+
+	return (head >= tail) ? head - tail : q->rx_size - tail + head;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Buffered Driver Transmit Frame Count
+
+@param[in] q Queue state set up by @ref can_queue_init.
+@returns Number of frames queued or waiting in a mailbox.
+ */
+uint16_t can_queue_tx_pending(struct can_queue *q)
+{
+	uint16_t count;
+
+	CM_ATOMIC_BLOCK() {
+		count = can_queue_tx_used(q);
+	}
+	return count;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Buffered Driver Interrupt Handler
+
+Drains both receive FIFOs completely and refills the transmit mailboxes.
+
+@param[in] q Queue state set up by @ref can_queue_init.
+ */
+void can_queue_irq_handler(struct can_queue *q)
+{
+	can_queue_rx_irq(q, 0);
+	can_queue_rx_irq(q, 1);
+	can_queue_tx_irq(q);
+}
@@ -0,0 +1,263 @@
+/** @addtogroup adc_stream_file ADC streaming API
+@ingroup peripheral_apis
+
+@brief Continuous, timer triggered ADC acquisition for the "v2" ADC.
+
+A timer update event (TRGO) starts every conversion of the regular sequence,
+so the sample rate is exact and independent of interrupt latency. Results
+are moved by a double buffered DMA transfer and each filled half of the
+buffer is handed to a callback in place, without copying. If the
+interrupt is serviced too late, blocks the DMA has already started to
+overwrite are not delivered and are counted in the overruns field.
+
+In dual mode the master and slave ADC convert together (regular
+simultaneous) or alternately (interleaved, doubling the sample rate) and
+the DMA reads both results at once from the common data register.
+
+The application configures clocks, GPIOs, the channel sequence, sample
+times, and powers on and calibrates the ADC(s) before @ref adc_stream_start.
+With a multi channel sequence, the block length should be a multiple of the
+sequence length so that blocks start at the first channel.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <libopencm3/stm32/adc_stream.h>
+#include <libopencm3/stm32/dma_xfer.h>
+#include <libopencm3/stm32/timer.h>
+
+static void adc_stream_dma_event(uint32_t dma, uint8_t channel,
+				 uint32_t events, void *user_data)
+{
+	struct adc_stream *stream = user_data;
+	uint8_t block;
+	uint32_t size;
+
+	(void)dma;
+	(void)channel;
+
+	if (events & DMA_XFER_EVENT_OVERRUN) {
+		stream->overruns++;
+	}
+	if (!(events & DMA_XFER_EVENT_COMPLETE)) {
+		return;
+	}
+
+	block = (events & DMA_XFER_EVENT_BUFFER1) ? 1 : 0;
+	size = stream->dual_mode ? sizeof(uint32_t) : sizeof(uint16_t);
+	if (stream->callback) {
+		stream->callback(stream, (const uint8_t *)stream->buf +
+				 block * stream->block_len * size,
+				 stream->block_len);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Initialise a continuous acquisition.
+
+Sets up the DMA for double buffered transfers from the ADC data register,
+or from the common data register in dual mode. Nothing is started yet.
+
+@param[out] stream Acquisition state to initialise.
+@param[in] adc ADC block register address base @ref adc_reg_base, the
+master ADC in dual mode.
+@param[in] dma DMA controller base address: DMA1 or DMA2
+@param[in] dma_channel DMA channel serving the ADC.
+@param[in] dma_request Request routed to @p dma_channel, see struct
+dma_xfer_config.
+@param[in] dual_mode Multi mode from @ref adc_multi_mode, or 0 to use a
+single ADC.
+@param[in] buf Storage for two blocks of samples, 2 * @p block_len
+uint16_t, or uint32_t in dual mode.
+@param[in] block_len Number of samples per block.
+@param[in] callback Called for every completed block.
+*/
+
+void adc_stream_init(struct adc_stream *stream, uint32_t adc, uint32_t dma,
+		     uint8_t dma_channel, uint8_t dma_request,
+		     uint32_t dual_mode, void *buf, uint16_t block_len,
+		     adc_stream_callback callback)
+{
+	struct dma_xfer_config cfg = {
+		.flags = DMA_XFER_PERIPH_TO_MEM | DMA_XFER_MINC |
+			 DMA_XFER_DOUBLE_BUFFER | DMA_XFER_PL_VERY_HIGH,
+		.periph_addr = (uint32_t)&ADC_DR(adc),
+		.mem_addr = (uint32_t)buf,
+		.count = block_len,
+		.request = dma_request,
+		.callback = adc_stream_dma_event,
+		.user_data = stream,
+	};
+
+	stream->adc = adc;
+	stream->dma = dma;
+	stream->dma_channel = dma_channel;
+	stream->timer = 0;
+	stream->dual_mode = dual_mode;
+	stream->buf = buf;
+	stream->block_len = block_len;
+	stream->callback = callback;
+	stream->overruns = 0;
+	stream->adc_overruns = 0;
+
+	if (dual_mode) {
+		cfg.flags |= DMA_XFER_MSIZE_32BIT | DMA_XFER_PSIZE_32BIT;
+#if defined(ADC_CDR)
+		cfg.periph_addr = (uint32_t)&ADC_CDR(adc);
+#endif
+		cfg.mem1_addr = (uint32_t)buf + block_len * sizeof(uint32_t);
+	} else {
+		cfg.flags |= DMA_XFER_MSIZE_16BIT | DMA_XFER_PSIZE_16BIT;
+		cfg.mem1_addr = (uint32_t)buf + block_len * sizeof(uint16_t);
+	}
+
+	dma_xfer_setup(dma, dma_channel, &cfg);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Set up a timer as the sample clock.
+
+The timer is programmed by timer_set_trgo_rate() to emit TRGO at @p rate.
+It is started by @ref adc_stream_start; select its TRGO as the trigger
+there.
+
+@param[in] stream Acquisition state set up by @ref adc_stream_init.
+@param[in] timer Timer register address base @ref tim_reg_base
+@param[in] timer_clk Input clock of the timer in Hz.
+@param[in] rate Requested sample (sequence) rate in Hz.
+@returns The rate actually achieved in Hz, 0 if @p rate is 0 or too low to
+reach with a 16 bit prescaler; the timer is left untouched then.
+*/
+
+uint32_t adc_stream_set_rate(struct adc_stream *stream, uint32_t timer,
+			     uint32_t timer_clk, uint32_t rate)
+{
+	uint32_t achieved = timer_set_trgo_rate(timer, timer_clk, rate);
+
+	if (achieved) {
+		stream->timer = timer;
+	}
+	return achieved;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Start a continuous acquisition.
+
+Arms the DMA, puts the ADC into externally triggered, DMA circular mode and
+starts the sample clock timer if one was set up. The ADC is switched to
+overwrite on overrun so it keeps running, overruns are counted by @ref
+adc_stream_irq_handler.
+
+@param[in] stream Acquisition state set up by @ref adc_stream_init.
+@param[in] trigger ADC_CFGR1_EXTSEL value selecting the trigger, usually the
+TRGO of the timer passed to @ref adc_stream_set_rate.
+@param[in] polarity ADC_CFGR1_EXTEN value selecting the trigger edge.
+*/
+
+void adc_stream_start(struct adc_stream *stream, uint32_t trigger,
+		      uint32_t polarity)
+{
+	uint32_t adc = stream->adc;
+
+	dma_xfer_start(stream->dma, stream->dma_channel);
+
+#if defined(ADC_CCR_DUAL_MASK)
+	if (stream->dual_mode) {
+		uint32_t reg32 = ADC_CCR(adc);
+
+		reg32 &= ~(ADC_CCR_MDMA_8_6_BIT | ADC_CCR_DMACFG |
+			   (ADC_CCR_DUAL_MASK << ADC_CCR_DUAL_SHIFT));
+		reg32 |= ADC_CCR_MDMA_12_10_BIT | ADC_CCR_DMACFG |
+			 (stream->dual_mode << ADC_CCR_DUAL_SHIFT);
+		ADC_CCR(adc) = reg32;
+	} else
+#endif
+	{
+		adc_enable_dma_circular_mode(adc);
+		adc_enable_dma(adc);
+	}
+
+	ADC_CFGR1(adc) |= ADC_CFGR1_OVRMOD;
+	adc_set_single_conversion_mode(adc);
+	adc_enable_external_trigger_regular(adc, trigger, polarity);
+	adc_clear_overrun_flag(adc);
+	adc_enable_overrun_interrupt(adc);
+	adc_start_conversion_regular(adc);
+
+	if (stream->timer) {
+		timer_enable_counter(stream->timer);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Stop a continuous acquisition.
+
+Stops the sample clock, any ongoing conversion and the DMA. A block that
+was partially filled is not reported.
+
+@param[in] stream Acquisition state set up by @ref adc_stream_init.
+*/
+
+void adc_stream_stop(struct adc_stream *stream)
+{
+	uint32_t adc = stream->adc;
+
+	if (stream->timer) {
+		timer_disable_counter(stream->timer);
+	}
+
+	if (ADC_CR(adc) & ADC_CR_ADSTART) {
+		ADC_CR(adc) |= ADC_CR_ADSTP;
+		while (ADC_CR(adc) & ADC_CR_ADSTART);
+	}
+	adc_disable_overrun_interrupt(adc);
+	adc_disable_external_trigger_regular(adc);
+
+#if defined(ADC_CCR_DUAL_MASK)
+	if (stream->dual_mode) {
+		ADC_CCR(adc) &= ~(ADC_CCR_MDMA_8_6_BIT | ADC_CCR_DMACFG);
+	} else
+#endif
+	{
+		adc_disable_dma(adc);
+	}
+
+	dma_xfer_stop(stream->dma, stream->dma_channel);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Service the ADC interrupt of a continuous acquisition.
+
+Counts and acknowledges ADC data overruns. Block delivery itself runs from
+the DMA interrupt through dma_xfer_irq_handler().
+
+@param[in] stream Acquisition state set up by @ref adc_stream_init.
+*/
+
+void adc_stream_irq_handler(struct adc_stream *stream)
+{
+	if (adc_get_overrun_flag(stream->adc)) {
+		adc_clear_overrun_flag(stream->adc);
+		stream->adc_overruns++;
+	}
+}
+
+/**@}*/
@@ -40,6 +40,7 @@ uint32_t crc_calculate(uint32_t data)
 	return CRC_DR;
 }
 
+LIBOPENCM3_RAMFUNC
 uint32_t crc_calculate_block(uint32_t *datap, int size)
 {
 	int i;
@@ -0,0 +1,314 @@
+/** @addtogroup dac_stream_file DAC streaming API
+@ingroup peripheral_apis
+
+@brief Continuous, timer triggered DAC output.
+
+A timer update event (TRGO) latches every sample into the DAC, so the
+output rate is exact and independent of interrupt latency. Samples are
+moved from a buffer holding two blocks by a double buffered DMA transfer.
+Whenever one block has been played, a callback is asked to refill it while
+the other one is playing. If the interrupt is serviced too late, blocks
+the DMA is already playing again are not refilled and are counted in the
+underruns field.
+
+With DAC_CHANNEL_BOTH both channels are written at once through the dual
+data register and latched by the same trigger, so they stay in sync.
+
+The application configures clocks and GPIOs and sets up the output buffers
+before @ref dac_stream_start.
+
+The F1 DAC cannot detect DMA underruns, there @ref dac_stream_irq_handler
+does nothing and dac_underruns stays 0.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <libopencm3/stm32/dac_stream.h>
+#include <libopencm3/stm32/dma_xfer.h>
+#include <libopencm3/stm32/timer.h>
+
+static uint32_t dac_stream_sample_size(const struct dac_stream *stream)
+{
+	uint32_t size = (stream->align == DAC_ALIGN_RIGHT8) ? 1 : 2;
+
+	return (stream->channel == DAC_CHANNEL_BOTH) ? size * 2 : size;
+}
+
+static uint32_t dac_stream_data_reg(const struct dac_stream *stream)
+{
+	uint32_t dac = stream->dac;
+
+	switch (stream->channel) {
+	case DAC_CHANNEL1:
+		if (stream->align == DAC_ALIGN_RIGHT8) {
+			return (uint32_t)&DAC_DHR8R1(dac);
+		} else if (stream->align == DAC_ALIGN_LEFT12) {
+			return (uint32_t)&DAC_DHR12L1(dac);
+		}
+		return (uint32_t)&DAC_DHR12R1(dac);
+	case DAC_CHANNEL2:
+		if (stream->align == DAC_ALIGN_RIGHT8) {
+			return (uint32_t)&DAC_DHR8R2(dac);
+		} else if (stream->align == DAC_ALIGN_LEFT12) {
+			return (uint32_t)&DAC_DHR12L2(dac);
+		}
+		return (uint32_t)&DAC_DHR12R2(dac);
+	default:
+		if (stream->align == DAC_ALIGN_RIGHT8) {
+			return (uint32_t)&DAC_DHR8RD(dac);
+		} else if (stream->align == DAC_ALIGN_LEFT12) {
+			return (uint32_t)&DAC_DHR12LD(dac);
+		}
+		return (uint32_t)&DAC_DHR12RD(dac);
+	}
+}
+
+/* DMA requests come from channel 2 only when it is used alone. */
+static int dac_stream_dma_channel_id(const struct dac_stream *stream)
+{
+	return (stream->channel == DAC_CHANNEL2) ? DAC_CHANNEL2 : DAC_CHANNEL1;
+}
+
+static void dac_stream_dma_event(uint32_t dma, uint8_t channel,
+				 uint32_t events, void *user_data)
+{
+	struct dac_stream *stream = user_data;
+	uint8_t block;
+
+	(void)dma;
+	(void)channel;
+
+	if (events & DMA_XFER_EVENT_OVERRUN) {
+		stream->underruns++;
+	}
+	if (!(events & DMA_XFER_EVENT_COMPLETE)) {
+		return;
+	}
+
+	block = (events & DMA_XFER_EVENT_BUFFER1) ? 1 : 0;
+
+	if (stream->callback) {
+		stream->callback(stream, (uint8_t *)stream->buf +
+				 block * stream->block_len *
+				 dac_stream_sample_size(stream),
+				 stream->block_len);
+	}
+}
+
+static void dac_stream_dma_setup(struct dac_stream *stream)
+{
+	uint32_t size = dac_stream_sample_size(stream);
+	struct dma_xfer_config cfg = {
+		.flags = DMA_XFER_MEM_TO_PERIPH | DMA_XFER_MINC |
+			 DMA_XFER_DOUBLE_BUFFER | DMA_XFER_PL_HIGH,
+		.periph_addr = dac_stream_data_reg(stream),
+		.mem_addr = (uint32_t)stream->buf,
+		.mem1_addr = (uint32_t)stream->buf + stream->block_len * size,
+		.count = stream->block_len,
+		.request = stream->dma_request,
+		.callback = dac_stream_dma_event,
+		.user_data = stream,
+	};
+
+	if (size == 4) {
+		cfg.flags |= DMA_XFER_MSIZE_32BIT | DMA_XFER_PSIZE_32BIT;
+	} else if (size == 2) {
+		cfg.flags |= DMA_XFER_MSIZE_16BIT | DMA_XFER_PSIZE_16BIT;
+	} else {
+		cfg.flags |= DMA_XFER_MSIZE_8BIT | DMA_XFER_PSIZE_8BIT;
+	}
+
+	dma_xfer_setup(stream->dma, stream->dma_channel, &cfg);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Initialise a continuous output.
+
+Sets up the DMA for double buffered transfers to the DAC data holding
+register selected by @p channel and @p align. Nothing is started yet.
+
+@param[out] stream Output state to initialise.
+@param[in] dac the base address of the DAC. @ref dac_reg_base
+@param[in] channel one or both, @ref dac_channel_id
+@param[in] align Data format of the samples, selects the data register.
+@param[in] dma DMA controller base address: DMA1 or DMA2
+@param[in] dma_channel DMA channel serving the DAC channel, channel 1 when
+both are used.
+@param[in] dma_request Request routed to @p dma_channel, see struct
+dma_xfer_config.
+@param[in] buf Storage for two blocks of samples, see @ref
+dac_stream_callback for their size.
+@param[in] block_len Number of samples per block.
+@param[in] callback Called to refill every played block.
+*/
+
+void dac_stream_init(struct dac_stream *stream, uint32_t dac, int channel,
+		     enum dac_align align, uint32_t dma, uint8_t dma_channel,
+		     uint8_t dma_request, void *buf, uint16_t block_len,
+		     dac_stream_callback callback)
+{
+	stream->dac = dac;
+	stream->channel = channel;
+	stream->align = align;
+	stream->dma = dma;
+	stream->dma_channel = dma_channel;
+	stream->dma_request = dma_request;
+	stream->timer = 0;
+	stream->buf = buf;
+	stream->block_len = block_len;
+	stream->callback = callback;
+	stream->underruns = 0;
+	stream->dac_underruns = 0;
+
+	dac_stream_dma_setup(stream);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Set up a timer as the sample clock.
+
+The timer is programmed by timer_set_trgo_rate() to emit TRGO at @p rate.
+It is started by @ref dac_stream_start; select its TRGO as the trigger
+there.
+
+@param[in] stream Output state set up by @ref dac_stream_init.
+@param[in] timer Timer register address base @ref tim_reg_base
+@param[in] timer_clk Input clock of the timer in Hz.
+@param[in] rate Requested sample rate in Hz.
+@returns The rate actually achieved in Hz, 0 if @p rate is 0 or too low to
+reach with a 16 bit prescaler; the timer is left untouched then.
+*/
+
+uint32_t dac_stream_set_rate(struct dac_stream *stream, uint32_t timer,
+			     uint32_t timer_clk, uint32_t rate)
+{
+	uint32_t achieved = timer_set_trgo_rate(timer, timer_clk, rate);
+
+	if (achieved) {
+		stream->timer = timer;
+	}
+	return achieved;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Start a continuous output.
+
+Asks the callback to fill both blocks, arms the DMA, enables the triggered
+DAC channel(s) and starts the sample clock timer if one was set up. DMA
+underruns are reported and recovered from by @ref dac_stream_irq_handler.
+
+@param[in] stream Output state set up by @ref dac_stream_init.
+@param[in] trigger DAC_CR_TSELx value(s) selecting the trigger, for both
+channels OR the TSEL1 and TSEL2 values of the same timer.
+*/
+
+void dac_stream_start(struct dac_stream *stream, uint32_t trigger)
+{
+	uint32_t dac = stream->dac;
+	int dma_id = dac_stream_dma_channel_id(stream);
+
+	if (stream->callback) {
+		stream->callback(stream, stream->buf, stream->block_len);
+		stream->callback(stream, (uint8_t *)stream->buf +
+				 stream->block_len *
+				 dac_stream_sample_size(stream),
+				 stream->block_len);
+	}
+
+	dma_xfer_start(stream->dma, stream->dma_channel);
+
+	dac_set_trigger_source(dac, trigger);
+	dac_trigger_enable(dac, stream->channel);
+#if !defined(STM32F1)
+	DAC_SR(dac) = (dma_id == DAC_CHANNEL2) ? DAC_SR_DMAUDR2 :
+						 DAC_SR_DMAUDR1;
+	DAC_CR(dac) |= (dma_id == DAC_CHANNEL2) ? DAC_CR_DMAUDRIE2 :
+						  DAC_CR_DMAUDRIE1;
+#endif
+	dac_dma_enable(dac, dma_id);
+	dac_enable(dac, stream->channel);
+
+	if (stream->timer) {
+		timer_enable_counter(stream->timer);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Stop a continuous output.
+
+Stops the sample clock and the DMA. The DAC channel(s) stay enabled and
+hold the last sample.
+
+@param[in] stream Output state set up by @ref dac_stream_init.
+*/
+
+void dac_stream_stop(struct dac_stream *stream)
+{
+	uint32_t dac = stream->dac;
+	int dma_id = dac_stream_dma_channel_id(stream);
+
+	if (stream->timer) {
+		timer_disable_counter(stream->timer);
+	}
+
+#if !defined(STM32F1)
+	DAC_CR(dac) &= ~((dma_id == DAC_CHANNEL2) ? DAC_CR_DMAUDRIE2 :
+						    DAC_CR_DMAUDRIE1);
+#endif
+	dac_dma_disable(dac, dma_id);
+	dma_xfer_stop(stream->dma, stream->dma_channel);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Service the DAC interrupt of a continuous output.
+
+On a DMA underrun the DAC stops issuing DMA requests. The underrun is
+counted, and the DMA is re-armed from the start of the buffer so that
+output resumes with the next trigger. Block refills themselves run from
+the DMA interrupt through dma_xfer_irq_handler().
+
+@param[in] stream Output state set up by @ref dac_stream_init.
+*/
+
+void dac_stream_irq_handler(struct dac_stream *stream)
+{
+#if defined(STM32F1)
+	(void)stream;
+#else
+	uint32_t dac = stream->dac;
+	int dma_id = dac_stream_dma_channel_id(stream);
+	uint32_t flag = (dma_id == DAC_CHANNEL2) ? DAC_SR_DMAUDR2 :
+						   DAC_SR_DMAUDR1;
+
+	if (!(DAC_SR(dac) & flag)) {
+		return;
+	}
+
+	DAC_SR(dac) = flag;
+	stream->dac_underruns++;
+
+	dac_dma_disable(dac, dma_id);
+	dac_stream_dma_setup(stream);
+	dma_xfer_start(stream->dma, stream->dma_channel);
+	dac_dma_enable(dac, dma_id);
+#endif
+}
+
+/**@}*/
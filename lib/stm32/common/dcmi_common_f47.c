@@ -6,6 +6,17 @@
  * receive a high-speed data flow from an external 8-, 10-, 12- or 14-bit
  * CMOS camera module.
  *
+ * Frames are captured by DMA into memory without CPU involvement. As one
+ * DMA transfer is limited to 65535 words, a frame is split into equal
+ * chunks transferred in double buffer mode: whenever a chunk is complete,
+ * its memory address register is pointed at the chunk after the next one
+ * while the DMA fills the other. In continuous mode this wraps around to
+ * the start of the buffer for the next frame.
+ *
+ * The application sets up clocks, GPIOs and the camera itself, and routes
+ * the DMA interrupt to dma_xfer_irq_handler() and the DCMI interrupt to
+ * @ref dcmi_capture_irq_handler.
+ *
  * If the APIs here are insufficient or incomplete, see @ref dcmi_defines
  *
  * LGPL License Terms @ref lgpl_license
@@ -14,5 +25,269 @@
 /**@{*/
 
 #include <libopencm3/stm32/dcmi.h>
+#include <libopencm3/stm32/dma.h>
+#include <libopencm3/stm32/dma_xfer.h>
+#include <stddef.h>
+
+#define DCMI_CR_CONFIG_MASK	(DCMI_CR_EDM1 | DCMI_CR_EDM0 | \
+				 DCMI_CR_FCRC1 | DCMI_CR_FCRC0 | \
+				 DCMI_CR_VSPOL | DCMI_CR_HSPOL | \
+				 DCMI_CR_PCKPOL | DCMI_CR_ESS | DCMI_CR_JPEG)
+
+#define DCMI_ICR_ALL		(DCMI_ICR_LINE | DCMI_ICR_VSYNC | \
+				 DCMI_ICR_ERR | DCMI_ICR_OVR | DCMI_ICR_FRAME)
+
+/*---------------------------------------------------------------------------*/
+/** @brief Configure synchronisation and data format.
+
+@param[in] flags OR of DCMI_CR_VSPOL, DCMI_CR_HSPOL, DCMI_CR_PCKPOL
+(polarities), DCMI_CR_ESS (embedded synchronisation codes), DCMI_CR_JPEG,
+DCMI_CR_EDMx (data width) and DCMI_CR_FCRCx (frame rate control).
+*/
+
+void dcmi_setup(uint32_t flags)
+{
+	DCMI_CR = (DCMI_CR & ~DCMI_CR_CONFIG_MASK) |
+		  (flags & DCMI_CR_CONFIG_MASK);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Set the embedded synchronisation codes.
+
+Only used with DCMI_CR_ESS.
+
+@param[in] fsc Frame start code
+@param[in] lsc Line start code
+@param[in] lec Line end code
+@param[in] fec Frame end code
+@param[in] unmask Bits compared for each code, in the layout of DCMI_ESUR
+*/
+
+void dcmi_set_embedded_codes(uint8_t fsc, uint8_t lsc, uint8_t lec,
+			     uint8_t fec, uint32_t unmask)
+{
+	DCMI_ESCR = ((uint32_t)fec << DCMI_ESCR_FEC_SHIFT) |
+		    ((uint32_t)lec << DCMI_ESCR_LEC_SHIFT) |
+		    ((uint32_t)lsc << DCMI_ESCR_LSC_SHIFT) |
+		    ((uint32_t)fsc << DCMI_ESCR_FSC_SHIFT);
+	DCMI_ESUR = unmask;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Capture a window of the image only.
+
+@param[in] x First column captured
+@param[in] y First line captured
+@param[in] width Columns captured
+@param[in] height Lines captured
+@param[in] clocks_per_pixel Pixel clocks per pixel, e.g. 2 for RGB565 over
+an 8-bit bus.
+*/
+
+void dcmi_set_crop(uint16_t x, uint16_t y, uint16_t width, uint16_t height,
+		   uint8_t clocks_per_pixel)
+{
+	DCMI_CWSTRT = ((uint32_t)y << DCMI_CWSTRT_VST_SHIFT) |
+		      ((uint32_t)(x * clocks_per_pixel) <<
+		       DCMI_CWSTRT_HOFFCNT_SHIFT);
+	DCMI_CWSIZE = ((uint32_t)(height - 1) << DCMI_CWSIZE_VLINE_SHIFT) |
+		      ((uint32_t)(width * clocks_per_pixel - 1) <<
+		       DCMI_CWSIZE_CAPCNT_SHIFT);
+	DCMI_CR |= DCMI_CR_CROP;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Capture the whole image.
+*/
+
+void dcmi_disable_crop(void)
+{
+	DCMI_CR &= ~DCMI_CR_CROP;
+}
+
+static void dcmi_capture_dma_event(uint32_t dma, uint8_t stream,
+				   uint32_t events, void *user_data)
+{
+	struct dcmi_capture *cap = user_data;
+	uint32_t next;
+
+	if (!(events & DMA_XFER_EVENT_COMPLETE)) {
+		return;
+	}
+
+	/* The target just completed is idle until the other one is full. */
+	next = cap->done + 2;
+	if (next >= cap->chunks && !cap->snapshot) {
+		next -= cap->chunks;
+	}
+	if (next < cap->chunks) {
+		uint32_t addr = cap->buf + next * cap->chunk_words * 4;
+
+		if (events & DMA_XFER_EVENT_BUFFER1) {
+			dma_set_memory_address_1(dma, stream, addr);
+		} else {
+			dma_set_memory_address(dma, stream, addr);
+		}
+	}
+
+	if (++cap->done < cap->chunks) {
+		return;
+	}
+
+	cap->done = 0;
+	cap->frames++;
+	if (cap->snapshot) {
+		dma_xfer_stop(dma, stream);
+	}
+	if (cap->callback) {
+		cap->callback(cap, DCMI_MIS_FRAME);
+	}
+}
+
+static void dcmi_capture_dma_setup(struct dcmi_capture *cap)
+{
+	struct dma_xfer_config cfg = {
+		.flags = DMA_XFER_PERIPH_TO_MEM | DMA_XFER_MINC |
+			 DMA_XFER_DOUBLE_BUFFER | DMA_XFER_FIFO |
+			 DMA_XFER_MSIZE_32BIT | DMA_XFER_PSIZE_32BIT |
+			 DMA_XFER_PL_HIGH,
+		.periph_addr = (uint32_t)&DCMI_DR,
+		.mem_addr = cap->buf,
+		.mem1_addr = cap->buf + cap->chunk_words * 4,
+		.count = cap->chunk_words,
+		.request = cap->dma_channel,
+		.callback = dcmi_capture_dma_event,
+		.user_data = cap,
+	};
+
+	cap->done = 0;
+	dma_xfer_setup(cap->dma, cap->dma_stream, &cfg);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Initialise a frame capture.
+
+Splits the frame into the smallest number (at least two) of equal DMA
+transfers that fit the 65535 word limit.
+
+@param[out] cap Capture state to initialise.
+@param[in] dma DMA controller base address: DMA2
+@param[in] stream DMA stream serving the DCMI, 1 or 7
+@param[in] channel DMA channel selection for the DCMI, 1
+@param[in] buf Frame buffer, word aligned.
+@param[in] frame_bytes Size of a frame, a multiple of 4.
+@param[in] callback Called for every complete frame and DCMI event.
+@returns 0 on success, -1 if the frame cannot be split.
+*/
+
+int dcmi_capture_init(struct dcmi_capture *cap, uint32_t dma, uint8_t stream,
+		      uint8_t channel, void *buf, uint32_t frame_bytes,
+		      dcmi_callback callback)
+{
+	uint32_t words = frame_bytes / 4;
+	uint32_t n;
+
+	for (n = 2; n <= DCMI_CAPTURE_MAX_CHUNKS; n++) {
+		if (!(words % n) && words / n <= 0xffff) {
+			break;
+		}
+	}
+	if ((frame_bytes & 3) || !words || n > DCMI_CAPTURE_MAX_CHUNKS) {
+		return -1;
+	}
+
+	cap->dma = dma;
+	cap->dma_stream = stream;
+	cap->dma_channel = channel;
+	cap->buf = (uint32_t)buf;
+	cap->chunk_words = words / n;
+	cap->chunks = n;
+	cap->done = 0;
+	cap->snapshot = false;
+	cap->callback = callback;
+	cap->user_data = NULL;
+	cap->frames = 0;
+	cap->errors = 0;
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Start capturing.
+
+Capture begins with the next frame start. Overrun and synchronisation error
+interrupts are always enabled, @ref dcmi_capture_irq_handler uses them to
+resynchronise.
+
+@param[in] cap Capture state set up by @ref dcmi_capture_init.
+@param[in] snapshot Capture a single frame instead of continuously.
+@param[in] interrupts Additional DCMI_IER_LINE / DCMI_IER_VSYNC events to
+report to the callback.
+*/
+
+void dcmi_capture_start(struct dcmi_capture *cap, bool snapshot,
+			uint32_t interrupts)
+{
+	cap->snapshot = snapshot;
+	dcmi_capture_dma_setup(cap);
+	dma_xfer_start(cap->dma, cap->dma_stream);
+
+	DCMI_ICR = DCMI_ICR_ALL;
+	DCMI_IER = (interrupts & (DCMI_IER_LINE | DCMI_IER_VSYNC)) |
+		   DCMI_IER_OVR | DCMI_IER_ERR;
+	if (snapshot) {
+		DCMI_CR |= DCMI_CR_CM;
+	} else {
+		DCMI_CR &= ~DCMI_CR_CM;
+	}
+	DCMI_CR |= DCMI_CR_EN;
+	DCMI_CR |= DCMI_CR_CAPTURE;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Stop capturing immediately.
+
+A partially captured frame is not reported.
+
+@param[in] cap Capture state set up by @ref dcmi_capture_init.
+*/
+
+void dcmi_capture_stop(struct dcmi_capture *cap)
+{
+	DCMI_CR &= ~(DCMI_CR_CAPTURE | DCMI_CR_EN);
+	DCMI_IER = 0;
+	dma_xfer_stop(cap->dma, cap->dma_stream);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Service the DCMI interrupt of a frame capture.
+
+After an overrun or synchronisation error the data in memory is no longer
+aligned to the frame, so the frame is dropped and counted, and capture
+restarts from the start of the buffer with the next frame.
+
+@param[in] cap Capture state set up by @ref dcmi_capture_init.
+*/
+
+void dcmi_capture_irq_handler(struct dcmi_capture *cap)
+{
+	uint32_t events = DCMI_MIS;
+
+	DCMI_ICR = events;
+
+	if (events & (DCMI_MIS_OVR | DCMI_MIS_ERR)) {
+		cap->errors++;
+		DCMI_CR &= ~(DCMI_CR_CAPTURE | DCMI_CR_EN);
+		dma_xfer_stop(cap->dma, cap->dma_stream);
+		dcmi_capture_dma_setup(cap);
+		dma_xfer_start(cap->dma, cap->dma_stream);
+		DCMI_CR |= DCMI_CR_EN;
+		DCMI_CR |= DCMI_CR_CAPTURE;
+	}
+
+	if (events && cap->callback) {
+		cap->callback(cap, events);
+	}
+}
 
 /**@}*/
\ No newline at end of file
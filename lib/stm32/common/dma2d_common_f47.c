@@ -7,6 +7,17 @@
  * This library supports the DMA2D Peripheral in the STM32F4xx and STM32F7xx
  * series of ARM Cortex Microcontrollers by ST Microelectronics.
  *
+ * Rectangle fills, copies with pixel format conversion, alpha blending and
+ * CLUT loads are queued and run back to back by the DMA2D, each one started
+ * from the transfer complete interrupt of the previous one. Drawing calls
+ * return as soon as the operation is queued, so the CPU can prepare the next
+ * one while the DMA2D works. Every operation gets a sequence number, the
+ * value of @ref dma2d_submitted after queueing it, which can be compared
+ * against @ref dma2d_completed to know when its pixels are in place.
+ *
+ * Call @ref dma2d_irq_handler from dma2d_isr() and enable the DMA2D
+ * interrupt in the NVIC.
+ *
  * LGPL License Terms @ref lgpl_license
  */
 /*
@@ -26,8 +37,387 @@
  * along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stddef.h>
+#include <libopencm3/cm3/assert.h>
+#include <libopencm3/cm3/cortex.h>
 #include <libopencm3/stm32/common/dma2d_common_f47.h>
 
 /**@{*/
 
+enum dma2d_op_kind {
+	DMA2D_OP_TRANSFER,
+	DMA2D_OP_CLUT_FG,
+	DMA2D_OP_CLUT_BG,
+};
+
+/* Register values of one queued operation. */
+struct dma2d_op {
+	uint8_t kind;
+	uint32_t cr;
+	uint32_t fgmar;
+	uint32_t fgor;
+	uint32_t fgpfccr;
+	uint32_t bgmar;
+	uint32_t bgor;
+	uint32_t bgpfccr;
+	uint32_t opfccr;
+	uint32_t ocolr;
+	uint32_t omar;
+	uint32_t oor;
+	uint32_t nlr;
+};
+
+static struct dma2d_op dma2d_queue[DMA2D_QUEUE_LEN];
+/* Operations [tail, head) are pending, the one at tail is running. */
+static volatile uint32_t dma2d_head;
+static volatile uint32_t dma2d_tail;
+static dma2d_callback dma2d_cb;
+static void *dma2d_cb_data;
+
+#define DMA2D_CR_IRQS	(DMA2D_CR_TCIE | DMA2D_CR_TEIE | DMA2D_CR_CEIE | \
+			 DMA2D_CR_CAEIE | DMA2D_CR_CTCIE)
+
+static const uint8_t dma2d_bits_per_pixel[] = {
+	[DMA2D_xPFCCR_CM_ARGB8888] = 32,
+	[DMA2D_xPFCCR_CM_RGB888] = 24,
+	[DMA2D_xPFCCR_CM_RGB565] = 16,
+	[DMA2D_xPFCCR_CM_ARGB1555] = 16,
+	[DMA2D_xPFCCR_CM_ARGB4444] = 16,
+	[DMA2D_xPFCCR_CM_L8] = 8,
+	[DMA2D_xPFCCR_CM_AL44] = 8,
+	[DMA2D_xPFCCR_CM_AL88] = 16,
+	[DMA2D_xPFCCR_CM_L4] = 4,
+	[DMA2D_xPFCCR_CM_A8] = 8,
+	[DMA2D_xPFCCR_CM_A4] = 4,
+};
+
+static uint32_t dma2d_pixel_addr(const struct dma2d_surface *s,
+				 uint16_t x, uint16_t y)
+{
+	return s->addr + ((uint32_t)y * s->pitch + x) *
+	       dma2d_bits_per_pixel[s->format] / 8;
+}
+
+static void dma2d_start(const struct dma2d_op *op)
+{
+	switch (op->kind) {
+	case DMA2D_OP_CLUT_FG:
+		DMA2D_CR = DMA2D_CR_IRQS;
+		DMA2D_FGCMAR = op->fgmar;
+		DMA2D_FGPFCCR = op->fgpfccr;
+		break;
+	case DMA2D_OP_CLUT_BG:
+		DMA2D_CR = DMA2D_CR_IRQS;
+		DMA2D_BGCMAR = op->bgmar;
+		DMA2D_BGPFCCR = op->bgpfccr;
+		break;
+	default:
+		DMA2D_FGMAR = op->fgmar;
+		DMA2D_FGOR = op->fgor;
+		DMA2D_FGPFCCR = op->fgpfccr;
+		DMA2D_BGMAR = op->bgmar;
+		DMA2D_BGOR = op->bgor;
+		DMA2D_BGPFCCR = op->bgpfccr;
+		DMA2D_OPFCCR = op->opfccr;
+		DMA2D_OCOLR = op->ocolr;
+		DMA2D_OMAR = op->omar;
+		DMA2D_OOR = op->oor;
+		DMA2D_NLR = op->nlr;
+		DMA2D_CR = op->cr;
+		break;
+	}
+}
+
+/* Clear the fields not every kind of operation sets. */
+static void dma2d_op_init(struct dma2d_op *op)
+{
+	op->kind = DMA2D_OP_TRANSFER;
+	op->fgmar = 0;
+	op->fgor = 0;
+	op->fgpfccr = 0;
+	op->bgmar = 0;
+	op->bgor = 0;
+	op->bgpfccr = 0;
+	op->ocolr = 0;
+}
+
+/*
+ * Copy a filled in operation into the queue and start it if the DMA2D is
+ * idle. The entry is taken and published in one atomic step, so a caller
+ * preempted by another one queueing work, or by the callback, cannot end
+ * up sharing it.
+ */
+static int dma2d_submit(const struct dma2d_op *op)
+{
+	int ret = -1;
+
+	CM_ATOMIC_BLOCK() {
+		if (dma2d_head - dma2d_tail < DMA2D_QUEUE_LEN) {
+			struct dma2d_op *slot;
+
+			slot = &dma2d_queue[dma2d_head % DMA2D_QUEUE_LEN];
+			*slot = *op;
+			dma2d_head++;
+			if (dma2d_head - dma2d_tail == 1) {
+				dma2d_start(slot);
+			}
+			ret = 0;
+		}
+	}
+	return ret;
+}
+
+static void dma2d_set_output(struct dma2d_op *op,
+			     const struct dma2d_surface *dst,
+			     uint16_t x, uint16_t y,
+			     uint16_t width, uint16_t height, uint32_t mode)
+{
+	cm3_assert(dst->format <= DMA2D_OPFCCR_CM_ARGB4444);
+	cm3_assert(width <= DMA2D_NLR_PL_MASK && dst->pitch >= width);
+
+	op->cr = (mode << DMA2D_CR_MODE_SHIFT) | DMA2D_CR_IRQS |
+		 DMA2D_CR_START;
+	op->opfccr = dst->format;
+	op->omar = dma2d_pixel_addr(dst, x, y);
+	op->oor = dst->pitch - width;
+	op->nlr = ((uint32_t)width << DMA2D_NLR_PL_SHIFT) |
+		  (height << DMA2D_NLR_NL_SHIFT);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Initialise the graphics engine.
+
+Aborts whatever the DMA2D is doing, empties the queue and resets the
+sequence numbers. The DMA2D clock must be enabled.
+
+@param[in] callback Optional, called after each completed operation.
+@param[in] user_data Passed to @p callback.
+*/
+
+void dma2d_init(dma2d_callback callback, void *user_data)
+{
+	if (DMA2D_CR & DMA2D_CR_START) {
+		DMA2D_CR |= DMA2D_CR_ABORT;
+		while (DMA2D_CR & DMA2D_CR_START);
+	}
+	DMA2D_CR = 0;
+	DMA2D_IFCR = DMA2D_IFCR_CCEIF | DMA2D_IFCR_CCTCIF | DMA2D_IFCR_CCAEIF |
+		     DMA2D_IFCR_CTWIF | DMA2D_IFCR_CTCIF | DMA2D_IFCR_CTEIF;
+
+	dma2d_head = 0;
+	dma2d_tail = 0;
+	dma2d_cb = callback;
+	dma2d_cb_data = user_data;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Queue a rectangle fill.
+
+@param[in] dst Surface to draw into.
+@param[in] x Left edge of the rectangle in pixels.
+@param[in] y Top edge of the rectangle in pixels.
+@param[in] width Width of the rectangle in pixels.
+@param[in] height Height of the rectangle in pixels.
+@param[in] color Fill colour, in the pixel format of @p dst.
+@returns 0 on success, -1 if the queue is full.
+*/
+
+int dma2d_fill(const struct dma2d_surface *dst, uint16_t x, uint16_t y,
+	       uint16_t width, uint16_t height, uint32_t color)
+{
+	struct dma2d_op op;
+
+	dma2d_op_init(&op);
+	dma2d_set_output(&op, dst, x, y, width, height, DMA2D_CR_MODE_R2M);
+	op.ocolr = color;
+	return dma2d_submit(&op);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Queue a rectangle copy.
+
+The pixels are converted if the two surfaces have different formats. A
+source in an indexed format (L8, AL44, L4) uses the foreground CLUT last
+loaded with @ref dma2d_load_clut.
+
+@param[in] dst Surface to draw into.
+@param[in] dx Left edge of the destination rectangle in pixels.
+@param[in] dy Top edge of the destination rectangle in pixels.
+@param[in] src Surface to copy from.
+@param[in] sx Left edge of the source rectangle in pixels.
+@param[in] sy Top edge of the source rectangle in pixels.
+@param[in] width Width of the rectangle in pixels.
+@param[in] height Height of the rectangle in pixels.
+@returns 0 on success, -1 if the queue is full.
+*/
+
+int dma2d_copy(const struct dma2d_surface *dst, uint16_t dx, uint16_t dy,
+	       const struct dma2d_surface *src, uint16_t sx, uint16_t sy,
+	       uint16_t width, uint16_t height)
+{
+	struct dma2d_op op;
+
+	dma2d_op_init(&op);
+	dma2d_set_output(&op, dst, dx, dy, width, height,
+			 src->format == dst->format ? DMA2D_CR_MODE_M2M :
+						      DMA2D_CR_MODE_M2MWPFC);
+	op.fgmar = dma2d_pixel_addr(src, sx, sy);
+	op.fgor = src->pitch - width;
+	op.fgpfccr = src->format;
+	return dma2d_submit(&op);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Queue an alpha blended copy.
+
+Blends the foreground over the background and writes the result to the
+destination, which may be the same as the background. The foreground
+alpha channel is multiplied by @p alpha.
+
+@param[in] dst Surface to draw into.
+@param[in] dx Left edge of the destination rectangle in pixels.
+@param[in] dy Top edge of the destination rectangle in pixels.
+@param[in] fg Foreground surface.
+@param[in] fx Left edge of the foreground rectangle in pixels.
+@param[in] fy Top edge of the foreground rectangle in pixels.
+@param[in] bg Background surface.
+@param[in] bx Left edge of the background rectangle in pixels.
+@param[in] by Top edge of the background rectangle in pixels.
+@param[in] width Width of the rectangle in pixels.
+@param[in] height Height of the rectangle in pixels.
+@param[in] alpha Global foreground opacity, 255 for opaque.
+@returns 0 on success, -1 if the queue is full.
+*/
+
+int dma2d_blend(const struct dma2d_surface *dst, uint16_t dx, uint16_t dy,
+		const struct dma2d_surface *fg, uint16_t fx, uint16_t fy,
+		const struct dma2d_surface *bg, uint16_t bx, uint16_t by,
+		uint16_t width, uint16_t height, uint8_t alpha)
+{
+	struct dma2d_op op;
+
+	dma2d_op_init(&op);
+	dma2d_set_output(&op, dst, dx, dy, width, height, DMA2D_CR_MODE_M2MWB);
+	op.fgmar = dma2d_pixel_addr(fg, fx, fy);
+	op.fgor = fg->pitch - width;
+	op.fgpfccr = fg->format;
+	if (alpha != 0xff) {
+		op.fgpfccr |= ((uint32_t)alpha << DMA2D_xPFCCR_ALPHA_SHIFT) |
+			       (DMA2D_xPFCCR_AM_PRODUCT <<
+				DMA2D_xPFCCR_AM_SHIFT);
+	}
+	op.bgmar = dma2d_pixel_addr(bg, bx, by);
+	op.bgor = bg->pitch - width;
+	op.bgpfccr = bg->format;
+	return dma2d_submit(&op);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Queue a colour lookup table load.
+
+The table is used by all following operations reading an indexed format
+on that layer. It must stay valid until the load has completed.
+
+@param[in] background Load the background instead of the foreground CLUT.
+@param[in] clut Table of colours.
+@param[in] entries Number of entries in @p clut, 1 to 256.
+@param[in] rgb888 Entries are RGB888 (packed, 3 bytes) instead of ARGB8888.
+@returns 0 on success, -1 if the queue is full.
+*/
+
+int dma2d_load_clut(bool background, const uint32_t *clut, uint16_t entries,
+		    bool rgb888)
+{
+	struct dma2d_op op;
+	uint32_t pfccr;
+
+	cm3_assert(entries >= 1 && entries <= 256);
+	dma2d_op_init(&op);
+	pfccr = ((uint32_t)(entries - 1) << DMA2D_xPFCCR_CS_SHIFT) |
+		(rgb888 ? DMA2D_xPFCCR_CCM_RGB888 : DMA2D_xPFCCR_CCM_ARGB8888) |
+		DMA2D_xPFCCR_CM_L8 | DMA2D_xPFCCR_START;
+	if (background) {
+		op.kind = DMA2D_OP_CLUT_BG;
+		op.bgmar = (uint32_t)clut;
+		op.bgpfccr = pfccr;
+	} else {
+		op.kind = DMA2D_OP_CLUT_FG;
+		op.fgmar = (uint32_t)clut;
+		op.fgpfccr = pfccr;
+	}
+	return dma2d_submit(&op);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Sequence number of the last queued operation.
+
+@returns Number of operations queued since @ref dma2d_init.
+*/
+
+uint32_t dma2d_submitted(void)
+{
+	return dma2d_head;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Sequence number of the last completed operation.
+
+@returns Number of operations completed since @ref dma2d_init.
+*/
+
+uint32_t dma2d_completed(void)
+{
+	return dma2d_tail;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Check whether operations are still queued or running.
+
+@returns true if the DMA2D has work left.
+*/
+
+bool dma2d_busy(void)
+{
+	return dma2d_head != dma2d_tail;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Wait until all queued operations have completed. */
+
+void dma2d_wait(void)
+{
+	while (dma2d_busy());
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Service the DMA2D interrupt.
+
+Acknowledges the end of the running operation, starts the next queued one
+and then reports the completion to the callback, which may queue more work.
+*/
+
+void dma2d_irq_handler(void)
+{
+	uint32_t isr = DMA2D_ISR;
+	bool error;
+	uint32_t seq;
+
+	DMA2D_IFCR = isr;
+	if (!(isr & (DMA2D_ISR_TCIF | DMA2D_ISR_CTCIF | DMA2D_ISR_TEIF |
+		     DMA2D_ISR_CEIF | DMA2D_ISR_CAEIF)) ||
+	    dma2d_head == dma2d_tail) {
+		return;
+	}
+	error = isr & (DMA2D_ISR_TEIF | DMA2D_ISR_CEIF | DMA2D_ISR_CAEIF);
+
+	seq = ++dma2d_tail;
+	if (dma2d_head != seq) {
+		dma2d_start(&dma2d_queue[seq % DMA2D_QUEUE_LEN]);
+	}
+
+	if (dma2d_cb) {
+		dma2d_cb(seq, error, dma2d_cb_data);
+	}
+}
+
 /**@}*/
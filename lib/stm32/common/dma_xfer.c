@@ -0,0 +1,588 @@
+/** @addtogroup dma_xfer_file DMA transfer API
+@ingroup peripheral_apis
+
+@brief Controller independent DMA transfer layer.
+
+The register level DMA API differs between the stream based controller of
+the F2/F4/F7 and the channel based controller of the other families, and
+needs a dozen calls to set up one transfer. This layer describes a transfer
+in a struct dma_xfer_config, writes it to the hardware in one pass, routes
+the request through CHSEL, CSELR or the DMAMUX as the part requires, and
+dispatches completion events to per channel callbacks.
+
+Channels are identified by their number as used by the register level API,
+that is 0-7 for F2/F4/F7 streams and 1-8 for channel based controllers.
+@ref dma_xfer_alloc hands out channels so drivers sharing a controller do not
+conflict. On parts with fixed request mapping, pass only the channels that
+can serve the request; on DMAMUX parts any channel will do.
+
+Double buffering (ping-pong) is supported on every controller. F2/F4/F7
+streams use the hardware double buffer mode with two independent buffers.
+Channel based controllers have no such mode, the two buffers must then be
+contiguous in memory and the transfer runs circularly over both, reporting
+each half as a completed buffer.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <stddef.h>
+#include <libopencm3/cm3/assert.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/stm32/dma_xfer.h>
+
+#if defined(STM32G0) || defined(STM32G4)
+#include <libopencm3/stm32/dmamux.h>
+
+/*
+ * DMAMUX channels are numbered across both controllers, DMA2 channels follow
+ * those of DMA1. The G4 line sizes its controllers per device.
+ */
+#if defined(STM32G4)
+#include <libopencm3/stm32/dbgmcu.h>
+
+/* DBGMCU_IDCODE device ID of G431/G441, six channels per DMA */
+#define DMA_XFER_G4_CAT2_DEV_ID		0x468
+
+static uint8_t dma_xfer_dma1_channels(void)
+{
+	if ((DBGMCU_IDCODE & DBGMCU_IDCODE_DEV_ID_MASK) ==
+	    DMA_XFER_G4_CAT2_DEV_ID) {
+		return 6;
+	}
+	return 8;
+}
+#else
+static uint8_t dma_xfer_dma1_channels(void)
+{
+	return 7;
+}
+#endif
+#endif
+
+struct dma_xfer_slot {
+	dma_xfer_callback callback;
+	void *user_data;
+	uint32_t flags;
+	/* Items per buffer in double buffer mode */
+	uint16_t count;
+	/* Buffer being filled when the last completion was handled */
+	uint8_t current;
+};
+
+static struct dma_xfer_slot dma_xfer_slots[2][DMA_XFER_CHANNELS];
+static uint16_t dma_xfer_used[2];
+
+static inline unsigned int dma_xfer_index(uint32_t dma)
+{
+	return (dma == DMA1) ? 0 : 1;
+}
+
+#if defined(DMA_SxCR_EN)
+
+static uint32_t dma_xfer_cr(const struct dma_xfer_config *cfg)
+{
+	uint32_t flags = cfg->flags;
+	uint32_t reg32;
+
+	reg32 = ((flags & DMA_XFER_MSIZE_MASK) >> DMA_XFER_MSIZE_SHIFT)
+		<< DMA_SxCR_MSIZE_SHIFT;
+	reg32 |= ((flags & DMA_XFER_PSIZE_MASK) >> DMA_XFER_PSIZE_SHIFT)
+		<< DMA_SxCR_PSIZE_SHIFT;
+	reg32 |= ((flags & DMA_XFER_PL_MASK) >> DMA_XFER_PL_SHIFT)
+		<< DMA_SxCR_PL_SHIFT;
+	reg32 |= (flags & DMA_XFER_DIR_MASK) << DMA_SxCR_DIR_SHIFT;
+	reg32 |= DMA_SxCR_CHSEL(cfg->request & 0x7);
+
+	if (flags & DMA_XFER_MINC) {
+		reg32 |= DMA_SxCR_MINC;
+	}
+	if (flags & DMA_XFER_PINC) {
+		reg32 |= DMA_SxCR_PINC;
+	}
+	if (flags & DMA_XFER_CIRCULAR) {
+		reg32 |= DMA_SxCR_CIRC;
+	}
+	if (flags & DMA_XFER_DOUBLE_BUFFER) {
+		reg32 |= DMA_SxCR_DBM | DMA_SxCR_CIRC;
+	}
+	if (flags & DMA_XFER_HALF_IRQ) {
+		reg32 |= DMA_SxCR_HTIE;
+	}
+	return reg32 | DMA_SxCR_TCIE | DMA_SxCR_TEIE | DMA_SxCR_DMEIE;
+}
+
+/* Pending flags of the interrupts enabled on the stream. HTIF is set in
+ * double buffer mode even without HTIE.
+ */
+static uint32_t dma_xfer_status(uint32_t dma, uint8_t channel)
+{
+	uint32_t isr = (channel < 4) ? DMA_LISR(dma) : DMA_HISR(dma);
+	uint32_t cr = DMA_SCR(dma, channel);
+	uint32_t enabled = 0;
+
+	if (cr & DMA_SxCR_TCIE) {
+		enabled |= DMA_TCIF;
+	}
+	if (cr & DMA_SxCR_HTIE) {
+		enabled |= DMA_HTIF;
+	}
+	if (cr & DMA_SxCR_TEIE) {
+		enabled |= DMA_TEIF;
+	}
+	if (cr & DMA_SxCR_DMEIE) {
+		enabled |= DMA_DMEIF;
+	}
+	return (isr >> DMA_ISR_OFFSET(channel)) & enabled;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Configure a DMA transfer.
+
+The channel is stopped and all of its registers are written from @p cfg.
+The transfer does not start until @ref dma_xfer_start. The transfer
+complete and error interrupts are always enabled in the DMA, so the
+callback fires as soon as the channel's interrupt is enabled in the NVIC.
+
+Memory to memory transfers need the stream FIFO, which is enabled
+automatically for them.
+
+@param[in] dma DMA controller base address: DMA1 or DMA2
+@param[in] channel Stream number: @ref dma_st_number
+@param[in] cfg Transfer description.
+*/
+
+void dma_xfer_setup(uint32_t dma, uint8_t channel,
+		    const struct dma_xfer_config *cfg)
+{
+	struct dma_xfer_slot *slot =
+		&dma_xfer_slots[dma_xfer_index(dma)][channel];
+	uint32_t fcr = DMA_SxFCR_FTH_2_4_FULL;
+
+	dma_xfer_stop(dma, channel);
+	dma_clear_interrupt_flags(dma, channel, DMA_ISR_FLAGS);
+
+	slot->callback = cfg->callback;
+	slot->user_data = cfg->user_data;
+	slot->flags = cfg->flags;
+	slot->count = cfg->count;
+
+	if ((cfg->flags & DMA_XFER_FIFO) ||
+	    (cfg->flags & DMA_XFER_DIR_MASK) == DMA_XFER_MEM_TO_MEM) {
+		fcr = DMA_SxFCR_DMDIS | DMA_SxFCR_FTH_4_4_FULL;
+	}
+
+	DMA_SPAR(dma, channel) = (void *)cfg->periph_addr;
+	DMA_SM0AR(dma, channel) = (void *)cfg->mem_addr;
+	DMA_SM1AR(dma, channel) = (void *)cfg->mem1_addr;
+	DMA_SNDTR(dma, channel) = cfg->count;
+	DMA_SFCR(dma, channel) = fcr;
+	DMA_SCR(dma, channel) = dma_xfer_cr(cfg);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Stop a DMA transfer.
+
+The stream is disabled and this waits until the hardware has let go of it,
+so it may be reconfigured right away.
+
+@param[in] dma DMA controller base address: DMA1 or DMA2
+@param[in] channel Stream number: @ref dma_st_number
+*/
+
+void dma_xfer_stop(uint32_t dma, uint8_t channel)
+{
+	DMA_SCR(dma, channel) &= ~DMA_SxCR_EN;
+	while (DMA_SCR(dma, channel) & DMA_SxCR_EN);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Point a stopped DMA transfer at a new buffer.
+
+Keeps the configuration from @ref dma_xfer_setup and only replaces the
+memory address and the number of data items, which is what chained
+transfers change from one run to the next. Call @ref dma_xfer_start to run.
+
+@param[in] dma DMA controller base address: DMA1 or DMA2
+@param[in] channel Stream number: @ref dma_st_number
+@param[in] mem_addr New memory address (buffer 0 in double buffer mode).
+@param[in] count Number of data items.
+*/
+
+void dma_xfer_reload(uint32_t dma, uint8_t channel, uint32_t mem_addr,
+		     uint16_t count)
+{
+	dma_xfer_stop(dma, channel);
+	DMA_SM0AR(dma, channel) = (void *)mem_addr;
+	DMA_SNDTR(dma, channel) = count;
+}
+
+#else
+
+static uint32_t dma_xfer_data_size(uint32_t flags)
+{
+	return 1 << ((flags & DMA_XFER_MSIZE_MASK) >> DMA_XFER_MSIZE_SHIFT);
+}
+
+static uint32_t dma_xfer_cr(const struct dma_xfer_config *cfg)
+{
+	uint32_t flags = cfg->flags;
+	uint32_t reg32;
+
+	reg32 = ((flags & DMA_XFER_MSIZE_MASK) >> DMA_XFER_MSIZE_SHIFT)
+		<< DMA_CCR_MSIZE_SHIFT;
+	reg32 |= ((flags & DMA_XFER_PSIZE_MASK) >> DMA_XFER_PSIZE_SHIFT)
+		<< DMA_CCR_PSIZE_SHIFT;
+	reg32 |= ((flags & DMA_XFER_PL_MASK) >> DMA_XFER_PL_SHIFT)
+		<< DMA_CCR_PL_SHIFT;
+
+	switch (flags & DMA_XFER_DIR_MASK) {
+	case DMA_XFER_MEM_TO_PERIPH:
+		reg32 |= DMA_CCR_DIR;
+		break;
+	case DMA_XFER_MEM_TO_MEM:
+		reg32 |= DMA_CCR_MEM2MEM;
+		break;
+	default:
+		break;
+	}
+
+	if (flags & DMA_XFER_MINC) {
+		reg32 |= DMA_CCR_MINC;
+	}
+	if (flags & DMA_XFER_PINC) {
+		reg32 |= DMA_CCR_PINC;
+	}
+	if (flags & DMA_XFER_CIRCULAR) {
+		reg32 |= DMA_CCR_CIRC;
+	}
+	if (flags & DMA_XFER_DOUBLE_BUFFER) {
+		reg32 |= DMA_CCR_CIRC | DMA_CCR_HTIE;
+	}
+	if (flags & DMA_XFER_HALF_IRQ) {
+		reg32 |= DMA_CCR_HTIE;
+	}
+	return reg32 | DMA_CCR_TCIE | DMA_CCR_TEIE;
+}
+
+/* Pending flags of the interrupts enabled on the channel. */
+static uint32_t dma_xfer_status(uint32_t dma, uint8_t channel)
+{
+	uint32_t cr = DMA_CCR(dma, channel);
+	uint32_t enabled = 0;
+
+	if (cr & DMA_CCR_TCIE) {
+		enabled |= DMA_TCIF;
+	}
+	if (cr & DMA_CCR_HTIE) {
+		enabled |= DMA_HTIF;
+	}
+	if (cr & DMA_CCR_TEIE) {
+		enabled |= DMA_TEIF;
+	}
+	return (DMA_ISR(dma) >> DMA_FLAG_OFFSET(channel)) & enabled;
+}
+
+static void dma_xfer_route(uint32_t dma, uint8_t channel, uint8_t request)
+{
+#if defined(STM32G0) || defined(STM32G4)
+	if (dma != DMA1) {
+		channel += dma_xfer_dma1_channels();
+	}
+	dmamux_set_dma_channel_request(DMAMUX1, channel, request);
+#elif defined(DMA_CSELR)
+	dma_set_channel_request(dma, channel, request);
+#else
+	(void)dma;
+	(void)channel;
+	(void)request;
+#endif
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Configure a DMA transfer.
+
+The channel is stopped and all of its registers are written from @p cfg,
+and the request is routed to it. The transfer does not start until @ref
+dma_xfer_start. The transfer complete and error interrupts are always
+enabled in the DMA, so the callback fires as soon as the channel's interrupt
+is enabled in the NVIC.
+
+For double buffering, mem1_addr must directly follow the count items at
+mem_addr, as this controller runs it as one circular transfer.
+
+@param[in] dma DMA controller base address: DMA1 or DMA2
+@param[in] channel Channel number: @ref dma_ch
+@param[in] cfg Transfer description.
+*/
+
+void dma_xfer_setup(uint32_t dma, uint8_t channel,
+		    const struct dma_xfer_config *cfg)
+{
+	struct dma_xfer_slot *slot =
+		&dma_xfer_slots[dma_xfer_index(dma)][channel];
+	uint32_t count = cfg->count;
+
+	if (cfg->flags & DMA_XFER_DOUBLE_BUFFER) {
+		cm3_assert(cfg->mem1_addr == cfg->mem_addr +
+			   count * dma_xfer_data_size(cfg->flags));
+		count *= 2;
+		cm3_assert(count <= 0xffff);
+	}
+
+	DMA_CCR(dma, channel) = 0;
+	dma_clear_interrupt_flags(dma, channel, DMA_FLAGS);
+
+	slot->callback = cfg->callback;
+	slot->user_data = cfg->user_data;
+	slot->flags = cfg->flags;
+	slot->count = cfg->count;
+
+	dma_xfer_route(dma, channel, cfg->request);
+	DMA_CPAR(dma, channel) = cfg->periph_addr;
+	DMA_CMAR(dma, channel) = cfg->mem_addr;
+	DMA_CNDTR(dma, channel) = count;
+	DMA_CCR(dma, channel) = dma_xfer_cr(cfg);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Stop a DMA transfer.
+
+@param[in] dma DMA controller base address: DMA1 or DMA2
+@param[in] channel Channel number: @ref dma_ch
+*/
+
+void dma_xfer_stop(uint32_t dma, uint8_t channel)
+{
+	DMA_CCR(dma, channel) &= ~DMA_CCR_EN;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Point a stopped DMA transfer at a new buffer.
+
+Keeps the configuration from @ref dma_xfer_setup and only replaces the
+memory address and the number of data items, which is what chained
+transfers change from one run to the next. Call @ref dma_xfer_start to run.
+
+@param[in] dma DMA controller base address: DMA1 or DMA2
+@param[in] channel Channel number: @ref dma_ch
+@param[in] mem_addr New memory address.
+@param[in] count Number of data items.
+*/
+
+void dma_xfer_reload(uint32_t dma, uint8_t channel, uint32_t mem_addr,
+		     uint16_t count)
+{
+	dma_xfer_stop(dma, channel);
+	DMA_CMAR(dma, channel) = mem_addr;
+	DMA_CNDTR(dma, channel) = count;
+}
+
+#endif
+
+/*---------------------------------------------------------------------------*/
+/** @brief Allocate a DMA channel.
+
+Claims the lowest numbered free channel out of @p channel_mask. Channels
+configured with @ref dma_xfer_setup without being allocated are not
+tracked; mixing both on one controller is up to the application.
+
+@param[in] dma DMA controller base address: DMA1 or DMA2
+@param[in] channel_mask Bit n set if channel (stream) n is acceptable.
+@returns The allocated channel number, or -1 if all of them are in use.
+*/
+
+int dma_xfer_alloc(uint32_t dma, uint32_t channel_mask)
+{
+	uint16_t *used = &dma_xfer_used[dma_xfer_index(dma)];
+	int channel = -1;
+	int i;
+
+	CM_ATOMIC_BLOCK() {
+		for (i = 0; i < DMA_XFER_CHANNELS; i++) {
+			if ((channel_mask & (1 << i)) && !(*used & (1 << i))) {
+				*used |= 1 << i;
+				channel = i;
+				break;
+			}
+		}
+	}
+
+	return channel;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Release a DMA channel.
+
+Stops the channel and returns it to the pool of @ref dma_xfer_alloc.
+
+@param[in] dma DMA controller base address: DMA1 or DMA2
+@param[in] channel Channel or stream number.
+*/
+
+void dma_xfer_free(uint32_t dma, uint8_t channel)
+{
+	unsigned int idx = dma_xfer_index(dma);
+
+	dma_xfer_stop(dma, channel);
+	dma_xfer_slots[idx][channel].callback = NULL;
+	CM_ATOMIC_BLOCK() {
+		dma_xfer_used[idx] &= ~(1 << channel);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Start a configured DMA transfer.
+
+Stale interrupt flags are cleared before the channel is enabled.
+
+@param[in] dma DMA controller base address: DMA1 or DMA2
+@param[in] channel Channel or stream number.
+*/
+
+void dma_xfer_start(uint32_t dma, uint8_t channel)
+{
+	dma_clear_interrupt_flags(dma, channel,
+				  DMA_TCIF | DMA_HTIF | DMA_TEIF);
+#if defined(DMA_SxCR_EN)
+	dma_xfer_slots[dma_xfer_index(dma)][channel].current =
+		(DMA_SCR(dma, channel) & DMA_SxCR_CT) ? 1 : 0;
+	DMA_SCR(dma, channel) |= DMA_SxCR_EN;
+#else
+	DMA_CCR(dma, channel) |= DMA_CCR_EN;
+#endif
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Dispatch DMA events to the transfer callbacks.
+
+Call from the DMA interrupt handlers. Where several channels share one
+interrupt vector, pass all of them in @p channel_mask. Pending events are
+acknowledged and reported to the callback given in the channel's
+configuration, in double buffer mode once per completed buffer. Flags of
+interrupts that are not enabled are left alone, so the callback never sees
+an empty event set.
+
+@param[in] dma DMA controller base address: DMA1 or DMA2
+@param[in] channel_mask Bit n set to service channel (stream) n.
+*/
+
+void dma_xfer_irq_handler(uint32_t dma, uint32_t channel_mask)
+{
+	struct dma_xfer_slot *slots = dma_xfer_slots[dma_xfer_index(dma)];
+	uint8_t channel;
+
+	for (channel = 0; channel < DMA_XFER_CHANNELS; channel++) {
+		struct dma_xfer_slot *slot = &slots[channel];
+		uint32_t status, events = 0;
+
+		if (!(channel_mask & (1 << channel))) {
+			continue;
+		}
+		status = dma_xfer_status(dma, channel);
+		if (!status) {
+			continue;
+		}
+		dma_clear_interrupt_flags(dma, channel, status);
+		if (!slot->callback) {
+			continue;
+		}
+
+		if (status & (DMA_TEIF
+#if defined(DMA_SxCR_EN)
+			      | DMA_DMEIF
+#endif
+			      )) {
+			events |= DMA_XFER_EVENT_ERROR;
+		}
+
+		if (!(slot->flags & DMA_XFER_DOUBLE_BUFFER)) {
+			if (status & DMA_HTIF) {
+				events |= DMA_XFER_EVENT_HALF;
+			}
+			if (status & DMA_TCIF) {
+				events |= DMA_XFER_EVENT_COMPLETE;
+			}
+			slot->callback(dma, channel, events, slot->user_data);
+			continue;
+		}
+
+#if defined(DMA_SxCR_EN)
+		if (status & DMA_HTIF) {
+			events |= DMA_XFER_EVENT_HALF;
+		}
+		if (status & DMA_TCIF) {
+			uint8_t current = (DMA_SCR(dma, channel) &
+					   DMA_SxCR_CT) ? 1 : 0;
+
+			events |= DMA_XFER_EVENT_COMPLETE;
+			/* CT already points at the buffer being filled next. */
+			if (!current) {
+				events |= DMA_XFER_EVENT_BUFFER1;
+			}
+			/* CT toggles once per buffer, unchanged means at least
+			 * two completions were merged into this one.
+			 */
+			if (current == slot->current) {
+				events |= DMA_XFER_EVENT_OVERRUN;
+			}
+			slot->current = current;
+		}
+		if (events) {
+			slot->callback(dma, channel, events, slot->user_data);
+		}
+#else
+		/*
+		 * Both halves are reported in order even if both flags were
+		 * pending. A half the DMA is already transferring again is
+		 * reported as lost instead of complete, the position tells:
+		 * CNDTR is above count while buffer 0 is being transferred.
+		 */
+		if (status & DMA_HTIF) {
+			if (DMA_CNDTR(dma, channel) > slot->count) {
+				slot->callback(dma, channel,
+					       events | DMA_XFER_EVENT_OVERRUN,
+					       slot->user_data);
+			} else {
+				slot->callback(dma, channel,
+					       events | DMA_XFER_EVENT_COMPLETE,
+					       slot->user_data);
+			}
+		}
+		if (status & DMA_TCIF) {
+			events |= DMA_XFER_EVENT_BUFFER1;
+			if (DMA_CNDTR(dma, channel) <= slot->count) {
+				slot->callback(dma, channel,
+					       events | DMA_XFER_EVENT_OVERRUN,
+					       slot->user_data);
+			} else {
+				slot->callback(dma, channel,
+					       events | DMA_XFER_EVENT_COMPLETE,
+					       slot->user_data);
+			}
+		}
+		if (!(status & (DMA_HTIF | DMA_TCIF))) {
+			slot->callback(dma, channel, events, slot->user_data);
+		}
+#endif
+	}
+}
+
+/**@}*/
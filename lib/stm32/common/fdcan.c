@@ -39,6 +39,11 @@
 #include <libopencm3/stm32/fdcan.h>
 #include <libopencm3/stm32/rcc.h>
 #include <stddef.h>
+#include <string.h>
+
+#if defined(LIBOPENCM3_HOST)
+#include <libopencm3/host/mmio_sim.h>
+#endif
 
 
 /* --- FD-CAN internal functions -------------------------------------------- */
@@ -161,17 +166,23 @@ static struct fdcan_message_ram *fdcan_get_msgram_addr(uint32_t canport)
 	 *
 	 * FDCAN1_RAM_BASE + (block_id * sizeof(struct fdcan_message_ram))
 	 */
+	uint32_t addr;
+
 	if (canport == CAN1) {
-		return (struct fdcan_message_ram *) (FDCAN1_RAM_BASE + 0);
+		addr = FDCAN1_RAM_BASE + 0;
 	} else if (canport == CAN2) {
-		return (struct fdcan_message_ram *)
-			(FDCAN1_RAM_BASE + sizeof(struct fdcan_message_ram));
+		addr = FDCAN1_RAM_BASE + sizeof(struct fdcan_message_ram);
 	} else if (canport == CAN3) {
-		return (struct fdcan_message_ram *)
-			(FDCAN1_RAM_BASE + (2 * sizeof(struct fdcan_message_ram)));
+		addr = FDCAN1_RAM_BASE + (2 * sizeof(struct fdcan_message_ram));
+	} else {
+		return NULL;
 	}
 
-	return NULL;
+#if defined(LIBOPENCM3_HOST)
+	return mmio_sim_mem(addr, sizeof(struct fdcan_message_ram));
+#else
+	return (struct fdcan_message_ram *) addr;
+#endif
 }
 
 /** Converts frame length to DLC value.
@@ -547,6 +558,254 @@ void fdcan_set_ext_filter(uint32_t canport, uint32_t nr,
 		| ((id2 & FDCAN_EFID2_MASK) << FDCAN_EFID2_SHIFT);
 }
 
+/** Order filter ranges by type, then by first identifier. */
+static void fdcan_filter_sort(struct can_filter_range *ranges, unsigned count)
+{
+	for (unsigned i = 1; i < count; i++) {
+		struct can_filter_range r = ranges[i];
+		unsigned j;
+
+		for (j = i; j > 0 && (ranges[j - 1].ext > r.ext ||
+				(ranges[j - 1].ext == r.ext && ranges[j - 1].first > r.first)); j--) {
+			ranges[j] = ranges[j - 1];
+		}
+		ranges[j] = r;
+	}
+}
+
+/** One planned filter element.
+ *
+ * type is one of FDCAN_SFT_RANGE, FDCAN_SFT_DUAL and FDCAN_SFT_ID_MASK. The
+ * wanted identifiers all lie between lo and hi and differ from lo only in
+ * the bits of vary. A dual ID element accepts lo and hi, a range element
+ * everything from lo to hi, and an ID/mask element every identifier
+ * matching lo outside of vary.
+ */
+struct fdcan_filter_elem {
+	uint32_t lo;
+	uint32_t hi;
+	uint32_t vary;
+	uint8_t type;
+};
+
+/** Number of identifiers a filter element lets through. */
+static uint32_t fdcan_filter_accepted(const struct fdcan_filter_elem *e)
+{
+	uint32_t n = 1;
+
+	switch (e->type) {
+	case FDCAN_SFT_DUAL:
+		return (e->lo == e->hi) ? 1 : 2;
+	case FDCAN_SFT_RANGE:
+		return e->hi - e->lo + 1;
+	default:
+		for (uint32_t v = e->vary; v; v &= v - 1) {
+			n <<= 1;
+		}
+		return n;
+	}
+}
+
+/** Cheapest single filter element accepting everything a and b accept. */
+static void fdcan_filter_merged(const struct fdcan_filter_elem *a,
+		const struct fdcan_filter_elem *b, struct fdcan_filter_elem *out)
+{
+	struct fdcan_filter_elem range, mask;
+
+	if (a->type == FDCAN_SFT_DUAL && b->type == FDCAN_SFT_DUAL &&
+			a->lo == a->hi && b->lo == b->hi) {
+		out->lo = a->lo < b->lo ? a->lo : b->lo;
+		out->hi = a->lo < b->lo ? b->lo : a->lo;
+		out->vary = a->lo ^ b->lo;
+		out->type = FDCAN_SFT_DUAL;
+		return;
+	}
+
+	range.lo = a->lo < b->lo ? a->lo : b->lo;
+	range.hi = a->hi > b->hi ? a->hi : b->hi;
+	range.vary = a->vary | b->vary | (a->lo ^ b->lo);
+	range.type = FDCAN_SFT_RANGE;
+	mask = range;
+	mask.type = FDCAN_SFT_ID_MASK;
+
+	*out = fdcan_filter_accepted(&range) <= fdcan_filter_accepted(&mask) ?
+		range : mask;
+}
+
+/** Replace the cheapest pair of elements by a single one.
+ *
+ * The cost of a merge is the number of identifiers that were not asked for
+ * and pass the merged element, on top of those passing already. Two single
+ * identifiers share a dual ID element for free.
+ */
+static void fdcan_filter_merge(struct fdcan_filter_elem *elems, unsigned *n)
+{
+	struct fdcan_filter_elem m;
+	int32_t cost, best_cost = INT32_MAX;
+	unsigned i, j, best_i = 0, best_j = 1;
+
+	for (i = 0; i < *n; i++) {
+		for (j = i + 1; j < *n; j++) {
+			fdcan_filter_merged(&elems[i], &elems[j], &m);
+			cost = (int32_t)fdcan_filter_accepted(&m) -
+			       (int32_t)fdcan_filter_accepted(&elems[i]) -
+			       (int32_t)fdcan_filter_accepted(&elems[j]);
+			if (cost < best_cost) {
+				best_cost = cost;
+				best_i = i;
+				best_j = j;
+			}
+		}
+	}
+
+	fdcan_filter_merged(&elems[best_i], &elems[best_j], &elems[best_i]);
+	elems[best_j] = elems[--*n];
+}
+
+/** Fit sorted ranges of one type into at most max filter elements.
+ *
+ * Overlapping and adjacent ranges are joined first. Each range then takes
+ * an element of its own, and whenever there is one more than fit, the
+ * cheapest pair of elements is merged, see @ref fdcan_filter_merge. Every
+ * merge saves exactly one element.
+ *
+ * @param [in,out] ranges Ranges of one type, joined in place.
+ * @param [out] elems Storage for max + 1 elements.
+ * @returns Number of filter elements planned.
+ */
+static unsigned fdcan_filter_fit(struct can_filter_range *ranges,
+		unsigned count, struct fdcan_filter_elem *elems, unsigned max)
+{
+	unsigned i, n = 0, planned = 0;
+
+	for (i = 0; i < count; i++) {
+		if (n > 0 && ranges[i].first <= ranges[n - 1].last + 1) {
+			if (ranges[i].last > ranges[n - 1].last) {
+				ranges[n - 1].last = ranges[i].last;
+			}
+		} else {
+			ranges[n++] = ranges[i];
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		struct fdcan_filter_elem *e = &elems[planned++];
+		uint32_t diff = ranges[i].first ^ ranges[i].last;
+
+		e->lo = ranges[i].first;
+		e->hi = ranges[i].last;
+		e->type = (e->lo == e->hi) ? FDCAN_SFT_DUAL : FDCAN_SFT_RANGE;
+		/* All bits up to the highest one differing in first and last. */
+		e->vary = diff;
+		while (diff) {
+			diff >>= 1;
+			e->vary |= diff;
+		}
+
+		if (planned > max) {
+			fdcan_filter_merge(elems, &planned);
+		}
+	}
+
+	return planned;
+}
+
+/** Program planned filter elements of one type. */
+static void fdcan_filter_write(uint32_t canport, bool ext,
+		const struct fdcan_filter_elem *elems, unsigned count, uint8_t fifo)
+{
+	for (unsigned nr = 0; nr < count; nr++) {
+		const struct fdcan_filter_elem *e = &elems[nr];
+		uint32_t id2 = e->hi;
+		uint8_t type;
+
+		if (ext) {
+			if (e->type == FDCAN_SFT_ID_MASK) {
+				type = FDCAN_EFT_ID_MASK;
+				id2 = ~e->vary;
+			} else if (e->type == FDCAN_SFT_DUAL) {
+				type = FDCAN_EFT_DUAL;
+			} else {
+				/* Independent of the global extended ID mask. */
+				type = FDCAN_EFT_RANGE_NOXIDAM;
+			}
+			fdcan_set_ext_filter(canport, nr, type, e->lo, id2,
+				fifo ? FDCAN_EFEC_FIFO1 : FDCAN_EFEC_FIFO0);
+		} else {
+			if (e->type == FDCAN_SFT_ID_MASK) {
+				id2 = ~e->vary;
+			}
+			fdcan_set_std_filter(canport, nr, e->type, e->lo, id2,
+				fifo ? FDCAN_SFEC_FIFO1 : FDCAN_SFEC_FIFO0);
+		}
+	}
+}
+
+/** Plan and program filters for a set of identifiers.
+ *
+ * Programs the standard and extended ID filter lists so that, as far as the
+ * number of filter elements allows, exactly the given identifiers are
+ * accepted into @p fifo, and all other frames are rejected. Single
+ * identifiers are paired into dual ID filters, ranges use range filters.
+ * When there are more than fit, filter elements are merged into range or
+ * classic ID/mask filters, whichever lets the fewest unwanted identifiers
+ * through.
+ *
+ * This has to be called while FDCAN block is in INIT mode, as it sets the
+ * filter list sizes, see @ref fdcan_init_filter.
+ *
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block.
+ * @param [in] ranges Identifier ranges to accept.
+ * @param [in] count Number of entries in @p ranges, at most
+ * 		@ref FDCAN_FILTER_PLAN_MAX.
+ * @param [in] fifo Receive FIFO accepted frames are stored to (0 or 1)
+ * @returns Total number of filter elements programmed, -1 if there are
+ * 		more ranges than FDCAN_FILTER_PLAN_MAX.
+ */
+int fdcan_filter_plan(uint32_t canport, const struct can_filter_range *ranges,
+		unsigned count, uint8_t fifo)
+{
+	struct can_filter_range sorted[FDCAN_FILTER_PLAN_MAX];
+	struct fdcan_filter_elem std[FDCAN_SFT_MAX_NR + 1];
+	struct fdcan_filter_elem ext[FDCAN_EFT_MAX_NR + 1];
+	unsigned n_std, std_slots, ext_slots;
+
+	if (count > FDCAN_FILTER_PLAN_MAX) {
+		return -1;
+	}
+
+	/* Sorted and joined in a copy, the caller's ranges stay as they are. */
+	for (unsigned i = 0; i < count; i++) {
+		uint32_t bits = ranges[i].ext ? FDCAN_EFID1_MASK : FDCAN_SFID1_MASK;
+
+		sorted[i] = ranges[i];
+		sorted[i].first &= bits;
+		sorted[i].last &= bits;
+		if (sorted[i].last < sorted[i].first) {
+			sorted[i].last = sorted[i].first;
+		}
+	}
+
+	fdcan_filter_sort(sorted, count);
+	for (n_std = 0; n_std < count && !sorted[n_std].ext; n_std++);
+
+	std_slots = fdcan_filter_fit(sorted, n_std, std, FDCAN_SFT_MAX_NR);
+	ext_slots = fdcan_filter_fit(&sorted[n_std], count - n_std, ext,
+			FDCAN_EFT_MAX_NR);
+
+	fdcan_init_filter(canport, std_slots, ext_slots);
+	fdcan_filter_write(canport, false, std, std_slots, fifo);
+	fdcan_filter_write(canport, true, ext, ext_slots, fifo);
+
+	FDCAN_RXGFC(canport) = (FDCAN_RXGFC(canport)
+		& ~((FDCAN_RXGFC_ANFS_MASK << FDCAN_RXGFC_ANFS_SHIFT)
+			| (FDCAN_RXGFC_ANFE_MASK << FDCAN_RXGFC_ANFE_SHIFT)))
+		| (FDCAN_RXGFC_ANF_REJECT << FDCAN_RXGFC_ANFS_SHIFT)
+		| (FDCAN_RXGFC_ANF_REJECT << FDCAN_RXGFC_ANFE_SHIFT);
+
+	return std_slots + ext_slots;
+}
+
 /** Transmit Message using FDCAN
  *
  * @param [in] canport CAN block register base. See @ref fdcan_block.
@@ -607,10 +866,13 @@ int fdcan_transmit(uint32_t canport, uint32_t id, bool ext, bool rtr,
 		(dlc << FDCAN_FIFO_DLC_SHIFT) | flags;
 
 	for (int q = 0; q < length; q += 4) {
-		ram->tx_buffer[mailbox].data[q / 4] = *((uint32_t *) &data[q]);
+		uint32_t word;
+
+		memcpy(&word, &data[q], sizeof(word));
+		ram->tx_buffer[mailbox].data[q / 4] = word;
 	}
 
-	FDCAN_TXBAR(canport) |= 1 << mailbox;
+	FDCAN_TXBAR(canport) = 1 << mailbox;
 
 	return mailbox;
 }
@@ -685,11 +947,13 @@ int fdcan_receive(uint32_t canport, uint8_t fifo_id, bool release, uint32_t *id,
 	}
 
 	for (unsigned int q = 0; q < len; q += 4) {
-		*((uint32_t *) &data[q]) = fifo[get_index].data[q / 4];
+		uint32_t word = fifo[get_index].data[q / 4];
+
+		memcpy(&data[q], &word, sizeof(word));
 	}
 
 	if (release) {
-		FDCAN_RXFIA(canport, fifo_id) |= get_index << FDCAN_RXFIFO_AI_SHIFT;
+		FDCAN_RXFIA(canport, fifo_id) = get_index << FDCAN_RXFIFO_AI_SHIFT;
 	}
 
 	return FDCAN_E_OK;
@@ -709,17 +973,177 @@ void fdcan_release_fifo(uint32_t canport, uint8_t fifo_id)
 {
 	unsigned pending_frames, get_index;
 
-	get_index = (FDCAN_RXFIS(canport, fifo_id) >> FDCAN_RXFIFO_GI_SHIFT)
-		& FDCAN_RXFIFO_GI_SHIFT;
-
-	pending_frames = (FDCAN_RXFIS(canport, fifo_id) >> FDCAN_RXFIFO_FL_SHIFT)
-		& FDCAN_RXFIFO_FL_SHIFT;
+	fdcan_get_fill_rxfifo(canport, fifo_id, &get_index, &pending_frames);
 
 	if (pending_frames) {
-		FDCAN_RXFIA(canport, fifo_id) |= get_index << FDCAN_RXFIFO_AI_SHIFT;
+		FDCAN_RXFIA(canport, fifo_id) = get_index << FDCAN_RXFIFO_AI_SHIFT;
 	}
 }
 
+/** Get pending frames from receive FIFO without copying them.
+ *
+ * Fills @p elements with pointers to the oldest pending frames, directly in
+ * message RAM, oldest first. They can be parsed in place, using
+ * @ref fdcan_rx_element_id and @ref fdcan_rx_element_length for the header.
+ * Message RAM must be read in 32 bit quantities. The frames stay valid until
+ * they are released with @ref fdcan_release_batch.
+ *
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block.
+ * @param [in] fifo_id ID of FIFO to read from (0 or 1)
+ * @param [out] elements Array receiving pointers to FIFO elements.
+ * @param [in] max Size of @p elements.
+ * @returns Number of pointers stored, 0 if the FIFO is empty.
+ */
+unsigned fdcan_receive_batch(uint32_t canport, uint8_t fifo_id,
+		const struct fdcan_rx_fifo_element **elements, unsigned max)
+{
+	const struct fdcan_message_ram *ram = fdcan_get_msgram_addr(canport);
+	unsigned pending_frames, get_index, n;
+
+	fdcan_get_fill_rxfifo(canport, fifo_id, &get_index, &pending_frames);
+
+	if (pending_frames > max) {
+		pending_frames = max;
+	}
+
+	for (n = 0; n < pending_frames; n++) {
+		elements[n] = &ram->rx_fifo[fifo_id][get_index];
+		if (++get_index == 3) {
+			get_index = 0;
+		}
+	}
+
+	return pending_frames;
+}
+
+/** Release several receive FIFO entries at once.
+ *
+ * Acknowledging a FIFO element releases it together with all older ones,
+ * so a batch obtained from @ref fdcan_receive_batch is released with a
+ * single register write.
+ *
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block.
+ * @param [in] fifo_id ID of FIFO where release should be performed (0 or 1)
+ * @param [in] count Number of oldest entries to release.
+ */
+void fdcan_release_batch(uint32_t canport, uint8_t fifo_id, unsigned count)
+{
+	unsigned pending_frames, get_index;
+
+	fdcan_get_fill_rxfifo(canport, fifo_id, &get_index, &pending_frames);
+
+	if (count > pending_frames) {
+		count = pending_frames;
+	}
+
+	if (count) {
+		FDCAN_RXFIA(canport, fifo_id) =
+			((get_index + count - 1) % 3) << FDCAN_RXFIFO_AI_SHIFT;
+	}
+}
+
+/** Get message ID of a receive FIFO element.
+ *
+ * @param [in] element FIFO element returned by @ref fdcan_receive_batch.
+ * @param [out] ext Returned type of the message ID (true if extended).
+ * @returns Message ID.
+ */
+uint32_t fdcan_rx_element_id(const struct fdcan_rx_fifo_element *element,
+		bool *ext)
+{
+	uint32_t identifier_flags = element->identifier_flags;
+
+	*ext = (identifier_flags & FDCAN_FIFO_XTD) == FDCAN_FIFO_XTD;
+	if (*ext) {
+		return (identifier_flags >> FDCAN_FIFO_EID_SHIFT) & FDCAN_FIFO_EID_MASK;
+	}
+
+	return (identifier_flags >> FDCAN_FIFO_SID_SHIFT) & FDCAN_FIFO_SID_MASK;
+}
+
+/** Get payload length of a receive FIFO element.
+ *
+ * @param [in] element FIFO element returned by @ref fdcan_receive_batch.
+ * @returns Payload length in bytes.
+ */
+uint8_t fdcan_rx_element_length(const struct fdcan_rx_fifo_element *element)
+{
+	return fdcan_dlc_to_length((element->filt_fmt_dlc_ts >> FDCAN_FIFO_DLC_SHIFT)
+		& FDCAN_FIFO_DLC_MASK);
+}
+
+/** Transmit several messages using FDCAN.
+ *
+ * Copies as many frames as there are free transmit buffers into message
+ * RAM, a word at a time, and requests their transmission with a single
+ * write to FDCAN_TXBAR. Stops at the first frame with a length no DLC
+ * encodes, which is then the frame at the returned index.
+ *
+ * @param [in] canport CAN block register base. See @ref fdcan_block.
+ * @param [in] frames Frames to send, in order.
+ * @param [in] count Number of frames in @p frames.
+ * @returns Number of frames queued for transmission.
+ */
+unsigned fdcan_transmit_batch(uint32_t canport, const struct fdcan_frame *frames,
+		unsigned count)
+{
+	struct fdcan_message_ram *ram = fdcan_get_msgram_addr(canport);
+	uint32_t pending = FDCAN_TXBRP(canport);
+	uint32_t request = 0;
+	unsigned n, mailbox = 0;
+
+	for (n = 0; n < count; n++) {
+		const struct fdcan_frame *frame = &frames[n];
+		struct fdcan_tx_buffer_element *element;
+		uint32_t dlc, flags = 0;
+
+		while (mailbox < 3 && (pending & (1 << mailbox))) {
+			mailbox++;
+		}
+		if (mailbox == 3) {
+			break;
+		}
+
+		dlc = fdcan_length_to_dlc(frame->length);
+		if (dlc == 0xFF) {
+			break;
+		}
+
+		element = &ram->tx_buffer[mailbox];
+		if (frame->flags & FDCAN_FRAME_EXT) {
+			element->identifier_flags = FDCAN_FIFO_XTD
+				| ((frame->id & FDCAN_FIFO_EID_MASK) << FDCAN_FIFO_EID_SHIFT);
+		} else {
+			element->identifier_flags =
+				(frame->id & FDCAN_FIFO_SID_MASK) << FDCAN_FIFO_SID_SHIFT;
+		}
+		if (frame->flags & FDCAN_FRAME_RTR) {
+			element->identifier_flags |= FDCAN_FIFO_RTR;
+		}
+
+		if (frame->flags & FDCAN_FRAME_FDF) {
+			flags |= FDCAN_FIFO_FDF;
+		}
+		if (frame->flags & FDCAN_FRAME_BRS) {
+			flags |= FDCAN_FIFO_BRS;
+		}
+		element->evt_fmt_dlc_res = (dlc << FDCAN_FIFO_DLC_SHIFT) | flags;
+
+		for (unsigned q = 0; q < (frame->length + 3U) / 4; q++) {
+			element->data[q] = frame->data[q];
+		}
+
+		request |= 1 << mailbox;
+		mailbox++;
+	}
+
+	if (request) {
+		FDCAN_TXBAR(canport) = request;
+	}
+
+	return n;
+}
+
 /** Enable IRQ from FDCAN block.
  *
  * This routine configures FDCAN to enable certain IRQ.
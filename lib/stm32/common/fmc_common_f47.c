@@ -108,4 +108,241 @@ sdram_command(enum fmc_sdram_bank bank,
 	FMC_SDCMR = tmp_reg;
 }
 
+/* Cycles of a clock needed to cover ns, rounded up. The clock is taken in
+ * 10 kHz units (rounded up) to keep the product within 32 bits.
+ */
+static uint32_t fmc_ns_to_cycles(uint32_t ns, uint32_t clk_hz)
+{
+	return (ns * ((clk_hz + 9999) / 10000) + 99999) / 100000;
+}
+
+static uint32_t fmc_max(uint32_t a, uint32_t b)
+{
+	return a > b ? a : b;
+}
+
+/* Busy wait of at least us microseconds, each iteration takes several
+ * cycles so this errs on the long side.
+ */
+static void fmc_delay_us(uint32_t hclk, uint32_t us)
+{
+	volatile uint32_t n = (hclk / 1000000) * us;
+
+	while (n--);
+}
+
+/*
+ * Convert the datasheet timings of an SDRAM into SDRAM Timing Control
+ * Register cycles for the SDCLK resulting from hclk, for use with
+ * sdram_timing(). The write recovery time is raised to satisfy the
+ * TWR >= TRAS - TRCD and TWR >= TRC - TRCD - TRP constraints of the
+ * controller. Returns -1 if a timing needs more than 16 cycles.
+ */
+int
+sdram_calc_timing(const struct sdram_config *cfg, uint32_t hclk,
+		  struct sdram_timing *t) {
+	uint32_t sdclk = hclk / cfg->sdclk_div;
+
+	t->trcd = fmc_max(1, fmc_ns_to_cycles(cfg->trcd_ns, sdclk));
+	t->trp = fmc_max(1, fmc_ns_to_cycles(cfg->trp_ns, sdclk));
+	t->trc = fmc_max(1, fmc_ns_to_cycles(cfg->trc_ns, sdclk));
+	t->tras = fmc_max(1, fmc_ns_to_cycles(cfg->tras_ns, sdclk));
+	t->txsr = fmc_max(1, fmc_ns_to_cycles(cfg->txsr_ns, sdclk));
+	t->tmrd = fmc_max(1, cfg->tmrd_clk);
+	t->twr = fmc_max(fmc_max(1, cfg->twr_clk),
+			 fmc_ns_to_cycles(cfg->twr_ns, sdclk));
+	if (t->tras - t->trcd > t->twr) {
+		t->twr = t->tras - t->trcd;
+	}
+	if (t->trc - t->trcd - t->trp > t->twr) {
+		t->twr = t->trc - t->trcd - t->trp;
+	}
+
+	if (t->trcd > 16 || t->trp > 16 || t->twr > 16 || t->trc > 16 ||
+	    t->tras > 16 || t->txsr > 16 || t->tmrd > 16) {
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Refresh timer count for the SDRAM Refresh Timer Register: the refresh
+ * interval in SDCLK cycles, less the 20 cycle margin recommended for
+ * pending accesses.
+ */
+uint32_t
+sdram_refresh_count(const struct sdram_config *cfg, uint32_t hclk) {
+	uint32_t sdclk_khz = hclk / cfg->sdclk_div / 1000;
+	uint32_t count = sdclk_khz * cfg->refresh_ms / cfg->refresh_rows;
+
+	return count > 20 ? count - 20 : 0;
+}
+
+/*
+ * Configure an SDRAM bank from its datasheet parameters and run the
+ * JEDEC power up sequence: clock enable, 100us delay, precharge all,
+ * eight auto refresh cycles and load mode register (burst length 1,
+ * single writes, the configured CAS latency), then start the refresh
+ * timer. The FMC clock and GPIOs must be set up before.
+ *
+ * SDCLK, read burst and read pipe (SDCR) and TRP, TRC (SDTR) are common to
+ * both banks and only exist in the bank 1 registers; they are taken from
+ * cfg when bank 2 is set up alone. Returns -1 if the timings cannot be met
+ * at this clock, 0 otherwise.
+ */
+int
+sdram_init(enum fmc_sdram_bank bank, const struct sdram_config *cfg,
+	   uint32_t hclk) {
+	struct sdram_timing t;
+	uint32_t sdcr, sdtr, count, mode;
+
+	count = sdram_refresh_count(cfg, hclk);
+	if (sdram_calc_timing(cfg, hclk, &t) < 0 ||
+	    count < 41 || count > 0x1fff) {
+		return -1;
+	}
+
+	sdcr = ((uint32_t)(cfg->columns - 8) << FMC_SDCR_NC_SHIFT) |
+	       ((uint32_t)(cfg->rows - 11) << FMC_SDCR_NR_SHIFT) |
+	       ((uint32_t)(cfg->width >> 4) << FMC_SDCR_MWID_SHIFT) |
+	       (cfg->banks == 4 ? FMC_SDCR_NB4 : FMC_SDCR_NB2) |
+	       ((uint32_t)cfg->cas_latency << FMC_SDCR_CAS_SHIFT) |
+	       ((uint32_t)cfg->sdclk_div << FMC_SDCR_SDCLK_SHIFT) |
+	       ((uint32_t)cfg->read_pipe << FMC_SDCR_RPIPE_SHIFT);
+	if (cfg->read_burst) {
+		sdcr |= FMC_SDCR_RBURST;
+	}
+	sdtr = sdram_timing(&t);
+
+	if (bank != SDRAM_BANK1) {
+		FMC_SDCR1 = (FMC_SDCR1 & ~FMC_SDCR_DNC_MASK) |
+			    (sdcr & FMC_SDCR_DNC_MASK);
+		FMC_SDTR1 = (FMC_SDTR1 & ~FMC_SDTR_DNC_MASK) |
+			    (sdtr & FMC_SDTR_DNC_MASK);
+		FMC_SDCR2 = sdcr;
+		FMC_SDTR2 = sdtr;
+	}
+	if (bank != SDRAM_BANK2) {
+		FMC_SDCR1 = sdcr;
+		FMC_SDTR1 = sdtr;
+	}
+#if defined(FSMC_BCR_FMCEN)
+	FSMC_BCR1 |= FSMC_BCR_FMCEN;
+#endif
+
+	sdram_command(bank, SDRAM_CLK_CONF, 0, 0);
+	fmc_delay_us(hclk, 100);
+	sdram_command(bank, SDRAM_PALL, 0, 0);
+	sdram_command(bank, SDRAM_AUTO_REFRESH, 7, 0);
+	mode = SDRAM_MODE_BURST_LENGTH_1 | SDRAM_MODE_BURST_TYPE_SEQUENTIAL |
+	       ((uint32_t)cfg->cas_latency << 4) |
+	       SDRAM_MODE_OPERATING_MODE_STANDARD |
+	       SDRAM_MODE_WRITEBURST_MODE_SINGLE;
+	sdram_command(bank, SDRAM_LOAD_MODE, 0, mode);
+
+	FMC_SDRTR = (FMC_SDRTR & ~FMC_SDRTR_COUNT_MASK) |
+		    (count << FMC_SDRTR_COUNT_SHIFT);
+	while (FMC_SDSR & FMC_SDSR_BUSY);
+
+	return 0;
+}
+
+/* BCR bits set up by fmc_sram_init(), the others are left alone */
+#define FMC_BCR_CONFIG_MASK	0x000fff7f
+
+/*
+ * Configure NOR/PSRAM/SRAM bank 1 .. 4 (NE1 .. NE4) from datasheet
+ * timings. Asynchronous accesses use mode 1/2, or with separate write
+ * timings the extended mode A (SRAM, PSRAM), B (NOR) or D (multiplexed).
+ * With burst_read or burst_write, the bank runs synchronously on the CLK
+ * pin, at most clk_hz, with the given data latency. Returns -1 if the
+ * timings cannot be met at this clock or the bank is invalid.
+ */
+int
+fmc_sram_init(uint8_t bank, const struct fmc_sram_config *cfg,
+	      uint32_t hclk) {
+	uint32_t addset, addhld, datast, busturn, accmod;
+	uint32_t bcr, btr;
+	uint8_t i = bank - 1;
+
+	addset = fmc_ns_to_cycles(cfg->addset_ns, hclk);
+	addhld = fmc_max(1, fmc_ns_to_cycles(cfg->addhld_ns, hclk));
+	datast = fmc_max(1, fmc_ns_to_cycles(cfg->datast_ns, hclk));
+	busturn = fmc_ns_to_cycles(cfg->busturn_ns, hclk);
+	if (bank < 1 || bank > 4 || addset > 15 || addhld > 15 ||
+	    datast > 255 || busturn > 15) {
+		return -1;
+	}
+
+	bcr = FSMC_BCR_MBKEN | FSMC_BCR_WREN |
+	      (FSMC_BCR_MTYP * cfg->type) |
+	      (FSMC_BCR_MWID * (cfg->width >> 4));
+	btr = FSMC_BTR_ADDSETx(addset) | FSMC_BTR_ADDHLDx(addhld) |
+	      FSMC_BTR_DATASTx(datast) | FSMC_BTR_BUSTURNx(busturn);
+
+	if (cfg->type == FMC_MEMORY_NOR) {
+		bcr |= FSMC_BCR_FACCEN;
+	}
+	if (cfg->mux) {
+		bcr |= FSMC_BCR_MUXEN;
+	}
+
+	if (cfg->burst_read || cfg->burst_write) {
+		uint32_t clkdiv = (hclk + cfg->clk_hz - 1) / cfg->clk_hz;
+		uint32_t datlat = cfg->data_latency > 2 ?
+				  cfg->data_latency - 2 : 0;
+
+		clkdiv = clkdiv < 2 ? 1 : clkdiv - 1;
+		if (clkdiv > 15 || datlat > 15) {
+			return -1;
+		}
+		btr |= FSMC_BTR_CLKDIVx(clkdiv) | FSMC_BTR_DATLATx(datlat);
+		if (cfg->burst_read) {
+			bcr |= FSMC_BCR_BURSTEN;
+		}
+		if (cfg->burst_write) {
+			bcr |= FSMC_BCR_CBURSTRW;
+		}
+	}
+
+	if (cfg->wait) {
+		bcr |= FSMC_BCR_WAITEN;
+		if (!cfg->burst_read && !cfg->burst_write) {
+			bcr |= FSMC_BCR_ASYNCWAIT;
+		}
+	}
+
+	if (cfg->wr_addset_ns || cfg->wr_datast_ns) {
+		uint32_t wr_addset = fmc_ns_to_cycles(cfg->wr_addset_ns, hclk);
+		uint32_t wr_datast = fmc_max(1,
+			fmc_ns_to_cycles(cfg->wr_datast_ns, hclk));
+
+		if (wr_addset > 15 || wr_datast > 255) {
+			return -1;
+		}
+		if (cfg->mux) {
+			accmod = FSMC_BTx_ACCMOD_D;
+		} else if (cfg->type == FMC_MEMORY_NOR) {
+			accmod = FSMC_BTx_ACCMOD_B;
+		} else {
+			accmod = FSMC_BTx_ACCMOD_A;
+		}
+		bcr |= FSMC_BCR_EXTMOD;
+		btr |= FSMC_BTR_ACCMODx(accmod);
+		FSMC_BWTR(i) = FSMC_BTR_ACCMODx(accmod) |
+			       FSMC_BTR_ADDSETx(wr_addset) |
+			       FSMC_BTR_ADDHLDx(addhld) |
+			       FSMC_BTR_DATASTx(wr_datast) |
+			       FSMC_BTR_BUSTURNx(busturn);
+	}
+
+	FSMC_BTR(i) = btr;
+	FSMC_BCR(i) = (FSMC_BCR(i) & ~FMC_BCR_CONFIG_MASK) | bcr;
+#if defined(FSMC_BCR_FMCEN)
+	FSMC_BCR1 |= FSMC_BCR_FMCEN;
+#endif
+
+	return 0;
+}
+
 /**@}*/
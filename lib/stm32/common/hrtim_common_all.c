@@ -0,0 +1,579 @@
+/** @addtogroup hrtim_file HRTIM peripheral API
+@ingroup peripheral_apis
+
+@brief High resolution timer driver for digital power conversion.
+
+The master timer and the timing units A..E count at up to 32 times the
+HRTIM clock thanks to the DLL, i.e. 217 ps per tick with a 144 MHz clock on
+the STM32F334. Periods and compares are programmed in these ticks, dead
+times in steps of 1/8 of the HRTIM clock period.
+
+Typical half bridge on timer A at 200 kHz, updated once per period from a
+table in RAM by the burst DMA controller without any interrupt:
+
+@code
+	rcc_periph_clock_enable(RCC_HRTIM);
+	hrtim_init(144000000);
+	hrtim_dll_calibrate(100000);
+
+	hrtim_timer_setup(HRTIM_TIMA, &(struct hrtim_timer_config) {
+		.freq_hz = 200000,
+	});
+	hrtim_set_output(HRTIM_TIMA, 1, HRTIM_TIMx_SETy_PER,
+			 HRTIM_TIMx_RSTy_CMP1);
+	hrtim_set_deadtime(HRTIM_TIMA, 50000, 50000);
+	hrtim_fault_setup(1, HRTIM_FAULT_FILTER(4));
+	hrtim_timer_set_faults(HRTIM_TIMA, 1 << 0,
+			       HRTIM_FAULT_STATE_INACTIVE);
+
+	hrtim_burst_dma_setup(HRTIM_TIMA, HRTIM_BDTxUPR_TIMxCMP1, DMA1,
+			      DMA_CHANNEL3, duty_table, 64);
+
+	hrtim_output_enable(HRTIM_OENR_TA1OEN | HRTIM_OENR_TA2OEN);
+	hrtim_counter_enable(HRTIM_MCR_TACEN);
+@endcode
+
+The burst DMA requests of the timers are on fixed channels of DMA1 on the
+STM32F334: master on channel 2, timer A to E on channels 3 to 7.
+
+The HRTIM clock has to be enabled and its source selected in the RCC before
+calling these functions. Timers are set up while their counter is stopped.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <libopencm3/stm32/dma_xfer.h>
+#include <libopencm3/stm32/hrtim.h>
+
+/* The master timer has the same layout as the timing units up to CMP4, and
+ * its MCR the same CONT, CK_PSC and PREEN bits as TIMxCR.
+ */
+#define HRTIM_TIMER_BASE(timer) \
+	((timer) == HRTIM_MASTER ? HRTIM_BASE : HRTIM_TIMx_BASE(timer))
+#define HRTIM_TIMER_CR(timer)		MMIO32(HRTIM_TIMER_BASE(timer) + 0x00)
+#define HRTIM_TIMER_PER(timer)		MMIO32(HRTIM_TIMER_BASE(timer) + 0x14)
+#define HRTIM_TIMER_REP(timer)		MMIO32(HRTIM_TIMER_BASE(timer) + 0x18)
+
+/* Counter enable bits of the master and the timing units in MCR */
+#define HRTIM_MCR_CEN_MASK		(0x3f << 16)
+
+#define HRTIM_ISR_FAULTS		(HRTIM_ISR_FLT1 | HRTIM_ISR_FLT2 | \
+					 HRTIM_ISR_FLT3 | HRTIM_ISR_FLT4 | \
+					 HRTIM_ISR_FLT5 | HRTIM_ISR_SYSFLT)
+
+#define HRTIM_DT_MAX			0x1ff
+
+static const uint8_t hrtim_cmp_offset[4] = { 0x1c, 0x24, 0x28, 0x2c };
+
+static uint32_t hrtim_clk_hz;
+static uint8_t hrtim_psc[HRTIM_MASTER + 1];
+
+/* Counter clock for a CK_PSC setting, the DLL multiplies by 32 at most. */
+static uint64_t hrtim_tick_hz(uint8_t psc)
+{
+	if (psc <= 5) {
+		return (uint64_t)hrtim_clk_hz * (32 >> psc);
+	}
+	return hrtim_clk_hz >> (psc - 5);
+}
+
+/* Smallest and largest period and compare values for a prescaler setting,
+ * 0x60 and 0xffdf in full resolution, scaled down with the prescaler.
+ */
+static uint32_t hrtim_min_value(uint8_t psc)
+{
+	uint32_t v = 0x60 >> psc;
+
+	return v < 3 ? 3 : v;
+}
+
+static uint32_t hrtim_max_value(uint8_t psc)
+{
+	uint32_t v = 0x20 >> psc;
+
+	return 0xffff - (v < 2 ? 2 : v);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Set the HRTIM input clock used for the time conversions.
+
+@param[in] clk_hz fHRTIM, the clock selected for the HRTIM in the RCC.
+*/
+
+void hrtim_init(uint32_t clk_hz)
+{
+	hrtim_clk_hz = clk_hz;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Calibrate the DLL and keep it calibrated.
+
+Runs a single calibration, which is required before using the high
+resolution, then enables periodic calibration to track temperature and
+voltage drift.
+
+@param[in] timeout Number of status polls before giving up.
+@returns 0 once the DLL is locked, -1 on timeout.
+*/
+
+int hrtim_dll_calibrate(uint32_t timeout)
+{
+	HRTIM_DLLCR = HRTIM_DLLCR_CAL;
+	while (!(HRTIM_ISR & HRTIM_ISR_DLLRDY)) {
+		if (!timeout--) {
+			return -1;
+		}
+	}
+	HRTIM_ICR = HRTIM_ICR_DLLRDYC;
+
+	HRTIM_DLLCR = HRTIM_DLLCR_CALRTE_1048576 | HRTIM_DLLCR_CALEN;
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Set up the master timer or a timing unit in continuous mode.
+
+The smallest prescaler that reaches the frequency is selected, which gives
+the finest resolution.
+
+@param[in] timer HRTIM_TIMA..HRTIM_TIME or HRTIM_MASTER.
+@param[in] cfg Timer setup.
+@returns 0 on success, -1 if the frequency is out of range.
+*/
+
+int hrtim_timer_setup(uint8_t timer, const struct hrtim_timer_config *cfg)
+{
+	uint8_t psc;
+
+	if (!cfg->freq_hz) {
+		return -1;
+	}
+
+	for (psc = 0; psc < 8; psc++) {
+		uint64_t ticks = hrtim_tick_hz(psc) / cfg->freq_hz;
+		uint32_t cr = cfg->flags | HRTIM_TIMx_CR_CONT |
+			      (psc << HRTIM_TIMx_CR_CK_PSCx_SHIFT);
+
+		if (ticks > hrtim_max_value(psc)) {
+			continue;
+		}
+		if (ticks < hrtim_min_value(psc)) {
+			return -1;
+		}
+
+		if (timer == HRTIM_MASTER) {
+			cr |= HRTIM_MCR & HRTIM_MCR_CEN_MASK;
+		}
+		HRTIM_TIMER_CR(timer) = cr;
+		HRTIM_TIMER_PER(timer) = ticks;
+		HRTIM_TIMER_REP(timer) = cfg->repetition;
+		hrtim_psc[timer] = psc;
+		return 0;
+	}
+
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Convert a time to counter ticks of a timer.
+
+@param[in] timer Timer set up by @ref hrtim_timer_setup.
+@param[in] ps Time in picoseconds.
+@returns Number of ticks, rounded down.
+*/
+
+uint32_t hrtim_ps_to_ticks(uint8_t timer, uint32_t ps)
+{
+	return (uint64_t)ps * (hrtim_tick_hz(hrtim_psc[timer]) / 1000) /
+	       1000000000;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Get the period of a timer.
+
+@param[in] timer HRTIM_TIMA..HRTIM_TIME or HRTIM_MASTER.
+@returns Period in counter ticks.
+*/
+
+uint32_t hrtim_get_period(uint8_t timer)
+{
+	return HRTIM_TIMER_PER(timer);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Set a compare value.
+
+The value is clamped to the range the timer accepts at its prescaler
+setting.
+
+@param[in] timer HRTIM_TIMA..HRTIM_TIME or HRTIM_MASTER.
+@param[in] cmp Compare unit, 1 to 4.
+@param[in] value Compare value in counter ticks.
+*/
+
+void hrtim_set_compare(uint8_t timer, uint8_t cmp, uint32_t value)
+{
+	uint8_t psc = hrtim_psc[timer];
+
+	if (value < hrtim_min_value(psc)) {
+		value = hrtim_min_value(psc);
+	} else if (value > hrtim_max_value(psc)) {
+		value = hrtim_max_value(psc);
+	}
+
+	MMIO32(HRTIM_TIMER_BASE(timer) + hrtim_cmp_offset[cmp - 1]) = value;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Set a compare value as a fraction of the period.
+
+@param[in] timer HRTIM_TIMA..HRTIM_TIME or HRTIM_MASTER.
+@param[in] cmp Compare unit, 1 to 4.
+@param[in] duty Fraction of the period, 0x10000 being the full period.
+*/
+
+void hrtim_set_duty(uint8_t timer, uint8_t cmp, uint16_t duty)
+{
+	hrtim_set_compare(timer, cmp,
+			  (HRTIM_TIMER_PER(timer) * (uint32_t)duty) >> 16);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Select the events that set and reset an output.
+
+@param[in] timer HRTIM_TIMA..HRTIM_TIME.
+@param[in] output 1 or 2.
+@param[in] set HRTIM_TIMx_SETy_* events that drive the output active.
+@param[in] reset HRTIM_TIMx_RSTy_* events that drive it inactive.
+*/
+
+void hrtim_set_output(uint8_t timer, uint8_t output, uint32_t set,
+		      uint32_t reset)
+{
+	if (output == 1) {
+		HRTIM_TIMx_SET1(timer) = set;
+		HRTIM_TIMx_RST1(timer) = reset;
+	} else {
+		HRTIM_TIMx_SET2(timer) = set;
+		HRTIM_TIMx_RST2(timer) = reset;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Insert dead times between the two outputs of a timing unit.
+
+Output 2 becomes the complement of output 1, delayed by the rising edge
+dead time, and output 1 is delayed by the falling edge dead time. The
+finest dead time prescaler that fits both values is used.
+
+@param[in] timer HRTIM_TIMA..HRTIM_TIME.
+@param[in] rising_ps Dead time on the rising edge of output 1, in ps.
+@param[in] falling_ps Dead time on the falling edge of output 1, in ps.
+@returns 0 on success, -1 if a dead time is too long.
+*/
+
+int hrtim_set_deadtime(uint8_t timer, uint32_t rising_ps,
+		       uint32_t falling_ps)
+{
+	uint64_t dtg_khz = (uint64_t)hrtim_clk_hz * 8 / 1000;
+	uint32_t prsc;
+
+	for (prsc = 0; prsc < 8; prsc++) {
+		uint32_t r = (uint64_t)rising_ps * dtg_khz /
+			     (1000000000ULL << prsc);
+		uint32_t f = (uint64_t)falling_ps * dtg_khz /
+			     (1000000000ULL << prsc);
+
+		if (r > HRTIM_DT_MAX || f > HRTIM_DT_MAX) {
+			continue;
+		}
+
+		HRTIM_TIMx_DT(timer) = (f << HRTIM_TIMx_DT_DTFx_SHIFT) |
+				       (prsc << HRTIM_TIMx_DT_DTPRSC_SHIFT) |
+				       (r << HRTIM_TIMx_DT_DTRx_SHIFT);
+		HRTIM_TIMx_OUT(timer) |= HRTIM_TIMx_OUT_DTEN;
+		return 0;
+	}
+
+	return -1;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Start counters.
+
+@param[in] timers HRTIM_MCR_MCEN, HRTIM_MCR_TACEN..HRTIM_MCR_TECEN.
+*/
+
+void hrtim_counter_enable(uint32_t timers)
+{
+	HRTIM_MCR |= timers;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Stop counters.
+
+@param[in] timers HRTIM_MCR_MCEN, HRTIM_MCR_TACEN..HRTIM_MCR_TECEN.
+*/
+
+void hrtim_counter_disable(uint32_t timers)
+{
+	HRTIM_MCR &= ~timers;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Transfer preloaded registers to the active ones now.
+
+@param[in] timers HRTIM_CR2_MSWU, HRTIM_CR2_TASWU..HRTIM_CR2_TESWU.
+*/
+
+void hrtim_force_update(uint32_t timers)
+{
+	HRTIM_CR2 |= timers;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Enable outputs.
+
+Also re-arms outputs that were disabled by a fault once the fault is gone.
+
+@param[in] outputs HRTIM_OENR_TA1OEN..HRTIM_OENR_TE2OEN.
+*/
+
+void hrtim_output_enable(uint32_t outputs)
+{
+	HRTIM_OENR = outputs;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Disable outputs, they go to their idle level.
+
+@param[in] outputs HRTIM_OENR_TA1OEN..HRTIM_OENR_TE2OEN.
+*/
+
+void hrtim_output_disable(uint32_t outputs)
+{
+	HRTIM_ODISR = outputs;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Configure and enable a fault input.
+
+@param[in] fault Fault input, 1 to 5.
+@param[in] flags HRTIM_FAULT_POL_HIGH, HRTIM_FAULT_SRC_INTERNAL,
+HRTIM_FAULT_FILTER(n).
+*/
+
+void hrtim_fault_setup(uint8_t fault, uint8_t flags)
+{
+	uint32_t value = flags | HRTIM_FLTINR1_FLTxE(1);
+
+	if (fault == 5) {
+		HRTIM_FLTINR2 = (HRTIM_FLTINR2 & ~0xff) | value;
+	} else {
+		uint32_t shift = (fault - 1) * 8;
+
+		HRTIM_FLTINR1 = (HRTIM_FLTINR1 & ~(0xff << shift)) |
+				(value << shift);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Connect fault inputs to a timing unit.
+
+While one of the faults is active, both outputs of the unit are forced to
+@p state and disabled, they stay disabled until @ref hrtim_output_enable.
+
+@param[in] timer HRTIM_TIMA..HRTIM_TIME.
+@param[in] faults Bit n set for fault input n + 1.
+@param[in] state Output state on fault.
+*/
+
+void hrtim_timer_set_faults(uint8_t timer, uint8_t faults,
+			    enum hrtim_fault_state state)
+{
+	HRTIM_TIMx_FLT(timer) = faults;
+	HRTIM_TIMx_OUT(timer) = (HRTIM_TIMx_OUT(timer) &
+				 ~(HRTIM_TIMx_OUT_FAULT1_MASK |
+				   HRTIM_TIMx_OUT_FAULT2_MASK)) |
+				(state << HRTIM_TIMx_OUT_FAULT1_SHIFT) |
+				(state << HRTIM_TIMx_OUT_FAULT2_SHIFT);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Read and acknowledge the fault flags.
+
+@returns HRTIM_ISR_FLT1..HRTIM_ISR_FLT5 and HRTIM_ISR_SYSFLT.
+*/
+
+uint32_t hrtim_get_and_clear_faults(void)
+{
+	uint32_t flags = HRTIM_ISR & HRTIM_ISR_FAULTS;
+
+	HRTIM_ICR = flags;
+	return flags;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Select the events that trigger an ADC conversion.
+
+@param[in] trigger HRTIM ADC trigger output, 1 to 4.
+@param[in] sources Events, HRTIM_ADC1R_* for triggers 1 and 3, the
+HRTIM_ADC2R_* values for triggers 2 and 4.
+*/
+
+void hrtim_set_adc_trigger(uint8_t trigger, uint32_t sources)
+{
+	(&HRTIM_ADC1R)[trigger - 1] = sources;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Reload timer registers from a table on every repetition event.
+
+The repetition event of the timer requests a DMA burst to BDMADR. Each
+burst writes the next entry of the table to the selected registers, which
+are preloaded and transferred together once the burst is complete. The DMA
+channel runs in circular mode so the table is replayed without CPU load.
+
+An entry holds one word per selected register, in the order of the bits in
+@p registers from the lowest, e.g. PER, CMP1, CMP3 for HRTIM_BDTxUPR_TIMxPER
+| HRTIM_BDTxUPR_TIMxCMP1 | HRTIM_BDTxUPR_TIMxCMP3.
+
+@param[in] timer HRTIM_TIMA..HRTIM_TIME or HRTIM_MASTER.
+@param[in] registers HRTIM_BDTxUPR_* for a timing unit, HRTIM_BDMUPDR_* for
+the master.
+@param[in] dma DMA controller of the timer's burst DMA request.
+@param[in] channel DMA channel of the timer's burst DMA request.
+@param[in] table Table of entries, must stay valid while running.
+@param[in] periods Number of entries in the table.
+@returns 0 on success, -1 if the table is empty or too long for the DMA.
+*/
+
+int hrtim_burst_dma_setup(uint8_t timer, uint32_t registers, uint32_t dma,
+			  uint8_t channel, const uint32_t *table,
+			  uint16_t periods)
+{
+	struct dma_xfer_config cfg = {
+		.flags = DMA_XFER_MEM_TO_PERIPH | DMA_XFER_MINC |
+			 DMA_XFER_CIRCULAR | DMA_XFER_MSIZE_32BIT |
+			 DMA_XFER_PSIZE_32BIT | DMA_XFER_PL_VERY_HIGH,
+		.periph_addr = (uint32_t)&HRTIM_BDMADR,
+		.mem_addr = (uint32_t)table,
+	};
+	uint32_t words = 0;
+	uint32_t r;
+
+	for (r = registers; r; r &= r - 1) {
+		words++;
+	}
+	if (!words || !periods || words * periods > 0xffff) {
+		return -1;
+	}
+
+	cfg.count = words * periods;
+	dma_xfer_setup(dma, channel, &cfg);
+	dma_xfer_start(dma, channel);
+
+	if (timer == HRTIM_MASTER) {
+		HRTIM_BDMUPDR = registers;
+		HRTIM_MCR = (HRTIM_MCR & ~HRTIM_MCR_BRSTDMA_MASK) |
+			    HRTIM_MCR_BRSTDMA_COMPL | HRTIM_MCR_PREEN;
+		HRTIM_MDIER |= HRTIM_MDIER_MREPDE;
+	} else {
+		HRTIM_BDTxUPR(timer) = registers;
+		HRTIM_TIMx_TIMCR(timer) = (HRTIM_TIMx_TIMCR(timer) &
+					   ~HRTIM_TIMx_CR_UPDGAT_MASK) |
+					  HRTIM_TIMx_CR_UPDGAT_DMA |
+					  HRTIM_TIMx_CR_PREEN;
+		HRTIM_TIMx_DIER(timer) |= HRTIM_TIMx_DIER_REPDE;
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Stop the table updates started by @ref hrtim_burst_dma_setup.
+
+The registers keep the values of the last burst.
+
+@param[in] timer HRTIM_TIMA..HRTIM_TIME or HRTIM_MASTER.
+@param[in] dma DMA controller passed to @ref hrtim_burst_dma_setup.
+@param[in] channel DMA channel passed to @ref hrtim_burst_dma_setup.
+*/
+
+void hrtim_burst_dma_stop(uint8_t timer, uint32_t dma, uint8_t channel)
+{
+	if (timer == HRTIM_MASTER) {
+		HRTIM_MDIER &= ~HRTIM_MDIER_MREPDE;
+	} else {
+		HRTIM_TIMx_DIER(timer) &= ~HRTIM_TIMx_DIER_REPDE;
+	}
+	dma_xfer_stop(dma, channel);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Set up the burst mode controller.
+
+In burst mode the outputs of the selected timers are held idle for @p idle
+burst clock periods out of every @p period + 1, e.g. to skip switching
+cycles at light load. Both values are preloaded and may be changed while
+running.
+
+@param[in] clock HRTIM_BMCR_BMCLK_* burst mode clock.
+@param[in] prescaler HRTIM_BMCR_BMPRSC_*, only used with
+HRTIM_BMCR_BMCLK_HRTIM.
+@param[in] timers HRTIM_BMCR_MTBM, HRTIM_BMCR_TABM..HRTIM_BMCR_TEBM to stop
+the counters of these timers during the idle time, otherwise only their
+outputs are idle.
+@param[in] period Burst period in burst clock periods minus 1.
+@param[in] idle Idle duration in burst clock periods.
+*/
+
+void hrtim_burst_mode_setup(uint32_t clock, uint32_t prescaler,
+			    uint32_t timers, uint16_t period, uint16_t idle)
+{
+	HRTIM_BMCR = clock | prescaler | timers | HRTIM_BMCR_BMPREN |
+		     HRTIM_BMCR_BMOM;
+	HRTIM_BMPER = period;
+	HRTIM_BMCMPR6 = idle;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Enable the burst mode controller.
+
+@param[in] triggers HRTIM_BMTRGR_* events that start a burst,
+HRTIM_BMTRGR_SW starts one right away.
+*/
+
+void hrtim_burst_mode_start(uint32_t triggers)
+{
+	HRTIM_BMCR |= HRTIM_BMCR_BME;
+	HRTIM_BMTRGR = triggers;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Disable the burst mode controller, the outputs resume at once. */
+
+void hrtim_burst_mode_stop(void)
+{
+	HRTIM_BMCR &= ~HRTIM_BMCR_BME;
+}
+
+/**@}*/
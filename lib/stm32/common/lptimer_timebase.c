@@ -0,0 +1,362 @@
+/** @addtogroup lptimer_timebase_file LPTIM time base API
+@ingroup peripheral_apis
+
+@brief Monotonic 64-bit time base and wakeup alarm on a low power timer.
+
+Clocked from LSE (or LSI), the LPTIM keeps counting in Stop mode and can
+wake the part up, unlike SysTick. The 16-bit counter runs freely and is
+extended in software: every read adds the distance travelled since the
+previous read, and the autoreload match interrupt makes sure there is a
+read at least once per counter period.
+
+One alarm can be armed at any distance. Its low 16 bits are programmed into
+the compare register once it is less than a counter period away, and the
+compare interrupt calls the alarm callback. A tickless scheduler arms the
+alarm for its next deadline before entering Stop.
+
+On parts with a subsecond RTC, @ref lptimer_timebase_sync_rtc measures the
+offset between the time base and the calendar, so wall clock time can be
+derived from the time base without reading the RTC.
+
+The application selects and enables the LPTIM kernel clock, and routes the
+LPTIM interrupt (and its EXTI line, for wakeup from Stop) to @ref
+lptimer_timebase_irq_handler.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <stddef.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/stm32/lptimer_timebase.h>
+#if defined(STM32F4) || defined(STM32L0) || defined(STM32L4)
+#include <libopencm3/stm32/rtc.h>
+#endif
+
+static uint32_t lptb_timer;
+static uint32_t lptb_hz;
+/* Last extended counter value, advanced by every read */
+static uint64_t lptb_last;
+
+static bool lptb_armed;
+static uint64_t lptb_alarm;
+static lptimer_timebase_callback lptb_callback;
+static void *lptb_user_data;
+
+static int64_t lptb_rtc_offset;
+
+/* The counter runs asynchronously to the bus, a value is only reliable
+ * once two consecutive reads agree.
+ */
+static uint16_t lptb_read_counter(void)
+{
+	uint16_t a, b;
+
+	b = LPTIM_CNT(lptb_timer);
+	do {
+		a = b;
+		b = LPTIM_CNT(lptb_timer);
+	} while (a != b);
+
+	return b;
+}
+
+static uint64_t lptb_update(void)
+{
+	uint16_t cnt = lptb_read_counter();
+
+	lptb_last += (uint16_t)(cnt - (uint16_t)lptb_last);
+	return lptb_last;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Start the time base.
+
+Configures the timer for a free running 16-bit count on its internal
+(kernel) clock, with the autoreload and compare interrupts enabled. The
+count starts at 0.
+
+@param[in] lptim Low power timer register base, e.g. LPTIM1
+@param[in] clk_hz LPTIM kernel clock, e.g. 32768 for LSE.
+@param[in] prescaler LPTIM_CFGR_PRESC_xxx
+*/
+
+void lptimer_timebase_init(uint32_t lptim, uint32_t clk_hz,
+			   uint32_t prescaler)
+{
+	lptb_timer = lptim;
+	lptb_hz = clk_hz >> ((prescaler >> LPTIM_CFGR_PRESC_SHIFT) &
+			     LPTIM_CFGR_PRESC_MASK);
+	lptb_last = 0;
+	lptb_armed = false;
+	lptb_rtc_offset = 0;
+
+	/* CFGR and IER may only be written while the timer is disabled. */
+	lptimer_disable(lptim);
+	lptimer_set_internal_clock_source(lptim);
+	lptimer_set_prescaler(lptim, prescaler);
+	lptimer_disable_preload(lptim);
+	LPTIM_IER(lptim) = LPTIM_IER_ARRMIE | LPTIM_IER_CMPMIE;
+
+	/* ARR and CMP may only be written while it is enabled. */
+	lptimer_enable(lptim);
+	LPTIM_ICR(lptim) = LPTIM_ICR_ARROKCF | LPTIM_ICR_CMPOKCF;
+	lptimer_set_period(lptim, 0xffff);
+	while (!(LPTIM_ISR(lptim) & LPTIM_ISR_ARROK));
+	lptimer_set_compare(lptim, 0xffff);
+	while (!(LPTIM_ISR(lptim) & LPTIM_ISR_CMPOK));
+	LPTIM_ICR(lptim) = LPTIM_ICR_ARROKCF | LPTIM_ICR_CMPOKCF |
+			   LPTIM_ICR_ARRMCF | LPTIM_ICR_CMPMCF;
+
+	lptimer_start_counter(lptim, LPTIM_CR_CNTSTRT);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Tick rate of the time base.
+
+@returns Ticks per second.
+*/
+
+uint32_t lptimer_timebase_hz(void)
+{
+	return lptb_hz;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Current time.
+
+@returns Ticks since @ref lptimer_timebase_init.
+*/
+
+uint64_t lptimer_timebase_now(void)
+{
+	uint64_t now;
+
+	CM_ATOMIC_BLOCK() {
+		now = lptb_update();
+	}
+
+	return now;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Current time in microseconds.
+
+@returns Microseconds since @ref lptimer_timebase_init, with the
+resolution of one tick.
+*/
+
+uint64_t lptimer_timebase_now_us(void)
+{
+	return lptimer_timebase_now() * 1000000 / lptb_hz;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Convert a duration to ticks, rounding up.
+
+@param[in] us Duration in microseconds.
+@returns Duration in ticks.
+*/
+
+uint64_t lptimer_timebase_us_to_ticks(uint64_t us)
+{
+	return (us * lptb_hz + 999999) / 1000000;
+}
+
+/* Program the compare register, waiting for the previous write to have
+ * reached the timer clock domain.
+ */
+static void lptb_set_compare(uint16_t value)
+{
+	LPTIM_ICR(lptb_timer) = LPTIM_ICR_CMPOKCF;
+	lptimer_set_compare(lptb_timer, value);
+	while (!(LPTIM_ISR(lptb_timer) & LPTIM_ISR_CMPOK));
+}
+
+/* Arm the compare for the alarm if it is within one counter period. */
+static void lptb_program_alarm(uint64_t now)
+{
+	if (lptb_armed && lptb_alarm - now < 0x10000) {
+		lptb_set_compare(lptb_alarm & 0xffff);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Arm the alarm.
+
+Replaces a previously armed alarm. Programming the compare register takes
+a few timer clock cycles, so alarms less than @ref
+LPTIMER_TIMEBASE_MIN_DELTA ticks away are refused.
+
+@param[in] tick Time to expire at, see @ref lptimer_timebase_now.
+@param[in] callback Called from @ref lptimer_timebase_irq_handler.
+@param[in] user_data Passed to the callback.
+@returns 0 on success, -1 if the alarm time is already (nearly) due.
+*/
+
+int lptimer_timebase_set_alarm(uint64_t tick,
+			       lptimer_timebase_callback callback,
+			       void *user_data)
+{
+	int ret = 0;
+
+	CM_ATOMIC_BLOCK() {
+		uint64_t now = lptb_update();
+
+		if (tick < now + LPTIMER_TIMEBASE_MIN_DELTA) {
+			lptb_armed = false;
+			ret = -1;
+		} else {
+			lptb_alarm = tick;
+			lptb_callback = callback;
+			lptb_user_data = user_data;
+			lptb_armed = true;
+			lptb_program_alarm(now);
+		}
+	}
+
+	return ret;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Disarm the alarm.
+*/
+
+void lptimer_timebase_cancel_alarm(void)
+{
+	CM_ATOMIC_BLOCK() {
+		lptb_armed = false;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Service the LPTIM interrupt of the time base.
+
+Keeps the extended counter up to date, programs the compare register once
+the alarm comes within range and calls the alarm callback when it expires.
+*/
+
+void lptimer_timebase_irq_handler(void)
+{
+	uint32_t isr = LPTIM_ISR(lptb_timer);
+	lptimer_timebase_callback callback = NULL;
+	uint64_t now;
+
+	LPTIM_ICR(lptb_timer) = isr & (LPTIM_ISR_ARRM | LPTIM_ISR_CMPM);
+
+	CM_ATOMIC_BLOCK() {
+		now = lptb_update();
+		if (lptb_armed && now >= lptb_alarm) {
+			lptb_armed = false;
+			callback = lptb_callback;
+		} else if (isr & LPTIM_ISR_ARRM) {
+			lptb_program_alarm(now);
+		}
+	}
+
+	if (callback) {
+		callback(now, lptb_user_data);
+	}
+}
+
+#if defined(STM32F4) || defined(STM32L0) || defined(STM32L4)
+
+static uint32_t lptb_bcd(uint32_t reg, uint32_t tens_shift,
+			 uint32_t tens_mask, uint32_t units_shift)
+{
+	return ((reg >> tens_shift) & tens_mask) * 10 +
+	       ((reg >> units_shift) & 0xf);
+}
+
+/* RTC calendar in ticks since 2000-01-01 00:00:00 */
+static uint64_t lptb_rtc_ticks(void)
+{
+	static const uint16_t month_days[12] = {
+		0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
+	};
+	uint32_t ssr, tr, dr, prediv_s;
+	uint32_t year, month, day, hours, seconds, days;
+
+	/* Reading SSR locks TR and DR until DR has been read. */
+	ssr = RTC_SSR;
+	tr = RTC_TR;
+	dr = RTC_DR;
+	prediv_s = (RTC_PRER >> RTC_PRER_PREDIV_S_SHIFT) &
+		   RTC_PRER_PREDIV_S_MASK;
+
+	year = lptb_bcd(dr, RTC_DR_YT_SHIFT, RTC_DR_YT_MASK, RTC_DR_YU_SHIFT);
+	month = lptb_bcd(dr, RTC_DR_MT_SHIFT, RTC_DR_MT_MASK, RTC_DR_MU_SHIFT);
+	day = lptb_bcd(dr, RTC_DR_DT_SHIFT, RTC_DR_DT_MASK, RTC_DR_DU_SHIFT);
+	hours = lptb_bcd(tr, RTC_TR_HT_SHIFT, RTC_TR_HT_MASK, RTC_TR_HU_SHIFT);
+	if (RTC_CR & RTC_CR_FMT) {
+		hours %= 12;
+		if (tr & RTC_TR_PM) {
+			hours += 12;
+		}
+	}
+
+	days = year * 365 + (year + 3) / 4 + month_days[month - 1] + day - 1;
+	if (month > 2 && !(year % 4)) {
+		days++;
+	}
+	seconds = ((days * 24 + hours) * 60 +
+		   lptb_bcd(tr, RTC_TR_MNT_SHIFT, RTC_TR_MNT_MASK,
+			    RTC_TR_MNU_SHIFT)) * 60 +
+		  lptb_bcd(tr, RTC_TR_ST_SHIFT, RTC_TR_ST_MASK,
+			   RTC_TR_SU_SHIFT);
+
+	/* The subsecond counter counts down from PREDIV_S. */
+	return (uint64_t)seconds * lptb_hz +
+	       (uint64_t)(prediv_s - ssr) * lptb_hz / (prediv_s + 1);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Measure the offset between the RTC and the time base.
+
+Call after @ref lptimer_timebase_init, and again from time to time if the
+two are clocked from different oscillators, to correct drift. The tick
+count itself is never changed, so it stays monotonic. The RTC must be
+running with shadow registers enabled (BYPSHAD cleared).
+*/
+
+void lptimer_timebase_sync_rtc(void)
+{
+	CM_ATOMIC_BLOCK() {
+		uint64_t now = lptb_update();
+
+		lptb_rtc_offset = (int64_t)(lptb_rtc_ticks() - now);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Wall clock time derived from the time base.
+
+@returns Ticks since 2000-01-01 00:00:00 in RTC time, as of the last @ref
+lptimer_timebase_sync_rtc.
+*/
+
+uint64_t lptimer_timebase_rtc_now(void)
+{
+	return lptimer_timebase_now() + lptb_rtc_offset;
+}
+
+#endif
+
+/**@}*/
@@ -12,6 +12,11 @@
  * This library supports the LCD controller (LTDC) in the STM32F4xx and
  * STM32F7xx series of ARM Cortex Microcontrollers by ST Microelectronics.
  *
+ * Layer registers are shadowed: changes made with @ref ltdc_layer_setup and
+ * friends take effect on the next reload, see ltdc_reload(). Reloading with
+ * LTDC_SRCR_VBR applies them during vertical blanking, which is what @ref
+ * ltdc_swapchain_present uses to flip framebuffers without tearing.
+ *
  * LGPL License Terms @ref lgpl_license
  */
 
@@ -37,6 +42,10 @@
 /**@{*/
 
 #include <libopencm3/stm32/common/ltdc_common_f47.h>
+#include <libopencm3/cm3/cortex.h>
+
+static ltdc_callback ltdc_cb;
+static void *ltdc_cb_data;
 
 void ltdc_set_tft_sync_timings(uint16_t sync_width,    uint16_t sync_height,
 			       uint16_t h_back_porch,  uint16_t v_back_porch,
@@ -83,5 +92,293 @@ void ltdc_setup_windowing(uint8_t  layer_number,
 				     (v_back_porch << 0);
 }
 
-/**@}*/
+/*---------------------------------------------------------------------------*/
+/** @brief Bytes per pixel of a layer pixel format.
+
+@param[in] format Pixel format, LTDC_LxPFCR_xxx
+@returns Size of a pixel in bytes.
+*/
+
+uint8_t ltdc_pixel_size(uint32_t format)
+{
+	switch (format) {
+	case LTDC_LxPFCR_ARGB8888:
+		return 4;
+	case LTDC_LxPFCR_RGB888:
+		return 3;
+	case LTDC_LxPFCR_L8:
+	case LTDC_LxPFCR_AL44:
+		return 1;
+	default:
+		return 2;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Configure and enable a layer.
+
+Sets the window, framebuffer, pixel format, constant alpha, blending factors
+and default color of a layer. The window is placed relative to the active
+area, so the sync timings must have been set with @ref
+ltdc_set_tft_sync_timings before. The new settings only take effect after a
+reload, see ltdc_reload().
+
+@param[in] layer LTDC_LAYER_1 or LTDC_LAYER_2
+@param[in] cfg Layer configuration.
+*/
+
+void ltdc_layer_setup(uint32_t layer, const struct ltdc_layer_config *cfg)
+{
+	uint32_t hstart = ((LTDC_BPCR >> LTDC_BPCR_AHBP_SHIFT) &
+			   LTDC_BPCR_AHBP_MASK) + 1 + cfg->x;
+	uint32_t vstart = ((LTDC_BPCR >> LTDC_BPCR_AVBP_SHIFT) &
+			   LTDC_BPCR_AVBP_MASK) + 1 + cfg->y;
+	uint32_t line = cfg->width * ltdc_pixel_size(cfg->format);
+	uint32_t pitch = cfg->pitch ? cfg->pitch : line;
+
+	LTDC_LxWHPCR(layer) = ((hstart + cfg->width - 1) <<
+			       LTDC_LxWHPCR_WHSPPOS_SHIFT) |
+			      (hstart << LTDC_LxWHPCR_WHSTPOS_SHIFT);
+	LTDC_LxWVPCR(layer) = ((vstart + cfg->height - 1) <<
+			       LTDC_LxWVPCR_WVSPPOS_SHIFT) |
+			      (vstart << LTDC_LxWVPCR_WVSTPOS_SHIFT);
+
+	ltdc_set_pixel_format(layer, cfg->format);
+	ltdc_set_constant_alpha(layer, cfg->alpha);
+	ltdc_set_blending_factors(layer, cfg->bf1, cfg->bf2);
+	LTDC_LxDCCR(layer) = cfg->default_color;
+
+	ltdc_set_fbuffer_address(layer, cfg->fb_addr);
+	/* The line length includes 3 extra bytes for the FIFO. */
+	ltdc_set_fb_line_length(layer, line + 3, pitch);
+	ltdc_set_fb_line_count(layer, cfg->height);
+
+	ltdc_layer_ctrl_enable(layer, LTDC_LxCR_LAYER_ENABLE);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Load the color lookup table of a layer and enable it.
+
+The CLUT may only be written while the layer is disabled or during vertical
+blanking. It is used by the L8, AL44 and AL88 pixel formats.
+
+@param[in] layer LTDC_LAYER_1 or LTDC_LAYER_2
+@param[in] clut RGB888 colors, in the low 24 bits of each entry.
+@param[in] entries Number of colors, up to 256.
+*/
+
+void ltdc_layer_load_clut(uint32_t layer, const uint32_t *clut,
+			  uint16_t entries)
+{
+	uint16_t i;
+
+	for (i = 0; i < entries && i < 256; i++) {
+		LTDC_LxCLUTWR(layer) = ((uint32_t)i <<
+					LTDC_LxCLUTWR_CLUTADD_SHIFT) |
+				       (clut[i] & 0xffffff);
+	}
+	ltdc_layer_ctrl_enable(layer, LTDC_LxCR_COLTAB_ENABLE);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Set the line interrupt position.
+
+@param[in] line Line to interrupt at, relative to the first line of the
+active area. Positions past the active area fall into the vertical front
+porch, e.g. the active height to get an interrupt right after the last
+visible line.
+*/
+
+void ltdc_set_line_interrupt(uint16_t line)
+{
+	uint32_t avbp = (LTDC_BPCR >> LTDC_BPCR_AVBP_SHIFT) &
+			LTDC_BPCR_AVBP_MASK;
+
+	LTDC_LIPCR = (avbp + 1 + line) & LTDC_LIPCR_LIPOS_MASK;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Set the interrupt callback.
+
+@param[in] callback Called from @ref ltdc_irq_handler, or NULL.
+@param[in] user_data Passed to the callback.
+@param[in] interrupts LTDC_IER_xxx interrupts to enable. LTDC_IER_RRIE
+signals that a reload, e.g. a framebuffer flip, has taken effect, and
+LTDC_IER_LIE reaches the line set by @ref ltdc_set_line_interrupt.
+*/
 
+void ltdc_set_callback(ltdc_callback callback, void *user_data,
+		       uint32_t interrupts)
+{
+	CM_ATOMIC_BLOCK() {
+		ltdc_cb = callback;
+		ltdc_cb_data = user_data;
+	}
+	LTDC_ICR = LTDC_ICR_CRRIF | LTDC_ICR_CTERRIF | LTDC_ICR_CFUIF |
+		   LTDC_ICR_CLIF;
+	LTDC_IER = interrupts;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Service the LTDC interrupts.
+
+Call this from both the LTDC and the LTDC error interrupt.
+*/
+
+void ltdc_irq_handler(void)
+{
+	uint32_t events = LTDC_ISR & LTDC_IER;
+
+	LTDC_ICR = events;
+	if (events && ltdc_cb) {
+		ltdc_cb(events, ltdc_cb_data);
+	}
+}
+
+/* Account for a flip once the hardware has performed the reload. */
+static void ltdc_swapchain_retire(struct ltdc_swapchain *sc)
+{
+	if (sc->pending != sc->count && !(LTDC_SRCR & LTDC_SRCR_VBR)) {
+		sc->front = sc->pending;
+		sc->pending = sc->count;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Initialise a swap chain.
+
+The first buffer becomes the front buffer and is latched at the next
+vertical blanking. With two buffers, drawing has to wait for every flip to
+complete, with three the next frame can be drawn while a flip is pending.
+
+@param[out] sc Swap chain to initialise.
+@param[in] layer LTDC_LAYER_1 or LTDC_LAYER_2, set up with @ref
+ltdc_layer_setup.
+@param[in] buffers Framebuffer addresses, all with the layout of the layer.
+@param[in] count Number of buffers, 2 or 3.
+*/
+
+void ltdc_swapchain_init(struct ltdc_swapchain *sc, uint32_t layer,
+			 const uint32_t *buffers, uint8_t count)
+{
+	uint8_t i;
+
+	if (count > LTDC_SWAPCHAIN_MAX) {
+		count = LTDC_SWAPCHAIN_MAX;
+	}
+
+	sc->layer = layer;
+	sc->count = count;
+	for (i = 0; i < count; i++) {
+		sc->buffers[i] = buffers[i];
+	}
+	sc->front = 0;
+	sc->pending = count;
+	sc->back = count;
+
+	ltdc_set_fbuffer_address(layer, buffers[0]);
+	ltdc_reload(LTDC_SRCR_VBR);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Get a buffer to draw the next frame into.
+
+@param[in] sc Swap chain.
+@returns Address of a buffer that is neither scanned out nor waiting to be,
+the same one until it is presented, or 0 if all buffers are in use. In that
+case, wait for the pending flip and try again.
+*/
+
+uint32_t ltdc_swapchain_acquire(struct ltdc_swapchain *sc)
+{
+	uint32_t addr = 0;
+	uint8_t i;
+
+	CM_ATOMIC_BLOCK() {
+		ltdc_swapchain_retire(sc);
+		if (sc->back == sc->count) {
+			for (i = 0; i < sc->count; i++) {
+				if (i != sc->front && i != sc->pending) {
+					sc->back = i;
+					break;
+				}
+			}
+		}
+		if (sc->back != sc->count) {
+			addr = sc->buffers[sc->back];
+		}
+	}
+
+	return addr;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Present the acquired buffer.
+
+The buffer is latched to replace the front buffer at the next vertical
+blanking, so the frame is never shown partially. Only one flip can be
+pending at a time.
+
+@param[in] sc Swap chain.
+@returns 0 on success, -1 if no buffer was acquired or a flip is still
+pending.
+*/
+
+int ltdc_swapchain_present(struct ltdc_swapchain *sc)
+{
+	int ret = -1;
+
+	CM_ATOMIC_BLOCK() {
+		ltdc_swapchain_retire(sc);
+		if (sc->back != sc->count && sc->pending == sc->count) {
+			ltdc_set_fbuffer_address(sc->layer,
+						 sc->buffers[sc->back]);
+			ltdc_reload(LTDC_SRCR_VBR);
+			sc->pending = sc->back;
+			sc->back = sc->count;
+			ret = 0;
+		}
+	}
+
+	return ret;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Check for a pending flip.
+
+@param[in] sc Swap chain.
+@returns true until the presented buffer has become the front buffer.
+*/
+
+bool ltdc_swapchain_pending(struct ltdc_swapchain *sc)
+{
+	bool pending;
+
+	CM_ATOMIC_BLOCK() {
+		ltdc_swapchain_retire(sc);
+		pending = sc->pending != sc->count;
+	}
+
+	return pending;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Get the buffer being scanned out.
+
+@param[in] sc Swap chain.
+@returns Address of the front buffer.
+*/
+
+uint32_t ltdc_swapchain_front(struct ltdc_swapchain *sc)
+{
+	uint32_t addr;
+
+	CM_ATOMIC_BLOCK() {
+		ltdc_swapchain_retire(sc);
+		addr = sc->buffers[sc->front];
+	}
+
+	return addr;
+}
+
+/**@}*/
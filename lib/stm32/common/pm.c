@@ -0,0 +1,325 @@
+/** @addtogroup pm_file Power mode manager API
+@ingroup peripheral_apis
+
+@brief Picks the deepest low power mode that is safe to enter when idle.
+
+Drivers that cannot work in a mode block it, e.g. a running USB stack
+blocks Stop, which implies every deeper mode. Standby loses the contents of
+SRAM and is therefore blocked until the application unblocks it.
+
+Each mode has a wakeup latency: the hardware part from the datasheet, plus
+the time measured for restoring the clocks after Stop. Stop and Standby
+start out with the typical datasheet values of the family, so that they are
+not entered for idle periods shorter than their wakeup before the first
+measurement; the application may set the exact values of its part. The
+idle hook is told how long the system may sleep, usually until the next
+timer deadline, and enters the deepest unblocked mode that wakes up in
+time.
+
+Typical idle loop, with interrupts disabled so that a wakeup interrupt is
+only serviced once the clocks are back:
+
+@code
+	cm_disable_interrupts();
+	if (!work_pending()) {
+		pm_idle(next_deadline_us());
+	}
+	cm_enable_interrupts();
+@endcode
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <libopencm3/cm3/assert.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/scb.h>
+#include <libopencm3/stm32/pm.h>
+#include <libopencm3/stm32/pwr.h>
+#include <libopencm3/stm32/rcc.h>
+
+/* SW and SWS are 2-bit fields at the same place on all these families */
+#define PM_RCC_CFGR_SW_MASK	3
+
+/* Typical wakeup from Stop with the main and the low power regulator, and
+ * from Standby until the reset vector runs, from the datasheets, rounded up.
+ * L0 and L1 take the slow Standby case, ULP set with FWU cleared.
+ */
+#if defined(STM32F0)
+#define PM_STOP_WAKEUP_US	4
+#define PM_STOP_LP_WAKEUP_US	6
+#define PM_STANDBY_WAKEUP_US	60
+#elif defined(STM32F1)
+#define PM_STOP_WAKEUP_US	4
+#define PM_STOP_LP_WAKEUP_US	6
+#define PM_STANDBY_WAKEUP_US	50
+#elif defined(STM32F3)
+#define PM_STOP_WAKEUP_US	5
+#define PM_STOP_LP_WAKEUP_US	7
+#define PM_STANDBY_WAKEUP_US	50
+#elif defined(STM32F4)
+#define PM_STOP_WAKEUP_US	14
+#define PM_STOP_LP_WAKEUP_US	105
+#define PM_STANDBY_WAKEUP_US	320
+#elif defined(STM32L0)
+#define PM_STOP_WAKEUP_US	5
+#define PM_STOP_LP_WAKEUP_US	8
+#define PM_STANDBY_WAKEUP_US	2200
+#elif defined(STM32L1)
+#define PM_STOP_WAKEUP_US	9
+#define PM_STOP_LP_WAKEUP_US	9
+#define PM_STANDBY_WAKEUP_US	2500
+#else
+#error "pm.c not available for this family."
+#endif
+
+static const struct pm_config *pm_config;
+static uint32_t pm_blocks[PM_MODE_COUNT] = {
+	[PM_MODE_STANDBY] = 1,
+};
+static uint32_t pm_latency_us[PM_MODE_COUNT] = {
+	[PM_MODE_STOP] = PM_STOP_WAKEUP_US,
+	[PM_MODE_STANDBY] = PM_STANDBY_WAKEUP_US,
+};
+static uint32_t pm_restore_us[PM_MODE_COUNT];
+static uint32_t pm_entries[PM_MODE_COUNT];
+
+/*---------------------------------------------------------------------------*/
+/** @brief Set up the power mode manager.
+
+Also resets the Stop wakeup latency to the datasheet value for the
+regulator mode chosen in @p config, and the Standby one to the datasheet
+value of the family.
+
+@param[in] config Application hooks, may be NULL. Must stay valid.
+*/
+
+void pm_init(const struct pm_config *config)
+{
+	pm_config = config;
+	pm_latency_us[PM_MODE_STOP] =
+		(config && config->stop_lp_regulator) ?
+		PM_STOP_LP_WAKEUP_US : PM_STOP_WAKEUP_US;
+	pm_latency_us[PM_MODE_STANDBY] = PM_STANDBY_WAKEUP_US;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Set the hardware wakeup latency of a mode.
+
+@param[in] mode Low power mode.
+@param[in] us Time from the wakeup event until code runs again, from the
+datasheet, not including restoring the clocks. Call after @ref pm_init.
+*/
+
+void pm_set_wakeup_latency(enum pm_mode mode, uint32_t us)
+{
+	pm_latency_us[mode] = us;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Get the wakeup latency of a mode.
+
+@param[in] mode Low power mode.
+@returns The hardware latency plus the longest clock restore time measured
+so far, in microseconds.
+*/
+
+uint32_t pm_get_wakeup_latency(enum pm_mode mode)
+{
+	return pm_latency_us[mode] + pm_restore_us[mode];
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Forbid a mode and all deeper ones.
+
+Calls nest, every call must be balanced by @ref pm_unblock.
+
+@param[in] mode Shallowest mode that must not be entered.
+*/
+
+void pm_block(enum pm_mode mode)
+{
+	CM_ATOMIC_BLOCK() {
+		cm3_assert(pm_blocks[mode] != UINT32_MAX);
+		pm_blocks[mode]++;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Release a constraint set by @ref pm_block.
+
+@param[in] mode Mode passed to @ref pm_block.
+*/
+
+void pm_unblock(enum pm_mode mode)
+{
+	CM_ATOMIC_BLOCK() {
+		if (pm_blocks[mode]) {
+			pm_blocks[mode]--;
+		}
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Choose the mode for an idle period.
+
+@param[in] idle_us Time until the system has to be running again.
+@returns The deepest unblocked mode that wakes up within @p idle_us,
+PM_MODE_RUN if there is none.
+*/
+
+enum pm_mode pm_select(uint32_t idle_us)
+{
+	enum pm_mode mode = PM_MODE_RUN;
+	int i;
+
+	for (i = PM_MODE_SLEEP; i < PM_MODE_COUNT; i++) {
+		if (pm_blocks[i]) {
+			break;
+		}
+		if (pm_get_wakeup_latency(i) <= idle_us) {
+			mode = i;
+		}
+	}
+
+	return mode;
+}
+
+static uint32_t pm_now_us(void)
+{
+	return (pm_config && pm_config->now_us) ? pm_config->now_us() : 0;
+}
+
+static void pm_wait_for_interrupt(void)
+{
+	__asm__ volatile ("wfi");
+}
+
+/* Bring back the oscillators and system clock that were in use before
+ * Stop, which always wakes up on the internal oscillator.
+ */
+static void pm_restore_clocks(uint32_t cr, uint32_t cfgr)
+{
+	uint32_t sw = (cfgr >> RCC_CFGR_SW_SHIFT) & PM_RCC_CFGR_SW_MASK;
+
+	if (cr & RCC_CR_HSEON) {
+		rcc_osc_on(RCC_HSE);
+		rcc_wait_for_osc_ready(RCC_HSE);
+	}
+	if (cr & RCC_CR_PLLON) {
+		rcc_osc_on(RCC_PLL);
+		rcc_wait_for_osc_ready(RCC_PLL);
+	}
+
+	RCC_CFGR = (RCC_CFGR & ~(PM_RCC_CFGR_SW_MASK << RCC_CFGR_SW_SHIFT)) |
+		   (sw << RCC_CFGR_SW_SHIFT);
+	while (((RCC_CFGR >> RCC_CFGR_SWS_SHIFT) & PM_RCC_CFGR_SW_MASK) != sw);
+}
+
+static void pm_enter_stop(void)
+{
+	uint32_t cr = RCC_CR;
+	uint32_t cfgr = RCC_CFGR;
+	uint32_t start;
+
+	pwr_set_stop_mode();
+	if (pm_config && pm_config->stop_lp_regulator) {
+		pwr_voltage_regulator_low_power_in_stop();
+	} else {
+		pwr_voltage_regulator_on_in_stop();
+	}
+
+	SCB_SCR |= SCB_SCR_SLEEPDEEP;
+	pm_wait_for_interrupt();
+	SCB_SCR &= ~SCB_SCR_SLEEPDEEP;
+
+	start = pm_now_us();
+	pm_restore_clocks(cr, cfgr);
+	if (pm_config && pm_config->now_us) {
+		uint32_t us = pm_now_us() - start;
+
+		if (us > pm_restore_us[PM_MODE_STOP]) {
+			pm_restore_us[PM_MODE_STOP] = us;
+		}
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Idle until the next interrupt in the deepest suitable mode.
+
+Must be called with interrupts disabled (PRIMASK set): a pending interrupt
+still wakes the core, but is serviced only once the clocks are restored and
+interrupts are enabled again by the caller. Standby only returns if it was
+aborted by a pending wakeup event.
+
+@param[in] idle_us Time until the system has to be running again, e.g. the
+next timer deadline.
+@returns The mode that was used.
+*/
+
+enum pm_mode pm_idle(uint32_t idle_us)
+{
+	enum pm_mode mode = pm_select(idle_us);
+
+	if (mode == PM_MODE_RUN) {
+		return mode;
+	}
+
+	if (pm_config && pm_config->suspend) {
+		pm_config->suspend(mode, idle_us);
+	}
+
+	switch (mode) {
+	case PM_MODE_STOP:
+		pm_enter_stop();
+		break;
+	case PM_MODE_STANDBY:
+		pwr_clear_wakeup_flag();
+		pwr_set_standby_mode();
+		SCB_SCR |= SCB_SCR_SLEEPDEEP;
+		pm_wait_for_interrupt();
+		SCB_SCR &= ~SCB_SCR_SLEEPDEEP;
+		break;
+	default:
+		pm_wait_for_interrupt();
+		break;
+	}
+
+	pm_entries[mode]++;
+	if (pm_config && pm_config->resume) {
+		pm_config->resume(mode);
+	}
+
+	return mode;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Number of times a mode was entered.
+
+@param[in] mode Low power mode.
+@returns Entries since reset.
+*/
+
+uint32_t pm_get_entries(enum pm_mode mode)
+{
+	return pm_entries[mode];
+}
+
+/**@}*/
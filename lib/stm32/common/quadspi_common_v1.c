@@ -1,5 +1,13 @@
-
+#include <string.h>
 #include <libopencm3/stm32/quadspi.h>
+#if defined(QUADSPI_CR_DMAEN)
+#include <libopencm3/stm32/dma_xfer.h>
+#endif
+
+#define QUADSPI_FIFO_SIZE	32
+
+#define QUADSPI_FCR_ALL		(QUADSPI_FCR_CTOF | QUADSPI_FCR_CSMF | \
+				 QUADSPI_FCR_CTCF | QUADSPI_FCR_CTEF)
 
 void quadspi_enable(void)
 {
@@ -9,4 +17,343 @@ void quadspi_enable(void)
 void quadspi_disable(void)
 {
 	QUADSPI_CR &= ~QUADSPI_CR_EN;
-}
\ No newline at end of file
+}
+
+void quadspi_setup(uint8_t prescaler, uint8_t flash_size_log2,
+		   uint8_t cs_high_cycles, bool clock_mode3, bool sample_shift)
+{
+	uint32_t reg32;
+
+	reg32 = QUADSPI_CR & ~((QUADSPI_CR_PRESCALE_MASK <<
+				QUADSPI_CR_PRESCALE_SHIFT) | QUADSPI_CR_SSHIFT);
+	reg32 |= (uint32_t)prescaler << QUADSPI_CR_PRESCALE_SHIFT;
+	if (sample_shift) {
+		reg32 |= QUADSPI_CR_SSHIFT;
+	}
+	QUADSPI_CR = reg32;
+
+	reg32 = ((flash_size_log2 - 1) & QUADSPI_DCR_FSIZE_MASK) <<
+		QUADSPI_DCR_FSIZE_SHIFT;
+	reg32 |= ((cs_high_cycles - 1) & QUADSPI_DCR_CSHT_MASK) <<
+		 QUADSPI_DCR_CSHT_SHIFT;
+	if (clock_mode3) {
+		reg32 |= QUADSPI_DCR_CKMODE;
+	}
+	QUADSPI_DCR = reg32;
+}
+
+void quadspi_abort(void)
+{
+	QUADSPI_CR |= QUADSPI_CR_ABORT;
+	while (QUADSPI_CR & QUADSPI_CR_ABORT);
+}
+
+bool quadspi_busy(void)
+{
+	return QUADSPI_SR & QUADSPI_SR_BUSY;
+}
+
+/*
+ * Program a command. Depending on its phases, it starts when CCR is written
+ * (no address, no data), when AR is written, or for indirect writes without
+ * address, when the first data reaches the FIFO.
+ */
+static void quadspi_start(const struct quadspi_command *cmd, uint32_t fmode,
+			  uint32_t len)
+{
+	uint32_t ccr;
+
+	while (QUADSPI_SR & QUADSPI_SR_BUSY);
+	QUADSPI_FCR = QUADSPI_FCR_ALL;
+
+	ccr = (fmode << QUADSPI_CCR_FMODE_SHIFT) |
+	      ((uint32_t)cmd->instruction << QUADSPI_CCR_INST_SHIFT) |
+	      ((uint32_t)cmd->instruction_mode << QUADSPI_CCR_IMODE_SHIFT) |
+	      ((uint32_t)cmd->address_mode << QUADSPI_CCR_ADMODE_SHIFT) |
+	      ((uint32_t)cmd->alternate_mode << QUADSPI_CCR_ABMODE_SHIFT) |
+	      (((uint32_t)cmd->dummy_cycles & QUADSPI_CCR_DCYC_MASK) <<
+	       QUADSPI_CCR_DCYC_SHIFT);
+	if (cmd->address_mode != QUADSPI_CCR_MODE_NONE) {
+		ccr |= ((uint32_t)(cmd->address_size - 1) &
+			QUADSPI_CCR_ADSIZE_MASK) << QUADSPI_CCR_ADSIZE_SHIFT;
+	}
+	if (cmd->alternate_mode != QUADSPI_CCR_MODE_NONE) {
+		ccr |= ((uint32_t)(cmd->alternate_size - 1) &
+			QUADSPI_CCR_ABSIZE_MASK) << QUADSPI_CCR_ABSIZE_SHIFT;
+		QUADSPI_ABR = cmd->alternate;
+	}
+	/* The data phase of memory-mapped reads is sized by the bus access. */
+	if (len || fmode == QUADSPI_CCR_FMODE_MEMMAP) {
+		ccr |= (uint32_t)cmd->data_mode << QUADSPI_CCR_DMODE_SHIFT;
+	}
+	if (len) {
+		QUADSPI_DLR = len - 1;
+	}
+	if (cmd->flags & QUADSPI_CMD_DDR) {
+		ccr |= QUADSPI_CCR_DDRM;
+	}
+	if (cmd->flags & QUADSPI_CMD_SIOO) {
+		ccr |= QUADSPI_CCR_SIOO;
+	}
+
+	QUADSPI_CCR = ccr;
+	if (cmd->address_mode != QUADSPI_CCR_MODE_NONE &&
+	    fmode != QUADSPI_CCR_FMODE_MEMMAP) {
+		QUADSPI_AR = cmd->address;
+	}
+}
+
+/* Wait for the end of an indirect command and acknowledge it. */
+static int quadspi_finish(void)
+{
+	uint32_t sr;
+
+	do {
+		sr = QUADSPI_SR;
+	} while (!(sr & (QUADSPI_SR_TCF | QUADSPI_SR_TEF)));
+	QUADSPI_FCR = QUADSPI_FCR_CTCF | QUADSPI_FCR_CTEF;
+
+	return (sr & QUADSPI_SR_TEF) ? -1 : 0;
+}
+
+static uint32_t quadspi_fifo_level(void)
+{
+	return (QUADSPI_SR >> QUADSPI_SR_FLEVEL_SHIFT) & QUADSPI_SR_FLEVEL_MASK;
+}
+
+int quadspi_command(const struct quadspi_command *cmd)
+{
+	quadspi_start(cmd, QUADSPI_CCR_FMODE_IWRITE, 0);
+	return quadspi_finish();
+}
+
+int quadspi_read(const struct quadspi_command *cmd, void *data, uint32_t len)
+{
+	uint8_t *p = data;
+
+	quadspi_start(cmd, QUADSPI_CCR_FMODE_IREAD, len);
+
+	while (len) {
+		uint32_t level = quadspi_fifo_level();
+
+		if (level >= 4 && len >= 4) {
+			uint32_t word = QUADSPI_DR;
+
+			memcpy(p, &word, 4);
+			p += 4;
+			len -= 4;
+		} else if (level) {
+			*p++ = QUADSPI_BYTE_DR;
+			len--;
+		} else if (QUADSPI_SR & QUADSPI_SR_TEF) {
+			break;
+		}
+	}
+
+	return quadspi_finish();
+}
+
+int quadspi_write(const struct quadspi_command *cmd, const void *data,
+		  uint32_t len)
+{
+	const uint8_t *p = data;
+
+	quadspi_start(cmd, QUADSPI_CCR_FMODE_IWRITE, len);
+
+	while (len) {
+		uint32_t level = quadspi_fifo_level();
+
+		if (level <= QUADSPI_FIFO_SIZE - 4 && len >= 4) {
+			uint32_t word;
+
+			memcpy(&word, p, 4);
+			QUADSPI_DR = word;
+			p += 4;
+			len -= 4;
+		} else if (level < QUADSPI_FIFO_SIZE) {
+			QUADSPI_BYTE_DR = *p++;
+			len--;
+		} else if (QUADSPI_SR & QUADSPI_SR_TEF) {
+			break;
+		}
+	}
+
+	return quadspi_finish();
+}
+
+int quadspi_auto_poll(const struct quadspi_command *cmd, uint8_t size,
+		      uint32_t match, uint32_t mask, uint16_t interval,
+		      uint32_t timeout)
+{
+	uint32_t sr;
+
+	while (QUADSPI_SR & QUADSPI_SR_BUSY);
+	QUADSPI_PSMKR = mask;
+	QUADSPI_PSMAR = match;
+	QUADSPI_PIR = interval;
+	QUADSPI_CR = (QUADSPI_CR & ~QUADSPI_CR_PMM) | QUADSPI_CR_APMS;
+
+	quadspi_start(cmd, QUADSPI_CCR_FMODE_APOLL, size);
+
+	do {
+		sr = QUADSPI_SR;
+		if (sr & (QUADSPI_SR_SMF | QUADSPI_SR_TEF)) {
+			break;
+		}
+	} while (!timeout || --timeout);
+
+	if (!(sr & QUADSPI_SR_SMF)) {
+		quadspi_abort();
+		QUADSPI_FCR = QUADSPI_FCR_ALL;
+		return -1;
+	}
+
+	QUADSPI_FCR = QUADSPI_FCR_CSMF | QUADSPI_FCR_CTCF;
+	return 0;
+}
+
+void quadspi_memory_mapped(const struct quadspi_command *cmd,
+			   uint16_t timeout)
+{
+	while (QUADSPI_SR & QUADSPI_SR_BUSY);
+	if (timeout) {
+		QUADSPI_LPTR = timeout;
+		QUADSPI_CR |= QUADSPI_CR_TCEN;
+	} else {
+		QUADSPI_CR &= ~QUADSPI_CR_TCEN;
+	}
+
+	quadspi_start(cmd, QUADSPI_CCR_FMODE_MEMMAP, 0);
+}
+
+#if defined(QUADSPI_CR_DMAEN)
+
+static uint32_t quadspi_dma;
+static uint8_t quadspi_dma_channel;
+static uint8_t quadspi_dma_request;
+static quadspi_callback quadspi_cb;
+static void *quadspi_cb_data;
+
+static void quadspi_set_fifo_threshold(uint8_t bytes)
+{
+	QUADSPI_CR = (QUADSPI_CR & ~(QUADSPI_CR_FTHRES_MASK <<
+				     QUADSPI_CR_FTHRES_SHIFT)) |
+		     ((uint32_t)(bytes - 1) << QUADSPI_CR_FTHRES_SHIFT);
+}
+
+void quadspi_dma_init(uint32_t dma, uint8_t channel, uint8_t request)
+{
+	quadspi_dma = dma;
+	quadspi_dma_channel = channel;
+	quadspi_dma_request = request;
+}
+
+/* End a DMA transfer, reads once the DMA has stored the last byte, writes
+ * once the command is complete, both early on a transfer error.
+ */
+static void quadspi_dma_finish(bool error)
+{
+	QUADSPI_CR &= ~(QUADSPI_CR_TCIE | QUADSPI_CR_TEIE | QUADSPI_CR_DMAEN);
+	QUADSPI_FCR = QUADSPI_FCR_CTCF | QUADSPI_FCR_CTEF;
+	dma_xfer_stop(quadspi_dma, quadspi_dma_channel);
+	if (error && (QUADSPI_SR & QUADSPI_SR_BUSY)) {
+		/* A failed DMA leaves the command waiting on the FIFO. */
+		quadspi_abort();
+	}
+
+	if (quadspi_cb) {
+		quadspi_cb(error, quadspi_cb_data);
+	}
+}
+
+/* TCF of a read only means the FIFO holds the last byte, the read is done
+ * when the DMA has drained it.
+ */
+static void quadspi_dma_read_done(uint32_t dma, uint8_t channel,
+				  uint32_t events, void *user_data)
+{
+	(void)dma;
+	(void)channel;
+	(void)user_data;
+
+	if (events & (DMA_XFER_EVENT_COMPLETE | DMA_XFER_EVENT_ERROR)) {
+		quadspi_dma_finish(events & DMA_XFER_EVENT_ERROR);
+	}
+}
+
+static int quadspi_dma_start(const struct quadspi_command *cmd,
+			     uint32_t fmode, uint32_t addr, uint32_t len,
+			     quadspi_callback callback, void *user_data)
+{
+	bool read = fmode == QUADSPI_CCR_FMODE_IREAD;
+	struct dma_xfer_config cfg = {
+		.periph_addr = (uint32_t)&QUADSPI_DR,
+		.mem_addr = addr,
+		.request = quadspi_dma_request,
+		.callback = read ? quadspi_dma_read_done : NULL,
+	};
+	bool words = !(addr & 3) && !(len & 3);
+	uint32_t count = words ? len / 4 : len;
+
+	if (!len || count > 0xffff) {
+		return -1;
+	}
+
+	cfg.flags = DMA_XFER_MINC | DMA_XFER_PL_HIGH |
+		    (read ? DMA_XFER_PERIPH_TO_MEM : DMA_XFER_MEM_TO_PERIPH);
+	cfg.flags |= words ? DMA_XFER_MSIZE_32BIT | DMA_XFER_PSIZE_32BIT :
+			     DMA_XFER_MSIZE_8BIT | DMA_XFER_PSIZE_8BIT;
+	cfg.count = count;
+
+	quadspi_cb = callback;
+	quadspi_cb_data = user_data;
+
+	while (QUADSPI_SR & QUADSPI_SR_BUSY);
+	quadspi_set_fifo_threshold(words ? 4 : 1);
+	dma_xfer_setup(quadspi_dma, quadspi_dma_channel, &cfg);
+	dma_xfer_start(quadspi_dma, quadspi_dma_channel);
+	QUADSPI_CR |= read ? QUADSPI_CR_TEIE :
+			     QUADSPI_CR_TCIE | QUADSPI_CR_TEIE;
+
+	quadspi_start(cmd, fmode, len);
+	QUADSPI_CR |= QUADSPI_CR_DMAEN;
+	return 0;
+}
+
+int quadspi_read_dma(const struct quadspi_command *cmd, void *data,
+		     uint32_t len, quadspi_callback callback, void *user_data)
+{
+	return quadspi_dma_start(cmd, QUADSPI_CCR_FMODE_IREAD, (uint32_t)data,
+				 len, callback, user_data);
+}
+
+int quadspi_write_dma(const struct quadspi_command *cmd, const void *data,
+		      uint32_t len, quadspi_callback callback,
+		      void *user_data)
+{
+	return quadspi_dma_start(cmd, QUADSPI_CCR_FMODE_IWRITE,
+				 (uint32_t)data, len, callback, user_data);
+}
+
+#endif
+
+void quadspi_irq_handler(void)
+{
+#if defined(QUADSPI_CR_DMAEN)
+	uint32_t sr = QUADSPI_SR;
+	uint32_t cr = QUADSPI_CR;
+
+	/* Only the flags of enabled interrupts, a DMA read leaves TCF. */
+	if (!(cr & QUADSPI_CR_TCIE)) {
+		sr &= ~QUADSPI_SR_TCF;
+	}
+	if (!(cr & QUADSPI_CR_TEIE)) {
+		sr &= ~QUADSPI_SR_TEF;
+	}
+	if (!(sr & (QUADSPI_SR_TCF | QUADSPI_SR_TEF))) {
+		return;
+	}
+
+	quadspi_dma_finish(sr & QUADSPI_SR_TEF);
+#endif
+}
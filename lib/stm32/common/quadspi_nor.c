@@ -0,0 +1,297 @@
+/** @addtogroup quadspi_nor_file QuadSPI NOR flash API
+@ingroup peripheral_apis
+
+@brief JEDEC serial NOR flash command set on top of the QuadSPI driver.
+
+Covers the commands common to the usual quad SPI NOR parts: identification,
+status, write enable, sector/block/chip erase, page program and quad I/O
+read. Busy waits use the automatic status polling of the QuadSPI on the WIP
+bit, so the CPU does not have to issue the status reads itself.
+
+Programs go out as 1-1-4 quad page programs (0x32), reads as 1-4-4 quad I/O
+reads (0xEB) with a mode byte of 0xFF, i.e. without continuous read mode.
+Quad mode must already be enabled in the device (QE bit) where needed, this
+is vendor specific.
+
+The QuadSPI is set up with quadspi_setup() and enabled before use.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <libopencm3/stm32/quadspi_nor.h>
+
+/* Instruction only command, or instruction followed by single line data. */
+static void quadspi_nor_simple(struct quadspi_command *cmd, uint8_t opcode,
+			       bool data)
+{
+	*cmd = (struct quadspi_command) {
+		.instruction = opcode,
+		.instruction_mode = QUADSPI_CCR_MODE_1LINE,
+		.data_mode = data ? QUADSPI_CCR_MODE_1LINE :
+				    QUADSPI_CCR_MODE_NONE,
+	};
+}
+
+/* Instruction with a single line address, using the 4-byte variant of the
+ * opcode if the flash is addressed with 4 bytes.
+ */
+static void quadspi_nor_addressed(const struct quadspi_nor *nor,
+				  struct quadspi_command *cmd, uint8_t opcode,
+				  uint8_t opcode4b, uint32_t addr)
+{
+	quadspi_nor_simple(cmd, nor->address_size == 4 ? opcode4b : opcode,
+			   false);
+	cmd->address_mode = QUADSPI_CCR_MODE_1LINE;
+	cmd->address_size = nor->address_size;
+	cmd->address = addr;
+}
+
+static void quadspi_nor_read_command(const struct quadspi_nor *nor,
+				     struct quadspi_command *cmd, uint32_t addr)
+{
+	quadspi_nor_addressed(nor, cmd, QUADSPI_NOR_CMD_4READ,
+			      QUADSPI_NOR_CMD_4READ4B, addr);
+	cmd->address_mode = QUADSPI_CCR_MODE_4LINE;
+	cmd->alternate_mode = QUADSPI_CCR_MODE_4LINE;
+	cmd->alternate_size = 1;
+	cmd->alternate = 0xff;
+	cmd->dummy_cycles = nor->read_dummy_cycles;
+	cmd->data_mode = QUADSPI_CCR_MODE_4LINE;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Read the JEDEC identification.
+
+@param[out] id Manufacturer ID followed by the device ID bytes.
+@param[in] len Number of bytes to read, usually 3.
+@returns 0 on success, -1 on a transfer error.
+*/
+
+int quadspi_nor_read_id(uint8_t *id, uint32_t len)
+{
+	struct quadspi_command cmd;
+
+	quadspi_nor_simple(&cmd, QUADSPI_NOR_CMD_RDID, true);
+	return quadspi_read(&cmd, id, len);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Read status register 1.
+
+@param[out] status Status register, @ref QUADSPI_NOR_SR_WIP etc.
+@returns 0 on success, -1 on a transfer error.
+*/
+
+int quadspi_nor_read_status(uint8_t *status)
+{
+	struct quadspi_command cmd;
+
+	quadspi_nor_simple(&cmd, QUADSPI_NOR_CMD_RDSR, true);
+	return quadspi_read(&cmd, status, 1);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Set the write enable latch.
+
+Waits until the device reports WEL set.
+
+@param[in] nor Flash description.
+@returns 0 on success, -1 on a transfer error or timeout.
+*/
+
+int quadspi_nor_write_enable(const struct quadspi_nor *nor)
+{
+	struct quadspi_command cmd;
+
+	quadspi_nor_simple(&cmd, QUADSPI_NOR_CMD_WREN, false);
+	if (quadspi_command(&cmd) < 0) {
+		return -1;
+	}
+
+	quadspi_nor_simple(&cmd, QUADSPI_NOR_CMD_RDSR, true);
+	return quadspi_auto_poll(&cmd, 1, QUADSPI_NOR_SR_WEL,
+				 QUADSPI_NOR_SR_WEL, 16, nor->timeout);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Wait for the end of a program or erase operation.
+
+The status register is polled by the QuadSPI until WIP reads as 0.
+
+@param[in] nor Flash description, its timeout field bounds the wait.
+@returns 0 once the device is ready, -1 on a transfer error or timeout.
+*/
+
+int quadspi_nor_wait_ready(const struct quadspi_nor *nor)
+{
+	struct quadspi_command cmd;
+
+	quadspi_nor_simple(&cmd, QUADSPI_NOR_CMD_RDSR, true);
+	return quadspi_auto_poll(&cmd, 1, 0, QUADSPI_NOR_SR_WIP, 16,
+				 nor->timeout);
+}
+
+static int quadspi_nor_erase(const struct quadspi_nor *nor,
+			     struct quadspi_command *cmd)
+{
+	if (quadspi_nor_write_enable(nor) < 0 ||
+	    quadspi_command(cmd) < 0) {
+		return -1;
+	}
+	return quadspi_nor_wait_ready(nor);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Erase the 4 KiB sector containing an address.
+
+@param[in] nor Flash description.
+@param[in] addr Any address within the sector.
+@returns 0 on success, -1 on a transfer error or timeout.
+*/
+
+int quadspi_nor_erase_sector(const struct quadspi_nor *nor, uint32_t addr)
+{
+	struct quadspi_command cmd;
+
+	quadspi_nor_addressed(nor, &cmd, QUADSPI_NOR_CMD_SE,
+			      QUADSPI_NOR_CMD_SE4B, addr);
+	return quadspi_nor_erase(nor, &cmd);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Erase the 64 KiB block containing an address.
+
+@param[in] nor Flash description.
+@param[in] addr Any address within the block.
+@returns 0 on success, -1 on a transfer error or timeout.
+*/
+
+int quadspi_nor_erase_block(const struct quadspi_nor *nor, uint32_t addr)
+{
+	struct quadspi_command cmd;
+
+	quadspi_nor_addressed(nor, &cmd, QUADSPI_NOR_CMD_BE,
+			      QUADSPI_NOR_CMD_BE4B, addr);
+	return quadspi_nor_erase(nor, &cmd);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Erase the whole device.
+
+This takes seconds to minutes depending on the size, set the timeout of @p
+nor accordingly.
+
+@param[in] nor Flash description.
+@returns 0 on success, -1 on a transfer error or timeout.
+*/
+
+int quadspi_nor_erase_chip(const struct quadspi_nor *nor)
+{
+	struct quadspi_command cmd;
+
+	quadspi_nor_simple(&cmd, QUADSPI_NOR_CMD_CE, false);
+	return quadspi_nor_erase(nor, &cmd);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Program data.
+
+The data is split at page boundaries, each page is written with a quad page
+program and completed before the next one is started. The area must have
+been erased.
+
+@param[in] nor Flash description.
+@param[in] addr Flash address to start at.
+@param[in] data Data to program.
+@param[in] len Number of bytes.
+@returns 0 on success, -1 on a transfer error or timeout.
+*/
+
+int quadspi_nor_program(const struct quadspi_nor *nor, uint32_t addr,
+			const void *data, uint32_t len)
+{
+	const uint8_t *p = data;
+	struct quadspi_command cmd;
+
+	while (len) {
+		uint32_t chunk = QUADSPI_NOR_PAGE_SIZE -
+				 (addr & (QUADSPI_NOR_PAGE_SIZE - 1));
+
+		if (chunk > len) {
+			chunk = len;
+		}
+
+		quadspi_nor_addressed(nor, &cmd, QUADSPI_NOR_CMD_QPP,
+				      QUADSPI_NOR_CMD_QPP4B, addr);
+		cmd.data_mode = QUADSPI_CCR_MODE_4LINE;
+
+		if (quadspi_nor_write_enable(nor) < 0 ||
+		    quadspi_write(&cmd, p, chunk) < 0 ||
+		    quadspi_nor_wait_ready(nor) < 0) {
+			return -1;
+		}
+
+		addr += chunk;
+		p += chunk;
+		len -= chunk;
+	}
+
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Read data with a quad I/O read.
+
+@param[in] nor Flash description.
+@param[in] addr Flash address to start at.
+@param[out] data Destination buffer.
+@param[in] len Number of bytes.
+@returns 0 on success, -1 on a transfer error.
+*/
+
+int quadspi_nor_read(const struct quadspi_nor *nor, uint32_t addr,
+		     void *data, uint32_t len)
+{
+	struct quadspi_command cmd;
+
+	quadspi_nor_read_command(nor, &cmd, addr);
+	return quadspi_read(&cmd, data, len);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Map the flash into the address space for execute in place.
+
+Sets up memory-mapped mode with the quad I/O read, the flash then reads
+from @ref QUADSPI_MEM_BASE onwards. Call quadspi_abort() before issuing
+other commands.
+
+@param[in] nor Flash description.
+*/
+
+void quadspi_nor_memory_mapped(const struct quadspi_nor *nor)
+{
+	struct quadspi_command cmd;
+
+	quadspi_nor_read_command(nor, &cmd, 0);
+	quadspi_memory_mapped(&cmd, 0);
+}
+
+/**@}*/
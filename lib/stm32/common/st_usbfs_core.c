@@ -233,6 +233,7 @@ uint16_t st_usbfs_ep_read_packet(usbd_device *dev, uint8_t addr,
 	return len;
 }
 
+LIBOPENCM3_RAMFUNC
 void st_usbfs_poll(usbd_device *dev)
 {
 	uint16_t istr = *USB_ISTR_REG;
@@ -536,6 +536,50 @@ void timer_set_master_mode(uint32_t timer_peripheral, uint32_t mode)
 	TIM_CR2(timer_peripheral) |= mode;
 }
 
+/*---------------------------------------------------------------------------*/
+/** @brief Set up a Timer as a Trigger Clock.
+
+The counter is stopped and programmed to emit TRGO on every update event
+at @p rate, using the smallest prescaler that fits the period into 16 bits,
+so the rate is as exact as the timer allows. The prescaler and period are
+loaded right away. Start the counter with @ref timer_enable_counter.
+
+@param[in] timer_peripheral Unsigned int32. Timer register address base @ref
+tim_reg_base
+@param[in] timer_clk Unsigned int32. Input clock of the timer in Hz.
+@param[in] rate Unsigned int32. Requested update rate in Hz.
+@returns Unsigned int32. The rate actually achieved in Hz, 0 if @p rate is 0
+or too low to reach with a 16 bit prescaler; the timer is left untouched
+then.
+*/
+
+uint32_t timer_set_trgo_rate(uint32_t timer_peripheral, uint32_t timer_clk,
+			     uint32_t rate)
+{
+	uint32_t ticks, psc, arr;
+
+	if (rate == 0) {
+		return 0;
+	}
+	ticks = (timer_clk + rate / 2) / rate;
+	if (ticks < 2) {
+		ticks = 2;
+	}
+	psc = (ticks - 1) / 0x10000;
+	if (psc > 0xffff) {
+		return 0;
+	}
+	arr = (ticks + psc / 2) / (psc + 1) - 1;
+
+	timer_disable_counter(timer_peripheral);
+	timer_set_prescaler(timer_peripheral, psc);
+	timer_set_period(timer_peripheral, arr);
+	timer_set_master_mode(timer_peripheral, TIM_CR2_MMS_UPDATE);
+	timer_generate_event(timer_peripheral, TIM_EGR_UG);
+
+	return timer_clk / ((psc + 1) * (arr + 1));
+}
+
 /*---------------------------------------------------------------------------*/
 /** @brief Set Timer DMA Requests on Capture/Compare Events.
 
@@ -0,0 +1,419 @@
+/** @addtogroup usart_dma_file USART DMA ring buffer API
+@ingroup peripheral_apis
+
+@brief Buffered USART driver moving all data through DMA.
+
+Reception runs as a circular DMA transfer into a ring buffer that never
+stops. Received data is published in variable length chunks whenever the
+line goes idle or the DMA passes the half or the end of the ring, so a
+whole frame costs a handful of interrupts instead of one per character.
+
+Transmission copies into a second ring and hands the longest contiguous
+run of pending bytes to the DMA. The transfer complete interrupt chains
+the next run, so the CPU is not involved while a burst drains.
+
+The DMA channels are configured through the DMA transfer layer, which also
+routes the USART requests to them. The application keeps ownership of
+clocks, GPIOs and the USART line settings. It calls @ref
+usart_dma_irq_handler from the USART interrupt and dma_xfer_irq_handler()
+from the interrupts of both DMA channels.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <string.h>
+#include <libopencm3/cm3/assert.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/stm32/dma_xfer.h>
+#include <libopencm3/stm32/usart_dma.h>
+
+#if defined(USART_RDR)
+#define USART_DMA_RX_REG(usart)	((uint32_t)&USART_RDR(usart))
+#define USART_DMA_TX_REG(usart)	((uint32_t)&USART_TDR(usart))
+#else
+#define USART_DMA_RX_REG(usart)	((uint32_t)&USART_DR(usart))
+#define USART_DMA_TX_REG(usart)	((uint32_t)&USART_DR(usart))
+#endif
+
+/*
+ * Clears IDLE and the errors raised through EIE, returns true if the line
+ * went idle. Framing and noise errors only mark a byte the DMA took anyway.
+ */
+static bool usart_dma_ack_line_events(struct usart_dma_ring *ring)
+{
+	bool idle = usart_get_flag(ring->usart, USART_FLAG_IDLE);
+	bool ore = usart_get_flag(ring->usart, USART_FLAG_ORE);
+	bool err = usart_get_flag(ring->usart, USART_FLAG_FE) ||
+		   usart_get_flag(ring->usart, USART_FLAG_NF);
+
+	if (!idle && !ore && !err) {
+		return false;
+	}
+	if (ore) {
+		ring->rx_overruns++;
+	}
+#if defined(USART_ICR_IDLECF)
+	USART_ICR(ring->usart) = USART_ICR_IDLECF | USART_ICR_ORECF |
+				 USART_ICR_FECF | USART_ICR_NCF;
+#else
+	/*
+	 * The SR read above followed by a DR read clears all flags. A byte
+	 * waiting in DR belongs to the DMA, whose own read then completes the
+	 * sequence, so DR is only read with the DMA request masked and RXNE
+	 * clear.
+	 */
+	CM_ATOMIC_BLOCK() {
+		usart_disable_rx_dma(ring->usart);
+		if (!usart_get_flag(ring->usart, USART_FLAG_RXNE)) {
+			(void)USART_DR(ring->usart);
+		}
+		usart_enable_rx_dma(ring->usart);
+	}
+#endif
+	return idle;
+}
+
+/* Must be called with the TX DMA channel idle or from its interrupt. */
+static void usart_dma_tx_kick(struct usart_dma_ring *ring)
+{
+	uint16_t head = ring->tx_head;
+	uint16_t tail = ring->tx_tail;
+	uint16_t len;
+
+	if (ring->tx_inflight || head == tail) {
+		return;
+	}
+
+	len = (head > tail) ? head - tail : ring->tx_size - tail;
+	ring->tx_inflight = len;
+
+	dma_xfer_reload(ring->dma, ring->tx_channel,
+			(uint32_t)&ring->tx_buf[tail], len);
+	dma_xfer_start(ring->dma, ring->tx_channel);
+}
+
+static void usart_dma_rx_dma_event(uint32_t dma, uint8_t channel,
+				   uint32_t events, void *user_data)
+{
+	(void)dma;
+	(void)channel;
+	(void)events;
+	usart_dma_rx_poll(user_data);
+}
+
+static void usart_dma_tx_dma_event(uint32_t dma, uint8_t channel,
+				   uint32_t events, void *user_data)
+{
+	struct usart_dma_ring *ring = user_data;
+	uint16_t tail;
+
+	(void)dma;
+	(void)channel;
+	(void)events;
+
+	if (!ring->tx_inflight) {
+		return;
+	}
+	/* On a bus error the run is dropped rather than retried forever. */
+	tail = ring->tx_tail + ring->tx_inflight;
+	ring->tx_tail = (tail == ring->tx_size) ? 0 : tail;
+	ring->tx_inflight = 0;
+	usart_dma_tx_kick(ring);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Initialise a DMA backed USART.
+
+Both DMA channels are reset and configured for byte transfers between the
+USART data register and the given buffers, but nothing is started yet.
+Either direction may be left out by passing a NULL buffer.
+
+@param[out] ring Driver state to initialise.
+@param[in] usart USART block register address base @ref usart_reg_base
+@param[in] dma DMA controller base address serving both directions.
+@param[in] rx_channel DMA channel or stream serving USART RX.
+@param[in] rx_request Request routed to @p rx_channel, see struct
+dma_xfer_config.
+@param[in] rx_buf RX ring storage, NULL to disable reception.
+@param[in] rx_size Size of @p rx_buf in bytes, at least 2.
+@param[in] tx_channel DMA channel or stream serving USART TX.
+@param[in] tx_request Request routed to @p tx_channel.
+@param[in] tx_buf TX ring storage, NULL to disable transmission.
+@param[in] tx_size Size of @p tx_buf in bytes, at least 2. One byte is kept
+free to tell a full ring from an empty one.
+@param[in] rx_callback Called from interrupt context for each chunk of
+received data.
+*/
+
+void usart_dma_init(struct usart_dma_ring *ring, uint32_t usart, uint32_t dma,
+		    uint8_t rx_channel, uint8_t rx_request,
+		    uint8_t *rx_buf, uint16_t rx_size,
+		    uint8_t tx_channel, uint8_t tx_request,
+		    uint8_t *tx_buf, uint16_t tx_size,
+		    usart_dma_rx_callback rx_callback)
+{
+	cm3_assert(!rx_buf || rx_size >= 2);
+	cm3_assert(!tx_buf || tx_size >= 2);
+
+	ring->usart = usart;
+	ring->dma = dma;
+	ring->rx_channel = rx_channel;
+	ring->tx_channel = tx_channel;
+	ring->rx_buf = rx_buf;
+	ring->rx_size = rx_buf ? rx_size : 0;
+	ring->rx_tail = 0;
+	ring->rx_callback = rx_callback;
+	ring->rx_overruns = 0;
+	ring->tx_buf = tx_buf;
+	ring->tx_size = tx_buf ? tx_size : 0;
+	ring->tx_head = 0;
+	ring->tx_tail = 0;
+	ring->tx_inflight = 0;
+
+	if (rx_buf) {
+		struct dma_xfer_config cfg = {
+			.flags = DMA_XFER_PERIPH_TO_MEM | DMA_XFER_MINC |
+				 DMA_XFER_CIRCULAR | DMA_XFER_HALF_IRQ |
+				 DMA_XFER_PL_HIGH,
+			.periph_addr = USART_DMA_RX_REG(usart),
+			.mem_addr = (uint32_t)rx_buf,
+			.count = rx_size,
+			.request = rx_request,
+			.callback = usart_dma_rx_dma_event,
+			.user_data = ring,
+		};
+		dma_xfer_setup(dma, rx_channel, &cfg);
+	}
+
+	if (tx_buf) {
+		struct dma_xfer_config cfg = {
+			.flags = DMA_XFER_MEM_TO_PERIPH | DMA_XFER_MINC |
+				 DMA_XFER_PL_HIGH,
+			.periph_addr = USART_DMA_TX_REG(usart),
+			.mem_addr = (uint32_t)tx_buf,
+			.request = tx_request,
+			.callback = usart_dma_tx_dma_event,
+			.user_data = ring,
+		};
+		dma_xfer_setup(dma, tx_channel, &cfg);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Start a DMA backed USART.
+
+Restarts the circular RX transfer from the start of the ring, enables the
+USART DMA requests, the idle line and error interrupts, and enables the
+USART itself. On parts with USART
+FIFOs these are switched on as well, so the DMA is requested in bursts.
+
+@param[in] ring Driver state set up by @ref usart_dma_init.
+*/
+
+void usart_dma_start(struct usart_dma_ring *ring)
+{
+#if defined(USART_CR1_FIFOEN)
+	usart_enable_fifos(ring->usart);
+	usart_set_rx_fifo_threshold(ring->usart, USART_FIFO_THRESH_HALF);
+	usart_set_tx_fifo_threshold(ring->usart, USART_FIFO_THRESH_HALF);
+#endif
+	if (ring->rx_buf) {
+		ring->rx_tail = 0;
+		/* A stopped channel keeps its count, begin a fresh lap. */
+		dma_xfer_reload(ring->dma, ring->rx_channel,
+				(uint32_t)ring->rx_buf, ring->rx_size);
+		dma_xfer_start(ring->dma, ring->rx_channel);
+		usart_enable_rx_dma(ring->usart);
+		usart_enable_idle_interrupt(ring->usart);
+		usart_enable_error_interrupt(ring->usart);
+	}
+	if (ring->tx_buf) {
+		usart_enable_tx_dma(ring->usart);
+	}
+	usart_enable(ring->usart);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Stop a DMA backed USART.
+
+Both DMA channels are stopped and the USART DMA requests and interrupts
+are disabled. Data still queued for transmission is discarded.
+
+@param[in] ring Driver state set up by @ref usart_dma_init.
+*/
+
+void usart_dma_stop(struct usart_dma_ring *ring)
+{
+	usart_disable_idle_interrupt(ring->usart);
+	usart_disable_error_interrupt(ring->usart);
+	usart_disable_rx_dma(ring->usart);
+	usart_disable_tx_dma(ring->usart);
+
+	if (ring->rx_buf) {
+		dma_xfer_stop(ring->dma, ring->rx_channel);
+	}
+	if (ring->tx_buf) {
+		dma_xfer_stop(ring->dma, ring->tx_channel);
+	}
+	ring->tx_head = 0;
+	ring->tx_tail = 0;
+	ring->tx_inflight = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Get the free space in the TX ring.
+
+@param[in] ring Driver state set up by @ref usart_dma_init.
+@returns Number of bytes @ref usart_dma_write can accept right now, always
+0 if transmission is disabled.
+*/
+
+uint16_t usart_dma_tx_free(struct usart_dma_ring *ring)
+{
+	uint16_t head = ring->tx_head;
+	uint16_t tail = ring->tx_tail;
+
+	if (!ring->tx_size) {
+		return 0;
+	}
+	if (head >= tail) {
+		return ring->tx_size - 1 - (head - tail);
+	}
+	return tail - head - 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Check whether transmission is still in progress.
+
+Only the DMA side is covered. The last byte may still be in the shift
+register when this turns false; wait for USART TC before turning an RS-485
+transceiver around.
+
+@param[in] ring Driver state set up by @ref usart_dma_init.
+@returns true while bytes are queued or being moved by the DMA.
+*/
+
+bool usart_dma_tx_busy(struct usart_dma_ring *ring)
+{
+	return ring->tx_inflight || ring->tx_head != ring->tx_tail;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Queue data for transmission.
+
+Copies as much of @p data as fits into the TX ring and starts the DMA if
+it is idle. Never blocks. Must not be called concurrently for the same
+ring from different contexts.
+
+@param[in] ring Driver state set up by @ref usart_dma_init.
+@param[in] data Bytes to send.
+@param[in] len Number of bytes in @p data.
+@returns Number of bytes queued, less than @p len if the ring is full.
+*/
+
+uint16_t usart_dma_write(struct usart_dma_ring *ring, const uint8_t *data,
+			 uint16_t len)
+{
+	uint16_t space = usart_dma_tx_free(ring);
+	uint16_t head = ring->tx_head;
+	uint16_t n, i;
+
+	if (len > space) {
+		len = space;
+	}
+
+	for (i = 0; i < len; i += n) {
+		n = ring->tx_size - head;
+		if (n > len - i) {
+			n = len - i;
+		}
+		memcpy(&ring->tx_buf[head], &data[i], n);
+		head += n;
+		if (head == ring->tx_size) {
+			head = 0;
+		}
+	}
+	ring->tx_head = head;
+
+	CM_ATOMIC_BLOCK() {
+		usart_dma_tx_kick(ring);
+	}
+
+	return len;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Publish data received so far.
+
+Reports everything the RX DMA has written since the last call to the RX
+callback. This is done automatically from the interrupt handlers, but
+may also be called to flush a partial frame without waiting for the line
+to go idle. Must not race with the interrupt handler.
+
+@param[in] ring Driver state set up by @ref usart_dma_init.
+*/
+
+void usart_dma_rx_poll(struct usart_dma_ring *ring)
+{
+	uint16_t tail = ring->rx_tail;
+	uint16_t head;
+
+	head = ring->rx_size - dma_get_number_of_data(ring->dma,
+						      ring->rx_channel);
+	if (head == ring->rx_size) {
+		head = 0;
+	}
+	if (head == tail) {
+		return;
+	}
+
+	ring->rx_tail = head;
+	if (!ring->rx_callback) {
+		return;
+	}
+
+	if (head > tail) {
+		ring->rx_callback(ring, &ring->rx_buf[tail], head - tail);
+	} else {
+		ring->rx_callback(ring, &ring->rx_buf[tail],
+				  ring->rx_size - tail);
+		if (head) {
+			ring->rx_callback(ring, ring->rx_buf, head);
+		}
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Service a DMA backed USART.
+
+Handles idle line detection and overruns. Call from the USART interrupt.
+
+@param[in] ring Driver state set up by @ref usart_dma_init.
+*/
+
+void usart_dma_irq_handler(struct usart_dma_ring *ring)
+{
+	if (ring->rx_buf && usart_dma_ack_line_events(ring)) {
+		usart_dma_rx_poll(ring);
+	}
+}
+
+/**@}*/
@@ -46,4 +46,28 @@ void pwr_set_vos_scale(enum pwr_vos_scale scale)
 	PWR_CR = reg32;
 }
 
+/** @brief Enable the regulator over-drive mode.
+
+Required for a system clock above 168 MHz on the F42x/F43x/F446/F469/F479,
+with voltage scale 1 selected. Call with the PLL running but before
+switching to it, the switch stalls the core while the regulator ramps up.
+*/
+void pwr_enable_overdrive(void)
+{
+	PWR_CR |= PWR_CR_ODEN;
+	while (!(PWR_CSR & PWR_CSR_ODRDY));
+	PWR_CR |= PWR_CR_ODSWEN;
+	while (!(PWR_CSR & PWR_CSR_ODSWRDY));
+}
+
+/** @brief Disable the regulator over-drive mode.
+
+The system clock must be at or below 168 MHz.
+*/
+void pwr_disable_overdrive(void)
+{
+	PWR_CR &= ~(PWR_CR_ODEN | PWR_CR_ODSWEN);
+	while (PWR_CSR & PWR_CSR_ODSWRDY);
+}
+
 /**@}*/
\ No newline at end of file
@@ -38,6 +38,7 @@
  */
 
 #include <libopencm3/cm3/assert.h>
+#include <libopencm3/stm32/dbgmcu.h>
 #include <libopencm3/stm32/rcc.h>
 #include <libopencm3/stm32/pwr.h>
 #include <libopencm3/stm32/flash.h>
@@ -544,14 +545,18 @@ void rcc_css_disable(void)
 
 /**
  * Set the dividers for the PLLI2S clock outputs
+ *
+ * The other fields, e.g. PLLI2SM on parts that have it, are kept.
  * @param n valid range depends on target device, check your RefManual.
  * @param r valid range is 2..7
  */
 void rcc_plli2s_config(uint16_t n, uint8_t r)
 {
-	RCC_PLLI2SCFGR = (
+	RCC_PLLI2SCFGR = (RCC_PLLI2SCFGR &
+	  ~((RCC_PLLI2SCFGR_PLLI2SN_MASK << RCC_PLLI2SCFGR_PLLI2SN_SHIFT) |
+	    (RCC_PLLI2SCFGR_PLLI2SR_MASK << RCC_PLLI2SCFGR_PLLI2SR_SHIFT))) |
 	  ((n & RCC_PLLI2SCFGR_PLLI2SN_MASK) << RCC_PLLI2SCFGR_PLLI2SN_SHIFT) |
-	  ((r & RCC_PLLI2SCFGR_PLLI2SR_MASK) << RCC_PLLI2SCFGR_PLLI2SR_SHIFT));
+	  ((r & RCC_PLLI2SCFGR_PLLI2SR_MASK) << RCC_PLLI2SCFGR_PLLI2SR_SHIFT);
 }
 
 /**
@@ -749,6 +754,23 @@ void rcc_clock_setup_pll(const struct rcc_clock_scale *clock)
 	rcc_osc_on(RCC_PLL);
 	rcc_wait_for_osc_ready(RCC_PLL);
 
+	if (clock->overdrive) {
+		pwr_enable_overdrive();
+	}
+
+	if (clock->plli2sn) {
+		rcc_osc_off(RCC_PLLI2S);
+		if (clock->plli2sm) {
+			RCC_PLLI2SCFGR = (RCC_PLLI2SCFGR &
+				~(RCC_PLLI2SCFGR_PLLI2SM_MASK <<
+				  RCC_PLLI2SCFGR_PLLI2SM_SHIFT)) |
+				(clock->plli2sm << RCC_PLLI2SCFGR_PLLI2SM_SHIFT);
+		}
+		rcc_plli2s_config(clock->plli2sn, clock->plli2sr);
+		rcc_osc_on(RCC_PLLI2S);
+		rcc_wait_for_osc_ready(RCC_PLLI2S);
+	}
+
 	/* Configure flash settings. */
 	if (clock->flash_config & FLASH_ACR_DCEN) {
 		flash_dcache_enable();
@@ -779,6 +801,289 @@ void rcc_clock_setup_pll(const struct rcc_clock_scale *clock)
 	}
 }
 
+/* Limits of the F4 lines at 2.7 V and above, by DBGMCU_IDCODE device ID. */
+struct rcc_f4_limits {
+	uint16_t dev_id;
+	/** SYSCLK maximum, with over-drive where available */
+	uint8_t sysclk_mhz;
+	/** SYSCLK maximum in each voltage scale without over-drive */
+	uint8_t scale1_mhz;
+	uint8_t scale2_mhz;
+	uint8_t scale3_mhz;
+	uint8_t apb1_mhz;
+	uint8_t apb2_mhz;
+	/** RCC_F4_PLLI2S_xxx */
+	uint8_t plli2s;
+	/** Highest value of the FLASH_ACR LATENCY field */
+	uint8_t max_latency;
+	/** HCLK per flash wait state from 2.7 V, 2.4 V, 2.1 V and below */
+	uint8_t ws_mhz[4];
+};
+
+#define RCC_F4_PLLI2S_NONE	0
+/* The PLLI2S input is divided by PLLM */
+#define RCC_F4_PLLI2S_PLLM	1
+/* The PLLI2S input has its own PLLI2SM divider */
+#define RCC_F4_PLLI2S_OWN_M	2
+
+/* The first entry is used for unknown or unreadable IDs: the lowest limits
+ * of all lines, without a PLLI2S whose layout is unknown. The F40x has no
+ * scale 3, the F401 no scale 1. Only the F40x has a 3 bit LATENCY field.
+ */
+#define RCC_F4_WS_F40X	{ 30, 24, 22, 20 }
+#define RCC_F4_WS_F401	{ 30, 24, 18, 16 }
+
+static const struct rcc_f4_limits rcc_f4_limits[] = {
+	{ 0x000, 84, 84, 84, 0, 42, 84, RCC_F4_PLLI2S_NONE,
+	  7, RCC_F4_WS_F401 },		/* unknown */
+	{ 0x413, 168, 168, 144, 0, 42, 84, RCC_F4_PLLI2S_PLLM,
+	  7, RCC_F4_WS_F40X },		/* F40x/F41x */
+	{ 0x419, 180, 168, 144, 120, 45, 90, RCC_F4_PLLI2S_PLLM,
+	  15, RCC_F4_WS_F40X },		/* F42x/F43x */
+	{ 0x421, 180, 168, 144, 120, 45, 90, RCC_F4_PLLI2S_OWN_M,
+	  15, RCC_F4_WS_F40X },		/* F446 */
+	{ 0x434, 180, 168, 144, 120, 45, 90, RCC_F4_PLLI2S_PLLM,
+	  15, RCC_F4_WS_F40X },		/* F469/F479 */
+	{ 0x423, 84, 84, 84, 60, 42, 84, RCC_F4_PLLI2S_PLLM,
+	  15, RCC_F4_WS_F401 },		/* F401xB/C */
+	{ 0x433, 84, 84, 84, 60, 42, 84, RCC_F4_PLLI2S_PLLM,
+	  15, RCC_F4_WS_F401 },		/* F401xD/E */
+	{ 0x431, 100, 100, 84, 64, 50, 100, RCC_F4_PLLI2S_PLLM,
+	  15, RCC_F4_WS_F401 },		/* F411 */
+	{ 0x458, 100, 100, 84, 64, 50, 100, RCC_F4_PLLI2S_NONE,
+	  15, RCC_F4_WS_F401 },		/* F410 */
+	{ 0x441, 100, 100, 84, 64, 50, 100, RCC_F4_PLLI2S_OWN_M,
+	  15, RCC_F4_WS_F401 },		/* F412 */
+	{ 0x463, 100, 100, 84, 64, 50, 100, RCC_F4_PLLI2S_OWN_M,
+	  15, RCC_F4_WS_F401 },		/* F413/F423 */
+};
+
+#define RCC_MHZ			1000000
+#define RCC_HSI_FREQUENCY	(16 * RCC_MHZ)
+
+static const struct rcc_f4_limits *rcc_f4_get_limits(uint16_t dev_id)
+{
+	unsigned i;
+
+	if (!dev_id) {
+		dev_id = DBGMCU_IDCODE & DBGMCU_IDCODE_DEV_ID_MASK;
+	}
+
+	for (i = 1; i < sizeof(rcc_f4_limits) / sizeof(rcc_f4_limits[0]);
+	     i++) {
+		if (rcc_f4_limits[i].dev_id == dev_id) {
+			return &rcc_f4_limits[i];
+		}
+	}
+	return &rcc_f4_limits[0];
+}
+
+/* Smallest APB prescaler that keeps the bus within its limit. */
+static uint8_t rcc_solve_ppre(uint32_t hclk, uint32_t max, uint32_t *freq)
+{
+	uint8_t ppre = RCC_CFGR_PPRE_NODIV;
+	uint32_t div = 1;
+
+	while (hclk / div > max && ppre != RCC_CFGR_PPRE_DIV16) {
+		ppre = div == 1 ? RCC_CFGR_PPRE_DIV2 : ppre + 1;
+		div *= 2;
+	}
+	*freq = hclk / div;
+	return ppre;
+}
+
+/* HCLK per flash wait state at the supply voltage, from the access time
+ * table of the reference manual of the line. 0 mV means 2.7 V or more.
+ */
+static uint32_t rcc_f4_ws_step(const struct rcc_f4_limits *lim,
+			       uint16_t vdd_mv)
+{
+	unsigned range;
+
+	if (!vdd_mv || vdd_mv >= 2700) {
+		range = 0;
+	} else if (vdd_mv >= 2400) {
+		range = 1;
+	} else if (vdd_mv >= 2100) {
+		range = 2;
+	} else {
+		range = 3;
+	}
+	return lim->ws_mhz[range] * RCC_MHZ;
+}
+
+/* Closest PLLI2S output to the target, from PLLM or from any PLLI2SM
+ * keeping the VCO input at 1-2 MHz.
+ */
+static void rcc_solve_plli2s(uint32_t fin, bool own_m, uint32_t target,
+			     struct rcc_clock_scale *clock)
+{
+	uint32_t best_err = UINT32_MAX;
+	uint32_t m = own_m ? 2 : clock->pllm;
+	uint32_t m_last = own_m ? 63 : clock->pllm;
+	uint32_t n, r;
+
+	for (; m <= m_last; m++) {
+		if (fin / m < RCC_MHZ || fin / m > 2 * RCC_MHZ) {
+			continue;
+		}
+		for (n = 50; n <= 432; n++) {
+			uint32_t vco = (uint64_t)fin * n / m;
+
+			if (vco < 100 * RCC_MHZ || vco > 432 * RCC_MHZ) {
+				continue;
+			}
+			for (r = 2; r <= 7; r++) {
+				uint32_t f = vco / r;
+				uint32_t err = f > target ? f - target :
+							    target - f;
+
+				if (err < best_err) {
+					best_err = err;
+					clock->plli2sm = own_m ? m : 0;
+					clock->plli2sn = n;
+					clock->plli2sr = r;
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Compute a clock configuration from board and application requirements.
+ *
+ * Searches the main PLL dividers for the highest SYSCLK the device allows,
+ * or @p target->sysclk_max if lower, keeping the VCO input at 1-2 MHz and
+ * the VCO at 100-432 MHz. When USB is required, only settings with an exact
+ * 48 MHz PLL48CK are considered. Among equal results the highest VCO input,
+ * i.e. the lowest jitter, wins. The bus prescalers, voltage scale,
+ * over-drive and the lowest legal flash latency for the supply voltage are
+ * then derived for the device read from DBGMCU_IDCODE, or given in
+ * @p target->dev_id. An unknown device gets the lowest limits of the F4
+ * lines, 84 MHz and no PLLI2S. Below 2.1 V there is no over-drive, SYSCLK
+ * stays at or below 168 MHz, and at or below 160 MHz on the F40x, whose
+ * LATENCY field ends at 7 wait states.
+ *
+ * @code
+ *	struct rcc_clock_scale clock;
+ *	const struct rcc_clock_target target = {
+ *		.hse_frequency = 24000000,
+ *		.usb = true,
+ *	};
+ *
+ *	if (rcc_clock_solve(&target, &clock) == 0) {
+ *		rcc_clock_setup_pll(&clock);
+ *	}
+ * @endcode
+ *
+ * @param target Requirements.
+ * @param clock Filled in for @ref rcc_clock_setup_pll.
+ * @returns 0 on success, -1 if no PLL setting satisfies the requirements
+ * or an I2S clock is asked for on a device without PLLI2S.
+ */
+int rcc_clock_solve(const struct rcc_clock_target *target,
+		    struct rcc_clock_scale *clock)
+{
+	const struct rcc_f4_limits *lim = rcc_f4_get_limits(target->dev_id);
+	uint32_t fin = target->hse_frequency ? target->hse_frequency :
+					       RCC_HSI_FREQUENCY;
+	uint32_t max = lim->sysclk_mhz * RCC_MHZ;
+	uint32_t best = 0;
+	uint32_t step;
+	uint32_t m, n, p, q;
+
+	if (target->i2s_frequency && lim->plli2s == RCC_F4_PLLI2S_NONE) {
+		return -1;
+	}
+	/* Over-drive needs 2.1 V or more. */
+	if (target->vdd_mv && target->vdd_mv < 2100 &&
+	    max > lim->scale1_mhz * RCC_MHZ) {
+		max = lim->scale1_mhz * RCC_MHZ;
+	}
+	/* The wait states must fit the LATENCY field, e.g. 160 MHz on the
+	 * F40x below 2.1 V.
+	 */
+	step = rcc_f4_ws_step(lim, target->vdd_mv);
+	if (max > (lim->max_latency + 1) * step) {
+		max = (lim->max_latency + 1) * step;
+	}
+	if (target->sysclk_max && target->sysclk_max < max) {
+		max = target->sysclk_max;
+	}
+
+	*clock = (struct rcc_clock_scale) {
+		.pll_source = target->hse_frequency ? RCC_CFGR_PLLSRC_HSE_CLK :
+						      RCC_CFGR_PLLSRC_HSI_CLK,
+		.hpre = RCC_CFGR_HPRE_NODIV,
+	};
+
+	for (m = 2; m <= 63; m++) {
+		uint32_t vco_in = fin / m;
+
+		if (fin % m || vco_in < RCC_MHZ || vco_in > 2 * RCC_MHZ) {
+			continue;
+		}
+		for (n = 50; n <= 432; n++) {
+			uint32_t vco = vco_in * n;
+
+			if (vco < 100 * RCC_MHZ || vco > 432 * RCC_MHZ) {
+				continue;
+			}
+			if (target->usb && vco % (48 * RCC_MHZ)) {
+				continue;
+			}
+			/* Slowest PLL48CK that does not exceed 48 MHz */
+			q = (vco + 48 * RCC_MHZ - 1) / (48 * RCC_MHZ);
+			if (q < 2) {
+				q = 2;
+			}
+			if (q > 15) {
+				continue;
+			}
+			for (p = 2; p <= 8; p += 2) {
+				uint32_t sysclk = vco / p;
+
+				if (sysclk > max || sysclk <= best) {
+					continue;
+				}
+				best = sysclk;
+				clock->pllm = m;
+				clock->plln = n;
+				clock->pllp = p;
+				clock->pllq = q;
+			}
+		}
+	}
+
+	if (!best) {
+		return -1;
+	}
+
+	if (target->i2s_frequency) {
+		rcc_solve_plli2s(fin, lim->plli2s == RCC_F4_PLLI2S_OWN_M,
+				 target->i2s_frequency, clock);
+	}
+
+	clock->ahb_frequency = best;
+	clock->ppre1 = rcc_solve_ppre(best, lim->apb1_mhz * RCC_MHZ,
+				      &clock->apb1_frequency);
+	clock->ppre2 = rcc_solve_ppre(best, lim->apb2_mhz * RCC_MHZ,
+				      &clock->apb2_frequency);
+
+	if (best <= lim->scale3_mhz * RCC_MHZ) {
+		clock->voltage_scale = PWR_SCALE3;
+	} else if (best <= lim->scale2_mhz * RCC_MHZ) {
+		clock->voltage_scale = PWR_SCALE2;
+	} else {
+		clock->voltage_scale = PWR_SCALE1;
+	}
+	clock->overdrive = best > lim->scale1_mhz * RCC_MHZ;
+
+	clock->flash_config = FLASH_ACR_DCEN | FLASH_ACR_ICEN |
+			      FLASH_ACR_LATENCY((best - 1) / step);
+	return 0;
+}
+
 /**
  * Setup clocks with the HSE.
  *
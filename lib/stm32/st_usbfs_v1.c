@@ -54,6 +54,7 @@ static usbd_device *st_usbfs_v1_usbd_init(void)
 	return &st_usbfs_dev;
 }
 
+LIBOPENCM3_RAMFUNC
 void st_usbfs_copy_to_pm(volatile void *vPM, const void *buf, uint16_t len)
 {
 	const uint16_t *lbuf = buf;
@@ -70,6 +71,7 @@ void st_usbfs_copy_to_pm(volatile void *vPM, const void *buf, uint16_t len)
  * @param vPM Destination pointer into packet memory.
  * @param len Number of bytes to copy.
  */
+LIBOPENCM3_RAMFUNC
 void st_usbfs_copy_from_pm(void *buf, const volatile void *vPM, uint16_t len)
 {
 	uint16_t *lbuf = buf;
@@ -41,6 +41,7 @@ static usbd_device *st_usbfs_v2_usbd_init(void)
 	return &st_usbfs_dev;
 }
 
+LIBOPENCM3_RAMFUNC
 void st_usbfs_copy_to_pm(volatile void *vPM, const void *buf, uint16_t len)
 {
 	/*
@@ -62,6 +63,7 @@ void st_usbfs_copy_to_pm(volatile void *vPM, const void *buf, uint16_t len)
  * @param vPM Source pointer into packet memory.
  * @param len Number of bytes to copy.
  */
+LIBOPENCM3_RAMFUNC
 void st_usbfs_copy_from_pm(void *buf, const volatile void *vPM, uint16_t len)
 {
 	const volatile uint16_t *PM = vPM;
@@ -190,6 +190,7 @@ void dwc_ep_nak_set(usbd_device *usbd_dev, uint8_t addr, uint8_t nak)
 	}
 }
 
+LIBOPENCM3_RAMFUNC
 uint16_t dwc_ep_write_packet(usbd_device *usbd_dev, uint8_t addr,
 			      const void *buf, uint16_t len)
 {
@@ -238,6 +239,7 @@ uint16_t dwc_ep_write_packet(usbd_device *usbd_dev, uint8_t addr,
 	return len;
 }
 
+LIBOPENCM3_RAMFUNC
 uint16_t dwc_ep_read_packet(usbd_device *usbd_dev, uint8_t addr,
 				  void *buf, uint16_t len)
 {
@@ -321,6 +323,7 @@ static void dwc_flush_txfifo(usbd_device *usbd_dev, int ep)
 	}
 }
 
+LIBOPENCM3_RAMFUNC
 void dwc_poll(usbd_device *usbd_dev)
 {
 	/* Read interrupt status register. */
@@ -82,14 +82,29 @@
  *		usbd_poll(usb_dev);
  *	}
  * @endcode
+ *
+ * <b>DMA transfers</b>
+ *
+ * Endpoints 1 to 3 have uDMA request lines, on channels 0 to 5 with their
+ * default assignment. @ref usb_ep_dma_write and @ref usb_ep_dma_read move a
+ * whole multi-packet transfer between memory and the endpoint FIFO without
+ * the CPU, the controller setting TXRDY and clearing RXRDY for each full
+ * packet by itself. Completion is reported from @ref usbd_poll(), so the USB
+ * interrupt must be used. The uDMA must be set up with @ref udma_init first:
+ * @code{.c}
+ *	udma_init();
+ *	usbd_dev = usbd_init(&lm4f_usb_driver, ...);
+ *	...
+ *	usb_ep_dma_write(0x81, buf, sizeof(buf), bulk_in_done, NULL);
+ * @endcode
  * @{
  */
 
 /*
  * TODO list:
  *
- * 1) Driver works by reading and writing to the FIFOs one byte at a time. It
- * has no knowledge of DMA.
+ * 1) ep_write_packet() and ep_read_packet() still copy through the FIFOs
+ * with the CPU, only the usb_ep_dma_*() transfers use the uDMA.
  * 2) Double-buffering is supported. How can we take advantage of it to speed
  * up endpoint transfers.
  * 3) No benchmarks as to the endpoint's performance has been done.
@@ -102,14 +117,34 @@
 #include <libopencm3/cm3/common.h>
 #include <libopencm3/lm4f/usb.h>
 #include <libopencm3/lm4f/rcc.h>
+#include <libopencm3/lm4f/udma.h>
 #include <libopencm3/usb/usbd.h>
 #include "../../lib/usb/usb_private.h"
 
 #include <stdbool.h>
+#include <stddef.h>
 
 
 #define MAX_FIFO_RAM	(4 * 1024)
 
+/* Endpoints with uDMA channels, OUT on channel 2n - 2 and IN on 2n - 1 */
+#define LM4F_USB_DMA_EPS	3
+#define LM4F_USB_DMA_CHANNELS	((1 << (2 * LM4F_USB_DMA_EPS)) - 1)
+
+struct lm4f_usb_dma {
+	usb_dma_callback callback;
+	void *user_data;
+	uint16_t len;
+	/* log2 of the uDMA item size */
+	uint8_t shift;
+	bool active;
+};
+
+/* Indexed by endpoint - 1, then OUT and IN */
+static struct lm4f_usb_dma lm4f_usb_dma[LM4F_USB_DMA_EPS][2];
+/* The uDMA is only touched once a transfer was started */
+static bool lm4f_usb_dma_used;
+
 const struct _usbd_driver lm4f_usb_driver;
 
 /**
@@ -291,11 +326,23 @@ static void lm4f_ep_setup(usbd_device *usbd_dev, uint8_t addr, uint8_t type,
 
 static void lm4f_endpoints_reset(usbd_device *usbd_dev)
 {
+	int i;
+
 	/*
 	 * The core resets the endpoints automatically on reset.
 	 * The first 64 bytes are always reserved for EP0
 	 */
 	usbd_dev->fifo_mem_top = 64;
+
+	/* Transfers cannot survive it */
+	for (i = 1; i <= LM4F_USB_DMA_EPS; i++) {
+		if (lm4f_usb_dma[i - 1][0].active) {
+			usb_ep_dma_abort(i);
+		}
+		if (lm4f_usb_dma[i - 1][1].active) {
+			usb_ep_dma_abort(i | 0x80);
+		}
+	}
 }
 
 static void lm4f_ep_stall_set(usbd_device *usbd_dev, uint8_t addr,
@@ -455,6 +502,248 @@ static uint16_t lm4f_ep_read_packet(usbd_device *usbd_dev, uint8_t addr,
 	return rlen;
 }
 
+static uint8_t lm4f_usb_dma_channel(uint8_t addr)
+{
+	return ((addr & 0xf) - 1) * 2 + ((addr & 0x80) ? 1 : 0);
+}
+
+static struct lm4f_usb_dma *lm4f_usb_dma_state(uint8_t addr)
+{
+	return &lm4f_usb_dma[(addr & 0xf) - 1][(addr & 0x80) ? 1 : 0];
+}
+
+/* Leave DMA mode on the endpoint, the uDMA channel is stopped */
+static void lm4f_usb_dma_disable(uint8_t addr)
+{
+	const uint8_t ep = addr & 0xf;
+
+	if (addr & 0x80) {
+		USB_TXCSRH(ep) &= ~(USB_TXCSRH_AUTOSET | USB_TXCSRH_DMAEN |
+				    USB_TXCSRH_DMAMOD);
+	} else {
+		USB_RXCSRH(ep) &= ~(USB_RXCSRH_AUTOCL | USB_RXCSRH_DMAEN |
+				    USB_RXCSRH_DMAMOD);
+	}
+	lm4f_usb_dma_state(addr)->active = false;
+}
+
+/* Report the end of a transfer, normal or cut short */
+static void lm4f_usb_dma_end(uint8_t addr)
+{
+	struct lm4f_usb_dma *dma = lm4f_usb_dma_state(addr);
+	uint8_t ch = lm4f_usb_dma_channel(addr);
+	uint16_t done;
+
+	done = dma->len - (udma_cycle_remaining(ch) << dma->shift);
+	udma_cycle_stop(ch);
+	lm4f_usb_dma_disable(addr);
+
+	/* AUTOSET only sends full packets, the short one is ours */
+	if ((addr & 0x80) && (done % USB_TXMAXP(addr & 0xf))) {
+		USB_TXCSRL(addr & 0xf) |= USB_TXCSRL_TXRDY;
+	}
+
+	if (dma->callback) {
+		dma->callback(addr, done, dma->user_data);
+	}
+}
+
+static void lm4f_usb_dma_done(uint8_t ch, uint32_t events, void *user_data)
+{
+	uint8_t addr = ch / 2 + 1;
+
+	(void)events;
+	(void)user_data;
+
+	if (ch & 1) {
+		addr |= 0x80;
+	}
+	if (lm4f_usb_dma_state(addr)->active) {
+		lm4f_usb_dma_end(addr);
+	}
+}
+
+/* Whole words when possible, the FIFO takes them as is */
+static uint8_t lm4f_usb_dma_shift(const void *buf, uint16_t len,
+				  uint16_t maxp)
+{
+	if ((((uint32_t)buf | len | maxp) & 0x3) == 0) {
+		return 2;
+	}
+	return 0;
+}
+
+/* One packet per arbitration, the FIFO side does not increment */
+static uint32_t lm4f_usb_dma_control(uint8_t shift, uint16_t maxp, bool in)
+{
+	uint32_t items = maxp >> shift;
+	uint32_t arb = UDMA_ARB_1;
+	uint32_t control;
+
+	while (arb < UDMA_ARB_1024 && (2U << arb) <= items) {
+		arb++;
+	}
+
+	/* The size and increment encodings are both log2 of the bytes */
+	control = (shift << UDMA_CHCTL_SRCSIZE_SHIFT) |
+		  (shift << UDMA_CHCTL_DSTSIZE_SHIFT) |
+		  UDMA_CHCTL_ARBSIZE(arb);
+	if (in) {
+		control |= (shift << UDMA_CHCTL_SRCINC_SHIFT) |
+			   UDMA_CHCTL_DSTINC_NONE;
+	} else {
+		control |= UDMA_CHCTL_SRCINC_NONE |
+			   (shift << UDMA_CHCTL_DSTINC_SHIFT);
+	}
+	return control;
+}
+
+static int lm4f_usb_dma_start(uint8_t addr, uint32_t buf, uint16_t len,
+			      uint16_t maxp, usb_dma_callback callback,
+			      void *user_data)
+{
+	const uint8_t ep = addr & 0xf;
+	const bool in = addr & 0x80;
+	struct lm4f_usb_dma *dma;
+	uint8_t ch;
+	uint8_t shift;
+
+	if (ep < 1 || ep > LM4F_USB_DMA_EPS || len == 0 || maxp == 0) {
+		return -1;
+	}
+
+	dma = lm4f_usb_dma_state(addr);
+	ch = lm4f_usb_dma_channel(addr);
+	shift = lm4f_usb_dma_shift((const void *)buf, len, maxp);
+	if (dma->active || (len >> shift) > UDMA_MAX_COUNT) {
+		return -1;
+	}
+
+	dma->callback = callback;
+	dma->user_data = user_data;
+	dma->len = len;
+	dma->shift = shift;
+	dma->active = true;
+	lm4f_usb_dma_used = true;
+
+	udma_channel_assign(ch, 0);
+	udma_set_callback(ch, lm4f_usb_dma_done, NULL);
+	if (in) {
+		udma_cycle_basic(ch, buf, (uint32_t)&USB_FIFO32(ep),
+				 len >> shift,
+				 lm4f_usb_dma_control(shift, maxp, true));
+		USB_TXCSRH(ep) |= USB_TXCSRH_AUTOSET | USB_TXCSRH_DMAEN |
+				  USB_TXCSRH_DMAMOD;
+	} else {
+		udma_cycle_basic(ch, (uint32_t)&USB_FIFO32(ep), buf,
+				 len >> shift,
+				 lm4f_usb_dma_control(shift, maxp, false));
+		USB_RXCSRH(ep) |= USB_RXCSRH_AUTOCL | USB_RXCSRH_DMAEN |
+				  USB_RXCSRH_DMAMOD;
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Send a buffer on an IN endpoint with the uDMA
+ *
+ * The buffer is split into packets of the endpoint's maximum size, the last
+ * one may be short. A transfer ending on a full packet is not terminated
+ * with a zero length packet, send one with usbd_ep_write_packet() when the
+ * protocol needs it.
+ *
+ * The IN callback of the endpoint is not called while the transfer runs.
+ * The DMA callback comes once the last byte is in the FIFO, before the
+ * packet is sent: the packets still in the FIFO then, the last one and
+ * possibly the one before, are reported to the IN callback as they leave,
+ * like packets written with usbd_ep_write_packet(). Wait for that callback
+ * before writing a zero length packet.
+ *
+ * Word aligned buffers whose length is a multiple of four go up to 4096
+ * bytes, others up to 1024.
+ *
+ * @param[in] addr Endpoint address, 0x81 to 0x83
+ * @param[in] buf Data, must stay valid until the callback
+ * @param[in] len Number of bytes
+ * @param[in] callback Called from @ref usbd_poll() once the last byte is in
+ *		       the FIFO, may be NULL
+ * @param[in] user_data Passed to the callback
+ * @return 0 if started, -1 if the endpoint has no DMA, is busy or the
+ *	   length is out of range
+ */
+int usb_ep_dma_write(uint8_t addr, const void *buf, uint16_t len,
+		     usb_dma_callback callback, void *user_data)
+{
+	const uint8_t ep = addr & 0xf;
+
+	if (ep >= 1 && ep <= LM4F_USB_DMA_EPS &&
+	    (USB_TXCSRL(ep) & USB_TXCSRL_TXRDY)) {
+		return -1;
+	}
+
+	return lm4f_usb_dma_start(ep | 0x80, (uint32_t)buf, len,
+				  USB_TXMAXP(ep), callback, user_data);
+}
+
+/**
+ * \brief Receive into a buffer from an OUT endpoint with the uDMA
+ *
+ * The transfer ends after @a len bytes or with a short packet. A short
+ * packet is left in the FIFO: the callback reports the bytes received
+ * before it, then the OUT callback of the endpoint is called as usual to
+ * read it with usbd_ep_read_packet(). The OUT callback is not called for
+ * the full packets of the transfer.
+ *
+ * @param[in] addr Endpoint address, 0x01 to 0x03
+ * @param[out] buf Data, must stay valid until the callback
+ * @param[in] len Number of bytes, a multiple of the endpoint's maximum
+ *		  packet size. Same limits as @ref usb_ep_dma_write.
+ * @param[in] callback Called from @ref usbd_poll() at the end of the
+ *		       transfer, may be NULL
+ * @param[in] user_data Passed to the callback
+ * @return 0 if started, -1 if the endpoint has no DMA, is busy or the
+ *	   length is not valid
+ */
+int usb_ep_dma_read(uint8_t addr, void *buf, uint16_t len,
+		    usb_dma_callback callback, void *user_data)
+{
+	const uint8_t ep = addr & 0xf;
+	uint16_t maxp;
+
+	if (ep < 1 || ep > LM4F_USB_DMA_EPS) {
+		return -1;
+	}
+
+	/* Only full packets raise DMA requests */
+	maxp = USB_RXMAXP(ep);
+	if (maxp == 0 || len % maxp) {
+		return -1;
+	}
+
+	return lm4f_usb_dma_start(ep, (uint32_t)buf, len, maxp, callback,
+				  user_data);
+}
+
+/**
+ * \brief Cancel the DMA transfer of an endpoint
+ *
+ * The callback is not called. Packets already in the FIFO stay there.
+ *
+ * @param[in] addr Endpoint address
+ */
+void usb_ep_dma_abort(uint8_t addr)
+{
+	const uint8_t ep = addr & 0xf;
+
+	if (ep < 1 || ep > LM4F_USB_DMA_EPS) {
+		return;
+	}
+
+	udma_cycle_stop(lm4f_usb_dma_channel(addr));
+	lm4f_usb_dma_disable(addr);
+}
+
 static void lm4f_poll(usbd_device *usbd_dev)
 {
 	void (*tx_cb)(usbd_device *usbd_dev, uint8_t ea);
@@ -471,6 +760,11 @@ static void lm4f_poll(usbd_device *usbd_dev)
 	const uint8_t usb_txis = USB_TXIS;
 	const uint8_t usb_csrl0 = USB_CSRL0;
 
+	/* Completed DMA transfers, before the packets that follow them */
+	if (lm4f_usb_dma_used) {
+		udma_irq_handler(LM4F_USB_DMA_CHANNELS);
+	}
+
 	if ((usb_is & USB_IM_SUSPEND) && (usbd_dev->user_callback_suspend)) {
 		usbd_dev->user_callback_suspend();
 	}
@@ -547,6 +841,18 @@ static void lm4f_poll(usbd_device *usbd_dev)
 		tx_cb = usbd_dev->user_callback_ctr[i][USB_TRANSACTION_IN];
 		rx_cb = usbd_dev->user_callback_ctr[i][USB_TRANSACTION_OUT];
 
+		/* The packets of a running DMA transfer are not ours */
+		if (i <= LM4F_USB_DMA_EPS &&
+		    lm4f_usb_dma_state(i | 0x80)->active) {
+			tx_cb = NULL;
+		}
+
+		/* Only a short packet interrupts a DMA reception */
+		if ((usb_rxis & (1 << i)) && i <= LM4F_USB_DMA_EPS &&
+		    lm4f_usb_dma_state(i)->active) {
+			lm4f_usb_dma_end(i);
+		}
+
 		if ((usb_txis & (1 << i)) && tx_cb) {
 			tx_cb(usbd_dev, i);
 		}
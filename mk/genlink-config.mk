@@ -64,6 +64,13 @@ $(warning $(OPENCM3_DIR)/lib/libopencm3_$(genlink_family).a library variant for
 endif
 endif
 
+# the flavors are built next to the default library, see lib/Makefile.include
+ifneq ($(OPENCM3_FLAVOR),)
+ifneq ($(LIBNAME),)
+LIBNAME := $(LIBNAME)_$(OPENCM3_FLAVOR)
+endif
+endif
+
 LDLIBS += -l$(LIBNAME)
 LIBDEPS += $(OPENCM3_DIR)/lib/lib$(LIBNAME).a
 
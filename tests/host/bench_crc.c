@@ -0,0 +1,82 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Time crc_calculate_block() of one library flavor, run by 'make bench'.
+ *
+ * The CRC unit is plain simulated memory, so this measures the code the
+ * compiler made of the driver and of the register accesses, the share of
+ * the optimisation level and of inlining across the library. Flash wait
+ * states and RAM placement only show on the target, time it there with the
+ * DWT cycle counter.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <time.h>
+#include <libopencm3/stm32/crc.h>
+
+#define WORDS		256
+#define RUNS		5
+#define RUN_NS		100000000
+
+/* Keeps the results, and so the calls */
+static volatile uint32_t bench_sink;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+	static uint32_t data[WORDS];
+	double best = 0;
+	unsigned i;
+	int run;
+
+	for (i = 0; i < WORDS; i++) {
+		data[i] = i * 0x9e3779b9;
+	}
+
+	/* Best of a few runs, each long enough for the clock */
+	for (run = 0; run < RUNS; run++) {
+		uint64_t start = now_ns();
+		uint64_t elapsed;
+		unsigned long blocks = 0;
+		double ns;
+
+		do {
+			bench_sink = crc_calculate_block(data, WORDS);
+			blocks++;
+			elapsed = now_ns() - start;
+		} while (elapsed < RUN_NS);
+
+		ns = (double)elapsed / ((double)blocks * WORDS);
+		if (run == 0 || ns < best) {
+			best = ns;
+		}
+	}
+
+	printf("crc_calculate_block %-6s %6.2f ns/word\n",
+	       argc > 1 ? argv[1] : "", best);
+	return 0;
+}
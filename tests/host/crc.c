@@ -0,0 +1,116 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The STM32 CRC driver against a model of the CRC unit in the simulated
+ * register file: CRC-32/MPEG-2 over whole words, reset by CRC_CR_RESET.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <libopencm3/host/mmio_sim.h>
+#include <libopencm3/stm32/crc.h>
+
+#define CRC_DR_ADDR	(CRC_BASE + 0x00)
+#define CRC_CR_ADDR	(CRC_BASE + 0x08)
+
+static unsigned crc_model_words;
+static int failures;
+
+static uint32_t crc_word(uint32_t crc, uint32_t data)
+{
+	int i;
+
+	crc ^= data;
+	for (i = 0; i < 32; i++) {
+		crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+	}
+	return crc;
+}
+
+static void crc_model_write(uint32_t addr, uint8_t size, uint64_t old,
+			    uint64_t val, void *user_data)
+{
+	(void)size;
+	(void)user_data;
+
+	if (addr == CRC_DR_ADDR) {
+		mmio_sim_poke32(addr, crc_word(old, val));
+		crc_model_words++;
+	} else if (addr == CRC_CR_ADDR && (val & CRC_CR_RESET)) {
+		/* The bit clears itself */
+		mmio_sim_poke32(CRC_DR_ADDR, 0xffffffff);
+		mmio_sim_poke32(addr, val & ~CRC_CR_RESET);
+	}
+}
+
+static const struct mmio_sim_ops crc_model_ops = {
+	.write = crc_model_write,
+};
+
+#define CHECK(expr) \
+	do { \
+		if (!(expr)) { \
+			printf("%s:%d: %s\n", __FILE__, __LINE__, #expr); \
+			failures++; \
+		} \
+	} while (0)
+
+int main(void)
+{
+	uint32_t data[] = { 0x12345678, 0x9abcdef0, 0x0badcafe, 0xdeadbeef };
+	uint32_t expect = 0xffffffff;
+	unsigned i;
+
+	if (mmio_sim_attach(CRC_BASE, 0x400, &crc_model_ops, NULL)) {
+		printf("cannot attach the CRC model\n");
+		return EXIT_FAILURE;
+	}
+
+	mmio_sim_poke32(CRC_DR_ADDR, 0x5a5a5a5a);
+	crc_reset();
+	mmio_sim_flush();
+	CHECK(mmio_sim_peek32(CRC_DR_ADDR) == 0xffffffff);
+	CHECK(!(mmio_sim_peek32(CRC_CR_ADDR) & CRC_CR_RESET));
+
+	/* Known value of the CRC unit */
+	CHECK(crc_calculate(0x12345678) == 0xdf8a8a2b);
+
+	crc_reset();
+	crc_model_words = 0;
+	for (i = 0; i < sizeof(data) / sizeof(data[0]); i++) {
+		expect = crc_word(expect, data[i]);
+	}
+	CHECK(crc_calculate_block(data, 4) == expect);
+	CHECK(crc_model_words == 4);
+
+	/* Without a reset the block continues the previous result */
+	expect = crc_word(expect, data[0]);
+	CHECK(crc_calculate_block(data, 1) == expect);
+
+	/* A word equal to the current result, the register keeps its value */
+	crc_reset();
+	crc_model_words = 0;
+	expect = crc_word(0xffffffff, 0xffffffff);
+	CHECK(crc_calculate(0xffffffff) == expect);
+	CHECK(crc_model_words == 1);
+
+	mmio_sim_reset();
+
+	printf("crc: %s\n", failures ? "FAIL" : "OK");
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,109 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The simulated register file itself: regions without a fixed limit,
+ * overlaps refused, pages created on demand around attached regions, and
+ * every store reported to the write callback.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <libopencm3/host/mmio_sim.h>
+
+#define REGIONS		1000
+
+static int failures;
+/* Set from the signal handler of the store, behind the compiler's back */
+static volatile unsigned writes;
+static volatile uint64_t write_old;
+static volatile uint64_t write_val;
+static volatile uint8_t write_size;
+
+static void count_write(uint32_t addr, uint8_t size, uint64_t old,
+			uint64_t val, void *user_data)
+{
+	(void)addr;
+	(void)user_data;
+
+	writes++;
+	write_size = size;
+	write_old = old;
+	write_val = val;
+}
+
+static const struct mmio_sim_ops count_ops = {
+	.write = count_write,
+};
+
+#define CHECK(expr) \
+	do { \
+		if (!(expr)) { \
+			printf("%s:%d: %s\n", __FILE__, __LINE__, #expr); \
+			failures++; \
+		} \
+	} while (0)
+
+int main(void)
+{
+	uint32_t i;
+
+	/* More peripherals than any part has */
+	for (i = 0; i < REGIONS; i++) {
+		CHECK(mmio_sim_attach(0x40000000 + i * 0x400, 0x400, NULL,
+				      NULL) == 0);
+	}
+	CHECK(mmio_sim_attach(0x40000200, 0x400, NULL, NULL) == -1);
+
+	for (i = 0; i < REGIONS; i++) {
+		MMIO32(0x40000000 + i * 0x400 + 0x3fc) = i;
+	}
+	for (i = 0; i < REGIONS; i++) {
+		CHECK(mmio_sim_peek32(0x40000000 + i * 0x400 + 0x3fc) == i);
+	}
+
+	/* A page on demand, clipped to the gap before the first region */
+	MMIO32(0x3ffffffc) = 0x12345678;
+	CHECK(MMIO32(0x3ffffffc) == 0x12345678);
+	CHECK(MMIO32(0x40000000) == 0);
+
+	mmio_sim_reset();
+	CHECK(mmio_sim_attach(0x40000200, 0x400, NULL, NULL) == 0);
+	mmio_sim_reset();
+
+	/* Every store is seen, also one leaving the value as it was */
+	CHECK(mmio_sim_attach(0x50000000, 0x400, &count_ops, NULL) == 0);
+	MMIO32(0x50000010) = 5;
+	MMIO32(0x50000010) = 5;
+	mmio_sim_flush();
+	CHECK(writes == 2);
+	CHECK(write_old == 5 && write_val == 5 && write_size == 4);
+	MMIO16(0x50000012) |= 0;
+	CHECK(writes == 3 && write_size == 2);
+	CHECK(MMIO32(0x50000010) == 5);
+	CHECK(writes == 3);
+
+	/* Not reported when done by the simulation */
+	mmio_sim_poke32(0x50000010, 7);
+	CHECK(mmio_sim_peek32(0x50000010) == 7);
+	mmio_sim_flush();
+	CHECK(writes == 3);
+	mmio_sim_reset();
+
+	printf("mmio_sim: %s\n", failures ? "FAIL" : "OK");
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}